@@ -29,7 +29,7 @@
 /** NDArray constructor, no parameters.
   * Initializes all fields to 0.  Creates the attribute linked list and linked list mutex. */
 NDArray::NDArray()
-  : referenceCount(0), pNDArrayPool(0), pDriver(0),
+  : referenceCount(0), pReleaseFunc(0), pReleasePvt(0), pNDArrayPool(0), pDriver(0),
     uniqueId(0), timeStamp(0.0), ndims(0), dataType(NDInt8),
     dataSize(0),  pData(0)
 {
@@ -41,7 +41,7 @@ NDArray::NDArray()
 }
 
 NDArray::NDArray(int nDims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData)
-  : referenceCount(0), pNDArrayPool(0), pDriver(0),
+  : referenceCount(0), pReleaseFunc(0), pReleasePvt(0), pNDArrayPool(0), pDriver(0),
     uniqueId(0), timeStamp(0.0), ndims(nDims), dataType(dataType),
     dataSize(dataSize),  pData(0)
 {
@@ -85,6 +85,22 @@ typedef struct NDArrayInfo {
     size_t colorStride;     /**< The number of array elements between color values */
 } NDArrayInfo_t;
 
+/** How NDArrayPool::copy() copies the attributes of the input array */
+typedef enum
+{
+    NDCopyAttributesReplace,  /**< The output attributes are deleted and replaced with copies of the input attributes */
+    NDCopyAttributesUpdate,   /**< Output attributes with the same names as input attributes are reused and their
+                                *  values are updated, so no memory is allocated if the output array already has them.
+                                *  Other output attributes are kept, as for an array from NDArrayPool::alloc(). */
+    NDCopyAttributesNone      /**< The output attributes are not changed */
+} NDCopyAttributes_t;
+
+/** Function called by NDArrayPool when the last reference to an NDArray whose data buffer is not
+  * owned by the pool is released.
+  * \param[in] pData The data buffer that was passed to NDArrayPool::alloc().
+  * \param[in] pvt The private pointer that was passed to NDArrayPool::alloc(). */
+typedef void (*NDArrayReleaseFunc_t)(void *pData, void *pvt);
+
 /** N-dimensional array class; each array has a set of dimensions, a data type, pointer to data, and optional attributes. 
   * An NDArray also has a uniqueId and timeStamp that to identify it. NDArray objects can be allocated
   * by an NDArrayPool object, which maintains a free list of NDArrays for efficient memory management. */
@@ -100,12 +116,15 @@ public:
     int          reserve();
     int          release();
     int          getReferenceCount() const {return referenceCount;}
+    NDArrayReleaseFunc_t getReleaseFunc() const {return pReleaseFunc;}
     int          report(FILE *fp, int details);
     friend class NDArrayPool;
     
 private:
     ELLNODE      node;              /**< This must come first because ELLNODE must have the same address as NDArray object */
     int          referenceCount;    /**< Reference count for this NDArray=number of clients who are using it */
+    NDArrayReleaseFunc_t pReleaseFunc; /**< Function that frees pData if the buffer is not owned by the pool */
+    void         *pReleasePvt;      /**< Private pointer passed to pReleaseFunc */
 
 public:
     class NDArrayPool *pNDArrayPool;  /**< The NDArrayPool object that created this array */
@@ -161,8 +180,11 @@ class epicsShareClass NDArrayPool {
 public:
     NDArrayPool  (class asynNDArrayDriver *pDriver, size_t maxMemory);
     virtual ~NDArrayPool() {}
-    NDArray*     alloc(int ndims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData);
-    NDArray*     copy(NDArray *pIn, NDArray *pOut, bool copyData, bool copyDimensions=true, bool copyDataType=true);
+    NDArray*     alloc(int ndims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData,
+                       NDArrayReleaseFunc_t releaseFunc=NULL, void *releasePvt=NULL);
+    NDArray*     copy(NDArray *pIn, NDArray *pOut, bool copyData, bool copyDimensions=true, bool copyDataType=true,
+                      NDCopyAttributes_t copyAttributes=NDCopyAttributesReplace);
+    NDArray*     share(NDArray *pIn);
 
     int          reserve(NDArray *pArray);
     int          release(NDArray *pArray);
@@ -195,6 +217,9 @@ private:
     int          numBuffers_;
     size_t       maxMemory_;     /**< Maximum bytes of memory this object is allowed to allocate; -1=unlimited */
     size_t       memorySize_;    /**< Number of bytes of memory this object has currently allocated */
+    int          numCopies_;     /**< Number of times copy() has copied array data */
+    double       copyBytes_;     /**< Number of bytes of array data copied by copy() */
+    double       copySeconds_;   /**< Time spent copying array data in copy() */
     class asynNDArrayDriver *pDriver_; /**< The asynNDArrayDriver that created this object */
 };
 
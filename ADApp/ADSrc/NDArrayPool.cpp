@@ -9,6 +9,15 @@
 #include <stdlib.h>
 #include <dbDefs.h>
 #include <stdint.h>
+#include <algorithm>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STREAM_COPY
+#endif
 
 #include <cantProceed.h>
 
@@ -18,12 +27,38 @@
 
 #include "asynNDArrayDriver.h"
 #include "NDArray.h"
+#include "NDWorkerPool.h"
 
 // How much larger an NDArray must be than the required size before it is considered "too large"
 #define THRESHOLD_SIZE_RATIO 1.5
 
+// Arrays at least this large are allocated on a page boundary, so that file plugins can write them with O_DIRECT
+#define PAGE_ALIGN_SIZE 65536
+#define PAGE_ALIGNMENT 4096
+
+// Arrays that are copied or only change data type are split into bands of whole blocks
+#define BAND_BLOCK_BYTES 4096
+#define BAND_BLOCK_ELEMENTS 1024
+
+// Cache size used for NDArrayPoolStreamBytes=0 if the size of the last level cache is not known
+#define DEFAULT_CACHE_SIZE (32*1024*1024)
+
 static const char *driverName = "NDArrayPool";
 
+/** Allocates the data buffer of an NDArray.  The buffer is released with free().
+  * On Linux large buffers are aligned on a page boundary. */
+static void *allocData(size_t dataSize)
+{
+#ifdef __linux__
+  if (dataSize >= PAGE_ALIGN_SIZE) {
+    void *pData;
+    if (posix_memalign(&pData, PAGE_ALIGNMENT, dataSize) != 0) return NULL;
+    return pData;
+  }
+#endif
+  return malloc(dataSize);
+}
+
 
 /** eraseNDAttributes is a global flag the controls whether NDArray::clearAttributes() is called
   * each time a new array is allocated with NDArrayPool->alloc().
@@ -37,13 +72,190 @@ static const char *driverName = "NDArrayPool";
 volatile int eraseNDAttributes=0;
 extern "C" {epicsExportAddress(int, eraseNDAttributes);}
 
+/** NDArrayPoolThreads is the number of threads in the process-wide pool that NDArrayPool::convert()
+  * and NDArrayPool::copy() use for large arrays.  These arrays are split into bands of rows, and the
+  * calling thread processes one band while the pool threads process the others.
+  * The pool is shared by all drivers and plugins in the IOC, and it is created the first time a
+  * large array is converted or copied, so this variable must be set before then, normally before iocInit.
+  * Set it to 0 to process all arrays in the calling thread.
+  */
+volatile int NDArrayPoolThreads=4;
+extern "C" {epicsExportAddress(int, NDArrayPoolThreads);}
+
+/** NDArrayPoolThreadBytes is the size in bytes of the smallest array that is split across threads.
+  * Smaller arrays are converted and copied by the calling thread, because the cost of waking
+  * the pool threads would be larger than the time saved.
+  */
+volatile int NDArrayPoolThreadBytes=8*1024*1024;
+extern "C" {epicsExportAddress(int, NDArrayPoolThreadBytes);}
+
+/** NDArrayPoolStreamBytes is the size in bytes of the smallest array data that NDArrayPool::copy() copies
+  * with non-temporal stores.  These write to memory without reading the output buffer into the caches,
+  * or evicting the data that other threads are working on.  0 (the default) uses the size of the last level
+  * cache, and a negative value always uses memcpy.  Non-temporal stores are only used on x86 with SSE2.
+  */
+volatile int NDArrayPoolStreamBytes=0;
+extern "C" {epicsExportAddress(int, NDArrayPoolStreamBytes);}
+
+/** Returns true if numBytes should be copied with non-temporal stores */
+static bool useStreamCopy(size_t numBytes)
+{
+#ifdef STREAM_COPY
+  static size_t cacheSize = 0;
+  long size = 0;
+
+  if (NDArrayPoolStreamBytes < 0) return false;
+  if (NDArrayPoolStreamBytes > 0) return (numBytes >= (size_t)NDArrayPoolStreamBytes);
+  if (cacheSize == 0) {
+#if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    cacheSize = (size > 0) ? (size_t)size : DEFAULT_CACHE_SIZE;
+  }
+  return (numBytes >= cacheSize);
+#else
+  return false;
+#endif
+}
+
+/** Copies numBytes with non-temporal stores where possible, otherwise with memcpy */
+static void streamCopy(char *pDst, const char *pSrc, size_t numBytes)
+{
+#ifdef STREAM_COPY
+  size_t head = (16 - ((size_t)pDst & 15)) & 15;
+  size_t i, numStream;
+
+  if (head > numBytes) head = numBytes;
+  memcpy(pDst, pSrc, head);
+  pDst += head;
+  pSrc += head;
+  numBytes -= head;
+  numStream = numBytes & ~(size_t)63;
+  for (i=0; i<numStream; i+=64) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(pSrc + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(pSrc + i + 16));
+    __m128i c = _mm_loadu_si128((const __m128i *)(pSrc + i + 32));
+    __m128i d = _mm_loadu_si128((const __m128i *)(pSrc + i + 48));
+    _mm_stream_si128((__m128i *)(pDst + i), a);
+    _mm_stream_si128((__m128i *)(pDst + i + 16), b);
+    _mm_stream_si128((__m128i *)(pDst + i + 32), c);
+    _mm_stream_si128((__m128i *)(pDst + i + 48), d);
+  }
+  /* Non-temporal stores are weakly ordered, they must be complete before another thread reads the data */
+  _mm_sfence();
+  memcpy(pDst + numStream, pSrc + numStream, numBytes - numStream);
+#else
+  memcpy(pDst, pSrc, numBytes);
+#endif
+}
+
+static NDWorkerPool *pBandPool;
+static epicsThreadOnceId bandPoolOnceId = EPICS_THREAD_ONCE_INIT;
+
+static void createBandPool(void *pvt)
+{
+  if (NDArrayPoolThreads > 0) pBandPool = new NDWorkerPool("NDArrayPool", NDArrayPoolThreads);
+}
+
+/** Work on an array that can be split into bands of rows, which are processed in parallel.
+  * The bands must not write to the same memory. */
+class NDArrayBands {
+public:
+  NDArrayBands() : numPending_(0) {}
+  virtual ~NDArrayBands() {}
+
+protected:
+  void run(size_t numRows, size_t numBytes);
+  /** Processes numRows rows starting at row first */
+  virtual void doRows(size_t first, size_t numRows) = 0;
+
+private:
+  struct Band {
+    NDArrayBands *pBands;
+    size_t first;
+    size_t numRows;
+  };
+  static void bandJob(void *pArg);
+  epicsMutex mutex_;
+  epicsEvent doneEvent_;    /**< Signalled when the last band run by the pool is done */
+  int numPending_;          /**< Number of bands queued on the pool that are not done */
+};
+
+/** Processes numRows rows, which hold numBytes bytes of the array.
+  * If the array is at least NDArrayPoolThreadBytes the rows are split into one band for the calling
+  * thread and one for each pool thread, otherwise they are all processed by the calling thread.
+  * Returns when all the rows are done. */
+void NDArrayBands::run(size_t numRows, size_t numBytes)
+{
+  NDWorkerPool *pPool = NULL;
+  size_t numBands = 1;
+  size_t i;
+
+  if ((NDArrayPoolThreads > 0) && (numBytes >= (size_t)NDArrayPoolThreadBytes)) {
+    epicsThreadOnce(&bandPoolOnceId, createBandPool, NULL);
+    pPool = pBandPool;
+  }
+  if (pPool) numBands = std::min(numRows, (size_t)pPool->getNumThreads() + 1);
+  if (numBands <= 1) {
+    doRows(0, numRows);
+    return;
+  }
+
+  /* Don't use NDWorkerPool::wait(), which would also wait for the bands of other arrays */
+  std::vector<Band> bands(numBands);
+  for (i=0; i<numBands; i++) {
+    bands[i].pBands = this;
+    bands[i].first = numRows * i / numBands;
+    bands[i].numRows = numRows * (i+1) / numBands - bands[i].first;
+  }
+  numPending_ = (int)numBands - 1;
+  for (i=1; i<numBands; i++) pPool->queue(bandJob, &bands[i]);
+  doRows(bands[0].first, bands[0].numRows);
+  doneEvent_.wait();
+}
+
+void NDArrayBands::bandJob(void *pArg)
+{
+  Band *pBand = (Band *)pArg;
+  NDArrayBands *pBands = pBand->pBands;
+  bool done;
+
+  pBands->doRows(pBand->first, pBand->numRows);
+  pBands->mutex_.lock();
+  done = (--pBands->numPending_ == 0);
+  pBands->mutex_.unlock();
+  if (done) pBands->doneEvent_.signal();
+}
+
+/** Copies blocks of bytes, optionally with non-temporal stores */
+class NDCopyBands : public NDArrayBands {
+public:
+  NDCopyBands(void *pDataOut, const void *pDataIn, size_t numBytes, bool stream=false)
+    : pDataOut_((char *)pDataOut), pDataIn_((const char *)pDataIn), numBytes_(numBytes), stream_(stream) {}
+  void run() { NDArrayBands::run((numBytes_ + BAND_BLOCK_BYTES - 1) / BAND_BLOCK_BYTES, numBytes_); }
+protected:
+  void doRows(size_t first, size_t count)
+  {
+    size_t start = first * BAND_BLOCK_BYTES;
+    size_t end = std::min((first + count) * BAND_BLOCK_BYTES, numBytes_);
+    if (stream_) streamCopy(pDataOut_ + start, pDataIn_ + start, end - start);
+    else memcpy(pDataOut_ + start, pDataIn_ + start, end - start);
+  }
+private:
+  char *pDataOut_;
+  const char *pDataIn_;
+  size_t numBytes_;
+  bool stream_;
+};
+
 /** NDArrayPool constructor
   * \param[in] pDriver Pointer to the asynNDArrayDriver that created this object.
   * \param[in] maxMemory Maxiumum number of bytes of memory the the pool is allowed to use, summed over
   * all of the NDArray objects; 0=unlimited.
   */
 NDArrayPool::NDArrayPool(class asynNDArrayDriver *pDriver, size_t maxMemory)
-  : numBuffers_(0), maxMemory_(maxMemory), memorySize_(0), pDriver_(pDriver)
+  : numBuffers_(0), maxMemory_(maxMemory), memorySize_(0),
+    numCopies_(0), copyBytes_(0), copySeconds_(0), pDriver_(pDriver)
 {
   listLock_ = epicsMutexCreate();
 }
@@ -90,9 +302,16 @@ void NDArrayPool::onReleaseArray(NDArray *pArray)
   * alloc() will compute the size required from ndims, dims, and dataType.
   * \param[in] pData Pointer to a data buffer; if NULL then alloc will allocate a new
   * array buffer; if not NULL then it is assumed to point to a valid buffer.
+  * \param[in] releaseFunc Function to call when the last reference to the array is released;
+  * default=NULL.  Only used if pData is not NULL.
+  * \param[in] releasePvt Private pointer passed to releaseFunc; default=NULL.
   * 
   * If pData is not NULL then dataSize must contain the actual number of bytes in the existing
   * array, and this array must be large enough to hold the array data. 
+  * If releaseFunc is NULL the pool takes ownership of pData and will eventually free() it.
+  * If releaseFunc is not NULL the pool never frees pData and does not count it against maxMemory;
+  * instead releaseFunc(pData, releasePvt) is called when the reference count reaches 0, and the
+  * NDArray object is returned to the free list without a data buffer.
   * alloc() searches
   * its free list to find a free NDArray buffer. If is cannot find one then it will
   * allocate a new one and add it to the free list. If allocating the memory required for
@@ -100,7 +319,8 @@ void NDArrayPool::onReleaseArray(NDArray *pArray)
   * maxMemory then an error will be returned. alloc() sets the reference count for the
   * returned NDArray to 1.
   */
-NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData)
+NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size_t dataSize, void *pData,
+                            NDArrayReleaseFunc_t releaseFunc, void *releasePvt)
 {
   NDArray *pArray=NULL;
   NDArrayInfo_t arrayInfo;
@@ -165,7 +385,12 @@ NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size
   if (pData) {
     pArray->pData = pData;
     pArray->dataSize = dataSize;
-    memorySize_ += dataSize;
+    if (releaseFunc) {
+      pArray->pReleaseFunc = releaseFunc;
+      pArray->pReleasePvt = releasePvt;
+    } else {
+      memorySize_ += dataSize;
+    }
   } else if (pArray->pData == NULL) {
     if ((maxMemory_ > 0) && ((memorySize_ + dataSize) > maxMemory_)) {
       // We don't have enough memory to allocate the array
@@ -188,7 +413,7 @@ NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size
              "%s: error: reached limit of %ld memory (%d buffers)\n",
              functionName, (long)maxMemory_, numBuffers_);
     } else {
-      pArray->pData = malloc(dataSize);
+      pArray->pData = allocData(dataSize);
       if (pArray->pData) {
         pArray->dataSize = dataSize;
         pArray->compressedSize = dataSize;
@@ -216,19 +441,28 @@ NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size
   * if 0 then everything except the data (including attributes) is copied.
   * \param[in] copyDimensions If this flag is true then the dimensions are copied even if pOut is not NULL; default=true.
   * \param[in] copyDataType If this flag is true then the dataType is copied even if pOut is not NULL; default=true.
+  * \param[in] copyAttributes How the attributes are copied; default=NDCopyAttributesReplace.
   * \return Returns a pointer to the output array.
   *
   * If pOut is NULL then it is first allocated. If the output array
   * object already exists (pOut!=NULL) then it must have sufficient memory allocated to
   * it to hold the data.
+  * Data larger than NDArrayPoolStreamBytes is copied with non-temporal stores, and data of at least
+  * NDArrayPoolThreadBytes is split across threads.  The number of copies, the bytes copied and
+  * the time taken are shown by report().
+  * NDCopyAttributesUpdate avoids deleting and allocating attributes when pOut was allocated
+  * with pIn's attributes already in it, which is the case for arrays from the same driver
+  * unless eraseNDAttributes is set.
   */
-NDArray* NDArrayPool::copy(NDArray *pIn, NDArray *pOut, bool copyData, bool copyDimensions, bool copyDataType)
+NDArray* NDArrayPool::copy(NDArray *pIn, NDArray *pOut, bool copyData, bool copyDimensions, bool copyDataType,
+                           NDCopyAttributes_t copyAttributes)
 {
   //const char *functionName = "copy";
   size_t dimSizeOut[ND_ARRAY_MAX_DIMS];
   int i;
   size_t numCopy;
   NDArrayInfo arrayInfo;
+  epicsTimeStamp startTime, endTime;
 
   /* If the output array does not exist then create it */
   if (!pOut) {
@@ -252,13 +486,65 @@ NDArray* NDArrayPool::copy(NDArray *pIn, NDArray *pOut, bool copyData, bool copy
     pIn->getInfo(&arrayInfo);
     numCopy = pIn->codec.empty() ? arrayInfo.totalBytes : pIn->compressedSize;
     if (pOut->dataSize < numCopy) numCopy = pOut->dataSize;
-    memcpy(pOut->pData, pIn->pData, numCopy);
+    epicsTimeGetCurrent(&startTime);
+    NDCopyBands bands(pOut->pData, pIn->pData, numCopy, useStreamCopy(numCopy));
+    bands.run();
+    epicsTimeGetCurrent(&endTime);
+    epicsMutexLock(listLock_);
+    numCopies_++;
+    copyBytes_ += numCopy;
+    copySeconds_ += epicsTimeDiffInSeconds(&endTime, &startTime);
+    epicsMutexUnlock(listLock_);
+  }
+  switch (copyAttributes) {
+    case NDCopyAttributesReplace:
+      pOut->pAttributeList->clear();
+      pIn->pAttributeList->copy(pOut->pAttributeList);
+      break;
+    case NDCopyAttributesUpdate:
+      pIn->pAttributeList->copy(pOut->pAttributeList);
+      break;
+    case NDCopyAttributesNone:
+      break;
   }
-  pOut->pAttributeList->clear();
-  pIn->pAttributeList->copy(pOut->pAttributeList);
   return(pOut);
 }
 
+static void releaseSharedArray(void *pData, void *pvt)
+{
+  NDArray *pParent = (NDArray *)pvt;
+  pParent->release();
+}
+
+/** This method creates an NDArray that refers to the data of an existing NDArray rather than copying it.
+  * \param[in] pIn The input array to be shared.
+  * \return Returns a pointer to the output array, or NULL if it could not be allocated.
+  *
+  * The output array is allocated from this pool and gets its own copy of the dimensions, timestamps,
+  * codec and attributes of pIn, so attributes can be added to it without affecting pIn.
+  * Its pData points to the data of pIn, which is reserved until the last reference to the output array
+  * is released.  The data must therefore be treated as read-only, as for any NDArray passed to a plugin.
+  * The reference count of the output array only counts users of the output array, not of the data.
+  * Its release function is set, so NDArray::getReleaseFunc() tells plugins that it does not own its data.
+  */
+NDArray* NDArrayPool::share(NDArray *pIn)
+{
+  size_t dimSizeOut[ND_ARRAY_MAX_DIMS];
+  NDArray *pOut;
+  int i;
+
+  for (i=0; i<pIn->ndims; i++) dimSizeOut[i] = pIn->dims[i].size;
+  pIn->reserve();
+  pOut = this->alloc(pIn->ndims, dimSizeOut, pIn->dataType, pIn->dataSize, pIn->pData,
+                     releaseSharedArray, pIn);
+  if (NULL == pOut) {
+    pIn->release();
+    return NULL;
+  }
+  this->copy(pIn, pOut, false);
+  return pOut;
+}
+
 /** This method increases the reference count for the NDArray object.
   * \param[in] pArray The array on which to increase the reference count.
   *
@@ -296,12 +582,17 @@ int NDArrayPool::reserve(NDArray *pArray)
   * \param[in] pArray The array on which to decrease the reference count.
   *
   * When the reference count reaches 0 the NDArray is placed back in the free list.
+  * If the data buffer is not owned by the pool its release function is called first,
+  * without holding the pool mutex.
   * Plugins must call release() when an NDArray is removed from the queue and
   * processing on it is complete. Drivers must call release() after calling all
   * plugins.
   */
 int NDArrayPool::release(NDArray *pArray)
 {
+  NDArrayReleaseFunc_t releaseFunc = NULL;
+  void *releasePvt = NULL;
+  void *releaseData = NULL;
   const char *functionName = "release";
 
   /* Make sure we own this array */
@@ -316,6 +607,16 @@ int NDArrayPool::release(NDArray *pArray)
   epicsMutexLock(listLock_);
   pArray->referenceCount--;
   if (pArray->referenceCount == 0) {
+    /* If we don't own the data buffer detach it, it is handed back to its owner below */
+    if (pArray->pReleaseFunc) {
+      releaseFunc = pArray->pReleaseFunc;
+      releasePvt = pArray->pReleasePvt;
+      releaseData = pArray->pData;
+      pArray->pReleaseFunc = NULL;
+      pArray->pReleasePvt = NULL;
+      pArray->pData = NULL;
+      pArray->dataSize = 0;
+    }
     /* The last user has released this image, add it back to the free list */
     freeListElement listElement(pArray, pArray->dataSize);
     freeList_.insert(listElement);
@@ -328,50 +629,144 @@ int NDArrayPool::release(NDArray *pArray)
   // Call release hook (for pools that manage objects derived from NDArray class)
   onReleaseArray(pArray);
   epicsMutexUnlock(listLock_);
+  if (releaseFunc) releaseFunc(releaseData, releasePvt);
   return ND_SUCCESS;
 }
 
-template <typename dataTypeIn, typename dataTypeOut> void convertType(NDArray *pIn, NDArray *pOut)
+/* The conversion kernels below are written as simple loops with unit stride where possible,
+ * so that the compiler vectorizes them. */
+
+template <typename dataTypeA, typename dataTypeB> struct sameType { static const bool value = false; };
+template <typename dataType> struct sameType<dataType, dataType> { static const bool value = true; };
+
+template <typename dataTypeIn, typename dataTypeOut>
+static void convertElements(const dataTypeIn *pDataIn, dataTypeOut *pDataOut, size_t nElements)
 {
   size_t i;
-  dataTypeIn *pDataIn = (dataTypeIn *)pIn->pData;
-  dataTypeOut *pDataOut = (dataTypeOut *)pOut->pData;
-  NDArrayInfo_t arrayInfo;
 
-  pOut->getInfo(&arrayInfo);
-  for (i=0; i<arrayInfo.nElements; i++) {
-    *pDataOut++ = (dataTypeOut)(*pDataIn++);
+  for (i=0; i<nElements; i++) {
+    pDataOut[i] = (dataTypeOut)pDataIn[i];
+  }
+}
+
+/** Converts one row (dimension 0) of the output array.
+  * If accumulate is false each output element is a single input element, which is assigned to it.
+  * Otherwise the input elements are added to the output elements one at a time in the order
+  * they are read, so that floating point results do not depend on which kernel is used. */
+template <typename dataTypeIn, typename dataTypeOut>
+static void convertRow(const dataTypeIn *pDIn, dataTypeOut *pDOut, size_t size,
+                       int binning, int reverse, bool accumulate)
+{
+  size_t out;
+  int bin;
+
+  if (reverse) {
+    pDIn += size * binning - 1;
+    if (!accumulate) {
+      for (out=0; out<size; out++) pDOut[out] = (dataTypeOut)*pDIn--;
+    } else {
+      for (out=0; out<size; out++) {
+        for (bin=0; bin<binning; bin++) pDOut[out] += (dataTypeOut)*pDIn--;
+      }
+    }
+  } else if (binning == 1) {
+    if (accumulate) {
+      for (out=0; out<size; out++) pDOut[out] += (dataTypeOut)pDIn[out];
+    } else if (sameType<dataTypeIn, dataTypeOut>::value) {
+      memcpy(pDOut, pDIn, size * sizeof(dataTypeOut));
+    } else {
+      convertElements(pDIn, pDOut, size);
+    }
+  } else if (binning == 2) {
+    for (out=0; out<size; out++) {
+      pDOut[out] += (dataTypeOut)pDIn[2*out];
+      pDOut[out] += (dataTypeOut)pDIn[2*out + 1];
+    }
+  } else if (binning == 4) {
+    for (out=0; out<size; out++) {
+      pDOut[out] += (dataTypeOut)pDIn[4*out];
+      pDOut[out] += (dataTypeOut)pDIn[4*out + 1];
+      pDOut[out] += (dataTypeOut)pDIn[4*out + 2];
+      pDOut[out] += (dataTypeOut)pDIn[4*out + 3];
+    }
+  } else {
+    for (out=0; out<size; out++) {
+      for (bin=0; bin<binning; bin++) pDOut[out] += (dataTypeOut)*pDIn++;
+    }
   }
 }
 
-template <typename dataTypeOut> int convertTypeSwitch (NDArray *pIn, NDArray *pOut)
+template <typename dataTypeIn, typename dataTypeOut> void convertType(void *pDataIn, void *pDataOut, size_t nElements)
+{
+  convertElements((dataTypeIn *)pDataIn, (dataTypeOut *)pDataOut, nElements);
+}
+
+template <typename dataTypeOut> int convertTypeSwitch (NDDataType_t dataTypeIn, void *pDataIn, void *pDataOut,
+                                                      size_t nElements)
 {
   int status = ND_SUCCESS;
 
-  switch(pIn->dataType) {
+  switch(dataTypeIn) {
+    case NDInt8:
+      convertType<epicsInt8, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    case NDUInt8:
+      convertType<epicsUInt8, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    case NDInt16:
+      convertType<epicsInt16, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    case NDUInt16:
+      convertType<epicsUInt16, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    case NDInt32:
+      convertType<epicsInt32, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    case NDUInt32:
+      convertType<epicsUInt32, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    case NDFloat32:
+      convertType<epicsFloat32, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    case NDFloat64:
+      convertType<epicsFloat64, dataTypeOut> (pDataIn, pDataOut, nElements);
+      break;
+    default:
+      status = ND_ERROR;
+      break;
+  }
+  return(status);
+}
+
+static int convertTypes(NDDataType_t dataTypeIn, NDDataType_t dataTypeOut,
+                        void *pDataIn, void *pDataOut, size_t nElements)
+{
+  int status = ND_SUCCESS;
+
+  switch(dataTypeOut) {
     case NDInt8:
-      convertType<epicsInt8, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsInt8> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     case NDUInt8:
-      convertType<epicsUInt8, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsUInt8> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     case NDInt16:
-      convertType<epicsInt16, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsInt16> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     case NDUInt16:
-      convertType<epicsUInt16, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsUInt16> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     case NDInt32:
-      convertType<epicsInt32, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsInt32> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     case NDUInt32:
-      convertType<epicsUInt32, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsUInt32> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     case NDFloat32:
-      convertType<epicsFloat32, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsFloat32> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     case NDFloat64:
-      convertType<epicsFloat64, dataTypeOut> (pIn, pOut);
+      status = convertTypeSwitch <epicsFloat64> (dataTypeIn, pDataIn, pDataOut, nElements);
       break;
     default:
       status = ND_ERROR;
@@ -381,18 +776,24 @@ template <typename dataTypeOut> int convertTypeSwitch (NDArray *pIn, NDArray *pO
 }
 
 
-template <typename dataTypeIn, typename dataTypeOut> void convertDim(NDArray *pIn, NDArray *pOut,
-                                                     void *pDataIn, void *pDataOut, int dim)
+template <typename dataTypeIn, typename dataTypeOut> void convertDim(NDDimension_t *pInDims,
+                                                     NDDimension_t *pOutDims,
+                                                     void *pDataIn, void *pDataOut, int dim,
+                                                     bool accumulate)
 {
   dataTypeOut *pDOut = (dataTypeOut *)pDataOut;
   dataTypeIn *pDIn = (dataTypeIn *)pDataIn;
-  NDDimension_t *pOutDims = pOut->dims;
-  NDDimension_t *pInDims = pIn->dims;
   size_t inStep, outStep, inOffset;
   int inDir;
   int i, bin;
   size_t inc, in, out;
 
+  if (dim == 0) {
+    convertRow(pDIn + pOutDims[0].offset, pDOut, pOutDims[0].size,
+               pOutDims[0].binning, pOutDims[0].reverse, accumulate);
+    return;
+  }
+
   inStep = 1;
   outStep = 1;
   inDir = 1;
@@ -409,46 +810,44 @@ template <typename dataTypeIn, typename dataTypeOut> void convertDim(NDArray *pI
   pDIn += inOffset*inStep;
   for (in=0, out=0; out<pOutDims[dim].size; out++, in++) {
     for (bin=0; bin<pOutDims[dim].binning; bin++) {
-      if (dim > 0) {
-        convertDim <dataTypeIn, dataTypeOut> (pIn, pOut, pDIn, pDOut, dim-1);
-      } else {
-        *pDOut += (dataTypeOut)*pDIn;
-      }
+      convertDim <dataTypeIn, dataTypeOut> (pInDims, pOutDims, pDIn, pDOut, dim-1, accumulate);
       pDIn += inc;
     }
     pDOut += outStep;
   }
 }
 
-template <typename dataTypeOut> int convertDimensionSwitch(NDArray *pIn, NDArray *pOut,
-                                                           void *pDataIn, void *pDataOut, int dim)
+template <typename dataTypeOut> int convertDimensionSwitch(NDArray *pIn, NDDimension_t *pOutDims,
+                                                           void *pDataIn, void *pDataOut, int dim,
+                                                           bool accumulate)
 {
   int status = ND_SUCCESS;
+  NDDimension_t *pInDims = pIn->dims;
 
   switch(pIn->dataType) {
     case NDInt8:
-      convertDim <epicsInt8, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsInt8, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDUInt8:
-      convertDim <epicsUInt8, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsUInt8, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDInt16:
-      convertDim <epicsInt16, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsInt16, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDUInt16:
-      convertDim <epicsUInt16, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsUInt16, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDInt32:
-      convertDim <epicsInt32, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsInt32, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDUInt32:
-      convertDim <epicsUInt32, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsUInt32, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDFloat32:
-      convertDim <epicsFloat32, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsFloat32, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDFloat64:
-      convertDim <epicsFloat64, dataTypeOut> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDim <epicsFloat64, dataTypeOut> (pInDims, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     default:
       status = ND_ERROR;
@@ -459,40 +858,42 @@ template <typename dataTypeOut> int convertDimensionSwitch(NDArray *pIn, NDArray
 
 static int convertDimension(NDArray *pIn,
                             NDArray *pOut,
+                            NDDimension_t *pOutDims,
                             void *pDataIn,
                             void *pDataOut,
-                            int dim)
+                            int dim,
+                            bool accumulate)
 {
   int status = ND_SUCCESS;
   /* This routine is passed:
    * A pointer to the start of the input data
    * A pointer to the start of the output data
-   * An array of dimensions
+   * An array of output dimensions
    * A dimension index */
   switch(pOut->dataType) {
     case NDInt8:
-      convertDimensionSwitch <epicsInt8>(pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsInt8>(pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDUInt8:
-      convertDimensionSwitch <epicsUInt8> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsUInt8> (pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDInt16:
-      convertDimensionSwitch <epicsInt16> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsInt16> (pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDUInt16:
-      convertDimensionSwitch <epicsUInt16> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsUInt16> (pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDInt32:
-      convertDimensionSwitch <epicsInt32> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsInt32> (pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDUInt32:
-      convertDimensionSwitch <epicsUInt32> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsUInt32> (pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDFloat32:
-      convertDimensionSwitch <epicsFloat32> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsFloat32> (pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     case NDFloat64:
-      convertDimensionSwitch <epicsFloat64> (pIn, pOut, pDataIn, pDataOut, dim);
+      convertDimensionSwitch <epicsFloat64> (pIn, pOutDims, pDataIn, pDataOut, dim, accumulate);
       break;
     default:
       status = ND_ERROR;
@@ -501,6 +902,84 @@ static int convertDimension(NDArray *pIn,
   return(status);
 }
 
+/** Converts the data type of blocks of elements */
+class NDConvertTypeBands : public NDArrayBands {
+public:
+  NDConvertTypeBands(NDArray *pIn, NDArray *pOut, size_t nElements)
+    : pIn_(pIn), pOut_(pOut), nElements_(nElements)
+  {
+    NDArrayInfo_t arrayInfo;
+    pIn->getInfo(&arrayInfo);
+    bytesIn_ = arrayInfo.bytesPerElement;
+    pOut->getInfo(&arrayInfo);
+    bytesOut_ = arrayInfo.bytesPerElement;
+  }
+  void run()
+  {
+    NDArrayBands::run((nElements_ + BAND_BLOCK_ELEMENTS - 1) / BAND_BLOCK_ELEMENTS,
+                      nElements_ * std::max(bytesIn_, bytesOut_));
+  }
+protected:
+  void doRows(size_t first, size_t count)
+  {
+    size_t start = first * BAND_BLOCK_ELEMENTS;
+    size_t end = std::min((first + count) * BAND_BLOCK_ELEMENTS, nElements_);
+    convertTypes(pIn_->dataType, pOut_->dataType, (char *)pIn_->pData + start*bytesIn_,
+                 (char *)pOut_->pData + start*bytesOut_, end - start);
+  }
+private:
+  NDArray *pIn_;
+  NDArray *pOut_;
+  size_t nElements_;
+  size_t bytesIn_;
+  size_t bytesOut_;
+};
+
+/** Extracts a region and/or bins, a band of the outermost output dimension at a time.
+  * Each band clears and writes its own part of the output array. */
+class NDConvertDimensionBands : public NDArrayBands {
+public:
+  NDConvertDimensionBands(NDArray *pIn, NDArray *pOut, NDDimension_t *pOutDims, bool accumulate)
+    : pIn_(pIn), pOut_(pOut), pOutDims_(pOutDims), accumulate_(accumulate)
+  {
+    NDArrayInfo_t arrayInfo;
+    int i;
+
+    outerDim_ = pIn->ndims - 1;
+    pOut->getInfo(&arrayInfo);
+    numBytes_ = arrayInfo.totalBytes;
+    bytesPerRow_ = arrayInfo.bytesPerElement;
+    for (i=0; i<outerDim_; i++) bytesPerRow_ *= pOutDims[i].size;
+  }
+  void run() { NDArrayBands::run(pOutDims_[outerDim_].size, numBytes_); }
+protected:
+  void doRows(size_t first, size_t count)
+  {
+    NDDimension_t dims[ND_ARRAY_MAX_DIMS];
+    NDDimension_t *pOuter = &dims[outerDim_];
+    char *pDataOut = (char *)pOut_->pData + first*bytesPerRow_;
+
+    memcpy(dims, pOutDims_, (outerDim_+1)*sizeof(NDDimension_t));
+    /* The input rows of a reversed band are counted from the end of the region */
+    if (pOuter->reverse) {
+      pOuter->offset += (pOuter->size - first - count) * pOuter->binning;
+    } else {
+      pOuter->offset += first * pOuter->binning;
+    }
+    pOuter->size = count;
+    if (accumulate_) memset(pDataOut, 0, count*bytesPerRow_);
+    convertDimension(pIn_, pOut_, dims, pIn_->pData, pDataOut, outerDim_, accumulate_);
+  }
+private:
+  NDArray *pIn_;
+  NDArray *pOut_;
+  NDDimension_t *pOutDims_;
+  bool accumulate_;
+  int outerDim_;
+  size_t numBytes_;
+  size_t bytesPerRow_;
+};
+
 /** Creates a new output NDArray from an input NDArray, performing
   * conversion operations.
   * This form of the function is for changing the data type only, not the dimensions,
@@ -606,46 +1085,24 @@ int NDArrayPool::convert(NDArray *pIn,
     if (pIn->dataType == pOut->dataType) {
       /* The dimensions are the same and the data type is the same,
        * then just copy the input image to the output image */
-      memcpy(pOut->pData, pIn->pData, arrayInfo.totalBytes);
+      NDCopyBands bands(pOut->pData, pIn->pData, arrayInfo.totalBytes);
+      bands.run();
       return ND_SUCCESS;
     } else {
       /* We need to convert data types */
-      switch(pOut->dataType) {
-        case NDInt8:
-          convertTypeSwitch <epicsInt8> (pIn, pOut);
-          break;
-        case NDUInt8:
-          convertTypeSwitch <epicsUInt8> (pIn, pOut);
-          break;
-        case NDInt16:
-          convertTypeSwitch <epicsInt16> (pIn, pOut);
-          break;
-        case NDUInt16:
-          convertTypeSwitch <epicsUInt16> (pIn, pOut);
-          break;
-        case NDInt32:
-          convertTypeSwitch <epicsInt32> (pIn, pOut);
-          break;
-        case NDUInt32:
-          convertTypeSwitch <epicsUInt32> (pIn, pOut);
-          break;
-        case NDFloat32:
-          convertTypeSwitch <epicsFloat32> (pIn, pOut);
-          break;
-        case NDFloat64:
-          convertTypeSwitch <epicsFloat64> (pIn, pOut);
-          break;
-        default:
-          //status = ND_ERROR;
-          break;
-      }
+      NDConvertTypeBands bands(pIn, pOut, arrayInfo.nElements);
+      bands.run();
     }
   } else {
     /* The input and output dimensions are not the same, so we are extracting a region
-     * and/or binning */
-    /* Clear entire output array */
-    memset(pOut->pData, 0, arrayInfo.totalBytes);
-    convertDimension(pIn, pOut, pIn->pData, pOut->pData, pIn->ndims-1);
+     * and/or binning.  Without binning each output element is a single input element,
+     * otherwise the output array is cleared and the input elements are added to it. */
+    bool accumulate = false;
+    for (i=0; i<pIn->ndims; i++) {
+      if (dimsOutCopy[i].binning > 1) accumulate = true;
+    }
+    NDConvertDimensionBands bands(pIn, pOut, dimsOutCopy, accumulate);
+    bands.run();
   }
 
   /* Set fields in the output array */
@@ -725,6 +1182,16 @@ int NDArrayPool::report(FILE *fp, int details)
          numBuffers_, this->getNumFree());
   fprintf(fp, "  memorySize=%ld, maxMemory=%ld\n",
         (long)memorySize_, (long)maxMemory_);
+  epicsMutexLock(listLock_);
+  fprintf(fp, "  numCopies=%d, copyBytes=%.0f, copyTime=%.3f s",
+        numCopies_, copyBytes_, copySeconds_);
+  if (numCopies_ > 0) {
+    fprintf(fp, ", bytes/copy=%.0f, ms/copy=%.3f",
+          copyBytes_/numCopies_, 1000.*copySeconds_/numCopies_);
+  }
+  if (copySeconds_ > 0) fprintf(fp, ", MB/s=%.1f", copyBytes_/copySeconds_/1.e6);
+  fprintf(fp, "\n");
+  epicsMutexUnlock(listLock_);
   if (details > 5) {
     int i;
     std::multiset<freeListElement>::iterator it;
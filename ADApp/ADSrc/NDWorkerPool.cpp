@@ -0,0 +1,141 @@
+/** NDWorkerPool.cpp
+ *
+ * A pool of worker threads for drivers and plugins that split their work into
+ * independent jobs.
+ *
+ */
+
+#include <stdio.h>
+#include <epicsStdio.h>
+
+#include <epicsExport.h>
+
+#include "NDWorkerPool.h"
+
+static void workerTaskC(void *drvPvt)
+{
+    NDWorkerPool *pPool = (NDWorkerPool *)drvPvt;
+    pPool->workerTask();
+}
+
+/** NDWorkerPool constructor; starts the worker threads.
+  * \param[in] name The name of the pool; the threads are named name_0, name_1, ...
+  * \param[in] numThreads The number of worker threads; values less than 1 are set to 1.
+  * \param[in] priority The priority of the worker threads.
+  * \param[in] stackSize The stack size of the worker threads. */
+NDWorkerPool::NDWorkerPool(const char *name, int numThreads, unsigned int priority, unsigned int stackSize)
+    : workEvent_(epicsEventEmpty), idleEvent_(epicsEventEmpty), exitEvent_(epicsEventEmpty),
+      numThreads_(numThreads < 1 ? 1 : numThreads), numRunning_(0), numPending_(0), exiting_(false)
+{
+    char threadName[64];
+    int i;
+
+    for (i=0; i<numThreads_; i++) {
+        epicsSnprintf(threadName, sizeof(threadName), "%s_%d", name, i);
+        mutex_.lock();
+        numRunning_++;
+        mutex_.unlock();
+        if (epicsThreadCreate(threadName, priority, stackSize, (EPICSTHREADFUNC)workerTaskC, this) == 0) {
+            printf("NDWorkerPool::NDWorkerPool ERROR creating thread %s\n", threadName);
+            mutex_.lock();
+            numRunning_--;
+            mutex_.unlock();
+        }
+    }
+}
+
+/** NDWorkerPool destructor; runs the jobs that are still queued and waits for the worker threads to exit. */
+NDWorkerPool::~NDWorkerPool()
+{
+    mutex_.lock();
+    exiting_ = true;
+    if (numRunning_ == 0) {
+        // No threads were created, nothing can run the jobs
+        jobs_.clear();
+        mutex_.unlock();
+        return;
+    }
+    mutex_.unlock();
+    workEvent_.signal();
+    exitEvent_.wait();
+}
+
+/** Returns the number of worker threads. */
+int NDWorkerPool::getNumThreads()
+{
+    return numThreads_;
+}
+
+/** Queues a job; it is run by the first worker thread that is idle.
+  * \param[in] job The function to run.
+  * \param[in] pArg The argument passed to the function. */
+void NDWorkerPool::queue(NDWorkerJob_t job, void *pArg)
+{
+    Job entry;
+
+    entry.job = job;
+    entry.pArg = pArg;
+    mutex_.lock();
+    if (numRunning_ == 0) {
+        // Run the job in the calling thread if there are no worker threads
+        mutex_.unlock();
+        job(pArg);
+        return;
+    }
+    jobs_.push_back(entry);
+    numPending_++;
+    mutex_.unlock();
+    workEvent_.signal();
+}
+
+/** Waits until all the jobs that have been queued are done. */
+void NDWorkerPool::wait()
+{
+    bool waited = false;
+
+    mutex_.lock();
+    while (numPending_ > 0) {
+        mutex_.unlock();
+        idleEvent_.wait();
+        waited = true;
+        mutex_.lock();
+    }
+    mutex_.unlock();
+    // idleEvent_ wakes one thread at a time, so pass it on in case another thread is waiting
+    if (waited) idleEvent_.signal();
+}
+
+/** The worker thread function; runs jobs until the pool is destroyed.
+  * This is public only so that the C thread function can call it. */
+void NDWorkerPool::workerTask()
+{
+    Job entry;
+
+    mutex_.lock();
+    while (true) {
+        while (jobs_.empty() && !exiting_) {
+            mutex_.unlock();
+            workEvent_.wait();
+            mutex_.lock();
+        }
+        if (jobs_.empty()) break;
+        entry = jobs_.front();
+        jobs_.pop_front();
+        // workEvent_ wakes one thread at a time, so pass it on if there is more work
+        if (!jobs_.empty()) workEvent_.signal();
+        mutex_.unlock();
+        entry.job(entry.pArg);
+        mutex_.lock();
+        numPending_--;
+        if (numPending_ == 0) idleEvent_.signal();
+    }
+    numRunning_--;
+    if (numRunning_ == 0) {
+        mutex_.unlock();
+        exitEvent_.signal();
+    } else {
+        // Wake the next thread so that it exits too
+        mutex_.unlock();
+        workEvent_.signal();
+    }
+}
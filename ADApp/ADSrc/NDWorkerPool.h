@@ -0,0 +1,51 @@
+/** NDWorkerPool.h
+ *
+ * A pool of worker threads for drivers and plugins that split their work into
+ * independent jobs.
+ *
+ */
+
+#ifndef NDWorkerPool_H
+#define NDWorkerPool_H
+
+#include <deque>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <shareLib.h>
+
+/** Function that runs one job on a worker thread. */
+typedef void (*NDWorkerJob_t)(void *pArg);
+
+/** NDWorkerPool class; runs jobs on a fixed number of worker threads.
+  * Jobs are started in the order they are queued, but they can finish in any order.
+  * Only EPICS base threads, mutexes and events are used, so the pool works with all supported
+  * versions of base. */
+class epicsShareClass NDWorkerPool {
+public:
+    NDWorkerPool(const char *name, int numThreads,
+                 unsigned int priority=epicsThreadPriorityMedium,
+                 unsigned int stackSize=epicsThreadGetStackSize(epicsThreadStackMedium));
+    ~NDWorkerPool();
+    int  getNumThreads();
+    void queue(NDWorkerJob_t job, void *pArg);
+    void wait();
+    void workerTask();
+
+private:
+    struct Job {
+        NDWorkerJob_t job;
+        void *pArg;
+    };
+    std::deque<Job> jobs_;    /**< Jobs that have not started yet */
+    epicsMutex mutex_;
+    epicsEvent workEvent_;    /**< Signalled when jobs are queued or the pool is exiting */
+    epicsEvent idleEvent_;    /**< Signalled when the last pending job is done */
+    epicsEvent exitEvent_;    /**< Signalled when the last worker thread exits */
+    int numThreads_;
+    int numRunning_;          /**< Number of worker threads that have not exited */
+    int numPending_;          /**< Number of jobs that are queued or running */
+    bool exiting_;
+};
+
+#endif
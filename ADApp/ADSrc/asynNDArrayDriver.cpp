@@ -833,6 +833,11 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     createParam(NDFileLazyOpenString,         asynParamInt32,           &NDFileLazyOpen);
     createParam(NDFileCreateDirString,        asynParamInt32,           &NDFileCreateDir);
     createParam(NDFileTempSuffixString,       asynParamOctet,           &NDFileTempSuffix);
+    createParam(NDFileWriteQueueSizeString,   asynParamInt32,           &NDFileWriteQueueSize);
+    createParam(NDFileWriteQueueUsedString,   asynParamInt32,           &NDFileWriteQueueUsed);
+    createParam(NDFileWriteLatencyP50String,  asynParamFloat64,         &NDFileWriteLatencyP50);
+    createParam(NDFileWriteLatencyP99String,  asynParamFloat64,         &NDFileWriteLatencyP99);
+    createParam(NDFileWriteLatencyMaxString,  asynParamFloat64,         &NDFileWriteLatencyMax);
     createParam(NDAttributesFileString,       asynParamOctet,           &NDAttributesFile);
     createParam(NDAttributesStatusString,     asynParamInt32,           &NDAttributesStatus);
     createParam(NDAttributesMacrosString,     asynParamOctet,           &NDAttributesMacros);
@@ -887,6 +892,11 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     setIntegerParam(NDFileNumCaptured, 0);
     setIntegerParam(NDFileCreateDir, 0);
     setStringParam (NDFileTempSuffix, "");
+    setIntegerParam(NDFileWriteQueueSize, 0);
+    setIntegerParam(NDFileWriteQueueUsed, 0);
+    setDoubleParam (NDFileWriteLatencyP50, 0.);
+    setDoubleParam (NDFileWriteLatencyP99, 0.);
+    setDoubleParam (NDFileWriteLatencyMax, 0.);
     setStringParam (NDAttributesFile, "");
     setIntegerParam(NDAttributesStatus, NDAttributesFileNotFound);
     setStringParam (NDAttributesMacros, "");
@@ -89,6 +89,11 @@ typedef enum {
 #define NDFileLazyOpenString    "FILE_LAZY_OPEN"    /**< (asynInt32,    r/w) Don't open file until first frame arrives in Stream mode */
 #define NDFileCreateDirString   "CREATE_DIR"        /**< (asynInt32,    r/w) Create the target directory up to this depth */
 #define NDFileTempSuffixString  "FILE_TEMP_SUFFIX"  /**< (asynOctet,    r/w) Temporary filename suffix while writing data to file. The file will be renamed (suffix removed) upon closing the file. */
+#define NDFileWriteQueueSizeString  "FILE_WRITE_QUEUE_SIZE"  /**< (asynInt32,    r/w) Number of NDArrays that can wait to be written in Stream mode. 0=write synchronously */
+#define NDFileWriteQueueUsedString  "FILE_WRITE_QUEUE_USED"  /**< (asynInt32,    r/o) Number of NDArrays waiting to be written in Stream mode */
+#define NDFileWriteLatencyP50String "FILE_WRITE_LATENCY_P50" /**< (asynFloat64,  r/o) Median time to write an NDArray in Stream mode (ms) */
+#define NDFileWriteLatencyP99String "FILE_WRITE_LATENCY_P99" /**< (asynFloat64,  r/o) 99th percentile of the time to write an NDArray in Stream mode (ms) */
+#define NDFileWriteLatencyMaxString "FILE_WRITE_LATENCY_MAX" /**< (asynFloat64,  r/o) Maximum time to write an NDArray in Stream mode (ms) */
 
 #define NDAttributesFileString    "ND_ATTRIBUTES_FILE"   /**< (asynOctet,    r/w) Attributes file name */
 #define NDAttributesStatusString  "ND_ATTRIBUTES_STATUS" /**< (asynInt32,    r/o) Attributes status */
@@ -186,6 +191,11 @@ protected:
     int NDFileLazyOpen;
     int NDFileCreateDir;
     int NDFileTempSuffix;
+    int NDFileWriteQueueSize;
+    int NDFileWriteQueueUsed;
+    int NDFileWriteLatencyP50;
+    int NDFileWriteLatencyP99;
+    int NDFileWriteLatencyMax;
     int NDAttributesFile;
     int NDAttributesStatus;
     int NDAttributesMacros;
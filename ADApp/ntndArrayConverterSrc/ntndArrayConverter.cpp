@@ -62,8 +62,50 @@ struct freeNDArray {
     void operator()(dataType *data) { array->release(); }
 };
 
+// Releases the reference to the pvData value held by an NDArray from toArray(NDArrayPool*)
+static void releaseValue (void *pData, void *pvt)
+{
+    delete static_cast<shared_vector<const void> *>(pvt);
+}
+
+template <typename pvFieldType>
+static inline typename pvFieldType::shared_pointer getField (PVStructurePtr const & src,
+        size_t index)
+{
+    return static_pointer_cast<pvFieldType>(src->getPVFields()[index]);
+}
+
 NTNDArrayConverter::NTNDArrayConverter (NTNDArrayPtr array) : m_array(array) {}
 
+// Looks up the field handles and indices for the structure of m_array.
+// Called at the start of each conversion, since the structure can change each time
+// it is received, and only does the lookup when it has changed.
+void NTNDArrayConverter::cacheFields (void)
+{
+    PVStructurePtr pvStructure(m_array->getPVStructure());
+    StructureConstPtr structure(pvStructure->getStructure());
+
+    if(structure == m_fields.structure)
+        return;
+
+    StructureConstPtr dim(m_array->getDimension()->getStructureArray()->getStructure());
+    m_fields.dimSize    = dim->getFieldIndex("size");
+    m_fields.dimOffset  = dim->getFieldIndex("offset");
+    m_fields.dimBinning = dim->getFieldIndex("binning");
+    m_fields.dimReverse = dim->getFieldIndex("reverse");
+
+    StructureConstPtr attr(m_array->getAttribute()->getStructureArray()->getStructure());
+    m_fields.attrName       = attr->getFieldIndex("name");
+    m_fields.attrValue      = attr->getFieldIndex("value");
+    m_fields.attrDescriptor = attr->getFieldIndex("descriptor");
+    m_fields.attrSourceType = attr->getFieldIndex("sourceType");
+    m_fields.attrSource     = attr->getFieldIndex("source");
+
+    // getUniqueId not implemented yet
+    m_fields.uniqueId  = pvStructure->getSubField<PVInt>("uniqueId");
+    m_fields.structure = structure;
+}
+
 ScalarType NTNDArrayConverter::getValueType (void)
 {
     string fieldName(m_array->getValue()->getSelectedFieldName());
@@ -88,9 +130,9 @@ NDColorMode_t NTNDArrayConverter::getColorMode (void)
     for(PVStructureArray::const_svector::iterator it(attrs.cbegin());
             it != attrs.cend(); ++it)
     {
-        if((*it)->getSubField<PVString>("name")->get() == "ColorMode")
+        if(getField<PVString>(*it, m_fields.attrName)->get() == "ColorMode")
         {
-            PVUnionPtr field((*it)->getSubField<PVUnion>("value"));
+            PVUnionPtr field(getField<PVUnion>(*it, m_fields.attrValue));
             int cm = static_pointer_cast<PVInt>(field->get())->get();
             colorMode = (NDColorMode_t) cm;
         }
@@ -103,6 +145,8 @@ NTNDArrayInfo_t NTNDArrayConverter::getInfo (void)
 {
     NTNDArrayInfo_t info = {0};
 
+    cacheFields();
+
     PVStructureArray::const_svector dims(m_array->getDimension()->view());
 
     info.ndims     = (int) dims.size();
@@ -110,7 +154,7 @@ NTNDArrayInfo_t NTNDArrayConverter::getInfo (void)
 
     for(int i = 0; i < info.ndims; ++i)
     {
-        info.dims[i]    = (size_t) dims[i]->getSubField<PVInt>("size")->get();
+        info.dims[i]    = (size_t) getField<PVInt>(dims[i], m_fields.dimSize)->get();
         info.nElements *= info.dims[i];
     }
 
@@ -219,6 +263,7 @@ NTNDArrayInfo_t NTNDArrayConverter::getInfo (void)
 
 void NTNDArrayConverter::toArray (NDArray *dest)
 {
+    cacheFields();
     toValue(dest);
     toDimensions(dest);
     toTimeStamp(dest);
@@ -227,12 +272,61 @@ void NTNDArrayConverter::toArray (NDArray *dest)
 
     // getUniqueId not implemented yet
     // dest->uniqueId = m_array->getUniqueId()->get();
-    PVIntPtr uniqueId(m_array->getPVStructure()->getSubField<PVInt>("uniqueId"));
-    dest->uniqueId = uniqueId->get();
+    dest->uniqueId = m_fields.uniqueId->get();
+}
+
+/** Allocates an NDArray from pool whose data buffer is the NTNDArray value itself.
+  * The NDArray holds a reference to the pvData array until it is released, so the
+  * value is not copied. The data must be treated as read-only.
+  * \return The new NDArray, or NULL if it could not be allocated.
+  */
+NDArray *NTNDArrayConverter::toArray (NDArrayPool *pool)
+{
+    NTNDArrayInfo_t info = getInfo();
+    NDArray *dest = NULL;
+
+    switch(getValueType())
+    {
+    case pvByte:    dest = wrapValue<PVByteArray>  (pool, info); break;
+    case pvUByte:   dest = wrapValue<PVUByteArray> (pool, info); break;
+    case pvShort:   dest = wrapValue<PVShortArray> (pool, info); break;
+    case pvUShort:  dest = wrapValue<PVUShortArray>(pool, info); break;
+    case pvInt:     dest = wrapValue<PVIntArray>   (pool, info); break;
+    case pvUInt:    dest = wrapValue<PVUIntArray>  (pool, info); break;
+    case pvFloat:   dest = wrapValue<PVFloatArray> (pool, info); break;
+    case pvDouble:  dest = wrapValue<PVDoubleArray>(pool, info); break;
+    case pvBoolean:
+    case pvLong:
+    case pvULong:
+    case pvString:
+    default:
+        throw std::runtime_error("invalid value data type");
+        break;
+    }
+
+    if(!dest)
+        return NULL;
+
+    try
+    {
+        toDimensions(dest);
+        toTimeStamp(dest);
+        toDataTimeStamp(dest);
+        toAttributes(dest);
+    }
+    catch(...)
+    {
+        dest->release();
+        throw;
+    }
+
+    dest->uniqueId = m_fields.uniqueId->get();
+    return dest;
 }
 
 void NTNDArrayConverter::fromArray (NDArray *src)
 {
+    cacheFields();
     fromValue(src);
     fromDimensions(src);
     fromTimeStamp(src);
@@ -241,8 +335,7 @@ void NTNDArrayConverter::fromArray (NDArray *src)
 
     // getUniqueId not implemented yet
     // m_array->getUniqueId()->put(src->uniqueId);
-    PVIntPtr uniqueId(m_array->getPVStructure()->getSubField<PVInt>("uniqueId"));
-    uniqueId->put(src->uniqueId);
+    m_fields.uniqueId->put(src->uniqueId);
 }
 
 template <typename arrayType>
@@ -263,6 +356,36 @@ void NTNDArrayConverter::toValue (NDArray *dest)
         dest->compressedSize = srcVec.size()*sizeof(arrayValType);
 }
 
+template <typename arrayType>
+NDArray *NTNDArrayConverter::wrapValue (NDArrayPool *pool, NTNDArrayInfo_t & info)
+{
+    typedef typename arrayType::value_type arrayValType;
+    typedef typename arrayType::const_svector arrayVecType;
+
+    PVUnionPtr src(m_array->getValue());
+    arrayVecType srcVec(src->get<arrayType>()->view());
+    size_t size = srcVec.size()*sizeof(arrayValType);
+
+    if(info.codec.empty() && size < info.totalBytes)
+        throw std::runtime_error("value is smaller than dimensions");
+
+    shared_vector<const void> *ref = new shared_vector<const void>(
+            static_shared_vector_cast<const void>(srcVec));
+
+    NDArray *dest = pool->alloc(info.ndims, info.dims, info.dataType, size,
+            (void*)srcVec.data(), releaseValue, ref);
+
+    if(!dest)
+    {
+        delete ref;
+        return NULL;
+    }
+
+    dest->codec = info.codec;
+    dest->compressedSize = size;
+    return dest;
+}
+
 void NTNDArrayConverter::toValue (NDArray *dest)
 {
     switch(getValueType())
@@ -296,10 +419,10 @@ void NTNDArrayConverter::toDimensions (NDArray *dest)
     for(size_t i = 0; i < srcVec.size(); ++i)
     {
         NDDimension_t *d = &dest->dims[i];
-        d->size    = srcVec[i]->getSubField<PVInt>("size")->get();
-        d->offset  = srcVec[i]->getSubField<PVInt>("offset")->get();
-        d->binning = srcVec[i]->getSubField<PVInt>("binning")->get();
-        d->reverse = srcVec[i]->getSubField<PVBoolean>("reverse")->get();
+        d->size    = getField<PVInt>(srcVec[i], m_fields.dimSize)->get();
+        d->offset  = getField<PVInt>(srcVec[i], m_fields.dimOffset)->get();
+        d->binning = getField<PVInt>(srcVec[i], m_fields.dimBinning)->get();
+        d->reverse = getField<PVBoolean>(srcVec[i], m_fields.dimReverse)->get();
     }
 }
 
@@ -335,12 +458,12 @@ void NTNDArrayConverter::toDataTimeStamp (NDArray *dest)
 template <typename pvAttrType, typename valueType>
 void NTNDArrayConverter::toAttribute (NDArray *dest, PVStructurePtr src)
 {
-    const char *name          = src->getSubField<PVString>("name")->get().c_str();
-    const char *desc          = src->getSubField<PVString>("descriptor")->get().c_str();
-    NDAttrSource_t sourceType = (NDAttrSource_t)src->getSubField<PVInt>("sourceType")->get();
-    const char *source        = src->getSubField<PVString>("source")->get().c_str();
+    const char *name          = getField<PVString>(src, m_fields.attrName)->get().c_str();
+    const char *desc          = getField<PVString>(src, m_fields.attrDescriptor)->get().c_str();
+    NDAttrSource_t sourceType = (NDAttrSource_t)getField<PVInt>(src, m_fields.attrSourceType)->get();
+    const char *source        = getField<PVString>(src, m_fields.attrSource)->get().c_str();
     NDAttrDataType_t dataType = scalarToNDAttrDataType[pvAttrType::typeCode];
-    valueType value           = src->getSubField<PVUnion>("value")->get<pvAttrType>()->get();
+    valueType value           = getField<PVUnion>(src, m_fields.attrValue)->get<pvAttrType>()->get();
 
     NDAttribute *attr = new NDAttribute(name, desc, sourceType, source, dataType, (void*)&value);
     dest->pAttributeList->add(attr);
@@ -348,11 +471,11 @@ void NTNDArrayConverter::toAttribute (NDArray *dest, PVStructurePtr src)
 
 void NTNDArrayConverter::toStringAttribute (NDArray *dest, PVStructurePtr src)
 {
-    const char *name          = src->getSubField<PVString>("name")->get().c_str();
-    const char *desc          = src->getSubField<PVString>("descriptor")->get().c_str();
-    NDAttrSource_t sourceType = (NDAttrSource_t)src->getSubField<PVInt>("sourceType")->get();
-    const char *source        = src->getSubField<PVString>("source")->get().c_str();
-    const char *value         = src->getSubField<PVUnion>("value")->get<PVString>()->get().c_str();
+    const char *name          = getField<PVString>(src, m_fields.attrName)->get().c_str();
+    const char *desc          = getField<PVString>(src, m_fields.attrDescriptor)->get().c_str();
+    NDAttrSource_t sourceType = (NDAttrSource_t)getField<PVInt>(src, m_fields.attrSourceType)->get();
+    const char *source        = getField<PVString>(src, m_fields.attrSource)->get().c_str();
+    const char *value         = getField<PVUnion>(src, m_fields.attrValue)->get<PVString>()->get().c_str();
 
     NDAttribute *attr = new NDAttribute(name, desc, sourceType, source, NDAttrString, (void*)value);
     dest->pAttributeList->add(attr);
@@ -360,10 +483,10 @@ void NTNDArrayConverter::toStringAttribute (NDArray *dest, PVStructurePtr src)
 
 void NTNDArrayConverter::toUndefinedAttribute (NDArray *dest, PVStructurePtr src)
 {
-    const char *name          = src->getSubField<PVString>("name")->get().c_str();
-    const char *desc          = src->getSubField<PVString>("descriptor")->get().c_str();
-    NDAttrSource_t sourceType = (NDAttrSource_t)src->getSubField<PVInt>("sourceType")->get();
-    const char *source        = src->getSubField<PVString>("source")->get().c_str();
+    const char *name          = getField<PVString>(src, m_fields.attrName)->get().c_str();
+    const char *desc          = getField<PVString>(src, m_fields.attrDescriptor)->get().c_str();
+    NDAttrSource_t sourceType = (NDAttrSource_t)getField<PVInt>(src, m_fields.attrSourceType)->get();
+    const char *source        = getField<PVString>(src, m_fields.attrSource)->get().c_str();
 
     NDAttribute *attr = new NDAttribute(name, desc, sourceType, source, NDAttrUndefined, NULL);
     dest->pAttributeList->add(attr);
@@ -377,7 +500,7 @@ void NTNDArrayConverter::toAttributes (NDArray *dest)
 
     for(VecIt it = srcVec.cbegin(); it != srcVec.cend(); ++it)
     {
-        PVScalarPtr srcScalar((*it)->getSubField<PVUnion>("value")->get<PVScalar>());
+        PVScalarPtr srcScalar(getField<PVUnion>(*it, m_fields.attrValue)->get<PVScalar>());
 
         if(!srcScalar)
             toUndefinedAttribute(dest, *it);
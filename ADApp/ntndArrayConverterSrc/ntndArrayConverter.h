@@ -25,17 +25,32 @@ public:
 
     NTNDArrayInfo_t getInfo (void);
     void toArray (NDArray *dest);
+    NDArray *toArray (NDArrayPool *pool);
     void fromArray (NDArray *src);
 
 private:
     epics::nt::NTNDArrayPtr m_array;
 
+    // Field handles and indices into the dimension and attribute structures,
+    // looked up once for the structure type of m_array
+    struct
+    {
+        epics::pvData::StructureConstPtr structure;
+        epics::pvData::PVIntPtr uniqueId;
+        size_t dimSize, dimOffset, dimBinning, dimReverse;
+        size_t attrName, attrValue, attrDescriptor, attrSourceType, attrSource;
+    }m_fields;
+
+    void cacheFields (void);
+
     epics::pvData::ScalarType getValueType (void);
     NDColorMode_t getColorMode (void);
 
     template <typename arrayType>
     void toValue (NDArray *dest);
     void toValue (NDArray *dest);
+    template <typename arrayType>
+    NDArray *wrapValue (NDArrayPool *pool, NTNDArrayInfo_t & info);
 
     void toDimensions (NDArray *dest);
     void toTimeStamp (NDArray *dest);
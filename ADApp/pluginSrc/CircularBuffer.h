@@ -4,78 +4,189 @@
 #include <algorithm>
 #include <vector>
 
+#include <epicsVersion.h>
+
+// epicsAtomic is only available in EPICS base 3.15 and later. With older
+// versions the element counters are protected by a mutex that is only held
+// while a counter is read or written, never while elements are copied.
+#if (EPICS_VERSION > 3) || ((EPICS_VERSION == 3) && (EPICS_REVISION >= 15))
+#  include <epicsAtomic.h>
+#  define CIRCULAR_BUFFER_ATOMIC
+#else
+#  include <epicsMutex.h>
+#endif
+
+/**
+ * Ring that holds the last max_length elements that were pushed.
+ *
+ * One thread at a time may push_back() and clear() (the caller serializes
+ * them), while other threads take snapshots with copy_to_array() without
+ * locking out the pushing thread. Elements are counted with a total that
+ * only increases. A snapshot reads the total that is being pushed after
+ * copying, and drops the elements that were overwritten while it was
+ * copying them.
+ */
 template <class T>
 class CircularBuffer {
 public:
     CircularBuffer(size_t max_length)
         : max_length_(max_length),
-          cpos_(0),
-          size_(0),
+          start_(0),
+          count_(0),
+          pending_(0),
           buffer_(max_length)
-    {}
+    {
+        create_lock();
+    }
+
+    CircularBuffer(const CircularBuffer& other)
+        : max_length_(other.max_length_),
+          start_(other.start_),
+          count_(other.count_),
+          pending_(other.pending_),
+          buffer_(other.buffer_)
+    {
+        create_lock();
+    }
+
+    ~CircularBuffer() {
+        destroy_lock();
+    }
+
+    CircularBuffer& operator=(const CircularBuffer& other) {
+        max_length_ = other.max_length_;
+        start_ = other.start_;
+        count_ = other.count_;
+        pending_ = other.pending_;
+        buffer_ = other.buffer_;
+        return *this;
+    }
 
     size_t max_size() const {
         return max_length_;
     }
 
     size_t size() const {
-        return size_;
-    }
-
-    const T& first() const {
-        return buffer_[cpos_];
+        size_t start, count;
+        load(&start, &count);
+        return std::min(count - start, max_length_);
     }
 
+    /** Last element pushed; only for the pushing thread, and the ring must not be empty */
     const T& last() const {
-        return buffer_[(cpos_ + max_length_ - 1) % max_length_];
+        return buffer_[(count_ + max_length_ - 1) % max_length_];
     }
 
     void push_back(const T& el) {
-        buffer_[cpos_] = el;
+        store_pending(count_ + 1);
+        buffer_[count_ % max_length_] = el;
+        store(start_, count_ + 1);
+    }
+
+    void clear() {
+        store(count_, count_);
+    }
 
-        cpos_ = (cpos_ + 1) % max_length_;
+    /**
+     * Copies the oldest elements held to buffer, at most buffer_size of them.
+     * This can be called from any thread while another thread pushes.
+     *
+     * \return The number of elements copied.
+     */
+    size_t copy_to_array(T * const buffer, size_t buffer_size) const {
+        size_t start, count;
+        load(&start, &count);
+        size_t held = std::min(count - start, max_length_);
+        size_t first = count - held;
+        size_t size = std::min(held, buffer_size);
+        size_t pos = first % max_length_;
+        size_t len_to_end = std::min(size, max_length_ - pos);
 
-        if (size_ < max_length_) {
-            size_++;
+        std::copy(buffer_.begin() + pos, buffer_.begin() + pos + len_to_end,
+                buffer);
+        std::copy(buffer_.begin(), buffer_.begin() + (size - len_to_end),
+                buffer + len_to_end);
+
+        // Element i is overwritten by the push that makes the total
+        // i + max_length_ + 1
+        size_t pending = load_pending();
+        if (pending > first + max_length_) {
+            size_t lost = std::min(size, pending - max_length_ - first);
+            std::copy(buffer + lost, buffer + size, buffer);
+            size -= lost;
         }
+        return size;
     }
 
-    const T& operator[](size_t i) const {
-        return buffer_[(cpos_ + i) % size_];
+private:
+#ifdef CIRCULAR_BUFFER_ATOMIC
+    void create_lock() {}
+    void destroy_lock() {}
+
+    void load(size_t *start, size_t *count) const {
+        *count = epicsAtomicGetSizeT(&count_);
+        *start = epicsAtomicGetSizeT(&start_);
+        epicsAtomicReadMemoryBarrier();
     }
 
-    void clear() {
-        cpos_ = 0;
-        size_ = 0;
-    }
-
-    const size_t copy_to_array(T * const buffer, size_t buffer_size) const {
-        size_t size = std::min(size_, buffer_size);
-        if (size_ < max_length_) {
-            std::copy(buffer_.begin(), buffer_.begin() + size, buffer);
-            return size;
-        } else {
-            size_t len_to_end = max_length_ - cpos_;
-            if (size < len_to_end) {
-                std::copy(buffer_.begin() + cpos_,
-                        buffer_.begin() + cpos_ + size, buffer);
-                return size;
-            } else {
-                std::copy(buffer_.begin() + cpos_,
-                        buffer_.begin() + cpos_ + len_to_end,
-                        buffer);
-                std::copy(buffer_.begin(),
-                        buffer_.begin() + (size - len_to_end),
-                        buffer + len_to_end);
-                return size;
-            }
-        }
+    void store(size_t start, size_t count) {
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetSizeT(&start_, start);
+        epicsAtomicSetSizeT(&count_, count);
     }
 
-private:
+    size_t load_pending() const {
+        epicsAtomicReadMemoryBarrier();
+        return epicsAtomicGetSizeT(&pending_);
+    }
+
+    void store_pending(size_t pending) {
+        epicsAtomicSetSizeT(&pending_, pending);
+        epicsAtomicWriteMemoryBarrier();
+    }
+#else
+    void create_lock() {
+        lock_ = epicsMutexMustCreate();
+    }
+
+    void destroy_lock() {
+        epicsMutexDestroy(lock_);
+    }
+
+    void load(size_t *start, size_t *count) const {
+        epicsMutexMustLock(lock_);
+        *start = start_;
+        *count = count_;
+        epicsMutexUnlock(lock_);
+    }
+
+    void store(size_t start, size_t count) {
+        epicsMutexMustLock(lock_);
+        start_ = start;
+        count_ = count;
+        epicsMutexUnlock(lock_);
+    }
+
+    size_t load_pending() const {
+        epicsMutexMustLock(lock_);
+        size_t pending = pending_;
+        epicsMutexUnlock(lock_);
+        return pending;
+    }
+
+    void store_pending(size_t pending) {
+        epicsMutexMustLock(lock_);
+        pending_ = pending;
+        epicsMutexUnlock(lock_);
+    }
+
+    epicsMutexId lock_;
+#endif
+
     size_t max_length_;
-    size_t cpos_;
-    size_t size_;
+    size_t start_;          // Total count when the buffer was last cleared
+    size_t count_;          // Total number of elements pushed
+    size_t pending_;        // Total once the element being pushed is done
     std::vector<T> buffer_;
 };
 
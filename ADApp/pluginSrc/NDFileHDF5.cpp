@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <list>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <sstream>
@@ -35,15 +36,108 @@
 
 #include <asynDriver.h>
 
+#ifdef HAVE_ZLIB
+  #include <zlib.h>
+#endif
+#ifdef HAVE_BLOSC
+  #include <blosc.h>
+#endif
+
 #include <epicsExport.h>
 #include "NDFileHDF5.h"
 
 #define METADATA_NDIMS 1
 #define MAX_LAYOUT_LEN 1048576
 
-enum HDF5Compression_t {HDF5CompressNone=0, HDF5CompressNumBits, HDF5CompressSZip, HDF5CompressZlib, HDF5CompressBlosc};
+enum HDF5Compression_t {HDF5CompressNone=0, HDF5CompressNumBits, HDF5CompressSZip, HDF5CompressZlib, HDF5CompressBlosc,
+                        HDF5CompressBSLZ4, HDF5CompressLZ4};
 /* Filter ID officially assigned to blosc */
 #define FILTER_BLOSC 32001
+/* Filter ID officially assigned to LZ4 */
+#define FILTER_LZ4 32004
+/* Filter ID officially assigned to bitshuffle, and its option for LZ4 compression */
+#define FILTER_BSHUF 32008
+#define BSHUF_H5_COMPRESS_LZ4 2
+/* The bitshuffle version that is stored in the filter parameters when the filter is not available */
+#define BSHUF_VERSION_MAJOR 0
+#define BSHUF_VERSION_MINOR 3
+
+/* The NDArray codecs that produce data in the format of an HDF5 compression filter.
+ * Arrays with these codecs are written to datasets with the matching filter using direct chunk writes */
+static const struct {
+  const char *codec;
+  int compression;
+} directChunkCodecs[] = {
+  {"blosc", HDF5CompressBlosc},
+  {"bslz4", HDF5CompressBSLZ4},
+  {"lz4",   HDF5CompressLZ4}
+};
+
+/* Reads a big-endian unsigned integer of nBytes bytes */
+static epicsUInt64 readBigEndian(const unsigned char *pData, int nBytes)
+{
+  epicsUInt64 value = 0;
+  for (int i=0; i<nBytes; i++) value = (value << 8) | pData[i];
+  return value;
+}
+
+/** Check that a compressed NDArray has the layout written by the HDF5 LZ4 filter or the bitshuffle filter
+ * with LZ4 compression: the uncompressed size and the block size as 8 and 4 byte big-endian integers,
+ * then each block as its 4 byte big-endian compressed size followed by the compressed block.
+ * For bitshuffle the block size is in bytes and a multiple of 8 elements; the last block is rounded down to
+ * a multiple of 8 elements and the remaining bytes are stored uncompressed after it.
+ * Plain LZ4 frames from a detector do not have this layout, and the filter could not read them back.
+ * \param[in] pArray - The compressed NDArray.
+ * \param[in] bitshuffle - True for the bitshuffle filter, false for the LZ4 filter.
+ */
+static bool checkLZ4Chunk(NDArray *pArray, bool bitshuffle)
+{
+  NDArrayInfo_t arrayInfo;
+  const unsigned char *pData = (const unsigned char *)pArray->pData;
+  size_t size = pArray->compressedSize;
+  size_t pos = 12;
+  size_t remaining, blockBytes, block;
+  size_t alignBytes;
+
+  pArray->getInfo(&arrayInfo);
+  alignBytes = bitshuffle ? 8 * arrayInfo.bytesPerElement : 1;
+  remaining = arrayInfo.totalBytes;
+  if (size < pos || readBigEndian(pData, 8) != remaining) return false;
+  blockBytes = (size_t)readBigEndian(pData + 8, 4);
+  if (blockBytes == 0 || blockBytes % alignBytes) return false;
+  while (remaining > 0) {
+    block = std::min(blockBytes, remaining);
+    block -= block % alignBytes;
+    if (block == 0) {
+      // The last bytes of a bitshuffle chunk that are not a multiple of 8 elements
+      pos += remaining;
+      break;
+    }
+    if (pos + 4 > size) return false;
+    pos += 4 + (size_t)readBigEndian(pData + pos, 4);
+    if (pos > size) return false;
+    remaining -= block;
+  }
+  return pos == size;
+}
+
+/* One frame that is compressed by the compression threads and then written with a direct chunk write */
+struct NDFileHDF5Chunk {
+  NDArray *pArray;                /* The frame; reserved until the chunk has been written */
+  NDFileHDF5Dataset *pDataset;    /* The dataset the chunk is written to */
+  std::vector<hsize_t> offset;    /* The offset of the chunk in the dataset */
+  int compression;                /* HDF5CompressZlib or HDF5CompressBlosc */
+  int level;
+  int shuffle;
+  const char *compressor;         /* Blosc compressor name */
+  size_t typeSize;
+  char *pBuffer;                  /* Compressed data */
+  size_t bufferSize;
+  const void *pData;              /* The data to write; pBuffer, or the NDArray data if compression did not help */
+  size_t dataSize;
+  unsigned int filterMask;
+  epicsEvent done;                /* Signalled when pData is ready to be written */
+};
 
 #define DIMSREPORTSIZE 512
 #define DIMNAMESIZE 40
@@ -59,6 +153,64 @@ enum HDF5Compression_t {HDF5CompressNone=0, HDF5CompressNumBits, HDF5CompressSZi
 static const char *driverName = "NDFileHDF5";
 static const char *uniqueIDName = "NDArrayUniqueId";
 
+/** Compresses one chunk; runs on the compression threads.
+  * The output is what the HDF5 filter would produce, so the file can be read with the standard filter.
+  * If the data do not compress the chunk is stored uncompressed and the filter is flagged as skipped,
+  * as the filter pipeline does for optional filters. */
+static void compressChunkTask(void *pArg)
+{
+  NDFileHDF5Chunk *pChunk = (NDFileHDF5Chunk *)pArg;
+  NDArrayInfo_t info;
+  size_t compressedSize = 0;
+
+  pChunk->pArray->getInfo(&info);
+  // Only compressed data smaller than the frame are kept, so the buffer never needs to be larger
+  if (pChunk->bufferSize < info.totalBytes){
+    free(pChunk->pBuffer);
+    pChunk->pBuffer = (char *)malloc(info.totalBytes);
+    pChunk->bufferSize = pChunk->pBuffer ? info.totalBytes : 0;
+  }
+  if (pChunk->pBuffer){
+    switch (pChunk->compression)
+    {
+  #ifdef HAVE_ZLIB
+      case HDF5CompressZlib:
+        {
+          uLongf destLen = (uLongf)pChunk->bufferSize;
+          if (compress2((Bytef *)pChunk->pBuffer, &destLen, (const Bytef *)pChunk->pArray->pData,
+                        (uLong)info.totalBytes, pChunk->level) == Z_OK){
+            compressedSize = destLen;
+          }
+        }
+        break;
+  #endif
+  #ifdef HAVE_BLOSC
+      case HDF5CompressBlosc:
+        {
+          int bloscSize = blosc_compress_ctx(pChunk->level, pChunk->shuffle, pChunk->typeSize,
+                                             info.totalBytes, pChunk->pArray->pData,
+                                             pChunk->pBuffer, pChunk->bufferSize,
+                                             pChunk->compressor, 0, 1);
+          if (bloscSize > 0) compressedSize = bloscSize;
+        }
+        break;
+  #endif
+      default:
+        break;
+    }
+  }
+  if (compressedSize > 0 && compressedSize < info.totalBytes){
+    pChunk->pData = pChunk->pBuffer;
+    pChunk->dataSize = compressedSize;
+    pChunk->filterMask = 0;
+  } else {
+    pChunk->pData = pChunk->pArray->pData;
+    pChunk->dataSize = info.totalBytes;
+    pChunk->filterMask = 1;
+  }
+  pChunk->done.signal();
+}
+
 // Not required if SWMR is not supported
 #if H5_VERSION_GE(1,9,178)
 // This is a callback function for object flushing when in SWMR mode
@@ -196,6 +348,9 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
 
   if (openMode & NDFileModeMultiple){
     this->multiFrameFile = true;
+    // Each multi-frame file starts new latency histograms
+    for (int stage = 0; stage < HDF5NumStages; stage++) this->stageHistograms[stage].reset();
+    this->publishStageLatencies(true);
   } else {
     this->multiFrameFile = false;
     this->lock();
@@ -264,6 +419,17 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
     return asynError;
   }
 
+  // Start the compression threads if they have been requested
+  if (this->startCompressPool()){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Failed to start the compression threads\n",
+              driverName, functionName);
+    return asynError;
+  }
+
+  // Write the frames in batches of one chunk if that has been requested
+  this->configureBatchWrites(pArray);
+
   if (storeAttributes == 1){
     this->createAttributeDataset(pArray);
     this->writeAttributeDataset(hdf5::OnFileOpen, 0, NULL);
@@ -1247,6 +1413,8 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   double dt=0.0, period=0.0, runtime = 0.0;
   int extradims = 0;
   hsize_t offsets[MAXEXTRADIMS] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  epicsTimeStamp stagets;
+  double extendTime, writeTime;
   static const char *functionName = "writeFile";
 
   if (this->file == 0) {
@@ -1256,6 +1424,11 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
     return asynError;
   }
 
+  // Compressed arrays can only be written if they are already in the format of the dataset filter
+  if (!pArray->codec.empty() && this->checkCompressedArray(pArray)){
+    return asynError;
+  }
+
   this->lock();
   getIntegerParam(NDFileHDF5_dimAttDatasets, &dimAttDataset);
   getIntegerParam(NDFileNumCaptured, &numCaptured);
@@ -1279,6 +1452,7 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   if (numCaptured == 1) epicsTimeGetCurrent(&this->firstFrame);
 
   if (storeAttributes == 1){
+    epicsTimeGetCurrent(&stagets);
     // Update attribute list. We use a separate attribute list
     // from the one in pArray to avoid the need to copy the array.
     // Get the current values of the attributes for this plugin
@@ -1308,6 +1482,7 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
                 driverName, functionName);
       return asynError;
     }
+    this->addStageTime(HDF5StageAttributes, &stagets);
   }
 
   // If we have a defined dataset destination NDAttribute name then we need to find the
@@ -1381,13 +1556,21 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   }
 
   if (status == asynSuccess){
-    status = this->detDataMap[destination]->writeFile(pArray, this->datatype, this->dataspace, this->framesize);
+    if (this->pCompressPool){
+      status = this->queueChunk(pArray, this->detDataMap[destination]);
+    } else if (pArray->codec.empty()){
+      status = this->detDataMap[destination]->writeFile(pArray, this->datatype, this->dataspace, this->framesize);
+    } else {
+      status = this->detDataMap[destination]->writeChunk(pArray->pData, pArray->compressedSize);
+    }
   }
   if (status != asynSuccess){
     // If dataset creation fails then close file and abort as all following writes will fail as well
     asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
               "%s::%s ERROR: could not write to dataset. Aborting\n",
               driverName, functionName);
+    this->stopCompressPool();
+    this->flushBatches();
     hdfstatus = H5Sclose(this->dataspace);
     if (hdfstatus){
       asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
@@ -1421,6 +1604,7 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   }
 
   if (storeAttributes == 1){
+    epicsTimeGetCurrent(&stagets);
     if (dimAttDataset == 1){
       // If attribute datasets are following dimensions of the main dataset
       // check to ensure this NDArray is destined for the default dataset
@@ -1435,6 +1619,7 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
     if (status != asynSuccess){
       return status;
     }
+    this->addStageTime(HDF5StageAttrDatasets, &stagets);
   }
   if (storePerformance == 1 && numCaptured <= this->numPerformancePoints){
     epicsTimeGetCurrent(&endts);
@@ -1456,12 +1641,26 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
 
   if (checkForSWMRMode()){
     if ((numCaptured+1) % flush == 0) {
+      // Chunks that are still being compressed must be written before they can be flushed
+      if (this->pCompressPool){
+        status = this->commitChunks(true);
+      }
+      // Frames that are waiting in the batch buffer must be written before they can be flushed
+      if (status == asynSuccess){
+        status = this->detDataMap[destination]->flushBatch(this->datatype, this->framesize);
+      }
       // We are in SWMR mode so flush the dataset on every <flush> frames
-      status = this->detDataMap[destination]->flushDataset();
+      if (status == asynSuccess){
+        epicsTimeGetCurrent(&stagets);
+        status = this->detDataMap[destination]->flushDataset();
+        this->addStageTime(HDF5StageFlush, &stagets);
+      }
     }
   }
 
   if (status != asynSuccess){
+    this->stopCompressPool();
+    this->flushBatches();
     hdfstatus = H5Fclose(this->file);
     if (hdfstatus){
       asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
@@ -1479,6 +1678,12 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
               driverName, functionName, dt, period);
 
     this->nextRecord++;
+    // Frames that are only copied to the batch buffer are not counted in the extend and write histograms
+    if (this->detDataMap[destination]->takeWriteTimes(&extendTime, &writeTime)){
+      this->stageHistograms[HDF5StageExtend].add(extendTime);
+      this->stageHistograms[HDF5StageWrite].add(writeTime);
+    }
+    this->publishStageLatencies(false);
   }
   return status;
 }
@@ -1508,6 +1713,16 @@ asynStatus NDFileHDF5::closeFile()
     return asynSuccess;
   }
 
+  // Write the chunks that are still being compressed
+  if (this->pCompressPool){
+    this->commitChunks(true);
+    this->stopCompressPool();
+  }
+
+  // Write the frames that are waiting in the batch buffers
+  this->flushBatches();
+  this->publishStageLatencies(true);
+
   this->lock();
   getIntegerParam(NDFileHDF5_storeAttributes, &storeAttributes);
   getIntegerParam(NDFileHDF5_storePerformance, &storePerformance);
@@ -1539,6 +1754,7 @@ asynStatus NDFileHDF5::closeFile()
   std::map<std::string, NDFileHDF5Dataset *>::iterator it_dset;
   for (it_dset = this->detDataMap.begin(); it_dset != this->detDataMap.end(); ++it_dset){
     H5Dclose(it_dset->second->getHandle());
+    delete it_dset->second;
   }
   std::map<std::string, hid_t>::iterator it_hid;
   // Iterate over the stored attribute data sets and close them
@@ -1764,6 +1980,12 @@ asynStatus NDFileHDF5::writeInt32(asynUser *pasynUser, epicsInt32 value)
       case HDF5CompressBlosc:
         filterId = FILTER_BLOSC;
         break;
+      case HDF5CompressBSLZ4:
+      case HDF5CompressLZ4:
+        // These filters are only used to write arrays that are already compressed, with direct chunk writes,
+        // so the filter does not need to be available for encoding. It is needed to read the file back.
+        filterId = H5Z_FILTER_NONE;
+        break;
       default:
         filterId = H5Z_FILTER_NONE;
         status = asynError;
@@ -1998,8 +2220,8 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
    * Set autoconnect to 1.  priority and stacksize can be 0, which will use defaults. */
   : NDPluginFile(portName, queueSize, blockingCallbacks,
                  NDArrayPort, NDArrayAddr, 1,
-                 0, 0, asynGenericPointerMask, asynGenericPointerMask, 
-                 ASYN_CANBLOCK, 1, priority, stackSize, 1)
+                 0, 0, asynGenericPointerMask | asynFloat64ArrayMask, asynGenericPointerMask | asynFloat64ArrayMask,
+                 ASYN_CANBLOCK, 1, priority, stackSize, 1, true)
 {
   //static const char *functionName = "NDFileHDF5";
 
@@ -2030,6 +2252,8 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   this->createParam(str_NDFileHDF5_bloscShuffleType,   asynParamInt32,   &NDFileHDF5_bloscShuffleType);
   this->createParam(str_NDFileHDF5_bloscCompressor,    asynParamInt32,   &NDFileHDF5_bloscCompressor);
   this->createParam(str_NDFileHDF5_bloscCompressLevel, asynParamInt32,   &NDFileHDF5_bloscCompressLevel);
+  this->createParam(str_NDFileHDF5_numCompressThreads, asynParamInt32,   &NDFileHDF5_numCompressThreads);
+  this->createParam(str_NDFileHDF5_batchWrites,     asynParamInt32,   &NDFileHDF5_batchWrites);
   this->createParam(str_NDFileHDF5_dimAttDatasets,  asynParamInt32,   &NDFileHDF5_dimAttDatasets);
   this->createParam(str_NDFileHDF5_layoutErrorMsg,  asynParamOctet,   &NDFileHDF5_layoutErrorMsg);
   this->createParam(str_NDFileHDF5_layoutValid,     asynParamInt32,   &NDFileHDF5_layoutValid);
@@ -2044,6 +2268,16 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   this->createParam(str_NDFileHDF5_SWMRSupported,   asynParamInt32,   &NDFileHDF5_SWMRSupported);
   this->createParam(str_NDFileHDF5_SWMRMode,        asynParamInt32,   &NDFileHDF5_SWMRMode);
   this->createParam(str_NDFileHDF5_SWMRRunning,     asynParamInt32,   &NDFileHDF5_SWMRRunning);
+  this->createParam(str_NDFileHDF5_chunkAutoTune,   asynParamInt32,   &NDFileHDF5_chunkAutoTune);
+  this->createParam(str_NDFileHDF5_fsBlockSize,     asynParamInt32,   &NDFileHDF5_fsBlockSize);
+  this->createParam(str_NDFileHDF5_writeAmplification, asynParamFloat64, &NDFileHDF5_writeAmplification);
+  this->createParam(str_NDFileHDF5_chunkTuneMsg,    asynParamOctet,   &NDFileHDF5_chunkTuneMsg);
+  this->createParam(str_NDFileHDF5_nRowChunksActual, asynParamInt32,  &NDFileHDF5_nRowChunksActual);
+  this->createParam(str_NDFileHDF5_nColChunksActual, asynParamInt32,  &NDFileHDF5_nColChunksActual);
+  this->createParam(str_NDFileHDF5_nFramesChunksActual, asynParamInt32, &NDFileHDF5_nFramesChunksActual);
+  this->createParam(str_NDFileHDF5_stageLatencyP50, asynParamFloat64Array, &NDFileHDF5_stageLatencyP50);
+  this->createParam(str_NDFileHDF5_stageLatencyP99, asynParamFloat64Array, &NDFileHDF5_stageLatencyP99);
+  this->createParam(str_NDFileHDF5_stageLatencyMax, asynParamFloat64Array, &NDFileHDF5_stageLatencyMax);
 
   setIntegerParam(NDFileHDF5_nRowChunks,      0);
   setIntegerParam(NDFileHDF5_nColChunks,      0);
@@ -2071,6 +2305,8 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   setIntegerParam(NDFileHDF5_bloscShuffleType, 1);
   setIntegerParam(NDFileHDF5_bloscCompressor, 0);
   setIntegerParam(NDFileHDF5_bloscCompressLevel, 5);
+  setIntegerParam(NDFileHDF5_numCompressThreads, 0);
+  setIntegerParam(NDFileHDF5_batchWrites,     0);
   setIntegerParam(NDFileHDF5_dimAttDatasets,  0);
   setStringParam (NDFileHDF5_layoutErrorMsg,  "");
   setIntegerParam(NDFileHDF5_layoutValid,     1);
@@ -2084,6 +2320,13 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   setIntegerParam(NDFileHDF5_SWMRCbCounter,   0);
   setIntegerParam(NDFileHDF5_SWMRMode,        0);
   setIntegerParam(NDFileHDF5_SWMRRunning,     0);
+  setIntegerParam(NDFileHDF5_chunkAutoTune,   0);
+  setIntegerParam(NDFileHDF5_fsBlockSize,     1048576);
+  setDoubleParam (NDFileHDF5_writeAmplification, 1.0);
+  setStringParam (NDFileHDF5_chunkTuneMsg,    "");
+  setIntegerParam(NDFileHDF5_nRowChunksActual,    0);
+  setIntegerParam(NDFileHDF5_nColChunksActual,    0);
+  setIntegerParam(NDFileHDF5_nFramesChunksActual, 0);
   if (checkForSWMRSupported()){
     setIntegerParam(NDFileHDF5_SWMRSupported, 1);
   } else {
@@ -2126,7 +2369,13 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   this->offset       = NULL;
   this->virtualdims  = NULL;
   this->rank         = 0;
+  this->extraRank    = 0;
+  epicsTimeGetCurrent(&this->stagePublished);
   this->file         = 0;
+  this->compressionScheme = HDF5CompressNone;
+  this->pCompressPool = NULL;
+  this->compressHead = 0;
+  this->compressCount = 0;
   this->ptrFillValue = (void*)calloc(8, sizeof(char));
   this->dimsreport   = (char*)calloc(DIMSREPORTSIZE, sizeof(char));
   this->performanceBuf       = NULL;
@@ -2201,15 +2450,57 @@ unsigned int NDFileHDF5::calcIstorek()
   return retval;
 }
 
+/** Calculate the size of the chunks of the detector datasets and the number of chunks that are
+ * being filled at any time while the frames are written in order.
+ * A chunk that spans several frames is incomplete until its last frame is written, and the chunks of
+ * the extra dimensions that change faster are all filled in the meantime.  These chunks must fit in
+ * the chunk cache, otherwise HDF5 evicts incomplete chunks and has to read them back (and with
+ * compression, decompress and compress them again) for each frame.
+ * \param[out] chunkBytes - The size of a chunk in bytes.
+ * \param[out] chunksPerFrame - The number of chunks that cover a frame.
+ * \param[out] numChunks - The number of chunks being filled, 0 if it is unbounded because the
+ *             chunks span an unlimited dimension.
+ */
+void NDFileHDF5::calcChunkWorkingSet(hsize_t *chunkBytes, hsize_t *chunksPerFrame, hsize_t *numChunks)
+{
+  int i, outer;
+
+  *chunkBytes = this->bytesPerElement;
+  for (i=0; i<this->rank; i++) *chunkBytes *= this->chunkdims[i];
+  *chunksPerFrame = 1;
+  for (i=this->extraRank; i<this->rank; i++){
+    *chunksPerFrame *= (this->framesize[i] + this->chunkdims[i] - 1) / this->chunkdims[i];
+  }
+  // The outermost extra dimension with chunks of more than one index keeps its chunks open
+  // while all of the extra dimensions inside it run through their indices
+  *numChunks = *chunksPerFrame;
+  for (outer=0; outer<this->extraRank; outer++){
+    if (this->chunkdims[outer] > 1) break;
+  }
+  for (i=outer+1; i<this->extraRank; i++){
+    if (this->maxdims[i] == H5S_UNLIMITED){
+      *numChunks = 0;
+      break;
+    }
+    *numChunks *= (this->maxdims[i] + this->chunkdims[i] - 1) / this->chunkdims[i];
+  }
+}
+
+/** Calculate the size of the chunk cache of the detector datasets.
+ * The cache holds all of the chunks that are being filled, so that each chunk is written to the
+ * file once, when it is complete. The cache is limited to HDF5_MAX_CHUNK_CACHE_BYTES, but always
+ * holds at least one chunk.
+ */
 hsize_t NDFileHDF5::calcChunkCacheBytes()
 {
-  hsize_t nbytes = 0;
-  epicsInt32 n_frames_chunk=0;
-  this->lock();
-  getIntegerParam(NDFileHDF5_nFramesChunks, &n_frames_chunk);
-  this->unlock();
-  nbytes = this->maxdims[this->rank - 1] * this->maxdims[this->rank - 2] * this->bytesPerElement * n_frames_chunk;
-  return nbytes;
+  hsize_t chunkBytes, chunksPerFrame, numChunks;
+
+  this->calcChunkWorkingSet(&chunkBytes, &chunksPerFrame, &numChunks);
+  if (numChunks == 0 || numChunks * chunkBytes > HDF5_MAX_CHUNK_CACHE_BYTES){
+    numChunks = HDF5_MAX_CHUNK_CACHE_BYTES / chunkBytes;
+  }
+  if (numChunks < 1) numChunks = 1;
+  return numChunks * chunkBytes;
 }
 
 /** find out whether or not the input is a prime number.
@@ -2228,34 +2519,63 @@ hsize_t NDFileHDF5::calcChunkCacheBytes()
   return divisor == 1;
 }*/
 
+/** Calculate the number of hash table slots of the chunk cache of the detector datasets.
+ * HDF5 recommends a prime number of slots, about 100 times the number of chunks that fit in the cache.
+ */
 hsize_t NDFileHDF5::calcChunkCacheSlots()
 {
-  unsigned int long nslots = 1;
-  unsigned int long num_chunks = 1;
-  double div_result = 0.0;
-  epicsInt32 n_frames_chunk=0, n_extra_dims=0, n_frames_capture=0;
-  
-  this->lock();
-  getIntegerParam(NDFileHDF5_nFramesChunks, &n_frames_chunk);
-  getIntegerParam(NDFileHDF5_nExtraDims, &n_extra_dims);
-  getIntegerParam(NDFileNumCapture, &n_frames_capture);
-  this->unlock();
-
-  div_result = (double)this->maxdims[this->rank - 1] / (double)this->chunkdims[this->rank -1];
-  num_chunks *= (unsigned int long)ceil(div_result);
-  div_result = (double)this->maxdims[this->rank - 2] / (double)this->chunkdims[this->rank -2];
-  num_chunks *= (unsigned int long)ceil(div_result);
-  div_result = (double)n_frames_capture / (double)n_frames_chunk;
-  num_chunks *= (unsigned int long)ceil(div_result);
-
-  // number of slots have to be a prime number which is between 10 and 50 times
-  // larger than the numer of chunks that can fit in the file/dataset.
-  nslots = num_chunks * 50;
-  while(!IsPrime(nslots))
+  hsize_t chunkBytes, chunksPerFrame, numChunks;
+  hsize_t nslots;
+
+  this->calcChunkWorkingSet(&chunkBytes, &chunksPerFrame, &numChunks);
+  nslots = this->calcChunkCacheBytes() / chunkBytes * 100;
+  // Between the HDF5 default and a hash table of a few MB
+  if (nslots < 521) nslots = 521;
+  if (nslots > 1000000) nslots = 1000000;
+  while(!IsPrime((int)nslots))
     nslots++;
   return nslots;
 }
 
+/** Add the time elapsed since the start of a stage of writeFile to the histogram of that stage.
+ * \param[in] stage - The stage.
+ * \param[in] start - The time at which the stage started.
+ */
+void NDFileHDF5::addStageTime(NDFileHDF5Stage_t stage, const epicsTimeStamp *start)
+{
+  epicsTimeStamp now;
+
+  epicsTimeGetCurrent(&now);
+  this->stageHistograms[stage].add(epicsTimeDiffInSeconds(&now, start));
+}
+
+/** Update the stage latency waveforms with the median, 99th percentile and maximum latency of each
+ * stage in ms.  While frames are written this is done at most every HDF5_STAGE_LATENCY_PERIOD seconds,
+ * so that the histograms are updated without taking the lock for each frame.
+ * \param[in] force - Update the waveforms even if they were updated recently.
+ */
+void NDFileHDF5::publishStageLatencies(bool force)
+{
+  epicsFloat64 p50[HDF5NumStages], p99[HDF5NumStages], maximum[HDF5NumStages];
+  epicsTimeStamp now;
+  int stage;
+
+  epicsTimeGetCurrent(&now);
+  if (!force && epicsTimeDiffInSeconds(&now, &this->stagePublished) < HDF5_STAGE_LATENCY_PERIOD) return;
+  this->stagePublished = now;
+
+  for (stage = 0; stage < HDF5NumStages; stage++){
+    p50[stage]     = 1000. * this->stageHistograms[stage].percentile(0.50);
+    p99[stage]     = 1000. * this->stageHistograms[stage].percentile(0.99);
+    maximum[stage] = 1000. * this->stageHistograms[stage].max();
+  }
+  this->lock();
+  doCallbacksFloat64Array(p50,     HDF5NumStages, NDFileHDF5_stageLatencyP50, 0);
+  doCallbacksFloat64Array(p99,     HDF5NumStages, NDFileHDF5_stageLatencyP99, 0);
+  doCallbacksFloat64Array(maximum, HDF5NumStages, NDFileHDF5_stageLatencyMax, 0);
+  this->unlock();
+}
+
 /** Setup the required allocation for the performance dataset
  */
 asynStatus NDFileHDF5::configurePerformanceDataset()
@@ -2766,10 +3086,11 @@ asynStatus NDFileHDF5::configureDatasetDims(NDArray *pArray)
   } else {
     numCapture = (int *)calloc(1, sizeof(int));
   }
+  // The chunking chosen by configureDims, which may have been tuned
   int user_chunking[3] = {1,1,1};
-  getIntegerParam(NDFileHDF5_nFramesChunks, &user_chunking[2]);
-  getIntegerParam(NDFileHDF5_nRowChunks,    &user_chunking[1]);
-  getIntegerParam(NDFileHDF5_nColChunks,    &user_chunking[0]);
+  getIntegerParam(NDFileHDF5_nFramesChunksActual, &user_chunking[2]);
+  getIntegerParam(NDFileHDF5_nRowChunksActual,    &user_chunking[1]);
+  getIntegerParam(NDFileHDF5_nColChunksActual,    &user_chunking[0]);
   this->unlock();
 
   // Iterate over the stored detector data sets and configure the dimensions
@@ -2875,7 +3196,7 @@ asynStatus NDFileHDF5::configureDims(NDArray *pArray)
       // Value of zero results in chunking of 1
       if (chunkSize < 1){
         this->chunkdims[i]   = 1;
-      } else if (chunkSize > numCapture){
+      } else if (numCapture > 0 && chunkSize > numCapture){
         this->chunkdims[i]   = numCapture;
       } else {
         this->chunkdims[i]   = chunkSize;
@@ -2897,6 +3218,7 @@ asynStatus NDFileHDF5::configureDims(NDArray *pArray)
   }
 
   this->rank = ndims;
+  this->extraRank = extradims;
   //asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, 
   //  "%s::%s initialising the basic frame dimension sizes. rank=%d\n",
   //  driverName, functionName, this->rank);
@@ -2931,6 +3253,9 @@ asynStatus NDFileHDF5::configureDims(NDArray *pArray)
     // There is another dimension (frame number)
     numDimsForChunking++;
   }
+  int autoTune = 0;
+  getIntegerParam(NDFileHDF5_chunkAutoTune, &autoTune);
+  if (autoTune) this->autoTuneChunking(pArray, user_chunking);
   // Loop over the number of user_chunking array elements
   for (i = 0; i<numDimsForChunking; i++)
   {
@@ -2950,15 +3275,22 @@ asynStatus NDFileHDF5::configureDims(NDArray *pArray)
       }
       assert(hdfdim >= 0); this->chunkdims[hdfdim] = user_chunking[i];
   }
-  setIntegerParam(NDFileHDF5_nFramesChunks, user_chunking[2]);
-  setIntegerParam(NDFileHDF5_nRowChunks,    user_chunking[1]);
-  setIntegerParam(NDFileHDF5_nColChunks,    user_chunking[0]);
+  // Tuned chunking is only shown in the readbacks, so that it does not replace the autosaved settings
+  if (!autoTune){
+    setIntegerParam(NDFileHDF5_nFramesChunks, user_chunking[2]);
+    setIntegerParam(NDFileHDF5_nRowChunks,    user_chunking[1]);
+    setIntegerParam(NDFileHDF5_nColChunks,    user_chunking[0]);
+  }
+  setIntegerParam(NDFileHDF5_nFramesChunksActual, user_chunking[2]);
+  setIntegerParam(NDFileHDF5_nRowChunksActual,    user_chunking[1]);
+  setIntegerParam(NDFileHDF5_nColChunksActual,    user_chunking[0]);
   // Check flushing parameter, if it is less than nFramesChunks then make them match
   getIntegerParam(NDFileHDF5_flushNthFrame, &numFlush);
   if (numFlush < user_chunking[2]){
     numFlush = user_chunking[2];
     setIntegerParam(NDFileHDF5_flushNthFrame, numFlush);
   }
+  this->checkChunking();
   this->unlock();
 
   for(i=0; i<pArray->ndims; i++) sprintf(strdims+(i*6), "%5d,", (int)pArray->dims[i].size);
@@ -2974,6 +3306,146 @@ asynStatus NDFileHDF5::configureDims(NDArray *pArray)
   return status;
 }
 
+/** Choose the chunk dimensions of the detector datasets from the frame size, data type and compression.
+ * Each chunk holds whole frames, at least as many as fit in the larger of NDFileHDF5_fsBlockSize and
+ * HDF5_AUTOTUNE_CHUNK_BYTES, so that chunks are written once, in large writes, without padding
+ * across the frame. Frames larger than HDF5_AUTOTUNE_MAX_CHUNK_BYTES are split along their slowest
+ * dimension. Chunks are one frame when the frames are compressed outside of the filter pipeline,
+ * which requires direct chunk writes.
+ * Called from configureDims with the lock held.
+ * \param[in] pArray - The NDArray that defines the frame dimensions.
+ * \param[in,out] user_chunking - The number of columns, rows and frames of a chunk, indexed as the
+ *                 NDArray dimensions followed by the frame number. These are not written to the
+ *                 chunking parameters, which keep the values set by the user.
+ */
+void NDFileHDF5::autoTuneChunking(NDArray *pArray, int *user_chunking)
+{
+  int i, blockSize, compression, numThreads;
+  int ndims = pArray->ndims;
+  hsize_t frameBytes = this->bytesPerElement;
+  hsize_t targetBytes = HDF5_AUTOTUNE_CHUNK_BYTES;
+  hsize_t maxFrames, nChunks, numCapture;
+  hsize_t nFrames = 1;
+  static const char *functionName = "autoTuneChunking";
+
+  if (ndims < 1 || ndims > 2){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+              "%s::%s WARNING: cannot tune the chunking of %d-dimensional NDArrays\n",
+              driverName, functionName, ndims);
+    return;
+  }
+  getIntegerParam(NDFileHDF5_fsBlockSize, &blockSize);
+  getIntegerParam(NDFileHDF5_compressionType, &compression);
+  getIntegerParam(NDFileHDF5_numCompressThreads, &numThreads);
+  if (blockSize > 0 && (hsize_t)blockSize > targetBytes) targetBytes = blockSize;
+
+  for (i=0; i<ndims; i++){
+    user_chunking[i] = (int)pArray->dims[i].size;
+    frameBytes *= pArray->dims[i].size;
+  }
+  if (frameBytes > HDF5_AUTOTUNE_MAX_CHUNK_BYTES){
+    // Split the frame into equal chunks along its slowest dimension
+    nChunks = (frameBytes + HDF5_AUTOTUNE_MAX_CHUNK_BYTES - 1) / HDF5_AUTOTUNE_MAX_CHUNK_BYTES;
+    user_chunking[ndims-1] = (int)((pArray->dims[ndims-1].size + nChunks - 1) / nChunks);
+  } else if (this->multiFrameFile){
+    nFrames = targetBytes / frameBytes;
+    maxFrames = HDF5_AUTOTUNE_MAX_CHUNK_BYTES / frameBytes;
+    if (nFrames > maxFrames) nFrames = maxFrames;
+    if (!pArray->codec.empty() || (compression != HDF5CompressNone && numThreads > 0)) nFrames = 1;
+    if (nFrames < 1) nFrames = 1;
+    // Spread the frames evenly over the chunks of a finite frame dimension, to reduce the padding of the last chunk.
+    // Use fewer, larger chunks where possible, so that the chunks are not smaller than the target size.
+    numCapture = this->maxdims[this->extraRank - 1];
+    if (numCapture != H5S_UNLIMITED && nFrames > 1){
+      nChunks = numCapture / nFrames;
+      if (nChunks < 1) nChunks = 1;
+      if ((numCapture + nChunks - 1) / nChunks > maxFrames) nChunks = (numCapture + nFrames - 1) / nFrames;
+      nFrames = (numCapture + nChunks - 1) / nChunks;
+    }
+  }
+  if (this->multiFrameFile) user_chunking[ndims] = (int)nFrames;
+
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s frame=%.0f bytes target=%.0f bytes chunking={%d, %d, %d}\n",
+            driverName, functionName, (double)frameBytes, (double)targetBytes,
+            user_chunking[0], user_chunking[1], user_chunking[2]);
+}
+
+/** Check the chunking of the detector datasets for configurations that write much more data than
+ * the frames contain, or that are slow to write.
+ * Sets NDFileHDF5_writeAmplification to an estimate of the bytes written to the file for each byte
+ * of frame data, which includes the padding of partial chunks, the alignment of chunks to
+ * NDFileHDF5_chunkBoundaryAlign, and the rewriting of incomplete chunks that do not fit in the chunk cache.
+ * Sets NDFileHDF5_chunkTuneMsg to the most serious problem found.
+ * Called from configureDims with the lock held.
+ */
+void NDFileHDF5::checkChunking()
+{
+  hsize_t chunkBytes, chunksPerFrame, numChunks, cacheBytes, size;
+  hsize_t framesPerChunk = 1;
+  double stored = 1.0, used = 1.0, padding, amplification;
+  int i, blockSize, align, threshold, compression, numThreads;
+  char message[256];
+  static const char *functionName = "checkChunking";
+
+  getIntegerParam(NDFileHDF5_fsBlockSize, &blockSize);
+  getIntegerParam(NDFileHDF5_chunkBoundaryAlign, &align);
+  getIntegerParam(NDFileHDF5_chunkBoundaryThreshold, &threshold);
+  getIntegerParam(NDFileHDF5_compressionType, &compression);
+  getIntegerParam(NDFileHDF5_numCompressThreads, &numThreads);
+
+  this->calcChunkWorkingSet(&chunkBytes, &chunksPerFrame, &numChunks);
+  cacheBytes = this->calcChunkCacheBytes();
+
+  // Chunks that do not divide a dimension are padded at its end
+  for (i=0; i<this->rank; i++){
+    if (i < this->extraRank){
+      size = this->maxdims[i];
+      framesPerChunk *= this->chunkdims[i];
+    } else {
+      size = this->framesize[i];
+    }
+    if (size == H5S_UNLIMITED) continue;
+    stored *= (double)(((size + this->chunkdims[i] - 1) / this->chunkdims[i]) * this->chunkdims[i]);
+    used   *= (double)size;
+  }
+  padding = stored / used;
+  amplification = padding;
+  if (align > 0 && chunkBytes >= (hsize_t)threshold){
+    amplification *= ceil((double)chunkBytes / align) * align / chunkBytes;
+  }
+  // Chunks of several frames that are evicted from the cache before they are complete are
+  // written, and read back, for each frame
+  bool thrashing = framesPerChunk > 1 && (numChunks == 0 || numChunks * chunkBytes > cacheBytes);
+  if (thrashing) amplification *= 2.0 * framesPerChunk;
+  setDoubleParam(NDFileHDF5_writeAmplification, amplification);
+
+  if (chunkBytes >= 4294967296ULL){
+    epicsSnprintf(message, sizeof(message), "Chunks of %.0f MB exceed the HDF5 limit of 4 GB",
+                  chunkBytes / 1048576.);
+  } else if (thrashing){
+    epicsSnprintf(message, sizeof(message), "Chunk cache of %.0f MB cannot hold the chunks being filled, use fewer frames per chunk",
+                  cacheBytes / 1048576.);
+  } else if (compression != HDF5CompressNone && numThreads > 0 && !this->isChunkFrame()){
+    epicsSnprintf(message, sizeof(message), "Compression threads need chunks of one frame");
+  } else if (padding > 1.25){
+    epicsSnprintf(message, sizeof(message), "%.0f%% of the dataset is padding, use chunks that divide the frames",
+                  (1.0 - 1.0 / padding) * 100.);
+  } else if (chunksPerFrame > 1000){
+    epicsSnprintf(message, sizeof(message), "%.0f chunks per frame, use larger chunks", (double)chunksPerFrame);
+  } else if (blockSize > 0 && chunkBytes < (hsize_t)blockSize){
+    epicsSnprintf(message, sizeof(message), "Chunks of %.0f kB are smaller than the file system block size",
+                  chunkBytes / 1024.);
+  } else {
+    setStringParam(NDFileHDF5_chunkTuneMsg, "Chunking OK");
+    return;
+  }
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+            "%s::%s WARNING: %s\n",
+            driverName, functionName, message);
+  setStringParam(NDFileHDF5_chunkTuneMsg, message);
+}
+
 /** Configure compression
  */
 asynStatus NDFileHDF5::configureCompression()
@@ -2999,6 +3471,7 @@ asynStatus NDFileHDF5::configureCompression()
   getIntegerParam(NDFileHDF5_bloscCompressor, &bloscCompressor);
   getIntegerParam(NDFileHDF5_bloscCompressLevel, &bloscLevel);
   this->unlock();
+  this->compressionScheme = compressionScheme;
   switch (compressionScheme)
   {
     case HDF5CompressNone:
@@ -3043,10 +3516,305 @@ asynStatus NDFileHDF5::configureCompression()
           H5Pset_filter(this->cparms, FILTER_BLOSC, H5Z_FLAG_OPTIONAL, 7, cds);
       }
       break;
+    case HDF5CompressBSLZ4:
+      {
+          /* 0 to 2 (inclusive) param slots hold the filter version and element size, 3 is the block size
+           * and 4 the compression. The filter sets 0 to 2 itself when it is available, but the arrays are
+           * written with direct chunk writes, so the filter is usually not loaded and they must be stored
+           * here for the file to be read back. Block size 0 selects the default block size. */
+          unsigned int cds[5];
+          cds[0] = BSHUF_VERSION_MAJOR;
+          cds[1] = BSHUF_VERSION_MINOR;
+          cds[2] = (unsigned int)H5Tget_size(this->datatype);
+          cds[3] = 0;
+          cds[4] = BSHUF_H5_COMPRESS_LZ4;
+          asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, 
+                    "%s::%s Setting bitshuffle/LZ4 compression filter\n",
+                    driverName, functionName);
+          H5Pset_filter(this->cparms, FILTER_BSHUF, H5Z_FLAG_OPTIONAL, 5, cds);
+      }
+      break;
+    case HDF5CompressLZ4:
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, 
+                "%s::%s Setting LZ4 compression filter\n",
+                driverName, functionName);
+      H5Pset_filter(this->cparms, FILTER_LZ4, H5Z_FLAG_OPTIONAL, 0, NULL);
+      break;
   }
   return status;
 }
 
+/** Check whether each chunk of the detector datasets holds exactly one frame.
+ * This is required to write frames with direct chunk writes.
+ */
+bool NDFileHDF5::isChunkFrame()
+{
+  int i;
+
+  if (this->chunkdims == NULL) return false;
+  for (i=0; i<this->rank; i++){
+    if (this->chunkdims[i] != this->framesize[i]) return false;
+  }
+  return true;
+}
+
+/** Check that a compressed NDArray can be written to the open file.
+ * The codec must produce the format of the filter of the detector datasets, and each chunk must
+ * be one frame, so that the compressed data can be written as a chunk without decompressing it.
+ * \param[in] pArray - The compressed NDArray.
+ */
+asynStatus NDFileHDF5::checkCompressedArray(NDArray *pArray)
+{
+  size_t i;
+  asynStatus status = asynSuccess;
+  static const char *functionName = "checkCompressedArray";
+
+  for (i=0; i<sizeof(directChunkCodecs)/sizeof(directChunkCodecs[0]); i++){
+    if (pArray->codec == directChunkCodecs[i].codec) break;
+  }
+  if (i == sizeof(directChunkCodecs)/sizeof(directChunkCodecs[0])){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: NDArray codec %s is not supported\n",
+              driverName, functionName, pArray->codec.c_str());
+    return asynError;
+  }
+
+  this->lock();
+  if (directChunkCodecs[i].compression != this->compressionScheme){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: NDArray codec %s does not match the compression filter of the file\n",
+              driverName, functionName, pArray->codec.c_str());
+    status = asynError;
+  } else if (!this->isChunkFrame()){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: compressed NDArrays require the chunk size to be one frame\n",
+              driverName, functionName);
+    status = asynError;
+  }
+  this->unlock();
+  if (status) return status;
+
+  if ((directChunkCodecs[i].compression == HDF5CompressLZ4 && !checkLZ4Chunk(pArray, false)) ||
+      (directChunkCodecs[i].compression == HDF5CompressBSLZ4 && !checkLZ4Chunk(pArray, true))){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: NDArray with codec %s does not have the block format of the HDF5 filter\n",
+              driverName, functionName, pArray->codec.c_str());
+    return asynError;
+  }
+  return asynSuccess;
+}
+
+/** Start the threads that compress the frames of a multi-frame file.
+ * The chunks are compressed by NDFileHDF5_numCompressThreads threads and written in order with
+ * direct chunk writes, instead of being compressed by the HDF5 filter pipeline in the file writing thread.
+ * This is only possible for the zlib and blosc filters, when each chunk is one frame; otherwise the
+ * filter pipeline is used.
+ */
+asynStatus NDFileHDF5::startCompressPool()
+{
+  int numThreads = 0;
+  int zLevel = 0;
+  int bloscShuffle = 0;
+  int bloscCompressor = 0;
+  int bloscLevel = 0;
+  const char *compressor = "";
+  bool supported = false;
+  size_t i;
+  static const char *functionName = "startCompressPool";
+
+  this->lock();
+  getIntegerParam(NDFileHDF5_numCompressThreads, &numThreads);
+  getIntegerParam(NDFileHDF5_zCompressLevel, &zLevel);
+  getIntegerParam(NDFileHDF5_bloscShuffleType, &bloscShuffle);
+  getIntegerParam(NDFileHDF5_bloscCompressor, &bloscCompressor);
+  getIntegerParam(NDFileHDF5_bloscCompressLevel, &bloscLevel);
+  this->unlock();
+
+  if (numThreads <= 0 || !this->multiFrameFile) return asynSuccess;
+
+#if H5_VERSION_GE(1,10,3)
+  #ifdef HAVE_ZLIB
+  if (this->compressionScheme == HDF5CompressZlib) supported = true;
+  #endif
+  #ifdef HAVE_BLOSC
+  if (this->compressionScheme == HDF5CompressBlosc &&
+      blosc_compcode_to_compname(bloscCompressor, &compressor) >= 0) supported = true;
+  #endif
+#endif
+  if (!supported || !this->isChunkFrame()){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+              "%s::%s compression threads not supported for this file, using the HDF5 filter pipeline\n",
+              driverName, functionName);
+    return asynSuccess;
+  }
+
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s starting %d compression threads\n",
+            driverName, functionName, numThreads);
+  this->pCompressPool = new NDWorkerPool("NDFileHDF5Compress", numThreads);
+  // Two chunks per thread keep the threads busy while the oldest chunk is written
+  this->compressChunks.resize(2*numThreads);
+  for (i=0; i<this->compressChunks.size(); i++){
+    NDFileHDF5Chunk *pChunk = new NDFileHDF5Chunk;
+    pChunk->pArray = NULL;
+    pChunk->pDataset = NULL;
+    pChunk->compression = this->compressionScheme;
+    pChunk->level = (this->compressionScheme == HDF5CompressZlib) ? zLevel : bloscLevel;
+    pChunk->shuffle = bloscShuffle;
+    pChunk->compressor = compressor;
+    pChunk->typeSize = H5Tget_size(this->datatype);
+    pChunk->pBuffer = NULL;
+    pChunk->bufferSize = 0;
+    pChunk->pData = NULL;
+    pChunk->dataSize = 0;
+    pChunk->filterMask = 0;
+    this->compressChunks[i] = pChunk;
+  }
+  this->compressHead = 0;
+  this->compressCount = 0;
+  return asynSuccess;
+}
+
+/** Stop the compression threads.
+ * Chunks that have not been written with commitChunks are discarded.
+ */
+void NDFileHDF5::stopCompressPool()
+{
+  size_t i;
+
+  if (this->pCompressPool == NULL) return;
+
+  // Deleting the pool waits for the chunks that are being compressed
+  delete this->pCompressPool;
+  this->pCompressPool = NULL;
+  for (i=0; i<this->compressChunks.size(); i++){
+    NDFileHDF5Chunk *pChunk = this->compressChunks[i];
+    if (pChunk->pArray) pChunk->pArray->release();
+    free(pChunk->pBuffer);
+    delete pChunk;
+  }
+  this->compressChunks.clear();
+  this->compressHead = 0;
+  this->compressCount = 0;
+}
+
+/** Queue a frame to be compressed by the compression threads.
+ * The position of the frame in the dataset is reserved now, and the chunk is written by a later call
+ * to commitChunks.  Frames that are already compressed are written in order with the other chunks.
+ * \param[in] pArray - The frame; it is reserved until the chunk has been written.
+ * \param[in] pDataset - The dataset to write the frame to.
+ */
+asynStatus NDFileHDF5::queueChunk(NDArray *pArray, NDFileHDF5Dataset *pDataset)
+{
+  asynStatus status;
+  NDFileHDF5Chunk *pChunk;
+
+  // Write the chunks that are done, and wait for the oldest one if there is no free chunk
+  status = this->commitChunks(false);
+  if (status != asynSuccess) return status;
+
+  pChunk = this->compressChunks[(this->compressHead + this->compressCount) % this->compressChunks.size()];
+  status = pDataset->reserveChunk(pChunk->offset);
+  if (status != asynSuccess) return status;
+  pArray->reserve();
+  pChunk->pArray = pArray;
+  pChunk->pDataset = pDataset;
+  this->compressCount++;
+
+  if (!pArray->codec.empty()){
+    pChunk->pData = pArray->pData;
+    pChunk->dataSize = pArray->compressedSize;
+    pChunk->filterMask = 0;
+    pChunk->done.signal();
+  } else {
+    this->pCompressPool->queue(compressChunkTask, pChunk);
+  }
+  return asynSuccess;
+}
+
+/** Write the compressed chunks in the order they were queued.
+ * \param[in] all - If true wait for all the chunks, otherwise write the chunks that are done,
+ *                  waiting only if no chunk is free for the next frame.
+ */
+asynStatus NDFileHDF5::commitChunks(bool all)
+{
+  asynStatus status = asynSuccess;
+  NDFileHDF5Chunk *pChunk;
+
+  while (this->compressCount > 0){
+    pChunk = this->compressChunks[this->compressHead];
+    if (all || this->compressCount == this->compressChunks.size()){
+      pChunk->done.wait();
+    } else if (!pChunk->done.tryWait()){
+      break;
+    }
+    if (pChunk->pDataset->writeChunk(pChunk->pData, pChunk->dataSize, &pChunk->offset[0], pChunk->filterMask)){
+      status = asynError;
+    }
+    pChunk->pArray->release();
+    pChunk->pArray = NULL;
+    this->compressHead = (this->compressHead + 1) % this->compressChunks.size();
+    this->compressCount--;
+  }
+  return status;
+}
+
+/** Configure the detector datasets to write the frames in batches of one chunk.
+ * The frames of a chunk are collected in a buffer and written with one call, instead of extending
+ * the dataset and writing a hyperslab for every frame.  This is only done for multi-frame files with
+ * more than one frame per chunk, no extra dimensions, no positional placement, and when the frames are
+ * not compressed by the compression threads.
+ * \param[in] pArray - An NDArray with the size of the frames.
+ */
+void NDFileHDF5::configureBatchWrites(NDArray *pArray)
+{
+  int batchWrites = 0;
+  int extradims = 0;
+  int posRunning = 0;
+  int numFrames = 0;
+  NDArrayInfo_t info;
+  static const char *functionName = "configureBatchWrites";
+
+  this->lock();
+  getIntegerParam(NDFileHDF5_batchWrites, &batchWrites);
+  getIntegerParam(NDFileHDF5_nExtraDims, &extradims);
+  getIntegerParam(NDFileHDF5_posRunning, &posRunning);
+  this->unlock();
+
+  if (batchWrites && this->multiFrameFile && this->pCompressPool == NULL && extradims == 0 && posRunning == 0){
+    numFrames = (int)this->chunkdims[0];
+  }
+  if (batchWrites && numFrames <= 1){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+              "%s::%s batch writes not possible for this file, writing one frame at a time\n",
+              driverName, functionName);
+  }
+
+  pArray->getInfo(&info);
+  std::map<std::string, NDFileHDF5Dataset *>::iterator it_dset;
+  for (it_dset = this->detDataMap.begin(); it_dset != this->detDataMap.end(); ++it_dset){
+    it_dset->second->configureBatch(numFrames, info.totalBytes);
+  }
+}
+
+/** Write the frames that are waiting in the batch buffers of the detector datasets, and free the buffers.
+ * This is called on every path that closes the file, including the error paths of writeFile.
+ */
+void NDFileHDF5::flushBatches()
+{
+  double extendTime, writeTime;
+  std::map<std::string, NDFileHDF5Dataset *>::iterator it_batch;
+
+  for (it_batch = this->detDataMap.begin(); it_batch != this->detDataMap.end(); ++it_batch){
+    it_batch->second->flushBatch(this->datatype, this->framesize);
+    it_batch->second->configureBatch(0, 0);
+    if (it_batch->second->takeWriteTimes(&extendTime, &writeTime)){
+      this->stageHistograms[HDF5StageExtend].add(extendTime);
+      this->stageHistograms[HDF5StageWrite].add(writeTime);
+    }
+  }
+}
+
 /** Translate the NDArray datatype to HDF5 datatypes 
  */
 hid_t NDFileHDF5::typeNd2Hdf(NDDataType_t datatype)
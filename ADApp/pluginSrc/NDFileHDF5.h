@@ -8,18 +8,23 @@
 #define NDFileHDF5_H
 
 #include <list>
+#include <vector>
 #include <hdf5.h>
 #include <asynDriver.h>
 #include <NDPluginFile.h>
 #include <NDArray.h>
+#include <NDWorkerPool.h>
 #include "NDFileHDF5Layout.h"
 #include "NDFileHDF5Dataset.h"
 #include "NDFileHDF5LayoutXML.h"
 #include "NDFileHDF5AttributeDataset.h"
+#include "NDFileHDF5Histogram.h"
 #include "NDFileHDF5VersionCheck.h"
 
 #define MAXEXTRADIMS 10
 
+struct NDFileHDF5Chunk;
+
 #define str_NDFileHDF5_nRowChunks        "HDF5_nRowChunks"
 #define str_NDFileHDF5_nColChunks        "HDF5_nColChunks"
 #define str_NDFileHDF5_nFramesChunks     "HDF5_nFramesChunks"
@@ -42,6 +47,8 @@
 #define str_NDFileHDF5_bloscShuffleType  "HDF5_bloscShuffleType"
 #define str_NDFileHDF5_bloscCompressor   "HDF5_bloscCompressor"
 #define str_NDFileHDF5_bloscCompressLevel "HDF5_bloscCompressLevel"
+#define str_NDFileHDF5_numCompressThreads "HDF5_numCompressThreads"
+#define str_NDFileHDF5_batchWrites      "HDF5_batchWrites"
 #define str_NDFileHDF5_dimAttDatasets    "HDF5_dimAttDatasets"
 #define str_NDFileHDF5_layoutErrorMsg    "HDF5_layoutErrorMsg"
 #define str_NDFileHDF5_layoutValid       "HDF5_layoutValid"
@@ -58,6 +65,38 @@
 #define str_NDFileHDF5_SWMRSupported     "HDF5_SWMRSupported"
 #define str_NDFileHDF5_SWMRMode          "HDF5_SWMRMode"
 #define str_NDFileHDF5_SWMRRunning       "HDF5_SWMRRunning"
+#define str_NDFileHDF5_chunkAutoTune     "HDF5_chunkAutoTune"
+#define str_NDFileHDF5_fsBlockSize       "HDF5_fsBlockSize"
+#define str_NDFileHDF5_writeAmplification "HDF5_writeAmplification"
+#define str_NDFileHDF5_chunkTuneMsg      "HDF5_chunkTuneMsg"
+#define str_NDFileHDF5_nRowChunksActual  "HDF5_nRowChunksActual"
+#define str_NDFileHDF5_nColChunksActual  "HDF5_nColChunksActual"
+#define str_NDFileHDF5_nFramesChunksActual "HDF5_nFramesChunksActual"
+#define str_NDFileHDF5_stageLatencyP50   "HDF5_stageLatencyP50"
+#define str_NDFileHDF5_stageLatencyP99   "HDF5_stageLatencyP99"
+#define str_NDFileHDF5_stageLatencyMax   "HDF5_stageLatencyMax"
+
+/** The stages of writing a frame, for which latency histograms are kept.
+  * These are the indices of the elements of the stage latency waveforms. */
+typedef enum {
+  HDF5StageAttributes,   /**< Gathering the NDAttributes of the frame */
+  HDF5StageExtend,       /**< Extending the detector dataset */
+  HDF5StageWrite,        /**< Writing the frame data (H5Dwrite or H5Dwrite_chunk) */
+  HDF5StageAttrDatasets, /**< Writing the NDAttribute datasets */
+  HDF5StageFlush,        /**< Flushing the detector dataset in SWMR mode */
+  HDF5NumStages
+} NDFileHDF5Stage_t;
+
+/** Minimum time between updates of the stage latency waveforms while frames are written, in seconds */
+#define HDF5_STAGE_LATENCY_PERIOD 0.5
+
+/** Chunk size that the chunk autotuner aims for when the file system block size is smaller */
+#define HDF5_AUTOTUNE_CHUNK_BYTES (1024*1024)
+/** Largest chunk that the chunk autotuner creates; larger frames are split into several chunks.
+  * HDF5 does not allow chunks of 4 GB or more. */
+#define HDF5_AUTOTUNE_MAX_CHUNK_BYTES (1024*1024*1024)
+/** Chunk cache size above which the chunk configuration is reported as pathological */
+#define HDF5_MAX_CHUNK_CACHE_BYTES (1024*1024*1024)
 
 /** Writes NDArrays in the HDF5 file format; an XML file can control the structure of the HDF5 file.
   */
@@ -147,6 +186,8 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     int NDFileHDF5_bloscCompressor;
     int NDFileHDF5_bloscCompressLevel;
     int NDFileHDF5_bloscShuffleType;
+    int NDFileHDF5_numCompressThreads;
+    int NDFileHDF5_batchWrites;
     int NDFileHDF5_dimAttDatasets;
     int NDFileHDF5_layoutErrorMsg;
     int NDFileHDF5_layoutValid;
@@ -159,6 +200,16 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     int NDFileHDF5_SWMRSupported;
     int NDFileHDF5_SWMRMode;
     int NDFileHDF5_SWMRRunning;
+    int NDFileHDF5_chunkAutoTune;
+    int NDFileHDF5_fsBlockSize;
+    int NDFileHDF5_writeAmplification;
+    int NDFileHDF5_chunkTuneMsg;
+    int NDFileHDF5_nRowChunksActual;
+    int NDFileHDF5_nColChunksActual;
+    int NDFileHDF5_nFramesChunksActual;
+    int NDFileHDF5_stageLatencyP50;
+    int NDFileHDF5_stageLatencyP99;
+    int NDFileHDF5_stageLatencyMax;
 
 #ifndef _UNITTEST_HDF5_
   private:
@@ -181,7 +232,17 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     hid_t typeNd2Hdf(NDDataType_t datatype);
     asynStatus configureDatasetDims(NDArray *pArray);
     asynStatus configureDims(NDArray *pArray);
+    void autoTuneChunking(NDArray *pArray, int *user_chunking);
+    void checkChunking();
     asynStatus configureCompression();
+    bool isChunkFrame();
+    asynStatus checkCompressedArray(NDArray *pArray);
+    asynStatus startCompressPool();
+    void stopCompressPool();
+    asynStatus queueChunk(NDArray *pArray, NDFileHDF5Dataset *pDataset);
+    asynStatus commitChunks(bool all);
+    void configureBatchWrites(NDArray *pArray);
+    void flushBatches();
     char* getDimsReport();
     asynStatus writeStringAttribute(hid_t element, const char* attrName, const char* attrStrValue);
     asynStatus calculateAttributeChunking(int *chunking, int *mdim_chunking);
@@ -192,8 +253,11 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     asynStatus writePerformanceDataset();
     void calcNumFrames();
     unsigned int calcIstorek();
+    void calcChunkWorkingSet(hsize_t *chunkBytes, hsize_t *chunksPerFrame, hsize_t *numChunks);
     hsize_t calcChunkCacheBytes();
     hsize_t calcChunkCacheSlots();
+    void addStageTime(NDFileHDF5Stage_t stage, const epicsTimeStamp *start);
+    void publishStageLatencies(bool force);
 
     void checkForOpenFile();
     bool checkForSWMRMode();
@@ -229,6 +293,8 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     epicsTimeStamp opents;
     epicsTimeStamp firstFrame;
     double frameSize;  /** < frame size in megabits. For performance measurement. */
+    NDFileHDF5Histogram stageHistograms[HDF5NumStages]; /** < Latencies of the stages of writeFile, only used by the thread that writes the file */
+    epicsTimeStamp stagePublished; /** < Time at which the stage latency waveforms were last updated */
     int bytesPerElement;
     char *hostname;
 
@@ -239,11 +305,17 @@ class epicsShareClass NDFileHDF5 : public NDPluginFile
     hid_t dataspace;
     hid_t datatype;
     hid_t cparms;
+    int compressionScheme;  /** < The compression filter of the detector datasets in the open file */
+    NDWorkerPool *pCompressPool;                /** < Threads that compress chunks, NULL if the filter pipeline compresses them */
+    std::vector<NDFileHDF5Chunk *> compressChunks; /** < Ring of chunks being compressed, written in order */
+    size_t compressHead;    /** < Index in compressChunks of the oldest chunk that has not been written */
+    size_t compressCount;   /** < Number of chunks that have not been written */
     void *ptrFillValue;
     hid_t perf_dataset_id;
 
     /* dimension descriptors */
     int rank;               /** < number of dimensions */
+    int extraRank;          /** < number of dimensions that are not frame dimensions, including the frame number. 0 for single frame files */
     hsize_t *dims;          /** < Array of current dimension sizes. This updates as various dimensions grow. */
     hsize_t *maxdims;       /** < Array of maximum dimension sizes. The value -1 is HDF5 term for infinite. */
     hsize_t *chunkdims;     /** < Array of chunk size in each dimension. Only the dimensions that indicate the frame size (width, height) can really be tweaked. All other dimensions should be set to 1. */
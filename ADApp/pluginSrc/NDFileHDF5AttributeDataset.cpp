@@ -9,9 +9,13 @@
 #include <epicsString.h>
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
 #include <epicsMath.h>
 
 #define MAX_ATTRIBUTE_STRING_SIZE 256
+/* Maximum size of the buffer of values that have not been written yet */
+#define MAX_ATTRIBUTE_BUFFER_SIZE 65536
 
 NDFileHDF5AttributeDataset::NDFileHDF5AttributeDataset(hid_t file, const std::string& name, NDAttrDataType_t type) :
   name_(name),
@@ -35,7 +39,12 @@ NDFileHDF5AttributeDataset::NDFileHDF5AttributeDataset(hid_t file, const std::st
   rank_(0),
   nextRecord_(0),
   extraDimensions_(0),
-  whenToSave_(hdf5::OnFrame)
+  whenToSave_(hdf5::OnFrame),
+  buffer_(NULL),
+  bufferSize_(0),
+  bufferCount_(0),
+  elementBytes_(0),
+  bufferStart_(0)
 {
   //printf("Constructor called for %s\n", name.c_str());
   // Allocate enough memory for the fill value to accept any data type
@@ -47,6 +56,7 @@ NDFileHDF5AttributeDataset::~NDFileHDF5AttributeDataset()
   //printf("Destructor called for %s\n", name_.c_str());
   // Free the memory that was allocated for the fill value
   free(ptrFillValue_);
+  free(buffer_);
 }
 
 void NDFileHDF5AttributeDataset::setDsetName(const std::string& dsetName)
@@ -122,6 +132,17 @@ asynStatus NDFileHDF5AttributeDataset::createHDF5Dataset()
 
   memspace_ = H5Screate_simple(rank_, elementSize_, NULL);
 
+  // Values are buffered up to the end of a chunk and written together, if the dataset grows
+  // along the first dimension only
+  elementBytes_ = H5Tget_size(datatype_);
+  bufferCount_ = 0;
+  bufferSize_ = 0;
+  if (extraDimensions_ <= 1){
+    bufferSize_ = MAX_ATTRIBUTE_BUFFER_SIZE / elementBytes_;
+    if (chunk_[0] < bufferSize_) bufferSize_ = (size_t)chunk_[0];
+    if (bufferSize_ < 1) bufferSize_ = 1;
+  }
+
   return status;
 }
 
@@ -141,6 +162,33 @@ asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenTo
     if (ret == ND_ERROR) {
       memset(pDatavalue, 0, MAX_ATTRIBUTE_STRING_SIZE);
     }
+
+    if (bufferSize_ > 0){
+      // Values are only buffered while they are consecutive
+      if (bufferCount_ > 0 && offset_[0] != bufferStart_ + bufferCount_){
+        status = this->writeBuffer();
+      }
+      if (buffer_ == NULL){
+        buffer_ = (char *)malloc(bufferSize_ * elementBytes_);
+      }
+      if (buffer_ != NULL){
+        if (bufferCount_ == 0) bufferStart_ = offset_[0];
+        // Undefined attributes are stored as the fill value
+        memcpy(buffer_ + bufferCount_ * elementBytes_, isUndefined_ ? ptrFillValue_ : pDatavalue, elementBytes_);
+        bufferCount_++;
+        // Write the buffer at the end of each chunk, when it is full, and before a flush
+        if ((chunk_[0] > 0 && (offset_[0]+1) % chunk_[0] == 0) || bufferCount_ == bufferSize_ || flush == 1){
+          if (this->writeBuffer() != asynSuccess) status = asynError;
+        }
+        // Check if we are being asked to flush
+        if (flush == 1 && status == asynSuccess){
+          status = this->flushDataset();
+        }
+        nextRecord_++;
+        return status;
+      }
+    }
+
     // Work with HDF5 library to select a suitable hyperslab (one element) and write the new data to it
     H5Dset_extent(dataset_, dims_);
     filespace_ = H5Dget_space(dataset_);
@@ -165,6 +213,34 @@ asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenTo
   return status;
 }
 
+/** Write the buffered values to the dataset with a single hyperslab write.
+ */
+asynStatus NDFileHDF5AttributeDataset::writeBuffer()
+{
+  asynStatus status = asynSuccess;
+  hid_t memspace;
+
+  if (bufferCount_ == 0) return asynSuccess;
+
+  std::vector<hsize_t> start(offset_, offset_ + rank_);
+  std::vector<hsize_t> count(elementSize_, elementSize_ + rank_);
+  start[0] = bufferStart_;
+  count[0] = bufferCount_;
+  bufferCount_ = 0;
+
+  H5Dset_extent(dataset_, dims_);
+  filespace_ = H5Dget_space(dataset_);
+  H5Sselect_hyperslab(filespace_, H5S_SELECT_SET, &start[0], NULL, &count[0], NULL);
+  memspace = H5Screate_simple(rank_, &count[0], NULL);
+  if (H5Dwrite(dataset_, datatype_, memspace, filespace_, H5P_DEFAULT, buffer_) < 0){
+    status = asynError;
+  }
+  H5Sclose(memspace);
+  H5Sclose(filespace_);
+
+  return status;
+}
+
 asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenToSave, hsize_t *offsets, NDAttribute *ndAttr, int flush, int indexed)
 {
   asynStatus status = asynSuccess;
@@ -174,6 +250,8 @@ asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenTo
   //check if the attribute is meant to be saved at this time
   if (whenToSave_ == whenToSave) {
     // Extend the dataset as required to store the data
+    // Positional writes are not buffered; write any values that are still in the buffer first
+    writeBuffer();
     if (indexed == -1){
       extendDataSet(offsets);
     } else {
@@ -210,6 +288,9 @@ asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenTo
 asynStatus NDFileHDF5AttributeDataset::closeAttributeDataset()
 {
   //printf("close called for %s\n", name_.c_str());
+  writeBuffer();
+  free(buffer_);
+  buffer_ = NULL;
   H5Dclose(dataset_);
   H5Sclose(memspace_);
   H5Sclose(dataspace_);
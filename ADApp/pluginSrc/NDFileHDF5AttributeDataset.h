@@ -42,6 +42,7 @@ private:
   void extendDataSet();
   void extendDataSet(hsize_t *offsets);
   void extendIndexDataSet(hsize_t offset);
+  asynStatus writeBuffer();
 
   std::string      name_;            // Name of the attribute
   std::string      dsetName_;        // Name of the dataset to store
@@ -66,6 +67,11 @@ private:
   int              nextRecord_;
   int              extraDimensions_;
   hdf5::When_t     whenToSave_;
+  char             *buffer_;         // Values that have not been written yet, for consecutive elements
+  size_t           bufferSize_;      // Maximum number of values in buffer_
+  size_t           bufferCount_;     // Number of values in buffer_
+  size_t           elementBytes_;    // Size of one value in bytes
+  hsize_t          bufferStart_;     // Offset of the first value in buffer_
 
 };
 
@@ -1,6 +1,7 @@
 #include "NDFileHDF5Dataset.h"
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
 
 static const char *fileName = "NDFileHDF5Dataset";
 
@@ -16,6 +17,27 @@ NDFileHDF5Dataset::NDFileHDF5Dataset(asynUser *pAsynUser, const std::string& nam
   this->dims_        = NULL;
   this->offset_      = NULL;
   this->virtualdims_ = NULL;
+  this->batchBuffer_ = NULL;
+  this->batchSize_   = 0;
+  this->batchCount_  = 0;
+  this->batchFrameBytes_ = 0;
+  this->batchStart_  = 0;
+  this->extendTime_  = 0.0;
+  this->writeTime_   = 0.0;
+  this->timed_       = false;
+}
+
+/** Destructor.
+ * Frees the batch buffer and the dimension arrays.  Frames that are still in the batch buffer are discarded,
+ * flushBatch must be called first to write them.  The dataset handle is not closed.
+ */
+NDFileHDF5Dataset::~NDFileHDF5Dataset()
+{
+  free(this->batchBuffer_);
+  free(this->maxdims_);
+  free(this->dims_);
+  free(this->offset_);
+  free(this->virtualdims_);
 }
  
 /** configureDims.
@@ -161,12 +183,38 @@ asynStatus NDFileHDF5Dataset::writeFile(NDArray *pArray, hid_t datatype, hid_t d
   herr_t hdfstatus;
   static const char *functionName = "writeFile";
 
+  // In batch mode copy the frame to the batch buffer, and write the frames when the buffer is full
+  if (this->batchSize_ > 0){
+    if (this->batchBuffer_ == NULL){
+      this->batchBuffer_ = (char *)malloc(this->batchSize_ * this->batchFrameBytes_);
+      if (this->batchBuffer_ == NULL){
+        asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+                  "%s::%s ERROR Unable to allocate the batch buffer for dataset [%s]\n", 
+                  fileName, functionName, this->name_.c_str());
+        return asynError;
+      }
+    }
+    if (this->batchCount_ == 0) this->batchStart_ = this->offset_[0];
+    memcpy(this->batchBuffer_ + this->batchCount_ * this->batchFrameBytes_, pArray->pData, this->batchFrameBytes_);
+    this->batchCount_++;
+    this->nextRecord_++;
+    // Write the batch when it reaches the end of a chunk, so that batches stay aligned
+    // to the chunks after a partial batch has been flushed
+    if (((this->offset_[0] + 1) % this->batchSize_ == 0) || (this->batchCount_ == this->batchSize_)){
+      return this->flushBatch(datatype, framesize);
+    }
+    return asynSuccess;
+  }
+
   // Increase the size of the dataset
   asynPrint(this->pAsynUser_, ASYN_TRACE_FLOW,
             "%s::%s: set_extent dims={%d,%d,%d}\n",
             fileName, functionName, (int)this->dims_[0], (int)this->dims_[1], (int)this->dims_[2]);
 
+  epicsTimeStamp callStart;
+  epicsTimeGetCurrent(&callStart);
   hdfstatus = H5Dset_extent(this->dataset_, this->dims_);
+  this->addTime(&this->extendTime_, &callStart);
   if (hdfstatus){
     asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
               "%s::%s ERROR Increasing the size of the dataset [%s] failed\n", 
@@ -189,7 +237,9 @@ asynStatus NDFileHDF5Dataset::writeFile(NDArray *pArray, hid_t datatype, hid_t d
     return asynError;
   }
   // Write the data to the hyperslab.
+  epicsTimeGetCurrent(&callStart);
   hdfstatus = H5Dwrite(this->dataset_, datatype, dataspace, fspace, H5P_DEFAULT, pArray->pData);
+  this->addTime(&this->writeTime_, &callStart);
   if (hdfstatus){
     asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
               "%s::%s ERROR Unable to write data to hyperslab\n", 
@@ -210,6 +260,189 @@ asynStatus NDFileHDF5Dataset::writeFile(NDArray *pArray, hid_t datatype, hid_t d
   return asynSuccess;
 }
 
+/** configureBatch.
+ * Write the frames in batches instead of one at a time.  The frames are copied to a buffer and each batch
+ * is written with a single hyperslab write, which reduces the HDF5 overhead per frame for small frames.
+ * Batches are only supported when the frames are stacked along the first dimension of the dataset,
+ * i.e. without extra dimensions or positional placement.
+ * \param[in] numFrames - The number of frames in a batch; normally the number of frames in a chunk.
+ *                        Each batch ends on a multiple of numFrames in the file.
+ *                        0 or 1 writes the frames one at a time.
+ * \param[in] frameBytes - The size of one frame in bytes.
+ */
+asynStatus NDFileHDF5Dataset::configureBatch(int numFrames, size_t frameBytes)
+{
+  free(this->batchBuffer_);
+  this->batchBuffer_ = NULL;
+  this->batchSize_ = (numFrames > 1) ? numFrames : 0;
+  this->batchCount_ = 0;
+  this->batchFrameBytes_ = frameBytes;
+  return asynSuccess;
+}
+
+/** flushBatch.
+ * Write the frames in the batch buffer.  This must be called before the dataset is flushed or closed.
+ * \param[in] datatype - The HDF5 datatype of the data.
+ * \param[in] framesize - The size of one frame in each dimension of the dataset.
+ */
+asynStatus NDFileHDF5Dataset::flushBatch(hid_t datatype, hsize_t *framesize)
+{
+  herr_t hdfstatus;
+  asynStatus status = asynSuccess;
+  static const char *functionName = "flushBatch";
+
+  if (this->batchCount_ == 0) return asynSuccess;
+
+  std::vector<hsize_t> start(this->offset_, this->offset_ + this->rank_);
+  std::vector<hsize_t> count(framesize, framesize + this->rank_);
+  start[0] = this->batchStart_;
+  count[0] = this->batchCount_;
+  this->batchCount_ = 0;
+
+  asynPrint(this->pAsynUser_, ASYN_TRACE_FLOW,
+            "%s::%s: set_extent dims={%d,%d,%d} writing %d frames\n",
+            fileName, functionName, (int)this->dims_[0], (int)this->dims_[1], (int)this->dims_[2], (int)count[0]);
+
+  epicsTimeStamp callStart;
+  epicsTimeGetCurrent(&callStart);
+  hdfstatus = H5Dset_extent(this->dataset_, this->dims_);
+  this->addTime(&this->extendTime_, &callStart);
+  if (hdfstatus){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Increasing the size of the dataset [%s] failed\n", 
+              fileName, functionName, this->name_.c_str());
+    return asynError;
+  }
+  hid_t fspace = H5Dget_space(this->dataset_);
+  if (fspace < 0){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Unable to get a copy of the dataspace for dataset [%s]\n", 
+              fileName, functionName, this->name_.c_str());
+    return asynError;
+  }
+  hid_t mspace = H5Screate_simple(this->rank_, &count[0], NULL);
+  if (mspace < 0){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Unable to create the memory dataspace\n", 
+              fileName, functionName);
+    H5Sclose(fspace);
+    return asynError;
+  }
+  hdfstatus = H5Sselect_hyperslab(fspace, H5S_SELECT_SET, &start[0], NULL, &count[0], NULL);
+  if (hdfstatus){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Unable to select hyperslab\n", 
+              fileName, functionName);
+    status = asynError;
+  } else {
+    epicsTimeGetCurrent(&callStart);
+    hdfstatus = H5Dwrite(this->dataset_, datatype, mspace, fspace, H5P_DEFAULT, this->batchBuffer_);
+    this->addTime(&this->writeTime_, &callStart);
+    if (hdfstatus){
+      asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+                "%s::%s ERROR Unable to write data to hyperslab\n", 
+                fileName, functionName);
+      status = asynError;
+    }
+  }
+  H5Sclose(mspace);
+  H5Sclose(fspace);
+  return status;
+}
+
+/** writeChunk.
+ * Write one chunk of already compressed data with a direct chunk write, bypassing the HDF5
+ * filter pipeline.  The chunk is written at the current offset, so the chunk dimensions
+ * must be the frame size.
+ * \param[in] pData - The compressed data, in the format that the dataset filter would produce.
+ * \param[in] dataSize - The size of the compressed data in bytes.
+ */
+asynStatus NDFileHDF5Dataset::writeChunk(const void *pData, size_t dataSize)
+{
+  std::vector<hsize_t> offset;
+  asynStatus status;
+
+  status = this->reserveChunk(offset);
+  if (status == asynSuccess){
+    // A filter mask of 0 means that all of the filters of the dataset have been applied
+    status = this->writeChunk(pData, dataSize, &offset[0], 0);
+  }
+  return status;
+}
+
+/** reserveChunk.
+ * Increase the size of the dataset to hold the frame at the current offset, and return that offset.
+ * The chunk can then be written later with writeChunk, while following frames are added.
+ * \param[out] offset - The offset of the frame in each dimension of the dataset.
+ */
+asynStatus NDFileHDF5Dataset::reserveChunk(std::vector<hsize_t>& offset)
+{
+  herr_t hdfstatus;
+  static const char *functionName = "reserveChunk";
+
+  asynPrint(this->pAsynUser_, ASYN_TRACE_FLOW,
+            "%s::%s: set_extent dims={%d,%d,%d}\n",
+            fileName, functionName, (int)this->dims_[0], (int)this->dims_[1], (int)this->dims_[2]);
+
+  epicsTimeStamp callStart;
+  epicsTimeGetCurrent(&callStart);
+  hdfstatus = H5Dset_extent(this->dataset_, this->dims_);
+  this->addTime(&this->extendTime_, &callStart);
+  if (hdfstatus){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Increasing the size of the dataset [%s] failed\n", 
+              fileName, functionName, this->name_.c_str());
+    return asynError;
+  }
+  offset.assign(this->offset_, this->offset_ + this->rank_);
+
+  this->nextRecord_++;
+
+  return asynSuccess;
+}
+
+/** writeChunk.
+ * Write one chunk with a direct chunk write at an offset returned by reserveChunk.
+ * \param[in] pData - The chunk data, in the format that the dataset filters would produce.
+ * \param[in] dataSize - The size of the chunk data in bytes.
+ * \param[in] offset - The offset of the chunk in the dataset.
+ * \param[in] filterMask - Bit n is set if filter n of the dataset was not applied to the data.
+ */
+asynStatus NDFileHDF5Dataset::writeChunk(const void *pData, size_t dataSize, const hsize_t *offset,
+                                         unsigned int filterMask)
+{
+  static const char *functionName = "writeChunk";
+
+  // Direct chunk write was added to the core library in 1.10.3
+  #if H5_VERSION_GE(1,10,3)
+
+  herr_t hdfstatus;
+
+  asynPrint(this->pAsynUser_, ASYN_TRACE_FLOW,
+            "%s::%s: chunk size=%lu filter mask=%u\n",
+            fileName, functionName, (unsigned long)dataSize, filterMask);
+
+  epicsTimeStamp callStart;
+  epicsTimeGetCurrent(&callStart);
+  hdfstatus = H5Dwrite_chunk(this->dataset_, H5P_DEFAULT, filterMask, offset, dataSize, pData);
+  this->addTime(&this->writeTime_, &callStart);
+  if (hdfstatus){
+    asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR Unable to write chunk to dataset [%s]\n", 
+              fileName, functionName, this->name_.c_str());
+    return asynError;
+  }
+
+  return asynSuccess;
+
+  #else
+  asynPrint(this->pAsynUser_, ASYN_TRACE_ERROR,
+            "%s::%s Direct chunk write attempted but the library compiled against doesn't support it.\n",
+            fileName, functionName);
+  return asynError;
+  #endif
+}
+
 /** getHandle.
  * Returns the HDF5 handle to this dataset.
  */
@@ -246,3 +479,36 @@ asynStatus NDFileHDF5Dataset::flushDataset()
   return asynSuccess;  
 }
 
+/** takeWriteTimes.
+ * Return the time spent extending the dataset and writing data to it since the last call, and
+ * reset the times.  Frames that are only copied to the batch buffer take no time in either.
+ * \param[out] extendTime - The time in seconds spent in H5Dset_extent.
+ * \param[out] writeTime - The time in seconds spent in H5Dwrite and H5Dwrite_chunk.
+ * Returns false if neither was called since the last call.
+ */
+bool NDFileHDF5Dataset::takeWriteTimes(double *extendTime, double *writeTime)
+{
+  bool timed = this->timed_;
+
+  *extendTime = this->extendTime_;
+  *writeTime  = this->writeTime_;
+  this->extendTime_ = 0.0;
+  this->writeTime_  = 0.0;
+  this->timed_      = false;
+  return timed;
+}
+
+/** addTime.
+ * Add the time elapsed since start to a total.
+ * \param[in,out] total - The total time in seconds.
+ * \param[in] start - The time at which the HDF5 call started.
+ */
+void NDFileHDF5Dataset::addTime(double *total, const epicsTimeStamp *start)
+{
+  epicsTimeStamp now;
+
+  epicsTimeGetCurrent(&now);
+  *total += epicsTimeDiffInSeconds(&now, start);
+  this->timed_ = true;
+}
+
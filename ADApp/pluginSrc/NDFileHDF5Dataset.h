@@ -2,7 +2,9 @@
 #define NDFILEHDF5DATASET_H_
 
 #include <string>
+#include <vector>
 #include <hdf5.h>
+#include <epicsTime.h>
 #include "NDPluginFile.h"
 #include "NDFileHDF5VersionCheck.h"
 
@@ -12,13 +14,20 @@ class NDFileHDF5Dataset
 {
   public:
     NDFileHDF5Dataset(asynUser *pAsynUser, const std::string& name, hid_t dataset);
+    ~NDFileHDF5Dataset();
 
     asynStatus configureDims(NDArray *pArray, bool multiframe, int extradimensions, int *extra_dims, int *user_chunking);
     asynStatus extendDataSet(int extradims);
     asynStatus extendDataSet(int extradims, hsize_t *offsets);
     asynStatus writeFile(NDArray *pArray, hid_t datatype, hid_t dataspace, hsize_t *framesize);
+    asynStatus configureBatch(int numFrames, size_t frameBytes);
+    asynStatus flushBatch(hid_t datatype, hsize_t *framesize);
+    asynStatus writeChunk(const void *pData, size_t dataSize);
+    asynStatus reserveChunk(std::vector<hsize_t>& offset);
+    asynStatus writeChunk(const void *pData, size_t dataSize, const hsize_t *offset, unsigned int filterMask);
     hid_t getHandle();
     asynStatus flushDataset();
+    bool takeWriteTimes(double *extendTime, double *writeTime);
 
 #ifndef _UNITTEST_HDF5_
   private:
@@ -37,6 +46,16 @@ class NDFileHDF5Dataset
     hsize_t     *virtualdims_; // The desired sizes of the extra (virtual) dimensions: {Y, X, n}
     char        *ptrDimensionNames[ND_ARRAY_MAX_DIMS]; // Array of strings with human readable names for each dimension
     char        *dimsreport_;  // A string which contain a verbose report of all dimension sizes. The method getDimsReport fill in this
+    char        *batchBuffer_; // Frames that have not been written yet, in file order
+    int         batchSize_;    // Number of frames written together, 0 if frames are written one at a time
+    int         batchCount_;   // Number of frames in batchBuffer_
+    size_t      batchFrameBytes_; // Size of one frame in batchBuffer_
+    hsize_t     batchStart_;   // Frame number of the first frame in batchBuffer_
+    double      extendTime_;   // Time spent extending the dataset since the last call to takeWriteTimes
+    double      writeTime_;    // Time spent writing data since the last call to takeWriteTimes
+    bool        timed_;        // True if extendTime_ and writeTime_ include any HDF5 calls
+
+    void addTime(double *total, const epicsTimeStamp *start);
 };
 
 
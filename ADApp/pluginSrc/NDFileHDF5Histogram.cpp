@@ -0,0 +1,80 @@
+/*
+ * NDFileHDF5Histogram.cpp
+ *
+ * Latency histogram of one stage of writing a frame with NDFileHDF5.
+ */
+
+#include "NDFileHDF5Histogram.h"
+#include <math.h>
+#include <string.h>
+
+/* Lower edge of the first bucket in seconds */
+#define HISTOGRAM_MIN_SECONDS 1e-6
+
+NDFileHDF5Histogram::NDFileHDF5Histogram()
+{
+  this->reset();
+}
+
+/** Remove all of the latencies.
+ */
+void NDFileHDF5Histogram::reset()
+{
+  memset(this->counts_, 0, sizeof(this->counts_));
+  this->count_ = 0;
+  this->max_ = 0.0;
+}
+
+/** Add a latency.  Bucket b holds latencies from 2^(b/HDF5_HISTOGRAM_BUCKETS_PER_OCTAVE) to
+ * 2^((b+1)/HDF5_HISTOGRAM_BUCKETS_PER_OCTAVE) microseconds; latencies outside of the buckets
+ * are added to the first or the last bucket.
+ * \param[in] seconds - The latency in seconds.
+ */
+void NDFileHDF5Histogram::add(double seconds)
+{
+  int bucket = 0;
+
+  if (seconds > HISTOGRAM_MIN_SECONDS){
+    bucket = (int)(log(seconds / HISTOGRAM_MIN_SECONDS) / log(2.0) * HDF5_HISTOGRAM_BUCKETS_PER_OCTAVE);
+    if (bucket >= HDF5_HISTOGRAM_BUCKETS) bucket = HDF5_HISTOGRAM_BUCKETS - 1;
+  }
+  this->counts_[bucket]++;
+  this->count_++;
+  if (seconds > this->max_) this->max_ = seconds;
+}
+
+/** Return a percentile of the latencies in seconds, or 0 if no latencies have been added.
+ * This is the upper edge of the bucket that holds the percentile, but no more than the largest latency.
+ * \param[in] fraction - The fraction of the latencies that are less than or equal to the percentile,
+ *            e.g. 0.99 for the 99th percentile.
+ */
+double NDFileHDF5Histogram::percentile(double fraction) const
+{
+  epicsUInt32 rank, sum = 0;
+  double seconds;
+  int bucket;
+
+  if (this->count_ == 0) return 0.0;
+  rank = (epicsUInt32)ceil(fraction * this->count_);
+  if (rank < 1) rank = 1;
+  for (bucket = 0; bucket < HDF5_HISTOGRAM_BUCKETS - 1; bucket++){
+    sum += this->counts_[bucket];
+    if (sum >= rank) break;
+  }
+  seconds = HISTOGRAM_MIN_SECONDS * pow(2.0, (double)(bucket + 1) / HDF5_HISTOGRAM_BUCKETS_PER_OCTAVE);
+  return (seconds < this->max_) ? seconds : this->max_;
+}
+
+/** Return the largest latency in seconds, or 0 if no latencies have been added.
+ */
+double NDFileHDF5Histogram::max() const
+{
+  return this->max_;
+}
+
+/** Return the number of latencies added.
+ */
+epicsUInt32 NDFileHDF5Histogram::count() const
+{
+  return this->count_;
+}
@@ -0,0 +1,38 @@
+/*
+ * NDFileHDF5Histogram.h
+ *
+ * Latency histogram of one stage of writing a frame with NDFileHDF5.
+ */
+
+#ifndef ADAPP_PLUGINSRC_NDFILEHDF5HISTOGRAM_H_
+#define ADAPP_PLUGINSRC_NDFILEHDF5HISTOGRAM_H_
+
+#include <epicsTypes.h>
+
+/** Number of buckets per factor of 2 of latency; the percentiles are accurate to about 9% */
+#define HDF5_HISTOGRAM_BUCKETS_PER_OCTAVE 8
+/** Number of buckets, covering 1 microsecond to over an hour */
+#define HDF5_HISTOGRAM_BUCKETS (32*HDF5_HISTOGRAM_BUCKETS_PER_OCTAVE)
+
+/** Histogram of latencies with logarithmic buckets.
+  * Adding a latency is a few arithmetic operations and does not allocate memory or take locks;
+  * the histogram must only be used by one thread at a time.
+  */
+class NDFileHDF5Histogram
+{
+public:
+  NDFileHDF5Histogram();
+
+  void reset();
+  void add(double seconds);
+  double percentile(double fraction) const;
+  double max() const;
+  epicsUInt32 count() const;
+
+private:
+  epicsUInt32 counts_[HDF5_HISTOGRAM_BUCKETS];
+  epicsUInt32 count_;   // Number of latencies added
+  double max_;          // Largest latency added, in seconds
+};
+
+#endif /* ADAPP_PLUGINSRC_NDFILEHDF5HISTOGRAM_H_ */
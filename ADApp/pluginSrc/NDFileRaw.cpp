@@ -0,0 +1,703 @@
+/* NDFileRaw.cpp
+ * Writes NDArrays to raw binary files, with a sidecar index file.
+ * On Linux the data file can be written with O_DIRECT, bypassing the page cache.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+  #include <io.h>
+  #define RAW_OPEN_BINARY O_BINARY
+#else
+  #include <unistd.h>
+  #define RAW_OPEN_BINARY 0
+#endif
+
+#include <epicsTypes.h>
+#include <epicsString.h>
+#include <iocsh.h>
+
+#include <asynDriver.h>
+
+#include <epicsExport.h>
+#include "NDFileRaw.h"
+
+static const char *driverName = "NDFileRaw";
+
+#define RAW_INDEX_MAGIC   "NDRAWIDX"
+#define RAW_INDEX_VERSION 1
+
+/** Moves the position of a file to an offset from the start, which can be beyond 2 GB.
+  * \return 0 on success, -1 with errno set on failure. */
+static int rawSeek(int fd, epicsUInt64 offset)
+{
+#ifdef _WIN32
+    return (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0) ? -1 : 0;
+#else
+    return (lseek(fd, (off_t)offset, SEEK_SET) < 0) ? -1 : 0;
+#endif
+}
+
+/** Sets the size of a file.
+  * \return 0 on success, -1 with errno set on failure. */
+static int rawTruncate(int fd, epicsUInt64 size)
+{
+#ifdef _WIN32
+    /* _chsize_s returns the error number rather than setting errno */
+    int err = _chsize_s(fd, (__int64)size);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+#else
+    return ftruncate(fd, (off_t)size);
+#endif
+}
+
+/** Header at the start of the index file */
+typedef struct {
+    char magic[8];              /**< RAW_INDEX_MAGIC, not null terminated */
+    epicsUInt32 version;        /**< RAW_INDEX_VERSION */
+    epicsInt32 dataType;        /**< NDDataType_t of the NDArrays */
+    epicsInt32 ndims;           /**< Number of dimensions of the NDArrays */
+    epicsUInt32 alignment;      /**< Alignment of the NDArrays in the data file, 1 if they are not all aligned */
+    struct {
+        epicsUInt64 size;
+        epicsUInt64 offset;
+        epicsInt32 binning;
+        epicsInt32 reverse;
+    } dims[ND_ARRAY_MAX_DIMS];
+} NDFileRawHeader_t;
+
+/** Record in the index file for each NDArray; it is followed by attributesSize bytes of NDAttributes */
+typedef struct {
+    epicsUInt64 offset;         /**< Offset of the data in the data file */
+    epicsUInt64 size;           /**< Size of the data in bytes */
+    epicsFloat64 timeStamp;
+    epicsInt32 uniqueId;
+    epicsUInt32 epicsTSSec;
+    epicsUInt32 epicsTSNsec;
+    epicsUInt32 attributesSize;
+} NDFileRawFrame_t;
+
+/** Header of each NDAttribute in the index file; it is followed by the name, description, source
+  * and value.  The strings and string values include the terminating null. */
+typedef struct {
+    epicsInt32 dataType;
+    epicsInt32 sourceType;
+    epicsUInt32 nameSize;
+    epicsUInt32 descriptionSize;
+    epicsUInt32 sourceSize;
+    epicsUInt32 valueSize;
+} NDFileRawAttribute_t;
+
+/** Opens a raw file.
+  * \param[in] fileName The name of the file to open.
+  * \param[in] openMode Mask defining how the file should be opened; bits are
+  *            NDFileModeRead, NDFileModeWrite, NDFileModeAppend, NDFileModeMultiple
+  * \param[in] pArray A pointer to an NDArray; this is used to determine the array and attribute properties.
+  */
+asynStatus NDFileRaw::openFile(const char *fileName, NDFileOpenMode_t openMode, NDArray *pArray)
+{
+    NDFileRawHeader_t header;
+    NDFileRawFrame_t frame;
+    NDArrayInfo_t arrayInfo;
+    char indexName[MAX_FILENAME_LEN];
+    int useDirectIO;
+    int numCapture;
+    int flags;
+    int i;
+    long position;
+    static const char *functionName = "openFile";
+
+    /* We don't support opening an existing file for appending yet */
+    if (openMode & NDFileModeAppend) return(asynError);
+
+    /* Make sure file is closed */
+    if (this->dataFd >= 0) this->closeFile();
+
+    /* The index file has the final name of the data file, so it does not need to be renamed if a
+     * temporary suffix is used */
+    this->lock();
+    getStringParam(NDFullFileName, sizeof(indexName) - sizeof(RAW_INDEX_SUFFIX), indexName);
+    getIntegerParam(NDFileRawDirectIO, &useDirectIO);
+    getIntegerParam(NDFileNumCapture, &numCapture);
+    this->unlock();
+    strcat(indexName, RAW_INDEX_SUFFIX);
+
+    if (openMode & NDFileModeRead) {
+        this->dataFd = open(fileName, O_RDONLY | RAW_OPEN_BINARY);
+        if (this->dataFd < 0) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s error opening file %s: %s\n",
+                driverName, functionName, fileName, strerror(errno));
+            return(asynError);
+        }
+        if (this->openIndex(indexName, "rb")) goto error;
+        if ((fread(&header, sizeof(header), 1, this->indexFile) != 1) ||
+            (memcmp(header.magic, RAW_INDEX_MAGIC, sizeof(header.magic)) != 0) ||
+            (header.version != RAW_INDEX_VERSION) ||
+            (header.ndims < 1) || (header.ndims > ND_ARRAY_MAX_DIMS)) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s %s is not a valid index file\n",
+                driverName, functionName, indexName);
+            goto error;
+        }
+        this->dataType = (NDDataType_t)header.dataType;
+        this->ndims = header.ndims;
+        for (i=0; i<this->ndims; i++) {
+            this->dims[i].size    = (size_t)header.dims[i].size;
+            this->dims[i].offset  = (size_t)header.dims[i].offset;
+            this->dims[i].binning = header.dims[i].binning;
+            this->dims[i].reverse = header.dims[i].reverse;
+        }
+        /* Find the record of each NDArray */
+        this->framePositions.clear();
+        while (true) {
+            position = ftell(this->indexFile);
+            if (fread(&frame, sizeof(frame), 1, this->indexFile) != 1) break;
+            if (fseek(this->indexFile, frame.attributesSize, SEEK_CUR) != 0) break;
+            this->framePositions.push_back(position);
+        }
+        this->lock();
+        setIntegerParam(NDFileRawNumFrames, (int)this->framePositions.size());
+        this->unlock();
+        return(asynSuccess);
+    }
+
+    flags = O_WRONLY | O_CREAT | O_TRUNC | RAW_OPEN_BINARY;
+    this->directIO = false;
+#ifdef O_DIRECT
+    if (useDirectIO) {
+        this->dataFd = open(fileName, flags | O_DIRECT, 0666);
+        if (this->dataFd >= 0) {
+            this->directIO = true;
+        } else if (errno == EINVAL) {
+            /* The file system does not support O_DIRECT */
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+                "%s::%s %s cannot be opened with O_DIRECT, using buffered writes\n",
+                driverName, functionName, fileName);
+        }
+    }
+#endif
+    if (this->dataFd < 0) this->dataFd = open(fileName, flags, 0666);
+    if (this->dataFd < 0) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error opening file %s: %s\n",
+            driverName, functionName, fileName, strerror(errno));
+        return(asynError);
+    }
+    this->writing = true;
+    this->dataOffset = 0;
+    this->dataEnd = 0;
+
+    pArray->getInfo(&arrayInfo);
+#ifdef FALLOC_FL_KEEP_SIZE
+    /* Allocate the disk space for the whole capture now, so that it is not allocated while streaming.
+     * Space that is not used is freed when the file is closed. */
+    if ((openMode & NDFileModeMultiple) && (numCapture > 0)) {
+        epicsUInt64 frameBytes = arrayInfo.totalBytes;
+        frameBytes = (frameBytes + RAW_ALIGNMENT - 1) / RAW_ALIGNMENT * RAW_ALIGNMENT;
+        if (fallocate(this->dataFd, FALLOC_FL_KEEP_SIZE, 0, (off_t)(frameBytes * numCapture)) != 0) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+                "%s::%s cannot preallocate %s: %s\n",
+                driverName, functionName, fileName, strerror(errno));
+        }
+    }
+#endif
+
+    if (this->openIndex(indexName, "wb")) goto error;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAW_INDEX_MAGIC, sizeof(header.magic));
+    header.version   = RAW_INDEX_VERSION;
+    header.dataType  = pArray->dataType;
+    header.ndims     = pArray->ndims;
+    header.alignment = this->directIO ? RAW_ALIGNMENT : 1;
+    for (i=0; i<pArray->ndims; i++) {
+        header.dims[i].size    = pArray->dims[i].size;
+        header.dims[i].offset  = pArray->dims[i].offset;
+        header.dims[i].binning = pArray->dims[i].binning;
+        header.dims[i].reverse = pArray->dims[i].reverse;
+    }
+    if (fwrite(&header, sizeof(header), 1, this->indexFile) != 1) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error writing index file %s: %s\n",
+            driverName, functionName, indexName, strerror(errno));
+        goto error;
+    }
+    return(asynSuccess);
+
+error:
+    this->closeFile();
+    return(asynError);
+}
+
+/** Opens the index file.
+  * \param[in] fileName The name of the index file.
+  * \param[in] mode The fopen mode. */
+asynStatus NDFileRaw::openIndex(const char *fileName, const char *mode)
+{
+    static const char *functionName = "openIndex";
+
+    this->indexFile = fopen(fileName, mode);
+    if (this->indexFile == NULL) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error opening index file %s: %s\n",
+            driverName, functionName, fileName, strerror(errno));
+        return(asynError);
+    }
+    return(asynSuccess);
+}
+
+/** Changes the alignment in the header of the index file that is being written.
+  * \param[in] alignment The new alignment of the NDArrays in the data file. */
+asynStatus NDFileRaw::setIndexAlignment(epicsUInt32 alignment)
+{
+    long position = ftell(this->indexFile);
+    static const char *functionName = "setIndexAlignment";
+
+    if ((position < 0) ||
+        (fseek(this->indexFile, (long)offsetof(NDFileRawHeader_t, alignment), SEEK_SET) != 0) ||
+        (fwrite(&alignment, sizeof(alignment), 1, this->indexFile) != 1) ||
+        (fseek(this->indexFile, position, SEEK_SET) != 0)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error writing index header: %s\n",
+            driverName, functionName, strerror(errno));
+        return(asynError);
+    }
+    return(asynSuccess);
+}
+
+/** Writes data to the data file at the current position, handling partial writes.
+  * \param[in] pData The data to write.
+  * \param[in] size The number of bytes to write.
+  * \param[out] pWritten The number of bytes written. */
+asynStatus NDFileRaw::writeData(const void *pData, size_t size, size_t *pWritten)
+{
+    const char *p = (const char *)pData;
+    size_t remaining = size;
+    int nWrite;
+
+    while (remaining > 0) {
+        /* Limit the size of each call for write() implementations that take an int */
+        nWrite = (int)(remaining < 0x40000000 ? remaining : 0x40000000);
+        nWrite = write(this->dataFd, p, nWrite);
+        if (nWrite < 0) {
+            if (errno == EINTR) continue;
+            return(asynError);
+        }
+        p += nWrite;
+        remaining -= nWrite;
+    }
+    *pWritten = size;
+    return(asynSuccess);
+}
+
+/** Writes data to a data file opened with O_DIRECT.
+  * If pData is aligned the whole blocks are written directly from pData.  The rest of the data
+  * is copied to an aligned buffer and written padded with zeros to a multiple of RAW_ALIGNMENT bytes.
+  * \param[in] pData The data to write.
+  * \param[in] size The number of bytes to write.
+  * \param[out] pWritten The number of bytes written, including the padding. */
+asynStatus NDFileRaw::writeAligned(const void *pData, size_t size, size_t *pWritten)
+{
+    size_t directBytes = 0;
+    size_t tailBytes, paddedBytes;
+    size_t written;
+    asynStatus status;
+
+    *pWritten = 0;
+    if (((size_t)pData % RAW_ALIGNMENT) == 0) {
+        directBytes = size - size % RAW_ALIGNMENT;
+        if (directBytes > 0) {
+            status = this->writeData(pData, directBytes, &written);
+            if (status) return status;
+            *pWritten = written;
+        }
+    }
+    tailBytes = size - directBytes;
+    if (tailBytes == 0) return(asynSuccess);
+    paddedBytes = (tailBytes + RAW_ALIGNMENT - 1) / RAW_ALIGNMENT * RAW_ALIGNMENT;
+    if (paddedBytes > this->alignedBufferSize) {
+        free(this->pAlignedBuffer);
+        this->pAlignedBuffer = NULL;
+        this->alignedBufferSize = 0;
+#ifdef _WIN32
+        return(asynError);
+#else
+        if (posix_memalign((void **)&this->pAlignedBuffer, RAW_ALIGNMENT, paddedBytes) != 0) {
+            this->pAlignedBuffer = NULL;
+            errno = ENOMEM;
+            return(asynError);
+        }
+#endif
+        this->alignedBufferSize = paddedBytes;
+    }
+    memcpy(this->pAlignedBuffer, (const char *)pData + directBytes, tailBytes);
+    memset(this->pAlignedBuffer + tailBytes, 0, paddedBytes - tailBytes);
+    status = this->writeData(this->pAlignedBuffer, paddedBytes, &written);
+    if (status) return status;
+    *pWritten += written;
+    return(asynSuccess);
+}
+
+/** Writes single NDArray to the raw file and its record to the index file.
+  * \param[in] pArray Pointer to the NDArray to be written
+  */
+asynStatus NDFileRaw::writeFile(NDArray *pArray)
+{
+    NDFileRawFrame_t frame;
+    NDArrayInfo_t arrayInfo;
+    size_t written = 0;
+    asynStatus status = asynSuccess;
+    static const char *functionName = "writeFile";
+
+    if ((this->dataFd < 0) || (this->indexFile == NULL)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s file is not open!\n",
+            driverName, functionName);
+        return(asynError);
+    }
+    pArray->getInfo(&arrayInfo);
+
+#ifdef O_DIRECT
+    if (this->directIO) {
+        status = this->writeAligned(pArray->pData, arrayInfo.totalBytes, &written);
+        if (status && (errno == EINVAL)) {
+            /* Some file systems accept O_DIRECT when opening the file but not when writing.
+             * Continue with buffered writes from the start of this NDArray. */
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+                "%s::%s O_DIRECT write failed, using buffered writes\n",
+                driverName, functionName);
+            fcntl(this->dataFd, F_SETFL, fcntl(this->dataFd, F_GETFL) & ~O_DIRECT);
+            this->directIO = false;
+            if (rawSeek(this->dataFd, this->dataOffset) != 0) return(asynError);
+            /* This and the following NDArrays are not aligned, so the header must no longer claim they are */
+            if (this->setIndexAlignment(1)) return(asynError);
+        }
+    }
+#endif
+    if (!this->directIO) {
+        status = this->writeData(pArray->pData, arrayInfo.totalBytes, &written);
+    }
+    if (status) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error writing data: %s\n",
+            driverName, functionName, strerror(errno));
+        return(asynError);
+    }
+
+    this->serializeAttributes(pArray->pAttributeList);
+    frame.offset         = this->dataOffset;
+    frame.size           = arrayInfo.totalBytes;
+    frame.timeStamp      = pArray->timeStamp;
+    frame.uniqueId       = pArray->uniqueId;
+    frame.epicsTSSec     = pArray->epicsTS.secPastEpoch;
+    frame.epicsTSNsec    = pArray->epicsTS.nsec;
+    frame.attributesSize = (epicsUInt32)this->attributeBuffer.size();
+    this->dataEnd = this->dataOffset + arrayInfo.totalBytes;
+    this->dataOffset += written;
+    if ((fwrite(&frame, sizeof(frame), 1, this->indexFile) != 1) ||
+        ((frame.attributesSize > 0) &&
+         (fwrite(&this->attributeBuffer[0], frame.attributesSize, 1, this->indexFile) != 1))) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error writing index: %s\n",
+            driverName, functionName, strerror(errno));
+        return(asynError);
+    }
+    return(asynSuccess);
+}
+
+/** Serializes the NDAttributes of an NDArray into attributeBuffer.
+  * \param[in] pAttributeList The NDAttributes to serialize. */
+void NDFileRaw::serializeAttributes(NDAttributeList *pAttributeList)
+{
+    NDAttribute *pAttribute;
+    NDFileRawAttribute_t header;
+    NDAttrDataType_t dataType;
+    NDAttrSource_t sourceType;
+    size_t valueSize;
+    const char *pName, *pDescription, *pSource;
+    size_t pos;
+    char *p;
+
+    this->attributeBuffer.clear();
+    pAttribute = pAttributeList->next(NULL);
+    while (pAttribute) {
+        pName = pAttribute->getName();
+        pDescription = pAttribute->getDescription();
+        pSource = pAttribute->getSourceInfo(&sourceType);
+        pAttribute->getValueInfo(&dataType, &valueSize);
+        header.dataType        = dataType;
+        header.sourceType      = sourceType;
+        header.nameSize        = (epicsUInt32)strlen(pName) + 1;
+        header.descriptionSize = (epicsUInt32)strlen(pDescription) + 1;
+        header.sourceSize      = (epicsUInt32)strlen(pSource) + 1;
+        header.valueSize       = (epicsUInt32)valueSize;
+        pos = this->attributeBuffer.size();
+        this->attributeBuffer.resize(pos + sizeof(header) + header.nameSize + header.descriptionSize +
+                                     header.sourceSize + header.valueSize);
+        p = &this->attributeBuffer[pos];
+        memcpy(p, &header, sizeof(header));                     p += sizeof(header);
+        memcpy(p, pName, header.nameSize);                      p += header.nameSize;
+        memcpy(p, pDescription, header.descriptionSize);        p += header.descriptionSize;
+        memcpy(p, pSource, header.sourceSize);                  p += header.sourceSize;
+        if (valueSize > 0) pAttribute->getValue(dataType, p, valueSize);
+        pAttribute = pAttributeList->next(pAttribute);
+    }
+}
+
+/** Creates NDAttributes from the serialized attributes of an NDArray.
+  * \param[in] pData The serialized attributes.
+  * \param[in] size The size of pData in bytes.
+  * \param[out] pAttributeList The list to add the NDAttributes to. */
+asynStatus NDFileRaw::deserializeAttributes(const char *pData, size_t size, NDAttributeList *pAttributeList)
+{
+    NDFileRawAttribute_t header;
+    const char *pName, *pDescription, *pSource;
+    const char *pEnd = pData + size;
+    epicsFloat64 numericValue;
+    void *pValue;
+
+    while (pData < pEnd) {
+        if ((size_t)(pEnd - pData) < sizeof(header)) return(asynError);
+        memcpy(&header, pData, sizeof(header));
+        pData += sizeof(header);
+        if ((size_t)(pEnd - pData) < (size_t)header.nameSize + header.descriptionSize +
+                                     header.sourceSize + header.valueSize) return(asynError);
+        pName = pData;                  pData += header.nameSize;
+        pDescription = pData;           pData += header.descriptionSize;
+        pSource = pData;                pData += header.sourceSize;
+        pValue = NULL;
+        if (header.dataType == NDAttrString) {
+            pValue = (void *)pData;
+        } else if ((header.valueSize > 0) && (header.valueSize <= sizeof(numericValue))) {
+            /* The value in the buffer may not be aligned */
+            memcpy(&numericValue, pData, header.valueSize);
+            pValue = &numericValue;
+        }
+        pData += header.valueSize;
+        pAttributeList->add(new NDAttribute(pName, pDescription, (NDAttrSource_t)header.sourceType,
+                                            pSource, (NDAttrDataType_t)header.dataType, pValue));
+    }
+    return(asynSuccess);
+}
+
+/** Reads the NDArray selected by NDFileRawReadFrame from a raw file.
+  * \param[out] pArray Pointer to the address of the NDArray that is read.
+  */
+asynStatus NDFileRaw::readFile(NDArray **pArray)
+{
+    NDFileRawFrame_t frame;
+    NDArrayInfo_t arrayInfo;
+    NDArray *pOut;
+    size_t dimSizes[ND_ARRAY_MAX_DIMS];
+    char *p;
+    size_t remaining;
+    int nRead;
+    int readFrame;
+    int i;
+    static const char *functionName = "readFile";
+
+    this->lock();
+    getIntegerParam(NDFileRawReadFrame, &readFrame);
+    this->unlock();
+    if ((readFrame < 0) || (readFrame >= (int)this->framePositions.size())) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s frame %d is not in the file, which has %d frames\n",
+            driverName, functionName, readFrame, (int)this->framePositions.size());
+        return(asynError);
+    }
+    if ((fseek(this->indexFile, this->framePositions[readFrame], SEEK_SET) != 0) ||
+        (fread(&frame, sizeof(frame), 1, this->indexFile) != 1)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error reading index\n",
+            driverName, functionName);
+        return(asynError);
+    }
+    this->attributeBuffer.resize(frame.attributesSize);
+    if ((frame.attributesSize > 0) &&
+        (fread(&this->attributeBuffer[0], frame.attributesSize, 1, this->indexFile) != 1)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error reading attributes\n",
+            driverName, functionName);
+        return(asynError);
+    }
+
+    for (i=0; i<this->ndims; i++) dimSizes[i] = this->dims[i].size;
+    pOut = this->pNDArrayPool->alloc(this->ndims, dimSizes, this->dataType, 0, NULL);
+    if (!pOut) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error allocating NDArray\n",
+            driverName, functionName);
+        return(asynError);
+    }
+    pOut->getInfo(&arrayInfo);
+    if (frame.size > arrayInfo.totalBytes) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s frame %d has %llu bytes, but the NDArray has %lu\n",
+            driverName, functionName, readFrame, (unsigned long long)frame.size,
+            (unsigned long)arrayInfo.totalBytes);
+        pOut->release();
+        return(asynError);
+    }
+    if (rawSeek(this->dataFd, frame.offset) != 0) goto readError;
+    p = (char *)pOut->pData;
+    remaining = (size_t)frame.size;
+    while (remaining > 0) {
+        nRead = (int)(remaining < 0x40000000 ? remaining : 0x40000000);
+        nRead = read(this->dataFd, p, nRead);
+        if ((nRead < 0) && (errno == EINTR)) continue;
+        if (nRead <= 0) goto readError;
+        p += nRead;
+        remaining -= nRead;
+    }
+
+    for (i=0; i<this->ndims; i++) pOut->dims[i] = this->dims[i];
+    pOut->uniqueId = frame.uniqueId;
+    pOut->timeStamp = frame.timeStamp;
+    pOut->epicsTS.secPastEpoch = frame.epicsTSSec;
+    pOut->epicsTS.nsec = frame.epicsTSNsec;
+    pOut->pAttributeList->clear();
+    if ((frame.attributesSize > 0) &&
+        this->deserializeAttributes(&this->attributeBuffer[0], frame.attributesSize, pOut->pAttributeList)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s invalid attributes for frame %d\n",
+            driverName, functionName, readFrame);
+    }
+    *pArray = pOut;
+    return(asynSuccess);
+
+readError:
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+        "%s::%s error reading data for frame %d\n",
+        driverName, functionName, readFrame);
+    pOut->release();
+    return(asynError);
+}
+
+/** Closes the raw file and the index file. */
+asynStatus NDFileRaw::closeFile()
+{
+    asynStatus status = asynSuccess;
+    static const char *functionName = "closeFile";
+
+    if (this->indexFile) {
+        if (fclose(this->indexFile) != 0) status = asynError;
+        this->indexFile = NULL;
+    }
+    if (this->dataFd >= 0) {
+        /* Remove the padding after the last NDArray and the space that was preallocated but not used */
+        if (this->writing && (rawTruncate(this->dataFd, this->dataEnd) != 0)) status = asynError;
+        if (close(this->dataFd) != 0) status = asynError;
+        this->dataFd = -1;
+    }
+    this->writing = false;
+    if (status) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error closing file: %s\n",
+            driverName, functionName, strerror(errno));
+    }
+    this->dataOffset = 0;
+    this->dataEnd = 0;
+    this->framePositions.clear();
+    return status;
+}
+
+
+/** Constructor for NDFileRaw; all parameters are simply passed to NDPluginFile::NDPluginFile.
+  * \param[in] portName The name of the asyn port driver to be created.
+  * \param[in] queueSize The number of NDArrays that the input queue for this plugin can hold when
+  *            NDPluginDriverBlockingCallbacks=0.  Larger queues can decrease the number of dropped arrays,
+  *            at the expense of more NDArray buffers being allocated from the underlying driver's NDArrayPool.
+  * \param[in] blockingCallbacks Initial setting for the NDPluginDriverBlockingCallbacks flag.
+  *            0=callbacks are queued and executed by the callback thread; 1 callbacks execute in the thread
+  *            of the driver doing the callbacks.
+  * \param[in] NDArrayPort Name of asyn port driver for initial source of NDArray callbacks.
+  * \param[in] NDArrayAddr asyn port driver address for initial source of NDArray callbacks.
+  * \param[in] priority The thread priority for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
+  * \param[in] stackSize The stack size for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
+  */
+NDFileRaw::NDFileRaw(const char *portName, int queueSize, int blockingCallbacks,
+                     const char *NDArrayPort, int NDArrayAddr,
+                     int priority, int stackSize)
+    /* Invoke the base class constructor.
+     * We allocate 2 NDArrays of unlimited size in the NDArray pool.
+     * This driver can block (because writing a file can be slow), and it is not multi-device.
+     * Set autoconnect to 1.  priority and stacksize can be 0, which will use defaults. */
+    : NDPluginFile(portName, queueSize, blockingCallbacks,
+                   NDArrayPort, NDArrayAddr, 1,
+                   2, 0, asynGenericPointerMask, asynGenericPointerMask,
+                   ASYN_CANBLOCK, 1, priority, stackSize, 1),
+    dataFd(-1), indexFile(NULL), writing(false), directIO(false), dataOffset(0), dataEnd(0),
+    pAlignedBuffer(NULL), alignedBufferSize(0), ndims(0), dataType(NDUInt8)
+{
+    //static const char *functionName = "NDFileRaw";
+
+    createParam(NDFileRawDirectIOString,  asynParamInt32, &NDFileRawDirectIO);
+    createParam(NDFileRawReadFrameString, asynParamInt32, &NDFileRawReadFrame);
+    createParam(NDFileRawNumFramesString, asynParamInt32, &NDFileRawNumFrames);
+
+    /* Set the plugin type string */
+    setStringParam(NDPluginDriverPluginType, "NDFileRaw");
+    this->supportsMultipleArrays = 1;
+    setIntegerParam(NDFileRawDirectIO, 1);
+    setIntegerParam(NDFileRawReadFrame, 0);
+    setIntegerParam(NDFileRawNumFrames, 0);
+}
+
+NDFileRaw::~NDFileRaw()
+{
+    this->closeFile();
+    free(this->pAlignedBuffer);
+}
+
+/* Configuration routine.  Called directly, or from the iocsh  */
+
+extern "C" int NDFileRawConfigure(const char *portName, int queueSize, int blockingCallbacks,
+                                  const char *NDArrayPort, int NDArrayAddr,
+                                  int priority, int stackSize)
+{
+    NDFileRaw *pPlugin = new NDFileRaw(portName, queueSize, blockingCallbacks, NDArrayPort, NDArrayAddr,
+                                       priority, stackSize);
+    return pPlugin->start();
+}
+
+
+/* EPICS iocsh shell commands */
+
+static const iocshArg initArg0 = { "portName",iocshArgString};
+static const iocshArg initArg1 = { "frame queue size",iocshArgInt};
+static const iocshArg initArg2 = { "blocking callbacks",iocshArgInt};
+static const iocshArg initArg3 = { "NDArray Port",iocshArgString};
+static const iocshArg initArg4 = { "NDArray Addr",iocshArgInt};
+static const iocshArg initArg5 = { "priority",iocshArgInt};
+static const iocshArg initArg6 = { "stack size",iocshArgInt};
+static const iocshArg * const initArgs[] = {&initArg0,
+                                            &initArg1,
+                                            &initArg2,
+                                            &initArg3,
+                                            &initArg4,
+                                            &initArg5,
+                                            &initArg6};
+static const iocshFuncDef initFuncDef = {"NDFileRawConfigure",7,initArgs};
+static void initCallFunc(const iocshArgBuf *args)
+{
+    NDFileRawConfigure(args[0].sval, args[1].ival, args[2].ival, args[3].sval, args[4].ival, args[5].ival, args[6].ival);
+}
+
+extern "C" void NDFileRawRegister(void)
+{
+    iocshRegister(&initFuncDef,initCallFunc);
+}
+
+extern "C" {
+epicsExportRegistrar(NDFileRawRegister);
+}
@@ -0,0 +1,76 @@
+/*
+ * NDFileRaw.h
+ * Writes NDArrays to raw binary files, with a sidecar index file.
+ */
+
+#ifndef DRV_NDFileRaw_H
+#define DRV_NDFileRaw_H
+
+#include <stdio.h>
+#include <vector>
+
+#include <epicsTypes.h>
+
+#include "NDPluginFile.h"
+
+/** Alignment of the data and size of each write when the data file is written with O_DIRECT */
+#define RAW_ALIGNMENT 4096
+
+/** Suffix appended to the name of the data file to create the name of the index file */
+#define RAW_INDEX_SUFFIX ".idx"
+
+#define NDFileRawDirectIOString  "RAW_DIRECT_IO"   /* (asynInt32, r/w) Write the data file with O_DIRECT */
+#define NDFileRawReadFrameString "RAW_READ_FRAME"  /* (asynInt32, r/w) Frame number that ReadFile reads */
+#define NDFileRawNumFramesString "RAW_NUM_FRAMES"  /* (asynInt32, r/o) Number of frames in the file last opened */
+
+/** Writes NDArrays as raw binary data, for the highest sustained rates to local disks.
+  * The data file contains only the NDArray data.  The index file, which has the name of the
+  * data file with RAW_INDEX_SUFFIX appended, contains the dimensions and data type, and for each
+  * NDArray the uniqueId, time stamps, offset and size in the data file and the NDAttributes.
+  * The index is written in the byte order of the host.
+  * On Linux the data file can be written with O_DIRECT, bypassing the page cache; each NDArray
+  * then starts at a multiple of RAW_ALIGNMENT bytes in the file.
+  */
+class epicsShareClass NDFileRaw : public NDPluginFile {
+public:
+    NDFileRaw(const char *portName, int queueSize, int blockingCallbacks,
+              const char *NDArrayPort, int NDArrayAddr,
+              int priority, int stackSize);
+    virtual ~NDFileRaw();
+
+    /* The methods that this class implements */
+    virtual asynStatus openFile(const char *fileName, NDFileOpenMode_t openMode, NDArray *pArray);
+    virtual asynStatus readFile(NDArray **pArray);
+    virtual asynStatus writeFile(NDArray *pArray);
+    virtual asynStatus closeFile();
+
+protected:
+    int NDFileRawDirectIO;
+    #define FIRST_NDFILE_RAW_PARAM NDFileRawDirectIO
+    int NDFileRawReadFrame;
+    int NDFileRawNumFrames;
+
+private:
+    asynStatus openIndex(const char *fileName, const char *mode);
+    asynStatus setIndexAlignment(epicsUInt32 alignment);
+    asynStatus writeData(const void *pData, size_t size, size_t *pWritten);
+    asynStatus writeAligned(const void *pData, size_t size, size_t *pWritten);
+    void serializeAttributes(NDAttributeList *pAttributeList);
+    asynStatus deserializeAttributes(const char *pData, size_t size, NDAttributeList *pAttributeList);
+
+    int dataFd;                     /**< Data file descriptor, -1 if no file is open */
+    FILE *indexFile;                /**< Index file */
+    bool writing;                   /**< True if dataFd was opened for writing */
+    bool directIO;                  /**< True if dataFd was opened with O_DIRECT */
+    epicsUInt64 dataOffset;         /**< Offset in the data file of the next NDArray */
+    epicsUInt64 dataEnd;            /**< Offset of the end of the data of the last NDArray */
+    char *pAlignedBuffer;           /**< Buffer for data that is not aligned when writing with O_DIRECT */
+    size_t alignedBufferSize;
+    std::vector<char> attributeBuffer;  /**< Serialized NDAttributes of one NDArray */
+    std::vector<long> framePositions;   /**< Positions of the frame records in the index file when reading */
+    int ndims;                      /**< Dimensions and data type of the file opened for reading */
+    NDDimension_t dims[ND_ARRAY_MAX_DIMS];
+    NDDataType_t dataType;
+};
+
+#endif
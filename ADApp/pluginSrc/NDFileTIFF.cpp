@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
@@ -32,12 +33,21 @@
 
 #include <asynDriver.h>
 
+#ifdef HAVE_ZLIB
+  #include <zlib.h>
+#endif
+
 #include <epicsExport.h>
 #include "NDPluginFile.h"
 #include "tiffio.h"
 #include "NDFileTIFF.h"
 
 #define STRING_BUFFER_SIZE 2048
+
+/* Older versions of libtiff do not define this; TIFFIsCODECConfigured() then reports that it is not available */
+#ifndef COMPRESSION_ZSTD
+  #define COMPRESSION_ZSTD 50000
+#endif
  
 static const char *driverName = "NDFileTIFF";
 
@@ -49,7 +59,7 @@ static const int TIFFTAG_EPICSTSNSEC     = 65003;
 static const int TIFFTAG_FIRST_ATTRIBUTE = 65010;
 static const int TIFFTAG_LAST_ATTRIBUTE  = 65500;
 
-#define NUM_CUSTOM_TIFF_TAGS (4 + TIFFTAG_LAST_ATTRIBUTE - TIFFTAG_FIRST_ATTRIBUTE - 1)
+#define NUM_CUSTOM_TIFF_TAGS (4 + TIFFTAG_LAST_ATTRIBUTE - TIFFTAG_FIRST_ATTRIBUTE)
 
 static TIFFFieldInfo tiffFieldInfo[NUM_CUSTOM_TIFF_TAGS] = {
     {TIFFTAG_NDTIMESTAMP, 1, 1, TIFF_DOUBLE,FIELD_CUSTOM, 1, 0, (char *)"NDTimeStamp"},
@@ -64,6 +74,31 @@ static void registerCustomTIFFTags(TIFF *tif)
     TIFFMergeFieldInfo(tif, tiffFieldInfo, sizeof(tiffFieldInfo)/sizeof(tiffFieldInfo[0]));
 }
 
+/** Returns the offset in an NDArray of one row of one plane.
+  * \param[in] colorMode Color mode of the NDArray
+  * \param[in] rowSize Size of a row in bytes; for RGB2 and RGB3 this is the size of the row of one color
+  * \param[in] sizeY Number of rows
+  * \param[in] plane Color plane for RGB2 and RGB3, ignored otherwise
+  * \param[in] y Row number
+  */
+static size_t rowOffset(NDColorMode_t colorMode, size_t rowSize, size_t sizeY, int plane, size_t y)
+{
+    switch (colorMode) {
+        case NDColorModeRGB2:
+            return (3*y + plane) * rowSize;
+        case NDColorModeRGB3:
+            return (plane*sizeY + y) * rowSize;
+        default:
+            return y * rowSize;
+    }
+}
+
+static void encodeTileTask(void *pArg)
+{
+    NDFileTIFFTile *pTile = (NDFileTIFFTile *)pArg;
+    pTile->pPlugin->encodeTile(pTile);
+}
+
 static void augmentLibTiffWithCustomTags() {
     static bool first_time = true;
     if (!first_time) return;
@@ -83,12 +118,14 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
     /* When we create TIFF variables and dimensions, we get back an
      * ID for each one. */
     static const char *functionName = "openFile";
-    size_t sizeX, sizeY, rowsPerStrip;
-    int bitsPerSample=8, sampleFormat=SAMPLEFORMAT_INT, samplesPerPixel, photoMetric, planarConfig;
     int colorMode=NDColorModeMono;
+    int numCapture;
+    int tileSizeX=0, tileSizeY=0, compressionChoice=0, numThreads=0;
+    size_t tilesAcross, tilesDown, tile;
+    int numPlanes, plane;
+    const char *writeMode = "w";
+    NDArrayInfo_t arrayInfo;
     NDAttribute *pAttribute = NULL;
-    char tagString[STRING_BUFFER_SIZE] = {0};
-    char attrString[STRING_BUFFER_SIZE] = {0};
     char tagName[STRING_BUFFER_SIZE] = {0};
     int i;
     TIFFFieldInfo fieldInfo = {0, 1, 1, TIFF_ASCII, FIELD_CUSTOM, 1, 0, tagName};
@@ -124,7 +161,68 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
 
     /* Open file for writing */
     else if (openMode & NDFileModeWrite) {
-        if ((this->tiff = TIFFOpen(fileName, "w")) == NULL ) {
+        /* Multi-page files that might not fit in 4 GB are written as BigTIFF.
+         * NumCapture=0 in Stream mode means there is no limit on the number of pages.
+         * Stream mode also opens each file with NDFileModeMultiple when TIFFMultiPage is No. */
+        this->multiPage = this->supportsMultipleArrays && ((openMode & NDFileModeMultiple) != 0);
+        this->numPages = 0;
+        this->lock();
+        getIntegerParam(NDFileNumCapture, &numCapture);
+        getIntegerParam(NDFileTIFFTileSizeX, &tileSizeX);
+        getIntegerParam(NDFileTIFFTileSizeY, &tileSizeY);
+        getIntegerParam(NDFileTIFFCompression, &compressionChoice);
+        getIntegerParam(NDFileTIFFCompressLevel, &this->compressLevel);
+        getIntegerParam(NDFileTIFFNumThreads, &numThreads);
+        this->unlock();
+
+        /* The TIFF specification requires the tile size to be a multiple of 16 */
+        if ((tileSizeX != 0) || (tileSizeY != 0)) {
+            if ((tileSizeX <= 0) || (tileSizeY <= 0) || (tileSizeX % 16) || (tileSizeY % 16)) {
+                asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                    "%s:%s: tile size %d x %d must be 0 or a multiple of 16\n",
+                    driverName, functionName, tileSizeX, tileSizeY);
+                return(asynError);
+            }
+        }
+        this->tileWidth = tileSizeX;
+        this->tileLength = tileSizeY;
+
+        switch (compressionChoice) {
+            case NDFileTIFFCompressDeflate:
+                this->compression = COMPRESSION_ADOBE_DEFLATE;
+                this->compressLevel = std::max(1, std::min(9, this->compressLevel));
+                break;
+            case NDFileTIFFCompressLZW:
+                this->compression = COMPRESSION_LZW;
+                break;
+            case NDFileTIFFCompressZSTD:
+                this->compression = COMPRESSION_ZSTD;
+                this->compressLevel = std::max(1, std::min(22, this->compressLevel));
+                break;
+            default:
+                this->compression = COMPRESSION_NONE;
+                break;
+        }
+        if (!TIFFIsCODECConfigured((epicsUInt16)this->compression)) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: compression %d is not supported by this version of libtiff\n",
+                driverName, functionName, compressionChoice);
+            return(asynError);
+        }
+        /* Uncompressed tiles, and deflate tiles if we have zlib, are completely encoded by the worker threads and
+         * written with TIFFWriteRawTile.  Other tiles are compressed by libtiff in this thread. */
+        this->rawTiles = (this->compression == COMPRESSION_NONE);
+#ifdef HAVE_ZLIB
+        if (this->compression == COMPRESSION_ADOBE_DEFLATE) this->rawTiles = true;
+#endif
+
+        if (this->multiPage) {
+            pArray->getInfo(&arrayInfo);
+            if ((numCapture <= 0) ||
+                ((unsigned long long)numCapture * arrayInfo.totalBytes > TIFF_BIGTIFF_THRESHOLD))
+                writeMode = "w8";
+        }
+        if ((this->tiff = TIFFOpen(fileName, writeMode)) == NULL ) {
             asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
             "%s:%s error opening file %s\n",
             driverName, functionName, fileName);
@@ -142,6 +240,9 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
     pAttribute = pArray->pAttributeList->find("ColorMode");
     if (pAttribute) pAttribute->getValue(NDAttrInt32, &colorMode);
 
+    bitsPerSample = 8;
+    sampleFormat = SAMPLEFORMAT_INT;
+
     switch (pArray->dataType) {
         case NDInt8:
             sampleFormat = SAMPLEFORMAT_INT;
@@ -223,6 +324,56 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
         return(asynError);
     }
 
+    /* Each page is divided into the same tiles.  Tiles at the right and bottom edges are padded. */
+    this->tiles.clear();
+    this->useEncodePool = false;
+    if (this->tileWidth > 0) {
+        tilesAcross = (sizeX + this->tileWidth - 1) / this->tileWidth;
+        tilesDown = (sizeY + this->tileLength - 1) / this->tileLength;
+        numPlanes = (planarConfig == PLANARCONFIG_SEPARATE) ? samplesPerPixel : 1;
+        this->tiles.resize(numPlanes * tilesAcross * tilesDown);
+        tile = 0;
+        for (plane=0; plane<numPlanes; plane++) {
+            for (size_t ty=0; ty<tilesDown; ty++) {
+                for (size_t tx=0; tx<tilesAcross; tx++, tile++) {
+                    this->tiles[tile].pPlugin = this;
+                    this->tiles[tile].pArray = NULL;
+                    this->tiles[tile].plane = plane;
+                    this->tiles[tile].x = tx * this->tileWidth;
+                    this->tiles[tile].y = ty * this->tileLength;
+                }
+            }
+        }
+        this->useEncodePool = (numThreads > 0) && (this->tiles.size() > 1);
+        if (this->useEncodePool) {
+            /* The threads are created when they are first needed and kept for the next files */
+            if (this->pEncodePool && (this->pEncodePool->getNumThreads() != numThreads)) {
+                delete this->pEncodePool;
+                this->pEncodePool = NULL;
+            }
+            if (this->pEncodePool == NULL) {
+                this->pEncodePool = new NDWorkerPool("NDFileTIFFEncode", numThreads);
+            }
+        }
+    }
+
+    return this->setTags(pArray);
+}
+
+/** Sets the tags of the current TIFF directory from the file format and from the NDArray.
+  * libtiff clears the tags after writing each directory, so this is called for each page of a multi-page file.
+  * \param[in] pArray Pointer to the NDArray that is written to the directory
+  */
+asynStatus NDFileTIFF::setTags(NDArray *pArray)
+{
+    static const char *functionName = "setTags";
+    NDAttribute *pAttribute = NULL;
+    char tagString[STRING_BUFFER_SIZE] = {0};
+    char attrString[STRING_BUFFER_SIZE] = {0};
+
+    if (this->multiPage) {
+        TIFFSetField(this->tiff, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+    }
     TIFFSetField(this->tiff, TIFFTAG_NDTIMESTAMP, pArray->timeStamp);
     TIFFSetField(this->tiff, TIFFTAG_UNIQUEID, pArray->uniqueId);
     TIFFSetField(this->tiff, TIFFTAG_EPICSTSSEC, pArray->epicsTS.secPastEpoch);
@@ -234,7 +385,21 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
     TIFFSetField(this->tiff, TIFFTAG_PLANARCONFIG, planarConfig);
     TIFFSetField(this->tiff, TIFFTAG_IMAGEWIDTH, (epicsUInt32)sizeX);
     TIFFSetField(this->tiff, TIFFTAG_IMAGELENGTH, (epicsUInt32)sizeY);
-    TIFFSetField(this->tiff, TIFFTAG_ROWSPERSTRIP, (epicsUInt32)rowsPerStrip);   
+    if (this->tileWidth > 0) {
+        TIFFSetField(this->tiff, TIFFTAG_TILEWIDTH, (epicsUInt32)this->tileWidth);
+        TIFFSetField(this->tiff, TIFFTAG_TILELENGTH, (epicsUInt32)this->tileLength);
+    } else {
+        TIFFSetField(this->tiff, TIFFTAG_ROWSPERSTRIP, (epicsUInt32)rowsPerStrip);
+    }
+    TIFFSetField(this->tiff, TIFFTAG_COMPRESSION, this->compression);
+    if (this->compression == COMPRESSION_ADOBE_DEFLATE) {
+        TIFFSetField(this->tiff, TIFFTAG_ZIPQUALITY, this->compressLevel);
+    }
+#ifdef TIFFTAG_ZSTD_LEVEL
+    if (this->compression == COMPRESSION_ZSTD) {
+        TIFFSetField(this->tiff, TIFFTAG_ZSTD_LEVEL, this->compressLevel);
+    }
+#endif
     
     this->pFileAttributes->clear();
     this->getAttributes(this->pFileAttributes);
@@ -355,10 +520,8 @@ asynStatus NDFileTIFF::openFile(const char *fileName, NDFileOpenMode_t openMode,
   */
 asynStatus NDFileTIFF::writeFile(NDArray *pArray)
 {
-    unsigned long stripSize;
-    tsize_t nwrite=0;
-    int strip, sizeY;
-    unsigned char *pRed, *pGreen, *pBlue;
+    NDArrayInfo_t arrayInfo;
+    asynStatus status;
     static const char *functionName = "writeFile";
 
     asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
@@ -372,6 +535,52 @@ asynStatus NDFileTIFF::writeFile(NDArray *pArray)
         return(asynError);
     }
 
+    /* The first page of a multi-page file uses the tags set by openFile */
+    if (this->multiPage && (this->numPages > 0)) {
+        status = this->setTags(pArray);
+        if (status) return status;
+    }
+
+    if (this->multiPage) {
+        pArray->getInfo(&arrayInfo);
+        if (arrayInfo.totalBytes != this->sizeX * this->sizeY * this->samplesPerPixel * (this->bitsPerSample/8)) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: array size %lu does not match the size of the pages in the file\n",
+                driverName, functionName, (unsigned long)arrayInfo.totalBytes);
+            return(asynError);
+        }
+    }
+
+    if (this->tileWidth > 0)
+        status = this->writeTiles(pArray);
+    else
+        status = this->writeStrips(pArray);
+    if (status) return status;
+
+    if (this->multiPage) {
+        if (!TIFFWriteDirectory(this->tiff)) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: error writing directory for page %d\n",
+                driverName, functionName, this->numPages);
+            return(asynError);
+        }
+        this->numPages++;
+    }
+
+    return(asynSuccess);
+}
+
+/** Writes an NDArray to the current TIFF directory in strips.
+  * \param[in] pArray Pointer to the NDArray to be written
+  */
+asynStatus NDFileTIFF::writeStrips(NDArray *pArray)
+{
+    unsigned long stripSize;
+    tsize_t nwrite=0;
+    int strip, sizeY;
+    unsigned char *pRed, *pGreen, *pBlue;
+    static const char *functionName = "writeStrips";
+
     stripSize = (unsigned long)TIFFStripSize(this->tiff);
     TIFFGetField(this->tiff, TIFFTAG_IMAGELENGTH, &sizeY);
 
@@ -413,6 +622,98 @@ asynStatus NDFileTIFF::writeFile(NDArray *pArray)
     return(asynSuccess);
 }
 
+/** Writes an NDArray to the current TIFF directory in tiles.
+  * The tiles are extracted and compressed in parallel by the encoding threads, and then written to the file
+  * in order by this thread.
+  * \param[in] pArray Pointer to the NDArray to be written
+  */
+asynStatus NDFileTIFF::writeTiles(NDArray *pArray)
+{
+    size_t i;
+    ttile_t tile;
+    tsize_t nwrite;
+    NDFileTIFFTile *pTile;
+    static const char *functionName = "writeTiles";
+
+    for (i=0; i<this->tiles.size(); i++) {
+        this->tiles[i].pArray = pArray;
+        if (this->useEncodePool)
+            this->pEncodePool->queue(encodeTileTask, &this->tiles[i]);
+        else
+            this->encodeTile(&this->tiles[i]);
+    }
+    if (this->useEncodePool) this->pEncodePool->wait();
+
+    for (i=0; i<this->tiles.size(); i++) {
+        pTile = &this->tiles[i];
+        pTile->pArray = NULL;
+        if (pTile->status) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: error compressing tile at [%lu, %lu]\n",
+                driverName, functionName, (unsigned long)pTile->x, (unsigned long)pTile->y);
+            return(asynError);
+        }
+        tile = TIFFComputeTile(this->tiff, (epicsUInt32)pTile->x, (epicsUInt32)pTile->y, 0, (tsample_t)pTile->plane);
+        if (this->rawTiles)
+            nwrite = TIFFWriteRawTile(this->tiff, tile, (void *)pTile->pData, pTile->size);
+        else
+            nwrite = TIFFWriteEncodedTile(this->tiff, tile, &pTile->raw[0], pTile->raw.size());
+        if (nwrite < 0) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: error writing tile %d to file\n",
+                driverName, functionName, (int)tile);
+            return(asynError);
+        }
+    }
+
+    return(asynSuccess);
+}
+
+/** Extracts one tile from the NDArray, padding it at the edges of the image, and compresses it if
+  * this can be done outside of libtiff.  Called by the encoding threads.
+  * \param[in] pTile Pointer to the tile
+  */
+void NDFileTIFF::encodeTile(NDFileTIFFTile *pTile)
+{
+    size_t elementSize = this->bitsPerSample / 8;
+    size_t pixelSize = (this->planarConfig == PLANARCONFIG_CONTIG) ? elementSize * this->samplesPerPixel : elementSize;
+    size_t rowSize = this->sizeX * pixelSize;
+    size_t tileRowSize = this->tileWidth * pixelSize;
+    size_t copySize = std::min(this->tileWidth, this->sizeX - pTile->x) * pixelSize;
+    const char *pIn = (const char *)pTile->pArray->pData;
+    char *pOut;
+    size_t row;
+
+    pTile->raw.resize(tileRowSize * this->tileLength);
+    pOut = &pTile->raw[0];
+    for (row=0; row<this->tileLength; row++, pOut+=tileRowSize) {
+        if (pTile->y + row < this->sizeY) {
+            memcpy(pOut, pIn + rowOffset(this->colorMode, rowSize, this->sizeY, pTile->plane, pTile->y + row) +
+                         pTile->x * pixelSize, copySize);
+            if (copySize < tileRowSize) memset(pOut + copySize, 0, tileRowSize - copySize);
+        } else {
+            memset(pOut, 0, tileRowSize);
+        }
+    }
+    pTile->pData = &pTile->raw[0];
+    pTile->size = pTile->raw.size();
+    pTile->status = asynSuccess;
+
+#ifdef HAVE_ZLIB
+    if (this->compression == COMPRESSION_ADOBE_DEFLATE) {
+        uLongf destLen = compressBound((uLong)pTile->size);
+        if (pTile->compressed.size() < destLen) pTile->compressed.resize(destLen);
+        if (compress2((Bytef *)&pTile->compressed[0], &destLen, (const Bytef *)pTile->pData,
+                      (uLong)pTile->size, this->compressLevel) != Z_OK) {
+            pTile->status = asynError;
+            return;
+        }
+        pTile->pData = &pTile->compressed[0];
+        pTile->size = destLen;
+    }
+#endif
+}
+
 /** Reads single NDArray from a TIFF file; 
   * \param[in] pArray Pointer to the NDArray to be read
   */
@@ -506,6 +807,11 @@ asynStatus NDFileTIFF::readFile(NDArray **pArray)
     pImage = this->pNDArrayPool->alloc(ndims, dims, dataType, 0, 0);
     *pArray = pImage;
     buffer = (char *)pImage->pData;
+    if (TIFFIsTiled(this->tiff)) {
+        /* A tiled file has no strips */
+        numStrips = 0;
+        status = this->readTiles(pImage, (NDColorMode_t)clrMode);
+    }
     for (strip=0; strip < numStrips; strip++) {
         size = (int)TIFFReadEncodedStrip(this->tiff, strip, buffer, pImage->dataSize-totalSize);
         if (size == -1) {
@@ -559,6 +865,62 @@ asynStatus NDFileTIFF::readFile(NDArray **pArray)
 }
 
 
+/** Reads the tiles of the current TIFF directory into an NDArray.
+  * \param[in] pImage NDArray with the dimensions and data type of the image
+  * \param[in] readColorMode Color mode of pImage
+  */
+asynStatus NDFileTIFF::readTiles(NDArray *pImage, NDColorMode_t readColorMode)
+{
+    epicsUInt32 width=0, length=0, tileW=0, tileL=0;
+    epicsUInt16 bits=0, spp=1, planar=PLANARCONFIG_CONTIG;
+    size_t elementSize, pixelSize, rowSize, tileRowSize, copySize, copyRows, row;
+    epicsUInt32 x, y;
+    int plane, numPlanes;
+    char *pOut = (char *)pImage->pData;
+    static const char *functionName = "readTiles";
+
+    TIFFGetField(this->tiff, TIFFTAG_IMAGEWIDTH,      &width);
+    TIFFGetField(this->tiff, TIFFTAG_IMAGELENGTH,     &length);
+    TIFFGetField(this->tiff, TIFFTAG_TILEWIDTH,       &tileW);
+    TIFFGetField(this->tiff, TIFFTAG_TILELENGTH,      &tileL);
+    TIFFGetField(this->tiff, TIFFTAG_BITSPERSAMPLE,   &bits);
+    TIFFGetField(this->tiff, TIFFTAG_SAMPLESPERPIXEL, &spp);
+    TIFFGetField(this->tiff, TIFFTAG_PLANARCONFIG,    &planar);
+
+    elementSize = bits / 8;
+    pixelSize = (planar == PLANARCONFIG_CONTIG) ? elementSize * spp : elementSize;
+    numPlanes = (planar == PLANARCONFIG_SEPARATE) ? spp : 1;
+    rowSize = width * pixelSize;
+    tileRowSize = tileW * pixelSize;
+    if ((tileW == 0) || (tileL == 0) || (rowSize * length * numPlanes > pImage->dataSize)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s, invalid tile size %u x %u\n",
+            driverName, functionName, tileW, tileL);
+        return asynError;
+    }
+    std::vector<char> buffer(TIFFTileSize(this->tiff));
+
+    for (plane=0; plane<numPlanes; plane++) {
+        for (y=0; y<length; y+=tileL) {
+            for (x=0; x<width; x+=tileW) {
+                if (TIFFReadTile(this->tiff, &buffer[0], x, y, 0, (tsample_t)plane) < 0) {
+                    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                        "%s::%s, error reading tile at [%u, %u]\n",
+                        driverName, functionName, x, y);
+                    return asynError;
+                }
+                copyRows = std::min(tileL, length - y);
+                copySize = std::min(tileW, width - x) * pixelSize;
+                for (row=0; row<copyRows; row++) {
+                    memcpy(pOut + rowOffset(readColorMode, rowSize, length, plane, y + row) + x * pixelSize,
+                           &buffer[row * tileRowSize], copySize);
+                }
+            }
+        }
+    }
+    return asynSuccess;
+}
+
 /** Closes the TIFF file. */
 asynStatus NDFileTIFF::closeFile()
 {
@@ -575,10 +937,37 @@ asynStatus NDFileTIFF::closeFile()
         "%s::%s closing file\n", 
         driverName, functionName);
     TIFFClose(this->tiff);
+    this->tiff = NULL;
 
     return asynSuccess;
 }
 
+/** Called when asyn clients call pasynInt32->write().
+  * Sets supportsMultipleArrays from NDFileTIFFMultiPage; this cannot be changed during a capture.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[in] value Value to write. */
+asynStatus NDFileTIFF::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    int function = pasynUser->reason;
+    int capture;
+    static const char *functionName = "writeInt32";
+
+    if (function == NDFileTIFFMultiPage) {
+        getIntegerParam(NDFileCapture, &capture);
+        if (capture) {
+            asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s:%s: cannot change TIFFMultiPage during capture\n",
+                driverName, functionName);
+            return asynError;
+        }
+        this->supportsMultipleArrays = (value != 0);
+        setIntegerParam(function, value);
+        callParamCallbacks();
+        return asynSuccess;
+    }
+    return NDPluginFile::writeInt32(pasynUser, value);
+}
+
 
 /** Constructor for NDFileTIFF; all parameters are simply passed to NDPluginFile::NDPluginFile.
   * \param[in] portName The name of the asyn port driver to be created.
@@ -604,18 +993,38 @@ NDFileTIFF::NDFileTIFF(const char *portName, int queueSize, int blockingCallback
                    NDArrayPort, NDArrayAddr, 1,
                    2, 0, asynGenericPointerMask, asynGenericPointerMask, 
                    ASYN_CANBLOCK, 1, priority, stackSize, 1),
-    numAttributes_(0)
+    tiff(NULL), numAttributes_(0), multiPage(false), numPages(0),
+    tileWidth(0), tileLength(0), compression(COMPRESSION_NONE), compressLevel(6), rawTiles(true),
+    pEncodePool(NULL), useEncodePool(false)
 {
     //static const char *functionName = "NDFileTIFF";
 
+    createParam(NDFileTIFFMultiPageString,     asynParamInt32, &NDFileTIFFMultiPage);
+    createParam(NDFileTIFFTileSizeXString,     asynParamInt32, &NDFileTIFFTileSizeX);
+    createParam(NDFileTIFFTileSizeYString,     asynParamInt32, &NDFileTIFFTileSizeY);
+    createParam(NDFileTIFFCompressionString,   asynParamInt32, &NDFileTIFFCompression);
+    createParam(NDFileTIFFCompressLevelString, asynParamInt32, &NDFileTIFFCompressLevel);
+    createParam(NDFileTIFFNumThreadsString,    asynParamInt32, &NDFileTIFFNumThreads);
+
     /* Set the plugin type string */    
     setStringParam(NDPluginDriverPluginType, "NDFileTIFF");
     this->supportsMultipleArrays = 0;
+    setIntegerParam(NDFileTIFFMultiPage, 0);
+    setIntegerParam(NDFileTIFFTileSizeX, 0);
+    setIntegerParam(NDFileTIFFTileSizeY, 0);
+    setIntegerParam(NDFileTIFFCompression, NDFileTIFFCompressNone);
+    setIntegerParam(NDFileTIFFCompressLevel, 6);
+    setIntegerParam(NDFileTIFFNumThreads, 0);
 
     this->pAttributeId = NULL;
     this->pFileAttributes = new NDAttributeList;
 }
 
+NDFileTIFF::~NDFileTIFF()
+{
+    delete this->pEncodePool;
+}
+
 /* Configuration routine.  Called directly, or from the iocsh  */
 
 extern "C" int NDFileTIFFConfigure(const char *portName, int queueSize, int blockingCallbacks,
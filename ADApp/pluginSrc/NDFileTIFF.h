@@ -8,6 +8,10 @@
 #ifndef DRV_NDFileTIFF_H
 #define DRV_NDFileTIFF_H
 
+#include <vector>
+
+#include <NDWorkerPool.h>
+
 #include "NDPluginFile.h"
 #include "tiffio.h"
 
@@ -15,10 +19,44 @@
  * to handle changes in the file contents */
 #define NDTIFFFileVersion 1.0
 
+/** Files whose data may exceed this size are written in the BigTIFF format */
+#define TIFF_BIGTIFF_THRESHOLD 0xF0000000ULL
+
+#define NDFileTIFFMultiPageString     "TIFF_MULTI_PAGE"      /* (asynInt32, r/w) Write all NDArrays in Capture and Stream mode to one file */
+#define NDFileTIFFTileSizeXString     "TIFF_TILE_SIZE_X"     /* (asynInt32, r/w) Tile width, 0 to write strips */
+#define NDFileTIFFTileSizeYString     "TIFF_TILE_SIZE_Y"     /* (asynInt32, r/w) Tile height, 0 to write strips */
+#define NDFileTIFFCompressionString   "TIFF_COMPRESSION"     /* (asynInt32, r/w) Compression, NDFileTIFFCompression_t */
+#define NDFileTIFFCompressLevelString "TIFF_COMPRESS_LEVEL"  /* (asynInt32, r/w) Deflate or ZSTD compression level */
+#define NDFileTIFFNumThreadsString    "TIFF_NUM_THREADS"     /* (asynInt32, r/w) Number of threads that encode tiles */
+
+/** Compression choices of NDFileTIFFCompression */
+typedef enum {
+    NDFileTIFFCompressNone,
+    NDFileTIFFCompressDeflate,
+    NDFileTIFFCompressLZW,
+    NDFileTIFFCompressZSTD
+} NDFileTIFFCompression_t;
+
+/** One tile of a tiled TIFF file, extracted from the NDArray and compressed by a worker thread */
+typedef struct {
+    class NDFileTIFF *pPlugin;
+    NDArray *pArray;
+    int plane;                      /**< Plane of files with PLANARCONFIG_SEPARATE */
+    size_t x;                       /**< Position of the tile in the image */
+    size_t y;
+    std::vector<char> raw;          /**< Uncompressed tile, padded to the full tile size */
+    std::vector<char> compressed;   /**< Compressed tile when the worker thread compresses it */
+    const char *pData;              /**< Data to write to the file */
+    size_t size;
+    asynStatus status;
+} NDFileTIFFTile;
+
 /** Writes NDArrays in the TIFF file format.
     Tagged Image File Format is a file format for storing images.  The format was originally created by Aldus corporation and is
     currently developed by Adobe Systems Incorporated.  This plugin was developed using the libtiff library to write the file.
-    The current version is only capable of writing 2-D images with one image per file.
+    In Capture and Stream mode the plugin can write one file per NDArray, or all of the NDArrays as the pages
+    of a single multi-page TIFF file (NDFileTIFFMultiPage).  Multi-page files that might be larger than 4 GB are
+    written in the BigTIFF format.
     */
 
 class epicsShareClass NDFileTIFF : public NDPluginFile {
@@ -26,19 +64,55 @@ public:
     NDFileTIFF(const char *portName, int queueSize, int blockingCallbacks,
                  const char *NDArrayPort, int NDArrayAddr,
                  int priority, int stackSize);
+    virtual ~NDFileTIFF();
 
     /* The methods that this class implements */
     virtual asynStatus openFile(const char *fileName, NDFileOpenMode_t openMode, NDArray *pArray);
     virtual asynStatus readFile(NDArray **pArray);
     virtual asynStatus writeFile(NDArray *pArray);
     virtual asynStatus closeFile();
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    /* This should be private, but is called from C, must be public */
+    void encodeTile(NDFileTIFFTile *pTile);
+
+protected:
+    int NDFileTIFFMultiPage;
+    #define FIRST_NDFILE_TIFF_PARAM NDFileTIFFMultiPage
+    int NDFileTIFFTileSizeX;
+    int NDFileTIFFTileSizeY;
+    int NDFileTIFFCompression;
+    int NDFileTIFFCompressLevel;
+    int NDFileTIFFNumThreads;
 
 private:
+    asynStatus setTags(NDArray *pArray);
+    asynStatus writeStrips(NDArray *pArray);
+    asynStatus writeTiles(NDArray *pArray);
+    asynStatus readTiles(NDArray *pImage, NDColorMode_t readColorMode);
+
     TIFF *tiff;
     NDColorMode_t colorMode;
     int *pAttributeId;
     NDAttributeList *pFileAttributes;
     int numAttributes_;
+    bool multiPage;         /**< True if the open file is a multi-page file */
+    int numPages;           /**< Number of pages written to a multi-page file */
+    int bitsPerSample;      /**< Format of the open file, set on every page */
+    int sampleFormat;
+    int samplesPerPixel;
+    int photoMetric;
+    int planarConfig;
+    size_t sizeX;
+    size_t sizeY;
+    size_t rowsPerStrip;
+    size_t tileWidth;       /**< Tile size of the open file, 0 if it is written in strips */
+    size_t tileLength;
+    int compression;        /**< libtiff COMPRESSION_ value of the open file */
+    int compressLevel;
+    bool rawTiles;          /**< True if the worker threads produce the data written to the file */
+    NDWorkerPool *pEncodePool;          /**< Threads that encode tiles, NULL until they are first needed */
+    bool useEncodePool;                 /**< True if the tiles of the open file are encoded by pEncodePool */
+    std::vector<NDFileTIFFTile> tiles;  /**< Tiles of one page */
 
 };
 
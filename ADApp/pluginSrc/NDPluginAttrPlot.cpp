@@ -1,4 +1,5 @@
 #include <cmath>
+#include <cstring>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -25,9 +26,9 @@ void ExposeDataTask::start() {
 
 void ExposeDataTask::run() {
     while (!stop_) {
-        plugin_.lock();
+        // callback_data only takes the plugin lock briefly, so that
+        // processCallbacks is not held up while the data is copied
         plugin_.callback_data();
-        plugin_.unlock();
         epicsThreadSleep(ND_ATTRPLOT_DATA_EXPOSURE_PERIOD);
     }
 }
@@ -68,6 +69,8 @@ NDPluginAttrPlot::NDPluginAttrPlot(const char * port, int n_attributes,
       attributes_(),
       n_data_blocks_(n_data_blocks),
       data_selections_(n_data_blocks, ND_ATTRPLOT_NONE_INDEX),
+      list_attrs_(),
+      list_index_(),
       expose_task_(*this)
 {
     data_.reserve(n_attributes_);
@@ -96,17 +99,24 @@ void NDPluginAttrPlot::start_expose() {
 
 void NDPluginAttrPlot::callback_data() {
 
+    // The selections are copied with the lock held, the data is copied from
+    // the rings without it
+    lock();
+    std::vector<int> selections(data_selections_);
+    size_t n_data = attributes_.size();
+    unlock();
+
     size_t size = uids_.size();
     size_t cache_size = uids_.max_size();
     double * const tmp_arr = new double[cache_size];
 
     size_t n_copied;
     for (size_t i = 0; i < n_data_blocks_; ++i) {
-        int selected = data_selections_[i];
+        int selected = selections[i];
         if (selected == ND_ATTRPLOT_UID_INDEX) {
             n_copied = uids_.copy_to_array(tmp_arr, size);
         } else if (selected >= 0 &&
-                static_cast<unsigned>(selected) < data_.size()) {
+                static_cast<unsigned>(selected) < n_data) {
             n_copied = data_[selected].copy_to_array(tmp_arr,
                     size);
         } else {
@@ -117,7 +127,7 @@ void NDPluginAttrPlot::callback_data() {
         // the remaining arrays with the last point
         std::fill(tmp_arr + n_copied,
                 tmp_arr + cache_size,
-                *(tmp_arr + n_copied - 1));
+                n_copied > 0 ? *(tmp_arr + n_copied - 1) : epicsNAN);
         doCallbacksFloat64Array(tmp_arr, cache_size, NDAttrPlotData, (int)i);
     }
 
@@ -125,10 +135,9 @@ void NDPluginAttrPlot::callback_data() {
 }
 
 void NDPluginAttrPlot::processCallbacks(NDArray *pArray) {
-    NDAttributeList attr_list;
+    NDAttributeList& attr_list = *pArray->pAttributeList;
 
     NDPluginDriver::beginProcessCallbacks(pArray);
-    pArray->pAttributeList->copy(&attr_list);
 
     epicsInt32 uid;
     getIntegerParam(NDUniqueId, &uid);
@@ -180,6 +189,7 @@ void NDPluginAttrPlot::rebuild_attributes(NDAttributeList& attr_list) {
     }
 
     std::sort(attributes_.begin(), attributes_.end());
+    list_index_.assign(attributes_.size(), 0);
 
     for (unsigned i = 0; i < n_data_blocks_; ++i) {
         if (selections[i] == ND_ATTRPLOT_UID_LABEL) {
@@ -241,28 +251,43 @@ void NDPluginAttrPlot::callback_selected() {
 
 asynStatus NDPluginAttrPlot::push_data(epicsInt32 uid, NDAttributeList& list) {
     size_t length = attributes_.size();
-    double *new_values = new double[length];
-    std::fill(new_values, new_values + length, epicsNAN);
+    double value;
 
-    // Populate the new values with values from the attribute list
+    list_attrs_.clear();
     for (NDAttribute * attr = list.next(NULL);
             attr != NULL; attr = list.next(attr)) {
-        std::string name(attr->getName());
-        std::vector<std::string>::const_iterator it = std::find(
-                attributes_.begin(), attributes_.end(), name);
-        if (it != attributes_.end()) {
-            ptrdiff_t index = it - attributes_.begin();
-            attr->getValue(NDAttrFloat64, &new_values[index], 1);
-        }
+        list_attrs_.push_back(attr);
     }
 
-    // Push the new values to the data block
-    uids_.push_back(uid);
+    // Arrays from the same source normally have their attributes in the same
+    // order, so each attribute is first looked for where it was found last
     for (size_t i = 0; i < length; ++i) {
-        data_[i].push_back(new_values[i]);
+        const char * name = attributes_[i].c_str();
+        NDAttribute * attr = NULL;
+        size_t j = list_index_[i];
+        if (j < list_attrs_.size() &&
+                strcmp(list_attrs_[j]->getName(), name) == 0) {
+            attr = list_attrs_[j];
+        } else {
+            for (j = 0; j < list_attrs_.size(); ++j) {
+                if (strcmp(list_attrs_[j]->getName(), name) == 0) {
+                    attr = list_attrs_[j];
+                    list_index_[i] = j;
+                    break;
+                }
+            }
+        }
+        value = epicsNAN;
+        if (attr != NULL) {
+            attr->getValue(NDAttrFloat64, &value, 1);
+        }
+        data_[i].push_back(value);
     }
 
-    delete new_values;
+    // The uid is pushed last, so that a snapshot never holds more uids
+    // than data points
+    uids_.push_back(uid);
+
     return asynSuccess;
 }
 
@@ -182,12 +182,20 @@ private:
     /**
      * \brief Sets data from the attribute list to the cache.
      *
+     * Only the saved attributes are read from the list, the list is not
+     * copied. All the saved attributes are pushed, not only the selected
+     * ones, so that the history of an attribute is available as soon as
+     * it is selected.
+     *
      * \param attr_list Attribute list containing the data.
      */
     asynStatus push_data(epicsInt32 uid, NDAttributeList& attr_list);
 
     /**
      * \brief Exposes the selected data fields to EPICS layer.
+     *
+     * The data is copied from the caches without holding the plugin lock,
+     * so this can run while arrays are being processed.
      */
     void callback_data();
 
@@ -220,6 +228,12 @@ private:
     const unsigned n_data_blocks_;
     std::vector<int> data_selections_;
 
+    /** Attributes of the current NDArray, in list order */
+    std::vector<NDAttribute *> list_attrs_;
+
+    /** Position of each saved attribute in the last attribute list */
+    std::vector<size_t> list_index_;
+
     /** Task that periodically exposes the data */
     ExposeDataTask expose_task_;
 };
@@ -40,6 +40,13 @@ typedef enum {
 
 #define DEFAULT_NUM_TSPOINTS 2048
 
+static void flushTaskC(void *drvPvt)
+{
+  NDPluginAttribute *pPvt = (NDPluginAttribute *)drvPvt;
+
+  pPvt->flushTask();
+}
+
 /** 
   * \param[in] pArray  The NDArray from the callback.
   */
@@ -54,11 +61,11 @@ void NDPluginAttribute::processCallbacks(NDArray *pArray)
   int currentTSPoint;
   int numTSPoints;
   int TSAcquiring;
-  double valueSum;
   int i;
-  char attrName[MAX_ATTR_NAME_] = {0};
+  double minUpdateTime;
+  epicsTimeStamp now;
   NDAttribute *pAttribute = NULL;
-  NDAttributeList *pAttrList = NULL;
+  NDAttrSlot_t *pSlot;
   epicsFloat64 attrValue = 0.0;
 
   static const char *functionName = "NDPluginAttribute::processCallbacks";
@@ -66,48 +73,52 @@ void NDPluginAttribute::processCallbacks(NDArray *pArray)
   /* Call the base class method */
   NDPluginDriver::beginProcessCallbacks(pArray);
   
-  /* Get the attributes for this driver */
-  pAttrList = pArray->pAttributeList;
-  
   getIntegerParam(NDPluginAttributeTSCurrentPoint, &currentTSPoint);
   getIntegerParam(NDPluginAttributeTSNumPoints,    &numTSPoints);
   getIntegerParam(NDPluginAttributeTSAcquiring,    &TSAcquiring);
+  getDoubleParam(NDPluginAttributeMinUpdateTime,   &minUpdateTime);
 
-  for (i=0; i<maxAttributes_; i++) {
-    getStringParam(i, NDPluginAttributeAttrName, MAX_ATTR_NAME_, attrName);
-
-    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "Finding the attribute %s\n", attrName);
+  /* Find the attributes that are tracked in the attribute list of this array */
+  if (!attrNames_.empty()) findAttributes(pArray->pAttributeList);
 
-    if (strcmp(attrName, UNIQUE_ID_NAME_) == 0) {
-      attrValue = (epicsFloat64) pArray->uniqueId;
-    } else if (strcmp(attrName, TIMESTAMP_NAME_) == 0) {
-      attrValue = pArray->timeStamp;
-    } else if (strcmp(attrName, EPICS_TS_SEC_NAME_) == 0) {
-      attrValue = (epicsFloat64)pArray->epicsTS.secPastEpoch;
-    } else if (strcmp(attrName, EPICS_TS_NSEC_NAME_) == 0) {
-      attrValue = (epicsFloat64)pArray->epicsTS.nsec;
-    } else {
-      pAttribute = pAttrList->find(attrName);
-      if (pAttribute) {
+  for (i=0; i<maxAttributes_; i++) {
+    pSlot = &slots_[i];
+    switch (pSlot->source) {
+      case NDAttrValueSourceNone:
+        continue;
+      case NDAttrValueSourceUniqueId:
+        attrValue = (epicsFloat64) pArray->uniqueId;
+        break;
+      case NDAttrValueSourceTimeStamp:
+        attrValue = pArray->timeStamp;
+        break;
+      case NDAttrValueSourceEpicsTSSec:
+        attrValue = (epicsFloat64)pArray->epicsTS.secPastEpoch;
+        break;
+      case NDAttrValueSourceEpicsTSnSec:
+        attrValue = (epicsFloat64)pArray->epicsTS.nsec;
+        break;
+      case NDAttrValueSourceAttribute:
+        pAttribute = attrNames_[pSlot->nameIndex].pAttribute;
+        if (!pAttribute) {
+          asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "%s: Error finding NDAttribute %s. \n",
+                    functionName, attrNames_[pSlot->nameIndex].name.c_str());
+          continue;
+        }
         status = pAttribute->getValue(NDAttrFloat64, &attrValue);
         if (status != asynSuccess) {
-          asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "%s: Error reading value for NDAttribute %s. \n", functionName, attrName);
+          asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "%s: Error reading value for NDAttribute %s. \n",
+                    functionName, attrNames_[pSlot->nameIndex].name.c_str());
           continue;
         }
-        asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "Attribute %s value is %f\n", attrName, attrValue);
-      } else {
-        asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "%s: Error finding NDAttribute %s. \n", functionName, attrName);
-        continue;
-      }
+        break;
     }
-    setDoubleParam(i, NDPluginAttributeVal, attrValue);
-    getDoubleParam(i, NDPluginAttributeValSum, &valueSum);
-    valueSum += attrValue;
-    setDoubleParam(i, NDPluginAttributeValSum, valueSum);
+    pSlot->value = attrValue;
+    pSlot->valueSum += attrValue;
+    pSlot->updated = true;
     if (TSAcquiring) {
       pTSArray_[i][currentTSPoint] = attrValue;
     }
-    callParamCallbacks(i);
   }
   if (TSAcquiring) {
     currentTSPoint++;
@@ -115,8 +126,168 @@ void NDPluginAttribute::processCallbacks(NDArray *pArray)
     if (currentTSPoint >= numTSPoints) {
         doTimeSeriesCallbacks();
         setIntegerParam(NDPluginAttributeTSAcquiring, 0);
+        TSAcquiring = 0;
+        minUpdateTime = 0.;
     }
   }
+
+  /* The values are published at most once per MinUpdateTime.  Values that are held back are
+   * published by flushTask() when MinUpdateTime has passed, even if no more arrays arrive. */
+  epicsTimeGetCurrent(&now);
+  if ((minUpdateTime <= 0.) || (epicsTimeDiffInSeconds(&now, &lastUpdateTime_) >= minUpdateTime)) {
+    publishValues();
+    lastUpdateTime_ = now;
+  } else if (!valuesPending_) {
+    valuesPending_ = true;
+    if (createFlushThread() == asynSuccess) epicsEventSignal(flushWakeEvent_);
+  }
+}
+
+/** Publishes the values that processCallbacks held back because of MinUpdateTime,
+  * once MinUpdateTime has passed since the last update. */
+void NDPluginAttribute::flushTask()
+{
+  double minUpdateTime, elapsed;
+  epicsTimeStamp now;
+
+  lock();
+  while (!flushExit_) {
+    if (valuesPending_) {
+      getDoubleParam(NDPluginAttributeMinUpdateTime, &minUpdateTime);
+      epicsTimeGetCurrent(&now);
+      elapsed = epicsTimeDiffInSeconds(&now, &lastUpdateTime_);
+      if (elapsed >= minUpdateTime) {
+        publishValues();
+        lastUpdateTime_ = now;
+        continue;
+      }
+      unlock();
+      epicsEventWaitWithTimeout(flushWakeEvent_, minUpdateTime - elapsed);
+    } else {
+      unlock();
+      epicsEventWait(flushWakeEvent_);
+    }
+    lock();
+  }
+  unlock();
+  epicsEventSignal(flushExitEvent_);
+}
+
+/** Creates the thread that runs flushTask() if it does not already exist. */
+asynStatus NDPluginAttribute::createFlushThread()
+{
+  char taskName[256];
+  static const char *functionName = "NDPluginAttribute::createFlushThread";
+
+  if (flushThreadId_ != 0) return asynSuccess;
+
+  epicsSnprintf(taskName, sizeof(taskName)-1, "%s_Plugin_Flush", portName);
+  flushThreadId_ = epicsThreadCreate(taskName,
+                                     this->threadPriority_,
+                                     this->threadStackSize_,
+                                     (EPICSTHREADFUNC)flushTaskC, this);
+  if (flushThreadId_ == 0) {
+    asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+      "%s: error creating flush thread\n",
+      functionName);
+    return asynError;
+  }
+  return asynSuccess;
+}
+
+/** Resolves the AttrName of each address to the source of its value.
+  * This is done when an AttrName changes, so that processCallbacks does not need to compare names.
+  * Addresses that track the same NDAttribute share one entry in attrNames_.
+  */
+void NDPluginAttribute::compileSlots()
+{
+  char attrName[MAX_ATTR_NAME_] = {0};
+  NDAttrSlot_t *pSlot;
+  NDAttrName_t newName;
+  size_t j;
+  int i;
+
+  attrNames_.clear();
+  for (i=0; i<maxAttributes_; i++) {
+    pSlot = &slots_[i];
+    getStringParam(i, NDPluginAttributeAttrName, MAX_ATTR_NAME_, attrName);
+    pSlot->nameIndex = -1;
+    if (strlen(attrName) == 0) {
+      pSlot->source = NDAttrValueSourceNone;
+    } else if (strcmp(attrName, UNIQUE_ID_NAME_) == 0) {
+      pSlot->source = NDAttrValueSourceUniqueId;
+    } else if (strcmp(attrName, TIMESTAMP_NAME_) == 0) {
+      pSlot->source = NDAttrValueSourceTimeStamp;
+    } else if (strcmp(attrName, EPICS_TS_SEC_NAME_) == 0) {
+      pSlot->source = NDAttrValueSourceEpicsTSSec;
+    } else if (strcmp(attrName, EPICS_TS_NSEC_NAME_) == 0) {
+      pSlot->source = NDAttrValueSourceEpicsTSnSec;
+    } else {
+      pSlot->source = NDAttrValueSourceAttribute;
+      for (j=0; j<attrNames_.size(); j++) {
+        if (attrNames_[j].name == attrName) break;
+      }
+      if (j == attrNames_.size()) {
+        newName.name = attrName;
+        newName.listIndex = 0;
+        newName.pAttribute = NULL;
+        attrNames_.push_back(newName);
+      }
+      pSlot->nameIndex = (int)j;
+    }
+  }
+}
+
+/** Finds each tracked NDAttribute in an attribute list.
+  * The list is walked once.  Arrays from the same driver normally have their attributes in the same order,
+  * so each name is first compared with the attribute at the position where it was last found.
+  * \param[in] pAttrList The attribute list of the NDArray
+  */
+void NDPluginAttribute::findAttributes(NDAttributeList *pAttrList)
+{
+  NDAttribute *pAttribute;
+  NDAttrName_t *pName;
+  size_t i, j;
+
+  attributes_.clear();
+  for (pAttribute=pAttrList->next(NULL); pAttribute; pAttribute=pAttrList->next(pAttribute)) {
+    attributes_.push_back(pAttribute);
+  }
+  for (i=0; i<attrNames_.size(); i++) {
+    pName = &attrNames_[i];
+    pName->pAttribute = NULL;
+    if ((pName->listIndex < attributes_.size()) &&
+        (strcmp(attributes_[pName->listIndex]->getName(), pName->name.c_str()) == 0)) {
+      pName->pAttribute = attributes_[pName->listIndex];
+      continue;
+    }
+    for (j=0; j<attributes_.size(); j++) {
+      if (strcmp(attributes_[j]->getName(), pName->name.c_str()) == 0) {
+        pName->listIndex = j;
+        pName->pAttribute = attributes_[j];
+        break;
+      }
+    }
+  }
+}
+
+/** Copies the values that have changed since they were last published to the parameter library,
+  * and does the callbacks for them.
+  */
+void NDPluginAttribute::publishValues()
+{
+  NDAttrSlot_t *pSlot;
+  int i;
+
+  valuesPending_ = false;
+  for (i=0; i<maxAttributes_; i++) {
+    pSlot = &slots_[i];
+    if (!pSlot->updated) continue;
+    pSlot->updated = false;
+    setDoubleParam(i, NDPluginAttributeVal, pSlot->value);
+    setDoubleParam(i, NDPluginAttributeValSum, pSlot->valueSum);
+    callParamCallbacks(i);
+  }
 }
 
 void NDPluginAttribute::doTimeSeriesCallbacks()
@@ -145,6 +316,9 @@ asynStatus NDPluginAttribute::writeInt32(asynUser *pasynUser, epicsInt32 value)
   if (function == NDPluginAttributeReset) {
   getIntegerParam(NDPluginAttributeTSNumPoints, &numTSPoints);
     for (i=0; i<maxAttributes_; i++) {
+      slots_[i].value = 0.0;
+      slots_[i].valueSum = 0.0;
+      slots_[i].updated = false;
       setDoubleParam(i, NDPluginAttributeVal, 0.0);
       setDoubleParam(i, NDPluginAttributeValSum, 0.0);
       // Clear the time series array
@@ -181,9 +355,11 @@ asynStatus NDPluginAttribute::writeInt32(asynUser *pasynUser, epicsInt32 value)
       case TSStop:
         setIntegerParam(NDPluginAttributeTSAcquiring, 0);
         doTimeSeriesCallbacks();
+        publishValues();
         break;
       case TSRead:
         doTimeSeriesCallbacks();
+        publishValues();
         break;
     }
   }
@@ -208,6 +384,48 @@ asynStatus NDPluginAttribute::writeInt32(asynUser *pasynUser, epicsInt32 value)
 }
 
 
+/** Called when asyn clients call pasynOctet->write().
+  * If the AttrName of an address changes the sources of the values are resolved again.
+  * For other parameters it calls NDPluginDriver::writeOctet.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[in] value Address of the string to write.
+  * \param[in] nChars Number of characters to write.
+  * \param[out] nActual Number of characters actually written. */
+asynStatus NDPluginAttribute::writeOctet(asynUser *pasynUser, const char *value,
+                                         size_t nChars, size_t *nActual)
+{
+  int addr = 0;
+  int function = pasynUser->reason;
+  asynStatus status = asynSuccess;
+  static const char *functionName = "NDPluginAttribute::writeOctet";
+
+  status = getAddress(pasynUser, &addr); if (status != asynSuccess) return(status);
+
+  if (function == NDPluginAttributeAttrName) {
+    /* Set the parameter in the parameter library. */
+    status = (asynStatus)setStringParam(addr, function, (char *)value);
+    compileSlots();
+  } else if (function < FIRST_NDPLUGIN_ATTR_PARAM) {
+    /* If this parameter belongs to a base class call its method */
+    status = NDPluginDriver::writeOctet(pasynUser, value, nChars, nActual);
+  }
+
+  /* Do callbacks so higher layers see any changes */
+  callParamCallbacks(addr);
+
+  if (status)
+    epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+                  "%s: status=%d, function=%d, value=%s",
+                  functionName, status, function, value);
+  else
+    asynPrint(pasynUser, ASYN_TRACEIO_DRIVER,
+              "%s: function=%d, value=%s\n",
+              functionName, function, value);
+  *nActual = nChars;
+  return status;
+}
+
+
 /** Constructor for NDPluginAttribute; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   *
   * \param[in] portName The name of the asyn port driver to be created.
@@ -236,7 +454,8 @@ NDPluginAttribute::NDPluginAttribute(const char *portName, int queueSize, int bl
                    NDArrayPort, NDArrayAddr, maxAttributes, maxBuffers, maxMemory,
                    asynInt32ArrayMask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
                    asynInt32ArrayMask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
-                   ASYN_MULTIDEVICE, 1, priority, stackSize, 1)
+                   ASYN_MULTIDEVICE, 1, priority, stackSize, 1),
+      valuesPending_(false), flushExit_(false), flushThreadId_(0)
 {
   int i;
   static const char *functionName = "NDPluginAttribute::NDPluginAttribute";
@@ -253,11 +472,18 @@ NDPluginAttribute::NDPluginAttribute(const char *portName, int queueSize, int bl
   createParam(NDPluginAttributeTSCurrentPointString, asynParamInt32,        &NDPluginAttributeTSCurrentPoint);
   createParam(NDPluginAttributeTSAcquiringString,    asynParamInt32,        &NDPluginAttributeTSAcquiring);
   createParam(NDPluginAttributeTSArrayValueString,   asynParamFloat64Array, &NDPluginAttributeTSArrayValue);
+  createParam(NDPluginAttributeMinUpdateTimeString,  asynParamFloat64,      &NDPluginAttributeMinUpdateTime);
 
   /* Set the plugin type string */
   setStringParam(NDPluginDriverPluginType, "NDPluginAttribute");
 
   setIntegerParam(NDPluginAttributeTSNumPoints, DEFAULT_NUM_TSPOINTS);
+  setDoubleParam(NDPluginAttributeMinUpdateTime, 0.0);
+  slots_.resize(maxAttributes_);
+  lastUpdateTime_.secPastEpoch = 0;
+  lastUpdateTime_.nsec = 0;
+  flushWakeEvent_ = epicsEventMustCreate(epicsEventEmpty);
+  flushExitEvent_ = epicsEventMustCreate(epicsEventEmpty);
   pTSArray_ = static_cast<epicsFloat64 **>(calloc(maxAttributes_, sizeof(epicsFloat64 *)));
   if (pTSArray_ == NULL) {
     perror(functionName);
@@ -268,6 +494,11 @@ NDPluginAttribute::NDPluginAttribute(const char *portName, int queueSize, int bl
     setDoubleParam(i, NDPluginAttributeVal, 0.0);
     setDoubleParam(i, NDPluginAttributeValSum, 0.0);
     setStringParam(i, NDPluginAttributeAttrName, "");
+    slots_[i].source = NDAttrValueSourceNone;
+    slots_[i].nameIndex = -1;
+    slots_[i].value = 0.0;
+    slots_[i].valueSum = 0.0;
+    slots_[i].updated = false;
     if (pTSArray_[i] == NULL) {
       perror(functionName);
       asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, "%s: Error from calloc for pTSArray_.\n", functionName);
@@ -284,6 +515,27 @@ NDPluginAttribute::NDPluginAttribute(const char *portName, int queueSize, int bl
 
 }
 
+/** Destructor; stops the callbacks from the driver and the flush thread, and frees the time series arrays */
+NDPluginAttribute::~NDPluginAttribute()
+{
+  int i;
+
+  setArrayInterrupt(0);
+  if (flushThreadId_ != 0) {
+    this->lock();
+    flushExit_ = true;
+    this->unlock();
+    epicsEventSignal(flushWakeEvent_);
+    epicsEventWait(flushExitEvent_);
+  }
+  epicsEventDestroy(flushWakeEvent_);
+  epicsEventDestroy(flushExitEvent_);
+  if (pTSArray_) {
+    for (i=0; i<maxAttributes_; i++) free(pTSArray_[i]);
+    free(pTSArray_);
+  }
+}
+
 /** Configuration command */
 extern "C" int NDAttrConfigure(const char *portName, int queueSize, int blockingCallbacks,
                                const char *NDArrayPort, int NDArrayAddr,
@@ -2,7 +2,12 @@
 #ifndef NDPluginAttribute_H
 #define NDPluginAttribute_H
 
+#include <string>
+#include <vector>
 #include <epicsTypes.h>
+#include <epicsTime.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
 
 #include "NDPluginDriver.h"
 
@@ -16,6 +21,33 @@
 #define NDPluginAttributeTSCurrentPointString "ATTR_TS_CURRENT_POINT" /* (asynInt32,        r/o) Current point in time series */
 #define NDPluginAttributeTSAcquiringString    "ATTR_TS_ACQUIRING"     /* (asynInt32,        r/o) Acquiring time series */
 #define NDPluginAttributeTSArrayValueString   "ATTR_TS_ARRAY_VALUE"   /* (asynFloat64Array, r/o) Series of minimum counts */
+#define NDPluginAttributeMinUpdateTimeString  "ATTR_MIN_UPDATE_TIME"  /* (asynFloat64,      r/w) Minimum time between updates of the values */
+
+/** Where the value of a tracked attribute comes from.  This is resolved when AttrName changes. */
+typedef enum {
+    NDAttrValueSourceNone,
+    NDAttrValueSourceUniqueId,
+    NDAttrValueSourceTimeStamp,
+    NDAttrValueSourceEpicsTSSec,
+    NDAttrValueSourceEpicsTSnSec,
+    NDAttrValueSourceAttribute
+} NDAttrValueSource_t;
+
+/** State of the attribute tracked at one asyn address */
+typedef struct {
+    NDAttrValueSource_t source;
+    int            nameIndex;   /**< Index into attrNames_ if source=NDAttrValueSourceAttribute */
+    epicsFloat64   value;
+    epicsFloat64   valueSum;
+    bool           updated;     /**< value has changed since it was last published */
+} NDAttrSlot_t;
+
+/** An NDAttribute name that is tracked at one or more addresses */
+typedef struct {
+    std::string    name;
+    size_t         listIndex;   /**< Position of the attribute in the last attribute list it was found in */
+    NDAttribute    *pAttribute; /**< The attribute in the current NDArray, NULL if it was not found */
+} NDAttrName_t;
 
 /** Extract an Attribute from an NDArray and publish the value (and array of values) over channel access.  */
 class epicsShareClass NDPluginAttribute : public NDPluginDriver {
@@ -24,9 +56,12 @@ public:
                       const char *NDArrayPort, int NDArrayAddr, int maxAttributes,
                       int maxBuffers, size_t maxMemory,
                       int priority, int stackSize);
+    virtual ~NDPluginAttribute();
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
     asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual);
+    void flushTask();
 
 protected:
     int NDPluginAttributeAttrName;
@@ -39,10 +74,15 @@ protected:
     int NDPluginAttributeTSCurrentPoint;
     int NDPluginAttributeTSAcquiring;
     int NDPluginAttributeTSArrayValue;
+    int NDPluginAttributeMinUpdateTime;
                                 
 private:
 
     void doTimeSeriesCallbacks();
+    void compileSlots();
+    void findAttributes(NDAttributeList *pAttrList);
+    void publishValues();
+    asynStatus createFlushThread();
     static const epicsInt32 MAX_ATTR_NAME_;
     static const char*      UNIQUE_ID_NAME_;
     static const char*      TIMESTAMP_NAME_;
@@ -51,6 +91,15 @@ private:
 
     int maxAttributes_;
     epicsFloat64 **pTSArray_;
+    std::vector<NDAttrSlot_t> slots_;
+    std::vector<NDAttrName_t> attrNames_;
+    std::vector<NDAttribute *> attributes_;  /* Attributes of the current NDArray, in list order */
+    epicsTimeStamp lastUpdateTime_;
+    bool valuesPending_;          /* Values are held back by MinUpdateTime */
+    bool flushExit_;
+    epicsThreadId flushThreadId_;
+    epicsEventId flushWakeEvent_;
+    epicsEventId flushExitEvent_;
 
 };
     
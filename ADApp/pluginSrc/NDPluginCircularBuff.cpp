@@ -142,7 +142,7 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
       }
 
       // First copy the buffer into our buffer pool so we can release the resource on the driver
-      pArrayCpy = this->pNDArrayPool->copy(pArray, NULL, 1);
+      pArrayCpy = this->pNDArrayPool->copy(pArray, NULL, 1, true, true, NDCopyAttributesUpdate);
 
       if (pArrayCpy){
 
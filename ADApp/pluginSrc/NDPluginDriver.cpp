@@ -12,9 +12,11 @@
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
+#include <set>
 
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
+#include <epicsMutex.h>
 #include <epicsThread.h>
 #include <epicsEvent.h>
 #include <epicsTime.h>
@@ -25,6 +27,17 @@
 #include <epicsExport.h>
 #include "NDPluginDriver.h"
 
+/* All of the plugins that exist, so that getCallbackPlugin can recognize the plugins that registered
+ * an interrupt whatever callback function they registered */
+static std::set<NDPluginDriver *> registeredPlugins;
+static epicsMutexId registeredPluginsLock;
+static epicsThreadOnceId registeredPluginsOnce = EPICS_THREAD_ONCE_INIT;
+
+static void registeredPluginsInit(void *)
+{
+    registeredPluginsLock = epicsMutexMustCreate();
+}
+
 typedef enum {
     ToThreadMessageData,
     ToThreadMessageExit
@@ -169,6 +182,11 @@ NDPluginDriver::NDPluginDriver(const char *portName, int queueSize, int blocking
     }
     
     unlock();
+
+    epicsThreadOnce(&registeredPluginsOnce, registeredPluginsInit, NULL);
+    epicsMutexMustLock(registeredPluginsLock);
+    registeredPlugins.insert(this);
+    epicsMutexUnlock(registeredPluginsLock);
 }
 
 NDPluginDriver::~NDPluginDriver()
@@ -178,6 +196,10 @@ NDPluginDriver::~NDPluginDriver()
   // We lock the mutex because deleteCallbackThreads expects it to be held, but then
   // unlocked it because the mutex is deleted in the asynPortDriver destructor and the
   // mutex must be unlocked before deleting it.
+  epicsMutexMustLock(registeredPluginsLock);
+  registeredPlugins.erase(this);
+  epicsMutexUnlock(registeredPluginsLock);
+
   this->lock();
   deleteCallbackThreads();
   this->unlock();
@@ -325,6 +347,42 @@ extern "C" {static void driverCallback(void *drvPvt, asynUser *pasynUser, void *
     pNDPluginDriver->driverCallback(pasynUser, genericPointer);
 }}
 
+/** Returns the plugin that registered an asynGenericPointer interrupt, or NULL if the interrupt
+  * was not registered by an NDPluginDriver.
+  * This is used by plugins that select which downstream plugin receives an NDArray (e.g. NDPluginScatter).
+  * Plugins pass themselves as the userPvt of the interrupt, but some (e.g. NDPluginGather) register their
+  * own callback function, so the userPvt is looked up in the plugins that exist.
+  * \param[in] pInterrupt The interrupt from the client list of the NDArray source. */
+NDPluginDriver *NDPluginDriver::getCallbackPlugin(asynGenericPointerInterrupt *pInterrupt)
+{
+    NDPluginDriver *pPlugin = (NDPluginDriver *)pInterrupt->userPvt;
+    bool found;
+
+    epicsThreadOnce(&registeredPluginsOnce, registeredPluginsInit, NULL);
+    epicsMutexMustLock(registeredPluginsLock);
+    found = (registeredPlugins.count(pPlugin) > 0);
+    epicsMutexUnlock(registeredPluginsLock);
+    return found ? pPlugin : NULL;
+}
+
+/** Returns the current load of this plugin.
+  * This method takes the lock, so it must not be called with the lock of this plugin held.
+  * \param[out] queuePending Number of NDArrays waiting in the input queue; 0 if callbacks are blocking.
+  * \param[out] numThreads Number of threads processing the input queue.
+  * \param[out] executionTime Execution time of the last call to processCallbacks (milliseconds). */
+void NDPluginDriver::getQueueStatus(int *queuePending, int *numThreads, double *executionTime)
+{
+    int blockingCallbacks;
+
+    this->lock();
+    getIntegerParam(NDPluginDriverBlockingCallbacks, &blockingCallbacks);
+    *queuePending = 0;
+    if (!blockingCallbacks && pToThreadMsgQ_) *queuePending = pToThreadMsgQ_->pending();
+    *numThreads = numThreads_;
+    getDoubleParam(NDPluginDriverExecutionTime, executionTime);
+    this->unlock();
+}
+
 /** Method that is called from the driver with a new NDArray.
   * It calls the processCallbacks function, which typically is implemented in the
   * derived class.
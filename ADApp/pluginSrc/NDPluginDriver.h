@@ -71,6 +71,8 @@ public:
     virtual void run(void);
     virtual asynStatus start(void);
     void sortingTask();
+    void getQueueStatus(int *queuePending, int *numThreads, double *executionTime);
+    static NDPluginDriver *getCallbackPlugin(asynGenericPointerInterrupt *pInterrupt);
 
 protected:
     virtual void processCallbacks(NDArray *pArray) = 0;
@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <errno.h>
 
+#include <algorithm>
+
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
@@ -25,10 +27,29 @@
 #include <epicsExport.h>
 #include <NDPluginDriver.h>
 #include "NDPluginFile.h"
+#include "NDWorkerPool.h"
 
 
 static const char *driverName="NDPluginFile";
 
+/* Number of Stream mode write times used to compute the write latency percentiles */
+#define NUM_WRITE_LATENCIES 1000
+/* Minimum time in seconds between updates of the latency percentile parameters */
+#define WRITE_LATENCY_UPDATE_PERIOD 1.0
+
+/* An NDArray queued for writeTask */
+typedef struct {
+    NDPluginFile *pPlugin;
+    NDArray *pArray;
+} NDFileWriteJob_t;
+
+static void writeTaskC(void *pArg)
+{
+    NDFileWriteJob_t *pJob = (NDFileWriteJob_t *)pArg;
+    pJob->pPlugin->writeTask(pJob->pArray);
+    delete pJob;
+}
+
 
 
 /** Base method for opening a file
@@ -98,6 +119,9 @@ asynStatus NDPluginFile::closeFileBase()
     char errorMessage[256];
     static const char* functionName = "closeFileBase";
 
+    /* Arrays that are queued for writeTask must be written before the file is closed */
+    this->flushWriteQueue();
+
     setIntegerParam(NDFileWriteStatus, NDFileWriteOK);
     setStringParam(NDFileWriteMessage, "");
 
@@ -218,6 +242,7 @@ asynStatus NDPluginFile::writeFileBase()
     NDAttribute *pAttribute;
     char driverFileName[MAX_FILENAME_LEN];
     char errorMessage[256];
+    epicsTimeStamp tStart, tEnd;
     static const char* functionName = "writeFileBase";
 
     /* Make sure there is a valid array */
@@ -326,6 +351,8 @@ asynStatus NDPluginFile::writeFileBase()
             callParamCallbacks();
             break;
         case NDFileModeStream:
+            /* NDFileNumCaptured counts the arrays that writeTask has written */
+            if (this->pWritePool) numCaptured = this->numWritesQueued;
             doLazyOpen = this->lazyOpen && (numCaptured == 0);
             if (!this->supportsMultipleArrays || doLazyOpen)
                 status = this->openFileBase(NDFileModeWrite | NDFileModeMultiple, pArrayOut);
@@ -337,11 +364,19 @@ asynStatus NDPluginFile::writeFileBase()
                 status = asynError;
             }
             if (status == asynSuccess) {
-                this->unlock();
-                epicsMutexLock(this->fileMutexId);
-                status = this->writeFile(pArrayOut);
-                epicsMutexUnlock(this->fileMutexId);
-                this->lock();
+                if (this->pWritePool) {
+                    /* writeTask writes the array and reports any error */
+                    status = this->queueWrite(pArrayOut);
+                } else {
+                    epicsTimeGetCurrent(&tStart);
+                    this->unlock();
+                    epicsMutexLock(this->fileMutexId);
+                    status = this->writeFile(pArrayOut);
+                    epicsMutexUnlock(this->fileMutexId);
+                    this->lock();
+                    epicsTimeGetCurrent(&tEnd);
+                    this->recordWriteLatency(epicsTimeDiffInSeconds(&tEnd, &tStart));
+                }
                 NDPluginDriver::endProcessCallbacks(pArrayOut, true, true);
                 if (status) {
                     epicsSnprintf(errorMessage, sizeof(errorMessage)-1,
@@ -409,6 +444,171 @@ void NDPluginFile::freeCaptureBuffer(int numCapture)
     this->pCapture = NULL;
 }
 
+/** Starts the thread that writes NDArrays in Stream mode if NDFileWriteQueueSize is greater than 0.
+  * Plugins that write one array per file, or that take the file name from NDAttributes,
+  * always write synchronously. Called with the lock held when streaming starts. */
+void NDPluginFile::startWriteQueue()
+{
+    char poolName[MAX_FILENAME_LEN];
+
+    this->stopWriteQueue();
+    this->numWritesQueued = 0;
+    this->numWritesPending = 0;
+    this->numWritesFailed = 0;
+    this->writeLatencies.clear();
+    this->writeLatencyNext = 0;
+    this->writeLatencyUpdate.secPastEpoch = 0;
+    this->writeLatencyUpdate.nsec = 0;
+    setIntegerParam(NDFileWriteQueueUsed, 0);
+    setDoubleParam(NDFileWriteLatencyP50, 0.);
+    setDoubleParam(NDFileWriteLatencyP99, 0.);
+    setDoubleParam(NDFileWriteLatencyMax, 0.);
+
+    getIntegerParam(NDFileWriteQueueSize, &this->writeQueueSize);
+    if ((this->writeQueueSize <= 0) || !this->supportsMultipleArrays || this->useAttrFilePrefix) return;
+    epicsSnprintf(poolName, sizeof(poolName), "%s_write", this->portName);
+    this->pWritePool = new NDWorkerPool(poolName, 1);
+}
+
+/** Writes the NDArrays that are still queued and stops the write thread.
+  * Called with the lock held. */
+void NDPluginFile::stopWriteQueue()
+{
+    NDWorkerPool *pPool = this->pWritePool;
+
+    if (!pPool) return;
+    /* Arrays that queueWrite is waiting to queue are not written after this */
+    this->pWritePool = NULL;
+    this->unlock();
+    delete pPool;
+    this->lock();
+    setIntegerParam(NDFileWriteQueueUsed, 0);
+    this->updateWriteLatencies();
+}
+
+/** Waits until writeTask has written all of the NDArrays that have been queued.
+  * Called with the lock held. */
+void NDPluginFile::flushWriteQueue()
+{
+    NDWorkerPool *pPool = this->pWritePool;
+
+    if (!pPool) return;
+    this->unlock();
+    pPool->wait();
+    this->lock();
+}
+
+/** Queues an NDArray for writeTask.
+  * If NDFileWriteQueueSize arrays are already waiting this waits, with the lock released,
+  * until one of them has been written.
+  * \param[in] pArray The NDArray to write. */
+asynStatus NDPluginFile::queueWrite(NDArray *pArray)
+{
+    NDFileWriteJob_t *pJob;
+    static const char* functionName = "queueWrite";
+
+    while (this->pWritePool && (this->numWritesPending >= this->writeQueueSize)) {
+        this->unlock();
+        epicsEventWait(this->writeDoneEventId);
+        this->lock();
+    }
+    if (!this->pWritePool) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s streaming stopped, array not written\n",
+            driverName, functionName);
+        return asynError;
+    }
+    pArray->reserve();
+    pJob = new NDFileWriteJob_t;
+    pJob->pPlugin = this;
+    pJob->pArray = pArray;
+    this->numWritesQueued++;
+    this->numWritesPending++;
+    setIntegerParam(NDFileWriteQueueUsed, this->numWritesPending);
+    this->pWritePool->queue(writeTaskC, pJob);
+    return asynSuccess;
+}
+
+/** Writes an NDArray that was queued with queueWrite; runs in the write thread.
+  * Updates NDFileNumCaptured, the write queue and latency parameters, and reports errors.
+  * This is public only so that the C job function can call it.
+  * \param[in] pArray The NDArray to write; it is released when it has been written. */
+void NDPluginFile::writeTask(NDArray *pArray)
+{
+    int status;
+    int numCaptured;
+    char errorMessage[256];
+    epicsTimeStamp tStart, tEnd;
+    static const char* functionName = "writeTask";
+
+    epicsTimeGetCurrent(&tStart);
+    epicsMutexLock(this->fileMutexId);
+    status = this->writeFile(pArray);
+    epicsMutexUnlock(this->fileMutexId);
+    epicsTimeGetCurrent(&tEnd);
+    pArray->release();
+
+    this->lock();
+    this->recordWriteLatency(epicsTimeDiffInSeconds(&tEnd, &tStart));
+    this->numWritesPending--;
+    setIntegerParam(NDFileWriteQueueUsed, this->numWritesPending);
+    if (status) {
+        epicsSnprintf(errorMessage, sizeof(errorMessage)-1,
+                "Error writing file, status=%d", status);
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s %s\n",
+                driverName, functionName, errorMessage);
+        setIntegerParam(NDFileWriteStatus, NDFileWriteError);
+        setStringParam(NDFileWriteMessage, errorMessage);
+        this->numWritesFailed++;
+    } else {
+        getIntegerParam(NDFileNumCaptured, &numCaptured);
+        setIntegerParam(NDFileNumCaptured, numCaptured+1);
+    }
+    callParamCallbacks();
+    this->unlock();
+    epicsEventSignal(this->writeDoneEventId);
+}
+
+/** Adds the time taken to write one NDArray in Stream mode to the most recent NUM_WRITE_LATENCIES
+  * times. The latency percentile parameters are updated at most every WRITE_LATENCY_UPDATE_PERIOD
+  * seconds, so that the times are not sorted for every NDArray. Called with the lock held.
+  * \param[in] seconds The time taken by writeFile. */
+void NDPluginFile::recordWriteLatency(double seconds)
+{
+    epicsTimeStamp now;
+
+    if (this->writeLatencies.size() < NUM_WRITE_LATENCIES) {
+        this->writeLatencies.push_back(seconds);
+    } else {
+        this->writeLatencies[this->writeLatencyNext] = seconds;
+    }
+    this->writeLatencyNext = (this->writeLatencyNext + 1) % NUM_WRITE_LATENCIES;
+
+    epicsTimeGetCurrent(&now);
+    if (epicsTimeDiffInSeconds(&now, &this->writeLatencyUpdate) >= WRITE_LATENCY_UPDATE_PERIOD) {
+        this->updateWriteLatencies();
+        this->writeLatencyUpdate = now;
+    }
+}
+
+/** Sets the latency percentile parameters from the most recent write times.
+  * Called with the lock held. */
+void NDPluginFile::updateWriteLatencies()
+{
+    std::vector<double> sorted;
+    size_t n;
+
+    if (this->writeLatencies.empty()) return;
+    sorted = this->writeLatencies;
+    n = sorted.size();
+    std::nth_element(sorted.begin(), sorted.begin() + n/2, sorted.end());
+    setDoubleParam(NDFileWriteLatencyP50, 1000. * sorted[n/2]);
+    std::nth_element(sorted.begin(), sorted.begin() + (n*99)/100, sorted.end());
+    setDoubleParam(NDFileWriteLatencyP99, 1000. * sorted[(n*99)/100]);
+    setDoubleParam(NDFileWriteLatencyMax, 1000. * *std::max_element(sorted.begin(), sorted.end()));
+}
+
 /** Handles the logic for when NDFileCapture changes state, starting or stopping capturing or streaming NDArrays
   * to a file.
   * \param[in] capture Flag to start or stop capture; 1=start capture, 0=stop capture. */
@@ -480,12 +680,14 @@ asynStatus NDPluginFile::doCapture(int capture)
         case NDFileModeStream:
             if (capture) {
                 /* Streaming was just started */
+                this->startWriteQueue();
                 if (this->supportsMultipleArrays && !this->useAttrFilePrefix && !this->lazyOpen)
                     status = this->openFileBase(NDFileModeWrite | NDFileModeMultiple, pArray);
                 setIntegerParam(NDFileNumCaptured, 0);
                 setIntegerParam(NDWriteFile, 1);
             } else {
                 /* Streaming was just stopped */
+                this->stopWriteQueue();
                 if (this->supportsMultipleArrays)
                     status = this->closeFileBase();
                 setIntegerParam(NDFileCapture, 0);
@@ -778,7 +980,20 @@ void NDPluginFile::processCallbacks(NDArray *pArray)
             if (capture) {
                 arrayCounter++;
                 status = writeFileBase();
-                if (status == asynSuccess) {
+                if (this->pWritePool) {
+                    /* writeTask counts the arrays that have been written in NDFileNumCaptured.
+                     * When the arrays that are written or still queued would complete the capture,
+                     * wait for them, and keep capturing if any of them could not be written. */
+                    if ((numCapture > 0) &&
+                        (this->numWritesQueued - this->numWritesFailed >= numCapture)) {
+                        while (this->pWritePool && (this->numWritesPending > 0)) {
+                            this->unlock();
+                            epicsEventWait(this->writeDoneEventId);
+                            this->lock();
+                        }
+                    }
+                    getIntegerParam(NDFileNumCaptured, &numCaptured);
+                } else if (status == asynSuccess) {
                     numCaptured++;
                     setIntegerParam(NDFileNumCaptured, numCaptured);
                 }
@@ -918,11 +1133,13 @@ asynStatus NDPluginFile::writeNDArray(asynUser *pasynUser, void *genericPointer)
   * \param[in] priority The thread priority for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
   * \param[in] stackSize The stack size for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
   * \param[in] maxThreads The maximum number of threads this driver is allowed to use. If 0 then 1 will be used.
+  * \param[in] compressionAware true if the plugin can write compressed input arrays, false if not.
   */
 NDPluginFile::NDPluginFile(const char *portName, int queueSize, int blockingCallbacks, 
                            const char *NDArrayPort, int NDArrayAddr, int maxAddr,
                            int maxBuffers, size_t maxMemory, int interfaceMask, int interruptMask,
-                           int asynFlags, int autoConnect, int priority, int stackSize, int maxThreads)
+                           int asynFlags, int autoConnect, int priority, int stackSize, int maxThreads,
+                           bool compressionAware)
 
     /* Invoke the base class constructor.
      * We allocate 1 NDArray of unlimited size in the NDArray pool.
@@ -930,8 +1147,8 @@ NDPluginFile::NDPluginFile(const char *portName, int queueSize, int blockingCall
      * Set autoconnect to 1.  priority and stacksize can be 0, which will use defaults. */
     : NDPluginDriver(portName, queueSize, blockingCallbacks, 
                      NDArrayPort, NDArrayAddr, maxAddr, maxBuffers, maxMemory, 
-                     asynGenericPointerMask, asynGenericPointerMask,
-                     asynFlags, autoConnect, priority, stackSize, maxThreads),
+                     interfaceMask | asynGenericPointerMask, interruptMask | asynGenericPointerMask,
+                     asynFlags, autoConnect, priority, stackSize, maxThreads, compressionAware),
     pCapture(NULL), captureBufferSize(0)
 {
     //static const char *functionName = "NDPluginFile";
@@ -941,6 +1158,15 @@ NDPluginFile::NDPluginFile(const char *portName, int queueSize, int blockingCall
 
     this->useAttrFilePrefix = false;
     this->fileMutexId = epicsMutexCreate();
+    this->pWritePool = NULL;
+    this->writeDoneEventId = epicsEventCreate(epicsEventEmpty);
+    this->writeQueueSize = 0;
+    this->numWritesQueued = 0;
+    this->numWritesPending = 0;
+    this->numWritesFailed = 0;
+    this->writeLatencyNext = 0;
+    this->writeLatencyUpdate.secPastEpoch = 0;
+    this->writeLatencyUpdate.nsec = 0;
     /* Set the plugin type string */    
     setStringParam(NDPluginDriverPluginType, "NDPluginFile");
 
@@ -951,3 +1177,11 @@ NDPluginFile::NDPluginFile(const char *portName, int queueSize, int blockingCall
     /* Try to connect to the NDArray port */
     connectToArrayPort();
 }
+
+NDPluginFile::~NDPluginFile()
+{
+    /* Stop the write thread before the event that it signals is destroyed */
+    delete this->pWritePool;
+    epicsEventDestroy(this->writeDoneEventId);
+    epicsMutexDestroy(this->fileMutexId);
+}
@@ -1,8 +1,12 @@
 #ifndef NDPluginFile_H
 #define NDPluginFile_H
 
+#include <vector>
+
 #include <epicsTypes.h>
 #include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
 
 #include "NDPluginDriver.h"
 
@@ -16,6 +20,8 @@
 #define NDFileModeMultiple 0x08
 typedef int NDFileOpenMode_t;
 
+class NDWorkerPool;
+
 #define FILEPLUGIN_NAME        "FilePluginFileName"
 #define FILEPLUGIN_NUMBER      "FilePluginFileNumber"
 #define FILEPLUGIN_DESTINATION "FilePluginDestination"
@@ -30,7 +36,9 @@ public:
     NDPluginFile(const char *portName, int queueSize, int blockingCallbacks, 
                  const char *NDArrayPort, int NDArrayAddr, int maxAddr,
                  int maxBuffers, size_t maxMemory, int interfaceMask, int interruptMask,
-                 int asynFlags, int autoConnect, int priority, int stackSize, int maxThreads);
+                 int asynFlags, int autoConnect, int priority, int stackSize, int maxThreads,
+                 bool compressionAware = false);
+    virtual ~NDPluginFile();
                  
     /* These methods override those in the base class */
     virtual void processCallbacks(NDArray *pArray);
@@ -61,6 +69,8 @@ public:
     /** Close the file opened with NDPluginFile::openFile; 
       * pure virtual function that must be implemented by derived classes. */ 
     virtual asynStatus closeFile() = 0;
+
+    void writeTask(NDArray *pArray);
     
     int supportsMultipleArrays; /**< Derived classes must set this flag to 0/1 if they cannot/can write 
                                   * multiple NDArrays to a single file. Used in capture and stream modes. */
@@ -78,6 +88,12 @@ private:
     bool attrIsProcessingRequired(NDAttributeList* pAttrList);
     void registerInitFrameInfo(NDArray *pArray); /**< Grab a copy of the NDArrayInfo_t structure for future reference */
     bool isFrameValid(NDArray *pArray); /**< Compare pArray dimensions and datatype against latched NDArrayInfo_t structure */
+    void startWriteQueue();
+    void stopWriteQueue();
+    void flushWriteQueue();
+    asynStatus queueWrite(NDArray *pArray);
+    void recordWriteLatency(double seconds);
+    void updateWriteLatencies();
 
     NDArray **pCapture;
     int captureBufferSize;
@@ -86,6 +102,15 @@ private:
     bool lazyOpen;
     NDArrayInfo_t *ndArrayInfoInit; /**< The NDArray information at file open time.
                                       *  Used to check against changes in incoming frames dimensions or datatype */
+    NDWorkerPool *pWritePool;         /**< Thread that writes NDArrays in Stream mode; NULL when writing synchronously */
+    epicsEventId writeDoneEventId;    /**< Signalled by writeTask after each NDArray is written */
+    int writeQueueSize;               /**< Maximum value of numWritesPending, latched when streaming starts */
+    int numWritesQueued;              /**< Number of NDArrays queued for writeTask since streaming started */
+    int numWritesPending;             /**< Number of NDArrays queued for or being written by writeTask */
+    int numWritesFailed;              /**< Number of NDArrays that writeTask failed to write since streaming started */
+    std::vector<double> writeLatencies; /**< Most recent Stream mode write times in seconds */
+    size_t writeLatencyNext;
+    epicsTimeStamp writeLatencyUpdate; /**< Time that the latency parameters were last updated */
 };
 
 #endif
@@ -13,7 +13,9 @@
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
+#include <epicsEvent.h>
 #include <epicsTime.h>
+#include <epicsStdio.h>
 #include <iocsh.h>
 
 #include <asynDriver.h>
@@ -24,6 +26,13 @@
 
 static const char *driverName="NDPluginGather";
 
+static void mergeTaskC(void *drvPvt)
+{
+    NDPluginGather *pPvt = (NDPluginGather *)drvPvt;
+
+    pPvt->mergeTask();
+}
+
 /** Constructor for NDPluginGather; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   *
   * \param[in] portName The name of the asyn port driver to be created.
@@ -51,16 +60,35 @@ NDPluginGather::NDPluginGather(const char *portName, int queueSize, int blocking
                    asynInt32Mask | asynFloat64Mask | asynGenericPointerMask,
                    asynInt32Mask | asynFloat64Mask | asynGenericPointerMask,
                    ASYN_MULTIDEVICE, 1, priority, stackSize, 1),
-    maxPorts_(maxPorts)
+    maxPorts_(maxPorts), numQueued_(0), nextUniqueId_(0), mergeStarted_(false), mergeThreadId_(0),
+    mergeExit_(false)
 {
     int i;
     NDGatherNDArraySource_t *pArraySrc;
     //static const char *functionName = "NDPluginGather";
 
+    createParam(NDPluginGatherModeString,        asynParamInt32,   &NDPluginGatherMode);
+    createParam(NDPluginGatherQueueSizeString,   asynParamInt32,   &NDPluginGatherQueueSize);
+    createParam(NDPluginGatherTimeoutString,     asynParamFloat64, &NDPluginGatherTimeout);
+    createParam(NDPluginGatherQueuedString,      asynParamInt32,   &NDPluginGatherQueued);
+    createParam(NDPluginGatherMissingString,     asynParamInt32,   &NDPluginGatherMissing);
+    createParam(NDPluginGatherLateString,        asynParamInt32,   &NDPluginGatherLate);
+
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginGather");
+
+    setIntegerParam(NDPluginGatherMode, NDGatherUnordered);
+    setIntegerParam(NDPluginGatherQueueSize, queueSize > 0 ? queueSize : 1);
+    setDoubleParam(NDPluginGatherTimeout, 1.0);
+    setIntegerParam(NDPluginGatherQueued, 0);
+    setIntegerParam(NDPluginGatherMissing, 0);
+    setIntegerParam(NDPluginGatherLate, 0);
+    epicsTimeGetCurrent(&lastOutputTime_);
+    mergeWakeEvent_ = epicsEventMustCreate(epicsEventEmpty);
+    mergeExitEvent_ = epicsEventMustCreate(epicsEventEmpty);
     
     if (maxPorts_ < 1) maxPorts_ = 1;
+    queues_.resize(maxPorts_);
     NDArraySrc_ = (NDGatherNDArraySource_t *)calloc(sizeof(NDGatherNDArraySource_t), maxPorts_);
     pArraySrc = NDArraySrc_;
     for (i=0; i<maxPorts_; i++, pArraySrc++) {
@@ -71,6 +99,35 @@ NDPluginGather::NDPluginGather(const char *portName, int queueSize, int blocking
     }
 }
 
+/** Destructor; stops the callbacks from the sources and the merge thread, and releases the arrays
+  * that are held for ordering.  It must be called with the lock released. */
+NDPluginGather::~NDPluginGather()
+{
+    int source;
+    NDArray *pArray;
+
+    setArrayInterrupt(0);
+    if (mergeThreadId_ != 0) {
+        this->lock();
+        mergeExit_ = true;
+        this->unlock();
+        epicsEventSignal(mergeWakeEvent_);
+        epicsEventWait(mergeExitEvent_);
+    }
+    this->lock();
+    for (source=0; source<maxPorts_; source++) {
+        while (!queues_[source].empty()) {
+            pArray = queues_[source].front().pArray;
+            queues_[source].pop_front();
+            pArray->pDriver->decrementQueuedArrayCount();
+            pArray->release();
+        }
+    }
+    numQueued_ = 0;
+    this->unlock();
+    epicsEventDestroy(mergeWakeEvent_);
+    epicsEventDestroy(mergeExitEvent_);
+}
 
 extern "C" {static void driverCallback(void *drvPvt, asynUser *pasynUser, void *genericPointer)
 {
@@ -95,6 +152,245 @@ void NDPluginGather::processCallbacks(NDArray *pArray)
     NDPluginDriver::endProcessCallbacks(pArray, true, true);
 }
 
+/** Method that is called from the upstream plugins with a new NDArray.
+  * In NDGatherUnordered mode this calls NDPluginDriver::driverCallback.
+  * In NDGatherOrdered mode the array is added to the queue for the source it came from,
+  * and mergeArrays() passes on the arrays that are ready, in uniqueId order, without copying them.
+  * These arrays do not go through the plugin input queue, so BlockingCallbacks and QueueSize
+  * do not apply; GATHER_QUEUE_SIZE limits the number of arrays held for each source.
+  * \param[in] pasynUser  The pasynUser from the asyn client.
+  * \param[in] genericPointer The pointer to the NDArray */ 
+void NDPluginGather::driverCallback(asynUser *pasynUser, void *genericPointer)
+{
+    NDArray *pArray = (NDArray *)genericPointer;
+    epicsTimeStamp now;
+    NDGatherQueuedArray_t queued;
+    int mode;
+    int source;
+    int queueSize;
+    double timeout;
+    int droppedArrays;
+    int lateArrays;
+    static const char *functionName = "driverCallback";
+
+    this->lock();
+    getIntegerParam(NDPluginGatherMode, &mode);
+    for (source=0; source<maxPorts_; source++) {
+        if (NDArraySrc_[source].pasynUserGenericPointer == pasynUser) break;
+    }
+    /* Arrays from ProcessPlugin do not come from a source */
+    if ((mode != NDGatherOrdered) || (source == maxPorts_)) {
+        this->unlock();
+        NDPluginDriver::driverCallback(pasynUser, genericPointer);
+        return;
+    }
+
+    this->pNDArrayPool = pArray->pNDArrayPool;
+    getIntegerParam(NDPluginGatherQueueSize, &queueSize);
+    getDoubleParam(NDPluginGatherTimeout, &timeout);
+    epicsTimeGetCurrent(&now);
+
+    if (mergeStarted_ && (pArray->uniqueId < nextUniqueId_)) {
+        /* An array far behind the output, or one that arrives after a pause, starts a new sequence,
+         * for example because ArrayCounter was reset.  Otherwise it arrived too late to be output in order. */
+        if ((nextUniqueId_ - pArray->uniqueId > maxPorts_ * queueSize) ||
+            ((numQueued_ == 0) && (epicsTimeDiffInSeconds(&now, &lastOutputTime_) > timeout))) {
+            mergeArrays(true);
+            mergeStarted_ = false;
+        } else {
+            getIntegerParam(NDPluginGatherLate, &lateArrays);
+            lateArrays++;
+            setIntegerParam(NDPluginGatherLate, lateArrays);
+            asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+                "%s::%s array arrived after uniqueId=%d was output, dropped array uniqueId=%d\n",
+                driverName, functionName, nextUniqueId_-1, pArray->uniqueId);
+            pasynUser->auxStatus = asynOverflow;
+            callParamCallbacks();
+            this->unlock();
+            return;
+        }
+    }
+
+    if ((int)queues_[source].size() >= queueSize) {
+        getIntegerParam(NDPluginDriverDroppedArrays, &droppedArrays);
+        droppedArrays++;
+        setIntegerParam(NDPluginDriverDroppedArrays, droppedArrays);
+        asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+            "%s::%s queue for source %d full, dropped array uniqueId=%d\n",
+            driverName, functionName, source, pArray->uniqueId);
+        pasynUser->auxStatus = asynOverflow;
+        callParamCallbacks();
+        this->unlock();
+        return;
+    }
+
+    pasynUser->auxStatus = asynSuccess;
+    pArray->reserve();
+    pArray->pDriver->incrementQueuedArrayCount();
+    queued.pArray = pArray;
+    queued.arrivalTime = now;
+    queues_[source].push_back(queued);
+    numQueued_++;
+    mergeArrays(false);
+    callParamCallbacks();
+    this->unlock();
+}
+
+/** Passes on the queued arrays that are ready, in uniqueId order.  Called with the lock held.
+  * The sources are expected to deliver arrays in increasing uniqueId order.  The array with the lowest
+  * uniqueId at the head of the queues is ready if it is the next uniqueId, or if every connected source
+  * has an array queued, since then no source can still deliver a lower uniqueId.  Otherwise it is output once
+  * the oldest queued array has waited for GATHER_TIMEOUT, and the uniqueIds skipped are counted in GATHER_MISSING_ARRAYS.
+  * \param[in] flush If true all queued arrays are passed on */
+void NDPluginGather::mergeArrays(bool flush)
+{
+    epicsTimeStamp now;
+    epicsTimeStamp *pOldest;
+    double timeout;
+    int missingArrays;
+    int source, minSource;
+    int uniqueId;
+    bool allQueued;
+    NDArray *pArray;
+    static const char *functionName = "mergeArrays";
+
+    getDoubleParam(NDPluginGatherTimeout, &timeout);
+    epicsTimeGetCurrent(&now);
+    while (numQueued_ > 0) {
+        minSource = -1;
+        allQueued = true;
+        pOldest = NULL;
+        for (source=0; source<maxPorts_; source++) {
+            if (queues_[source].empty()) {
+                if (NDArraySrc_[source].connectedToArrayPort) allQueued = false;
+                continue;
+            }
+            NDGatherQueuedArray_t& head = queues_[source].front();
+            if ((minSource < 0) || (head.pArray->uniqueId < queues_[minSource].front().pArray->uniqueId)) {
+                minSource = source;
+            }
+            if (!pOldest || epicsTimeLessThan(&head.arrivalTime, pOldest)) {
+                pOldest = &head.arrivalTime;
+            }
+        }
+        pArray = queues_[minSource].front().pArray;
+        uniqueId = pArray->uniqueId;
+        if (!flush && 
+            !(mergeStarted_ && (uniqueId <= nextUniqueId_)) &&
+            !allQueued &&
+            (epicsTimeDiffInSeconds(&now, pOldest) < timeout)) break;
+        if (mergeStarted_ && (uniqueId > nextUniqueId_)) {
+            getIntegerParam(NDPluginGatherMissing, &missingArrays);
+            missingArrays += uniqueId - nextUniqueId_;
+            setIntegerParam(NDPluginGatherMissing, missingArrays);
+            asynPrint(pasynUserSelf, ASYN_TRACE_WARNING, 
+                "%s::%s skipped uniqueId=%d to %d\n",
+                driverName, functionName, nextUniqueId_, uniqueId-1);
+        }
+        queues_[minSource].pop_front();
+        numQueued_--;
+        nextUniqueId_ = uniqueId + 1;
+        mergeStarted_ = true;
+        lastOutputTime_ = now;
+        outputArray(pArray);
+    }
+    setIntegerParam(NDPluginGatherQueued, numQueued_);
+}
+
+/** Does the callbacks for an array that was held for ordering and releases it.  Called with the lock held.
+  * The array is passed on without copying unless this plugin has NDAttributes of its own,
+  * which must not be added to an array that other plugins may also be using.
+  * \param[in] pArray  The NDArray; the reference taken in driverCallback is passed on or released. */
+void NDPluginGather::outputArray(NDArray *pArray)
+{
+    asynNDArrayDriver *pDriver = pArray->pDriver;
+
+    NDPluginDriver::beginProcessCallbacks(pArray);
+    if (this->pAttributeList->count() > 0) {
+        NDPluginDriver::endProcessCallbacks(pArray, true, true);
+        pArray->release();
+    } else {
+        NDPluginDriver::endProcessCallbacks(pArray, false, false);
+    }
+    pDriver->decrementQueuedArrayCount();
+}
+
+/** Thread that passes on queued arrays once they have waited for GATHER_TIMEOUT,
+  * so that they are output even if no more arrays arrive.  It exits when the destructor sets mergeExit_. */
+void NDPluginGather::mergeTask()
+{
+    double timeout;
+
+    lock();
+    while (!mergeExit_) {
+        getDoubleParam(NDPluginGatherTimeout, &timeout);
+        unlock();
+        epicsEventWaitWithTimeout(mergeWakeEvent_, timeout > 0.002 ? timeout/2. : 0.001);
+        lock();
+        if (!mergeExit_ && (numQueued_ > 0)) {
+            mergeArrays(false);
+            callParamCallbacks();
+        }
+    }
+    unlock();
+    epicsEventSignal(mergeExitEvent_);
+}
+
+/** Creates the thread that runs mergeTask() if it does not already exist. */
+asynStatus NDPluginGather::createMergeThread()
+{
+    char taskName[256];
+    static const char *functionName = "createMergeThread";
+
+    if (mergeThreadId_ != 0) return asynSuccess;
+
+    epicsSnprintf(taskName, sizeof(taskName)-1, "%s_Plugin_Merge", portName);
+    mergeThreadId_ = epicsThreadCreate(taskName,
+                                       this->threadPriority_,
+                                       this->threadStackSize_,
+                                       (EPICSTHREADFUNC)mergeTaskC, this);
+    if (mergeThreadId_ == 0) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error creating merge thread\n",
+            driverName, functionName);
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+/** Called when asyn clients call pasynInt32->write().
+  * This function performs actions for some parameters, including GATHER_MODE.
+  * Leaving NDGatherOrdered mode passes on all queued arrays.
+  * For other parameters it calls NDPluginDriver::writeInt32.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[in] value Value to write. */
+asynStatus NDPluginGather::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    int function = pasynUser->reason;
+    asynStatus status = asynSuccess;
+    static const char *functionName = "writeInt32";
+
+    if (function < FIRST_NDPLUGIN_GATHER_PARAM) {
+        return NDPluginDriver::writeInt32(pasynUser, value);
+    }
+
+    setIntegerParam(function, value);
+    if (function == NDPluginGatherMode) {
+        if (value == NDGatherOrdered) {
+            status = createMergeThread();
+        } else {
+            mergeArrays(true);
+            mergeStarted_ = false;
+        }
+    }
+    callParamCallbacks();
+    if (status) 
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, 
+              "%s::%s ERROR, status=%d, function=%d, value=%d\n", 
+              driverName, functionName, status, function, value);
+    return status;
+}
+
 /** Register or unregister to receive asynGenericPointer (NDArray) callbacks from the driver.
   * Note: this function must be called with the lock released, otherwise a deadlock can occur
   * in the call to cancelInterruptUser.
@@ -2,9 +2,26 @@
 #define NDPluginGather_H
 
 #include <set>
+#include <deque>
+#include <vector>
+
+#include <epicsEvent.h>
 
 #include "NDPluginDriver.h"
 
+/** Order in which NDArrays are passed to downstream plugins */
+typedef enum {
+    NDGatherUnordered,  /**< In the order they arrive */
+    NDGatherOrdered     /**< In uniqueId order, merging the arrays from all sources */
+} NDGatherMode_t;
+
+#define NDPluginGatherModeString       "GATHER_MODE"           /* (asynInt32,   r/w) Unordered or ordered merge */
+#define NDPluginGatherQueueSizeString  "GATHER_QUEUE_SIZE"     /* (asynInt32,   r/w) Maximum arrays held for each source in ordered mode */
+#define NDPluginGatherTimeoutString    "GATHER_TIMEOUT"        /* (asynFloat64, r/w) Time to wait for a missing uniqueId (seconds) */
+#define NDPluginGatherQueuedString     "GATHER_QUEUED"         /* (asynInt32,   r/o) Arrays currently held for ordering */
+#define NDPluginGatherMissingString    "GATHER_MISSING_ARRAYS" /* (asynInt32,   r/w) Number of uniqueIds that were skipped */
+#define NDPluginGatherLateString       "GATHER_LATE_ARRAYS"    /* (asynInt32,   r/w) Arrays dropped because a later uniqueId was already output */
+
 typedef struct {
     void *asynGenericPointerInterruptPvt;        /**< InterruptPvt for connecting to NDArray driver interupts */
     asynUser *pasynUserGenericPointer;           /**< asynUser for connecting to NDArray driver */
@@ -13,6 +30,12 @@ typedef struct {
     bool connectedToArrayPort;
 } NDGatherNDArraySource_t;
 
+/** An NDArray held for ordering and the time it arrived */
+typedef struct {
+    NDArray *pArray;
+    epicsTimeStamp arrivalTime;
+} NDGatherQueuedArray_t;
+
 /** A plugin that subscribes to callbacks from multiple ports, not just a single port  */
 class epicsShareClass NDPluginGather : public NDPluginDriver {
 public:
@@ -20,6 +43,14 @@ public:
                    int maxPorts, 
                    int maxBuffers, size_t maxMemory,
                    int priority, int stackSize);
+    virtual ~NDPluginGather();
+
+    /* These methods override the virtual methods in the base class */
+    virtual void driverCallback(asynUser *pasynUser, void *genericPointer);
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+
+    /* These methods are new to this class */
+    void mergeTask();
 
 protected:
     /* These methods override the virtual methods in the base class */
@@ -27,10 +58,30 @@ protected:
     virtual asynStatus connectToArrayPort(void);    
     virtual asynStatus setArrayInterrupt(int connect);
 
+    int NDPluginGatherMode;
+    #define FIRST_NDPLUGIN_GATHER_PARAM NDPluginGatherMode
+    int NDPluginGatherQueueSize;
+    int NDPluginGatherTimeout;
+    int NDPluginGatherQueued;
+    int NDPluginGatherMissing;
+    int NDPluginGatherLate;
                                 
 private:
+    void mergeArrays(bool flush);
+    void outputArray(NDArray *pArray);
+    asynStatus createMergeThread();
+
     int maxPorts_;
     NDGatherNDArraySource_t *NDArraySrc_;
+    std::vector<std::deque<NDGatherQueuedArray_t> > queues_;  /* Arrays held for ordering, one queue per source */
+    int numQueued_;
+    int nextUniqueId_;               /* uniqueId expected next in ordered mode */
+    bool mergeStarted_;              /* False until the first array of a sequence has been output */
+    epicsTimeStamp lastOutputTime_;
+    epicsThreadId mergeThreadId_;
+    bool mergeExit_;                 /* Set by the destructor to stop the merge thread */
+    epicsEventId mergeWakeEvent_;    /* Wakes the merge thread early when it must exit */
+    epicsEventId mergeExitEvent_;    /* Signalled by the merge thread when it exits */
 };
     
 #endif
@@ -37,6 +37,69 @@
 
 static const char *driverName="NDPluginOverlay";
 
+/* The fonts are pre-rasterized into runs of set pixels in each row of each glyph, so text is drawn
+ * as spans rather than by testing the font bitmap one bit at a time for every frame. */
+typedef struct {
+  unsigned char start;
+  unsigned char length;
+} NDOverlayGlyphRun_t;
+
+typedef struct {
+  int width;
+  int height;
+  std::vector<int> rowStart;              /* Runs for row r of glyph g are runs[rowStart[g*height+r]] to runs[rowStart[g*height+r+1]-1] */
+  std::vector<NDOverlayGlyphRun_t> runs;
+} NDOverlayGlyphAtlas_t;
+
+/* The fonts contain the characters 32-126 and 160-255 */
+#define NUM_GLYPHS (95 + 96)
+
+static std::vector<NDOverlayGlyphAtlas_t> glyphAtlases;
+static epicsThreadOnceId glyphAtlasOnceId = EPICS_THREAD_ONCE_INIT;
+
+static int glyphIndex(unsigned char c)
+{
+  if ((c >= 32) && (c <= 126)) return c - 32;
+  if (c >= 160) return c - 160 + 95;
+  return -1;
+}
+
+static void buildGlyphAtlases(void *)
+{
+  int font, glyph, row, ib, start;
+  int bpc;    // bytes per row of a character, ie, 1 for 6x13 font, 2 for 9x15 font
+  const unsigned char *pRow;
+  NDPluginOverlayTextFontBitmapType *bmp;
+  NDOverlayGlyphRun_t run;
+
+  glyphAtlases.resize(NDPluginOverlayTextFontBitmapTypeN);
+  for (font=0; font<NDPluginOverlayTextFontBitmapTypeN; font++) {
+    NDOverlayGlyphAtlas_t *pAtlas = &glyphAtlases[font];
+    bmp = &NDPluginOverlayTextFontBitmaps[font];
+    bpc = bmp->width / 8 + 1;
+    pAtlas->width = bmp->width;
+    pAtlas->height = bmp->height;
+    for (glyph=0; glyph<NUM_GLYPHS; glyph++) {
+      for (row=0; row<bmp->height; row++) {
+        pAtlas->rowStart.push_back((int)pAtlas->runs.size());
+        pRow = &bmp->bitmap[(bmp->height*glyph + row)*bpc];
+        for (ib=0; ib<bmp->width; ) {
+          if (!(pRow[ib/8] & (0x80 >> (ib%8)))) {
+            ib++;
+            continue;
+          }
+          start = ib;
+          while ((ib < bmp->width) && (pRow[ib/8] & (0x80 >> (ib%8)))) ib++;
+          run.start = (unsigned char)start;
+          run.length = (unsigned char)(ib - start);
+          pAtlas->runs.push_back(run);
+        }
+      }
+    }
+    pAtlas->rowStart.push_back((int)pAtlas->runs.size());
+  }
+}
+
 void NDPluginOverlay::addPixel(NDOverlay_t *pOverlay, int ix, int iy, NDArrayInfo_t *pArrayInfo)
 {
   if ((ix >= 0) && (ix < (int)pArrayInfo->xSize) &&
@@ -44,6 +107,29 @@ void NDPluginOverlay::addPixel(NDOverlay_t *pOverlay, int ix, int iy, NDArrayInf
     pOverlay->pvt.addressOffset.push_back((int)(iy*pArrayInfo->yStride) + (int)(ix*pArrayInfo->xStride));
 }
 
+/** Adds the pixels ixmin to ixmax (inclusive) of row iy, clipped to the array, to the overlay spans */
+void NDPluginOverlay::addSpan(NDOverlay_t *pOverlay, int ixmin, int ixmax, int iy, NDArrayInfo_t *pArrayInfo)
+{
+  NDOverlaySpan_t span;
+
+  if ((iy < 0) || (iy >= (int)pArrayInfo->ySize)) return;
+  ixmin = MAX(ixmin, 0);
+  ixmax = MIN(ixmax, (int)pArrayInfo->xSize-1);
+  if (ixmin > ixmax) return;
+  span.offset = (int)(iy*pArrayInfo->yStride) + (int)(ixmin*pArrayInfo->xStride);
+  span.count = ixmax - ixmin + 1;
+  pOverlay->pvt.numPixels += span.count;
+  // Extend the previous span if this one follows it in memory
+  if (!pOverlay->pvt.spans.empty()) {
+    NDOverlaySpan_t *pLast = &pOverlay->pvt.spans.back();
+    if (pLast->offset + pLast->count*(int)pArrayInfo->xStride == span.offset) {
+      pLast->count += span.count;
+      return;
+    }
+  }
+  pOverlay->pvt.spans.push_back(span);
+}
+
 template <typename epicsType>
 void NDPluginOverlay::setPixel(epicsType *pValue, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
 {
@@ -73,185 +159,199 @@ void NDPluginOverlay::setPixel(epicsType *pValue, NDOverlay_t *pOverlay, NDArray
 }
 
 
-
-template <typename epicsType>
-void NDPluginOverlay::doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
+/** Computes the spans of pixels that an overlay covers.
+  * The spans are kept from one array to the next, and are only recomputed if the overlay,
+  * the array dimensions or the text to be drawn have changed.
+  * This does not depend on the data type, and does not access the array data.
+  */
+void NDPluginOverlay::computeSpans(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
 {
-  int xmin, xmax, ymin, ymax, xcent, ycent, xsize, ysize, ix, iy, ii, jj, ib;
-  int xwide, ywide, xwidemax_line, xwidemin_line;
+  int xmin, xmax, ymin, ymax, xcent, ycent, xsize, ysize, ix, iy, ii, jj, ir;
+  int xwide, ywide;
   std::vector<int>::iterator it;
   int nSteps;
   double theta, thetaStep;
-  epicsType *pData=(epicsType *)pArray->pData;
   char textOutStr[512];                    // our string, maybe with a time stamp, to place into the image array
-  char *cp;                                // character pointer to current character being rendered
-  int bmc;                                 // current byte in the font bitmap
-  int mask;                                // selects the bit in bmc to look at
+  const unsigned char *cp;                 // character pointer to current character being rendered
   char tstr[64];                           // Used to build the time string
-  NDPluginOverlayTextFontBitmapType *bmp;  // pointer to our font information (bitmap pointer, perhaps misnamed)
-  int bpc;                                 // bytes per char, ie, 1 for 6x13 font, 2 for 9x15 font
-  int sbc;                                 // "sub" byte counter to keep track of which byte we are looking at for multi byte fonts
-  //static const char *functionName = "doOverlayT";
+  NDOverlayGlyphAtlas_t *pAtlas;           // pre-rasterized font
+  const NDOverlayGlyphRun_t *pRun;
+  int glyph;
 
   asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-    "NDPluginOverlay::DoOverlayT, shape=%d, Xpos=%d, Ypos=%d, Xsize=%d, Ysize=%d\n",
+    "NDPluginOverlay::computeSpans, shape=%d, Xpos=%d, Ypos=%d, Xsize=%d, Ysize=%d\n",
     pOverlay->shape, (int)pOverlay->PositionX, (int)pOverlay->PositionY, 
     (int)pOverlay->SizeX, (int)pOverlay->SizeY);
 
-  if (pOverlay->pvt.changed) {
-    pOverlay->pvt.addressOffset.clear();
-
-    switch(pOverlay->shape) {
-      case NDOverlayCross:
-        xcent = pOverlay->PositionX + pOverlay->SizeX/2;
-        ycent = pOverlay->PositionY + pOverlay->SizeY/2;
-        xmin = xcent - pOverlay->SizeX/2;
-        xmax = xcent + pOverlay->SizeX/2;
-        ymin = ycent - pOverlay->SizeY/2;
-        ymax = ycent + pOverlay->SizeY/2;
-        xwide = pOverlay->WidthX / 2;
-        ywide = pOverlay->WidthY / 2;
-
-        for (iy=ymin; iy<=ymax; iy++) {
-          if ((iy >= (ycent - ywide)) && (iy <= ycent + ywide)) {
-            for (ix=xmin; ix<=xmax; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          } else {
-            xwidemin_line = xcent - xwide;
-            xwidemax_line = xcent + xwide;
-            for (ix=xwidemin_line; ix<=xwidemax_line; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          }
-        }
-        break;
-
-      case NDOverlayRectangle:
-        xmin = pOverlay->PositionX;
-        xmax = pOverlay->PositionX + pOverlay->SizeX;
-        ymin = pOverlay->PositionY;
-        ymax = pOverlay->PositionY + pOverlay->SizeY;
-        xwide = pOverlay->WidthX;
-        ywide = pOverlay->WidthY;
-        xwide = MIN(xwide, (int)pOverlay->SizeX-1);
-        ywide = MIN(ywide, (int)pOverlay->SizeY-1);
-
-        //For non-zero width, grow the rectangle towards the center.
-        for (iy=ymin; iy<=ymax; iy++) {
-          if ((iy < (ymin + ywide)) || 
-              (iy > (ymax - ywide))) {
-            for (ix=xmin; ix<=xmax; ix++) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          } else {
-            for (ix=xmin; ix<(xmin+xwide); ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-            for (ix=(xmax-xwide+1); ix<=xmax; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          }
-        }
-        break;
-
-      case NDOverlayEllipse:
-        xwide = pOverlay->WidthX;
-        ywide = pOverlay->WidthY;
-        xwide = MIN(xwide, (int)pOverlay->SizeX-1);
-        ywide = MIN(ywide, (int)pOverlay->SizeY-1);
-        xcent = pOverlay->PositionX + pOverlay->SizeX/2;
-        ycent = pOverlay->PositionY + pOverlay->SizeY/2;
-        xsize = pOverlay->SizeX/2;
-        ysize = pOverlay->SizeY/2;
-        xmax = (int)(pArrayInfo->xSize-1);
-        ymax = (int)(pArrayInfo->ySize-1);
-
-        // Use the parametric equation for an ellipse.  
-        // Only need to compute 0 to pi/2, other quadrants by symmetry
-        // Make 2*(xsize + ysize) angle points
-        nSteps = 2*(xsize + ysize);
-        thetaStep = M_PI / 2. / nSteps;
-        for (ii=0, theta=0.; ii<=nSteps; ii++, theta+=thetaStep) {
-          for (jj=0; jj<xwide; jj++) {
-            ix = (int)((xsize-jj) * cos(theta) + 0.5);
-            iy = (int)((ysize-jj) * sin(theta) + 0.5);
-            addPixel(pOverlay, (xcent + ix), (ycent + iy), pArrayInfo);
-            addPixel(pOverlay, (xcent + ix), (ycent - iy), pArrayInfo);
-            addPixel(pOverlay, (xcent - ix), (ycent + iy), pArrayInfo);
-            addPixel(pOverlay, (xcent - ix), (ycent - iy), pArrayInfo);
-          }
-        }
-        // There may be duplicate pixels in the address list.  
-        // We must remove them or the XOR draw mode won't work because the pixel will be set and then unset
-        std::sort(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
-        it = std::unique(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
-        pOverlay->pvt.addressOffset.resize(std::distance(pOverlay->pvt.addressOffset.begin(), it));
-        break;
-
-      case NDOverlayText:
-        if ((pOverlay->Font >= 0) && (pOverlay->Font < NDPluginOverlayTextFontBitmapTypeN)) {
-          bmp = &NDPluginOverlayTextFontBitmaps[pOverlay->Font];
+  if (pOverlay->shape == NDOverlayText) {
+    if (strlen(pOverlay->TimeStampFormat) > 0) {
+      epicsTimeToStrftime(tstr, sizeof(tstr)-1, pOverlay->TimeStampFormat, &pArray->epicsTS);
+      epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s%s", pOverlay->DisplayText, tstr);
+    } else {
+      epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s", pOverlay->DisplayText);
+    }
+    textOutStr[sizeof(textOutStr)-1] = 0;
+    // The time stamp usually changes much less often than arrays arrive
+    if (pOverlay->pvt.text != textOutStr) {
+      pOverlay->pvt.text = textOutStr;
+      pOverlay->pvt.changed = true;
+    }
+  }
+
+  if (!pOverlay->pvt.changed) return;
+
+  pOverlay->pvt.addressOffset.clear();
+  pOverlay->pvt.spans.clear();
+  pOverlay->pvt.numPixels = 0;
+
+  switch(pOverlay->shape) {
+    case NDOverlayCross:
+      xcent = pOverlay->PositionX + pOverlay->SizeX/2;
+      ycent = pOverlay->PositionY + pOverlay->SizeY/2;
+      xmin = xcent - pOverlay->SizeX/2;
+      xmax = xcent + pOverlay->SizeX/2;
+      ymin = ycent - pOverlay->SizeY/2;
+      ymax = ycent + pOverlay->SizeY/2;
+      xwide = pOverlay->WidthX / 2;
+      ywide = pOverlay->WidthY / 2;
+
+      for (iy=ymin; iy<=ymax; iy++) {
+        if ((iy >= (ycent - ywide)) && (iy <= ycent + ywide)) {
+          addSpan(pOverlay, xmin, xmax, iy, pArrayInfo);
         } else {
-          // Really, no reason to go on if the font is ill defined
-          return;
+          addSpan(pOverlay, xcent - xwide, xcent + xwide, iy, pArrayInfo);
         }
+      }
+      break;
 
-        bpc = bmp->width / 8 + 1;
-
-        if (strlen(pOverlay->TimeStampFormat) > 0) {
-          epicsTimeToStrftime(tstr, sizeof(tstr)-1, pOverlay->TimeStampFormat, &pArray->epicsTS);
-          epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s%s", pOverlay->DisplayText, tstr);
+    case NDOverlayRectangle:
+      xmin = pOverlay->PositionX;
+      xmax = pOverlay->PositionX + pOverlay->SizeX;
+      ymin = pOverlay->PositionY;
+      ymax = pOverlay->PositionY + pOverlay->SizeY;
+      xwide = pOverlay->WidthX;
+      ywide = pOverlay->WidthY;
+      xwide = MIN(xwide, (int)pOverlay->SizeX-1);
+      ywide = MIN(ywide, (int)pOverlay->SizeY-1);
+
+      //For non-zero width, grow the rectangle towards the center.
+      for (iy=ymin; iy<=ymax; iy++) {
+        if ((iy < (ymin + ywide)) || 
+            (iy > (ymax - ywide))) {
+          addSpan(pOverlay, xmin, xmax, iy, pArrayInfo);
         } else {
-          epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s", pOverlay->DisplayText);
+          addSpan(pOverlay, xmin, xmin + xwide - 1, iy, pArrayInfo);
+          addSpan(pOverlay, xmax - xwide + 1, xmax, iy, pArrayInfo);
         }
-        textOutStr[sizeof(textOutStr)-1] = 0;
-
-        cp   = textOutStr;
-        xmin = pOverlay->PositionX;
-        xmax = pOverlay->PositionX + pOverlay->SizeX;
-        ymin = pOverlay->PositionY;
-        ymax = pOverlay->PositionY + pOverlay->SizeY;
-        ymax = MIN(ymax, pOverlay->PositionY + bmp->height);
-
-        // Loop over vertical lines
-        for (jj=0, iy=ymin; iy<ymax; jj++, iy++) {
-
-          // Loop over characters
-          for (ii=0; cp[ii]!=0; ii++) {
-            if( cp[ii] < 32)
-              continue;
-
-            if (xmin+ii * bmp->width >= xmax)
-              // None of this character can be written
-              break;
-
-            sbc = 0;
-            bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc];
-            mask = 0x80;
-            for (ib=0; ib<bmp->width; ib++) {
-              ix = xmin + ii * bmp->width + ib;
-              if (ix >= xmax)
-                break;
-              if (mask & bmc) {
-                addPixel(pOverlay, ix, iy, pArrayInfo);
-              }
-              mask >>= 1;
-              if (!mask) {
-                mask = 0x80;
-                sbc++;
-                bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc + sbc];
-              }
-            }
+      }
+      break;
+
+    case NDOverlayEllipse:
+      xwide = pOverlay->WidthX;
+      ywide = pOverlay->WidthY;
+      xwide = MIN(xwide, (int)pOverlay->SizeX-1);
+      ywide = MIN(ywide, (int)pOverlay->SizeY-1);
+      xcent = pOverlay->PositionX + pOverlay->SizeX/2;
+      ycent = pOverlay->PositionY + pOverlay->SizeY/2;
+      xsize = pOverlay->SizeX/2;
+      ysize = pOverlay->SizeY/2;
+
+      // Use the parametric equation for an ellipse.  
+      // Only need to compute 0 to pi/2, other quadrants by symmetry
+      // Make 2*(xsize + ysize) angle points
+      nSteps = 2*(xsize + ysize);
+      thetaStep = M_PI / 2. / nSteps;
+      for (ii=0, theta=0.; ii<=nSteps; ii++, theta+=thetaStep) {
+        for (jj=0; jj<xwide; jj++) {
+          ix = (int)((xsize-jj) * cos(theta) + 0.5);
+          iy = (int)((ysize-jj) * sin(theta) + 0.5);
+          addPixel(pOverlay, (xcent + ix), (ycent + iy), pArrayInfo);
+          addPixel(pOverlay, (xcent + ix), (ycent - iy), pArrayInfo);
+          addPixel(pOverlay, (xcent - ix), (ycent + iy), pArrayInfo);
+          addPixel(pOverlay, (xcent - ix), (ycent - iy), pArrayInfo);
+        }
+      }
+      // There may be duplicate pixels in the address list.  
+      // We must remove them or the XOR draw mode won't work because the pixel will be set and then unset
+      std::sort(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
+      it = std::unique(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
+      pOverlay->pvt.addressOffset.resize(std::distance(pOverlay->pvt.addressOffset.begin(), it));
+      // The sorted pixels are in row order, so neighbouring pixels combine into spans
+      for (it=pOverlay->pvt.addressOffset.begin(); it!=pOverlay->pvt.addressOffset.end(); ++it) {
+        NDOverlaySpan_t span = {*it, 1};
+        pOverlay->pvt.numPixels++;
+        if (!pOverlay->pvt.spans.empty()) {
+          NDOverlaySpan_t *pLast = &pOverlay->pvt.spans.back();
+          if (pLast->offset + pLast->count*(int)pArrayInfo->xStride == span.offset) {
+            pLast->count++;
+            continue;
           }
         }
-        break;
-    } // switch(pOverlay->shape)
-  } // if (pOverlay->pvt.changed)
+        pOverlay->pvt.spans.push_back(span);
+      }
+      pOverlay->pvt.addressOffset.clear();
+      break;
 
-  // Set the pixels in the image from the addressOffset vector list
-  for (ii=0; ii<(int)pOverlay->pvt.addressOffset.size(); ii++) {
-    setPixel(pData + pOverlay->pvt.addressOffset[ii], pOverlay, pArrayInfo);
+    case NDOverlayText:
+      if ((pOverlay->Font >= 0) && (pOverlay->Font < NDPluginOverlayTextFontBitmapTypeN)) {
+        epicsThreadOnce(&glyphAtlasOnceId, buildGlyphAtlases, NULL);
+        pAtlas = &glyphAtlases[pOverlay->Font];
+      } else {
+        // Really, no reason to go on if the font is ill defined
+        return;
+      }
+
+      cp   = (const unsigned char *)pOverlay->pvt.text.c_str();
+      xmin = pOverlay->PositionX;
+      xmax = pOverlay->PositionX + pOverlay->SizeX;
+      ymin = pOverlay->PositionY;
+      ymax = pOverlay->PositionY + pOverlay->SizeY;
+      ymax = MIN(ymax, pOverlay->PositionY + pAtlas->height);
+
+      // Loop over vertical lines
+      for (jj=0, iy=ymin; iy<ymax; jj++, iy++) {
+
+        // Loop over characters
+        for (ii=0; cp[ii]!=0; ii++) {
+          glyph = glyphIndex(cp[ii]);
+          if (glyph < 0)
+            continue;
+
+          ix = xmin + ii * pAtlas->width;
+          if (ix >= xmax)
+            // None of this character can be written
+            break;
+
+          for (ir=pAtlas->rowStart[glyph*pAtlas->height + jj]; ir<pAtlas->rowStart[glyph*pAtlas->height + jj + 1]; ir++) {
+            pRun = &pAtlas->runs[ir];
+            xsize = MIN(pRun->length, xmax - ix - pRun->start);
+            addSpan(pOverlay, ix + pRun->start, ix + pRun->start + xsize - 1, iy, pArrayInfo);
+          }
+        }
+      }
+      break;
+  } // switch(pOverlay->shape)
+}
+
+template <typename epicsType>
+void NDPluginOverlay::doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
+{
+  epicsType *pData=(epicsType *)pArray->pData;
+  epicsType *pValue, *pEnd;
+  std::vector<NDOverlaySpan_t>::const_iterator span;
+  int xStride = (int)pArrayInfo->xStride;
+  bool fill = (pOverlay->drawMode == NDOverlaySet) && (xStride == 1) && (pArrayInfo->colorMode == NDColorModeMono);
+
+  // Set the pixels in the image from the cached spans
+  for (span=pOverlay->pvt.spans.begin(); span!=pOverlay->pvt.spans.end(); ++span) {
+    pValue = pData + span->offset;
+    if (fill) {
+      std::fill(pValue, pValue + span->count, (epicsType)pOverlay->green);
+      continue;
+    }
+    for (pEnd = pValue + span->count*xStride; pValue < pEnd; pValue += xStride) {
+      setPixel(pValue, pOverlay, pArrayInfo);
+    }
   }
 }
 
@@ -303,6 +403,9 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
 
   int overlay;
   int itemp;
+  int numPixels=0;
+  int blockingCallbacks;
+  bool drawInPlace;
   NDArray *pOutput;
   NDArrayInfo arrayInfo;
   std::vector<NDOverlay_t>pOverlays;
@@ -314,11 +417,8 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   /* Call the base class method */
   NDPluginDriver::beginProcessCallbacks(pArray);
 
-  /* Copy the input array so we can modify it. */
-  pOutput = this->pNDArrayPool->copy(pArray, NULL, 1);
-  
   /* Get information about the array needed later */
-  pOutput->getInfo(&arrayInfo);
+  pArray->getInfo(&arrayInfo);
   arrayInfoChanged = (memcmp(&arrayInfo, &this->prevArrayInfo_, sizeof(arrayInfo)) != 0);
   this->prevArrayInfo_ = arrayInfo;
   setIntegerParam(NDPluginOverlayMaxSizeX, (int)arrayInfo.xSize);
@@ -353,22 +453,65 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
     // Compare to see if any fields in the overlay have changed
     pOverlay->pvt.changed = (memcmp(&this->prevOverlays_[overlay], pOverlay, overlayUserLen) != 0);
     if (arrayInfoChanged) pOverlay->pvt.changed = true;
-    /* If this is a text overlay with a non-blank time stamp format then it always needs to be updated */
-    if ((pOverlay->shape == NDOverlayText) && (strlen(pOverlay->TimeStampFormat) > 0)) {
-        pOverlay->pvt.changed = true;
-    }
   }
   /* This function is called with the lock taken, and it must be set when we exit.
    * The following code can be exected without the mutex because we are not accessing memory
    * that other threads can access. */
   this->unlock();
+  for (overlay=0; overlay<this->maxOverlays_; overlay++) {
+    pOverlay = &pOverlays[overlay];
+    if (!pOverlay->use) continue;
+    this->computeSpans(pArray, pOverlay, &arrayInfo);
+    numPixels += pOverlay->pvt.numPixels;
+  }
+
+  /* Only copy the input array if we must.  If nothing is drawn and it gets no attributes from this
+   * plugin it is passed on unchanged.  If the only references to it are our queue entry and
+   * pPrevInputArray_ the overlays are drawn directly into it.  That is never the case with blocking
+   * callbacks, because then the driver still owns the array and passes it on to other plugins after us.
+   * The reference count only describes the users of the data when the pool owns the buffer.
+   * Arrays from NDArrayPool::share() or that wrap an external buffer have a release function,
+   * and other clients may still be reading their data, so they are never drawn in place.
+   * NDArray data are a single buffer, so otherwise the whole array must be copied. */
+  this->lock();
+  getIntegerParam(NDPluginDriverBlockingCallbacks, &blockingCallbacks);
+  if ((numPixels == 0) && (this->pAttributeList->count() == 0)) {
+    drawInPlace = true;
+  } else if (!blockingCallbacks && !pArray->getReleaseFunc() &&
+             (pArray->getReferenceCount() == ((pPrevInputArray_ == pArray) ? 2 : 1))) {
+    drawInPlace = true;
+    // ProcessPlugin would draw the overlays a second time on this array, so don't keep it
+    if (pPrevInputArray_ == pArray) {
+      pPrevInputArray_->release();
+      pPrevInputArray_ = 0;
+    }
+  } else {
+    drawInPlace = false;
+  }
+  this->unlock();
+
+  if (drawInPlace) {
+    pOutput = pArray;
+    pOutput->reserve();
+  } else {
+    pOutput = this->pNDArrayPool->copy(pArray, NULL, 1, true, true, NDCopyAttributesUpdate);
+    if (!pOutput) {
+      asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+        "%s::%s error copying input array\n",
+        driverName, functionName);
+      this->lock();
+      return;
+    }
+  }
+
   for (overlay=0; overlay<this->maxOverlays_; overlay++) {
     pOverlay = &pOverlays[overlay];
     if (!pOverlay->use) continue;
     this->doOverlay(pOutput, pOverlay, &arrayInfo);
     asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER, 
-      "%s::%s overlay %d, changed=%d, points=%d\n", 
-      driverName, functionName, overlay, pOverlay->pvt.changed, (int)pOverlay->pvt.addressOffset.size());
+      "%s::%s overlay %d, changed=%d, points=%d, spans=%d\n", 
+      driverName, functionName, overlay, pOverlay->pvt.changed, pOverlay->pvt.numPixels,
+      (int)pOverlay->pvt.spans.size());
   }
   this->lock();
   this->prevOverlays_ = pOverlays;
@@ -376,8 +519,8 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   callParamCallbacks();
 }
 
-
-
+
+
 /** Constructor for NDPluginOverlay; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   * After calling the base class constructor this method sets reasonable default values for all of the
   * ROI parameters.
@@ -2,6 +2,7 @@
 #define NDPluginOverlay_H
 
 #include <vector>
+#include <string>
 #include <algorithm>
 #include "NDPluginDriver.h"
 
@@ -17,8 +18,17 @@ typedef enum {
     NDOverlayXOR
 } NDOverlayDrawMode_t;
 
+/** A run of overlay pixels that are adjacent in memory, i.e. at offset, offset+xStride, ... */
 typedef struct {
-    std::vector<int> addressOffset;
+    int offset;
+    int count;
+} NDOverlaySpan_t;
+
+typedef struct {
+    std::vector<int> addressOffset;       /* Pixels of shapes that are not built from spans (ellipse) */
+    std::vector<NDOverlaySpan_t> spans;   /* Pixels to draw, cached until the overlay or array changes */
+    int numPixels;
+    std::string text;                     /* Text drawn by a text overlay, including any time stamp */
     bool changed;
     bool freezePositionX;
     bool freezePositionY;
@@ -105,6 +115,8 @@ private:
     NDArrayInfo prevArrayInfo_;
     std::vector<NDOverlay_t> prevOverlays_;    /* Vector of NDOverlay structures */
     inline void addPixel(NDOverlay_t *pOverlay, int ix, int iy, NDArrayInfo_t *pArrayInfo);
+    inline void addSpan(NDOverlay_t *pOverlay, int ixmin, int ixmax, int iy, NDArrayInfo_t *pArrayInfo);
+    void computeSpans(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
     template <typename epicsType> void doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
     int doOverlay(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
     template <typename epicsType> void setPixel(epicsType *pValue, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
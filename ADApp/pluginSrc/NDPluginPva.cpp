@@ -3,6 +3,7 @@
 #include <pv/channelProviderLocal.h>
 
 #include <epicsThread.h>
+#include <epicsGuard.h>
 #include <epicsExport.h>
 #include <iocsh.h>
 
@@ -24,6 +25,8 @@ using namespace epics::pvDatabase;
 using namespace epics::nt;
 using namespace std;
 
+static const char *driverName = "NDPluginPva";
+
 class epicsShareClass NTNDArrayRecord :
     public PVRecord
 {
@@ -92,20 +95,127 @@ void NTNDArrayRecord::update(NDArray *pArray)
     unlock();
 }
 
+/** Count of the NDArrays published by a plugin that are still held by pvAccess clients.
+  * It is shared with the references that pvAccess holds, so it stays valid if the plugin
+  * is destroyed first. It is updated from pvAccess threads, so it does not use the asyn port lock.
+  */
+struct pvaInFlight {
+    pvaInFlight() : numInFlight(0), pCurrent(NULL) {}
+    epicsMutex lock;
+    int numInFlight;                /**< Published NDArrays held by clients, not counting pCurrent */
+    struct pvaArrayRef *pCurrent;   /**< The NDArray that is the current value of the record */
+};
+
+/** Reference to an NDArray that is held by the pvAccess server */
+struct pvaArrayRef {
+    std::tr1::shared_ptr<pvaInFlight> pInFlight;
+    NDArray *pArray;
+};
+
+/** Called by the NDArrayPool when pvAccess has released the last reference
+  * to an NDArray published by this plugin, i.e. after all of the clients have been served.
+  */
+static void releasePvaArray(void *pData, void *pvt)
+{
+    pvaArrayRef *pRef = (pvaArrayRef *)pvt;
+
+    {
+        epicsGuard<epicsMutex> guard(pRef->pInFlight->lock);
+        if (pRef->pInFlight->pCurrent == pRef)
+            pRef->pInFlight->pCurrent = NULL;
+        else
+            pRef->pInFlight->numInFlight--;
+    }
+    pRef->pArray->release();
+    delete pRef;
+}
+
 /** Callback function that is called by the NDArray driver with new NDArray
   * data.
   * \param[in] pArray  The NDArray from the callback.
+  *
+  * Neither the NTNDArray nor the output NDArray copies the data.  The NTNDArray
+  * value is a shared_vector that wraps pArray->pData and holds a reference to pArray
+  * until pvAccess has sent it to all of the clients.  The output NDArray has its own
+  * attributes but also points to pArray->pData.
+  *
+  * The record holds its current value until the next NDArray replaces it, so that NDArray
+  * is not counted against MaxInFlight. An NDArray is in flight from when it is replaced
+  * until the clients that are still sending it release it.
   */
 void NDPluginPva::processCallbacks(NDArray *pArray)
 {
-    NDPluginDriver::beginProcessCallbacks(pArray);   // Base class method
+    int maxInFlight;
+    int numInFlight;
+    size_t dims[ND_ARRAY_MAX_DIMS];
+    NDArray *pPvaArray = NULL;
+    NDArray *pArrayOut;
+    static const char *functionName = "processCallbacks";
 
-    this->unlock();             // Function called with the lock taken
-    m_record->update(pArray);
-    this->lock();               // Must return locked
+    NDPluginDriver::beginProcessCallbacks(pArray);   // Base class method
 
-    // Do NDArray callbacks.  We need to copy the array and get the attributes
-    NDPluginDriver::endProcessCallbacks(pArray, true, true);
+    getIntegerParam(NDPluginPvaMaxInFlight, &maxInFlight);
+    m_inFlight->lock.lock();
+    numInFlight = m_inFlight->numInFlight;
+    if ((maxInFlight <= 0) || (numInFlight < maxInFlight)) {
+        pvaArrayRef *pRef = new pvaArrayRef;
+        pRef->pInFlight = m_inFlight;
+        pRef->pArray = pArray;
+        for (int i=0; i<pArray->ndims; i++) dims[i] = pArray->dims[i].size;
+        pArray->reserve();
+        pPvaArray = this->pNDArrayPool->alloc(pArray->ndims, dims, pArray->dataType,
+                        pArray->dataSize, pArray->pData, releasePvaArray, pRef);
+        if (pPvaArray) {
+            this->pNDArrayPool->copy(pArray, pPvaArray, false);
+            // The current value of the record is replaced, and is in flight until the clients release it
+            if (m_inFlight->pCurrent) {
+                m_inFlight->numInFlight++;
+                numInFlight++;
+            }
+            m_inFlight->pCurrent = pRef;
+        } else {
+            pArray->release();
+            delete pRef;
+        }
+    }
+    m_inFlight->lock.unlock();
+
+    if (pPvaArray) {
+        this->unlock();             // Function called with the lock taken
+        try {
+            m_record->update(pPvaArray);
+        }
+        catch(...) {
+            pPvaArray->release();
+            this->lock();
+            throw;
+        }
+        // The NTNDArray now holds its own reference
+        pPvaArray->release();
+        this->lock();               // Must return locked
+    } else {
+        int droppedUpdates;
+        getIntegerParam(NDPluginPvaDroppedUpdates, &droppedUpdates);
+        setIntegerParam(NDPluginPvaDroppedUpdates, ++droppedUpdates);
+        asynPrint(pasynUserSelf, ASYN_TRACE_WARNING,
+            "%s::%s %d arrays in flight, not publishing uniqueId=%d\n",
+            driverName, functionName, numInFlight, pArray->uniqueId);
+    }
+    // The replaced value was released by the update if no client was sending it
+    m_inFlight->lock.lock();
+    numInFlight = m_inFlight->numInFlight;
+    m_inFlight->lock.unlock();
+    setIntegerParam(NDPluginPvaNumInFlight, numInFlight);
+
+    // Do NDArray callbacks with an array that shares the data of the input array
+    pArrayOut = this->pNDArrayPool->share(pArray);
+    if (pArrayOut) {
+        NDPluginDriver::endProcessCallbacks(pArrayOut, false, true);
+    } else {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s Couldn't allocate output array\n",
+            driverName, functionName);
+    }
 
     callParamCallbacks();
 }
@@ -143,9 +253,13 @@ NDPluginPva::NDPluginPva(const char *portName, int queueSize,
     : NDPluginDriver(portName, queueSize, blockingCallbacks,
             NDArrayPort, NDArrayAddr, 1, maxBuffers, maxMemory, 0, 0,
             0, 1, priority, stackSize, 1, true),
-            m_record(NTNDArrayRecord::create(pvName))
+            m_record(NTNDArrayRecord::create(pvName)),
+            m_inFlight(new pvaInFlight)
 {
-    createParam(NDPluginPvaPvNameString, asynParamOctet, &NDPluginPvaPvName);
+    createParam(NDPluginPvaPvNameString,         asynParamOctet, &NDPluginPvaPvName);
+    createParam(NDPluginPvaMaxInFlightString,    asynParamInt32, &NDPluginPvaMaxInFlight);
+    createParam(NDPluginPvaNumInFlightString,    asynParamInt32, &NDPluginPvaNumInFlight);
+    createParam(NDPluginPvaDroppedUpdatesString, asynParamInt32, &NDPluginPvaDroppedUpdates);
 
     if(!m_record.get())
         throw runtime_error("failed to create NTNDArrayRecord");
@@ -156,6 +270,10 @@ NDPluginPva::NDPluginPva(const char *portName, int queueSize,
     /* Set PvName */
     setStringParam(NDPluginPvaPvName, pvName);
 
+    setIntegerParam(NDPluginPvaMaxInFlight, 0);
+    setIntegerParam(NDPluginPvaNumInFlight, 0);
+    setIntegerParam(NDPluginPvaDroppedUpdates, 0);
+
     /* Try to connect to the NDArray port */
     connectToArrayPort();
 
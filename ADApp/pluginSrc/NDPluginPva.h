@@ -11,10 +11,14 @@
 #include <pv/pvData.h>
 #include <vector>
 
-#define NDPluginPvaPvNameString "PV_NAME"
+#define NDPluginPvaPvNameString         "PV_NAME"
+#define NDPluginPvaMaxInFlightString    "MAX_IN_FLIGHT"    /**< (asynInt32, r/w) Max arrays held by pvAccess, 0=unlimited */
+#define NDPluginPvaNumInFlightString    "NUM_IN_FLIGHT"    /**< (asynInt32, r/o) Arrays currently held by pvAccess */
+#define NDPluginPvaDroppedUpdatesString "DROPPED_UPDATES"  /**< (asynInt32, r/w) Arrays not published because MaxInFlight was reached */
 
 class NTNDArrayRecord;
 typedef std::tr1::shared_ptr<NTNDArrayRecord> NTNDArrayRecordPtr;
+struct pvaInFlight;
 
 /** Converts NDArray callback data into EPICS V4 NTNDArray data and exposes it
   * as an EPICS V4 PV  */
@@ -32,9 +36,13 @@ public:
 
 protected:
     int NDPluginPvaPvName;
+    int NDPluginPvaMaxInFlight;
+    int NDPluginPvaNumInFlight;
+    int NDPluginPvaDroppedUpdates;
 
 private:
     NTNDArrayRecordPtr m_record;
+    std::tr1::shared_ptr<pvaInFlight> m_inFlight;
 };
 
 #endif
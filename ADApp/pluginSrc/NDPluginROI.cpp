@@ -12,6 +12,9 @@
 #include <stdio.h>
 #include <math.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
 #include <epicsThread.h>
@@ -32,11 +35,123 @@
 
 static const char *driverName="NDPluginROI";
 
-
+typedef void (*NDROIConvertRowFunc)(const void *pIn, void *pOut, size_t nElements);
+typedef void (*NDROIBinRowFunc)(const void *pIn, void *pOut, size_t outSize, int binning, int reverse);
+
+/** State of one ROI during a pass over the rows of the input array */
+typedef struct {
+    NDROIDefinition_t *pDef;
+    char *pData;                        /* Output data */
+    size_t elementSize;
+    size_t outSize[ND_ARRAY_MAX_DIMS];  /* Output size in each dimension */
+    int rowBuffer;                      /* Index of the converted row to read, -1 to read the input array */
+    NDROIBinRowFunc binRow;
+} NDROIPass_t;
+
+/** One row of the input array converted to the data type of one or more ROIs.
+  * Only the elements used by these ROIs are converted, once for all of them. */
+typedef struct {
+    NDDataType_t dataType;
+    size_t elementSize;
+    size_t start;                       /* First element converted */
+    size_t end;                         /* Last element converted + 1 */
+    size_t row;                         /* Row that was last converted */
+    NDROIConvertRowFunc convertRow;
+    std::vector<epicsFloat64> data;     /* Large enough for a row of any data type */
+} NDROIRowBuffer_t;
+
+/** Converts nElements of a row of the input array to the data type of an ROI */
+template <typename epicsTypeIn, typename epicsTypeOut>
+static void convertRow(const void *pIn, void *pOut, size_t nElements)
+{
+    const epicsTypeIn *pDIn = (const epicsTypeIn *)pIn;
+    epicsTypeOut *pDOut = (epicsTypeOut *)pOut;
+    size_t i;
+
+    for (i=0; i<nElements; i++) pDOut[i] = (epicsTypeOut)pDIn[i];
+}
+
+template <typename epicsTypeIn>
+static NDROIConvertRowFunc convertRowTo(NDDataType_t dataTypeOut)
+{
+    switch (dataTypeOut) {
+        case NDInt8:    return convertRow<epicsTypeIn, epicsInt8>;
+        case NDUInt8:   return convertRow<epicsTypeIn, epicsUInt8>;
+        case NDInt16:   return convertRow<epicsTypeIn, epicsInt16>;
+        case NDUInt16:  return convertRow<epicsTypeIn, epicsUInt16>;
+        case NDInt32:   return convertRow<epicsTypeIn, epicsInt32>;
+        case NDUInt32:  return convertRow<epicsTypeIn, epicsUInt32>;
+        case NDFloat32: return convertRow<epicsTypeIn, epicsFloat32>;
+        case NDFloat64: return convertRow<epicsTypeIn, epicsFloat64>;
+        default:        return NULL;
+    }
+}
+
+static NDROIConvertRowFunc getConvertRow(NDDataType_t dataTypeIn, NDDataType_t dataTypeOut)
+{
+    switch (dataTypeIn) {
+        case NDInt8:    return convertRowTo<epicsInt8>(dataTypeOut);
+        case NDUInt8:   return convertRowTo<epicsUInt8>(dataTypeOut);
+        case NDInt16:   return convertRowTo<epicsInt16>(dataTypeOut);
+        case NDUInt16:  return convertRowTo<epicsUInt16>(dataTypeOut);
+        case NDInt32:   return convertRowTo<epicsInt32>(dataTypeOut);
+        case NDUInt32:  return convertRowTo<epicsUInt32>(dataTypeOut);
+        case NDFloat32: return convertRowTo<epicsFloat32>(dataTypeOut);
+        case NDFloat64: return convertRowTo<epicsFloat64>(dataTypeOut);
+        default:        return NULL;
+    }
+}
+
+/** Adds outSize*binning elements of a row to outSize elements of a row of an ROI.
+  * The elements are added in the same order as NDArrayPool::convert() adds them. */
+template <typename epicsType>
+static void binRow(const void *pIn, void *pOut, size_t outSize, int binning, int reverse)
+{
+    const epicsType *pDIn = (const epicsType *)pIn;
+    epicsType *pDOut = (epicsType *)pOut;
+    size_t i;
+    int bin;
+
+    if (reverse) {
+        pDIn += outSize*binning - 1;
+        for (i=0; i<outSize; i++) {
+            for (bin=0; bin<binning; bin++) pDOut[i] += *pDIn--;
+        }
+    } else if (binning == 1) {
+        for (i=0; i<outSize; i++) pDOut[i] += pDIn[i];
+    } else {
+        for (i=0; i<outSize; i++) {
+            for (bin=0; bin<binning; bin++) pDOut[i] += *pDIn++;
+        }
+    }
+}
+
+static NDROIBinRowFunc getBinRow(NDDataType_t dataType)
+{
+    switch (dataType) {
+        case NDInt8:    return binRow<epicsInt8>;
+        case NDUInt8:   return binRow<epicsUInt8>;
+        case NDInt16:   return binRow<epicsInt16>;
+        case NDUInt16:  return binRow<epicsUInt16>;
+        case NDInt32:   return binRow<epicsInt32>;
+        case NDUInt32:  return binRow<epicsUInt32>;
+        case NDFloat32: return binRow<epicsFloat32>;
+        case NDFloat64: return binRow<epicsFloat64>;
+        default:        return NULL;
+    }
+}
+
+/** Returns true if the ROI is extracted as NDFloat64, scaled and then converted to its data type */
+static bool isScaled(const NDROIDefinition_t *pDef)
+{
+    return pDef->enableScale && (pDef->scale != 0) && (pDef->scale != 1);
+}
+
+
 /** Callback function that is called by the NDArray driver with new NDArray data.
-  * Extracts the NthrDArray data into each of the ROIs that are being used.
-  * Computes statistics on the ROI if NDPluginROIComputeStatistics is 1.
-  * Computes the histogram of ROI values if NDPluginROIComputeHistogram is 1.
+  * Extracts the NDArray data into each of the ROIs that are being used.
+  * When there is more than one ROI they are all extracted in a single pass over the input array,
+  * and each ROI is passed to the plugins connected to its asyn address.
   * \param[in] pArray  The NDArray from the callback.
   */
 void NDPluginROI::processCallbacks(NDArray *pArray)
@@ -46,39 +161,13 @@ void NDPluginROI::processCallbacks(NDArray *pArray)
      * structures don't need to be protected.
      */
 
-    int dataType;
-    int dim;
-    NDDimension_t dims[ND_ARRAY_MAX_DIMS], tempDim, *pDim;
     size_t userDims[ND_ARRAY_MAX_DIMS];
-    NDArrayInfo arrayInfo, scratchInfo;
-    NDArray *pScratch, *pOutput;
-    NDColorMode_t colorMode;
-    double *pData;
-    int enableScale, enableDim[3], autoSize[3];
-    size_t i;
-    double scale;
-    int collapseDims;
+    NDArrayInfo arrayInfo;
+    std::vector<NDROIDefinition_t> defs(maxROIs_);
+    std::vector<NDArray *> pROIs(maxROIs_, (NDArray *)NULL);
+    std::vector<int> useROI(maxROIs_, 1);
+    int roi;
     //static const char* functionName = "processCallbacks";
-    
-    memset(dims, 0, sizeof(NDDimension_t) * ND_ARRAY_MAX_DIMS);
-
-    /* Get all parameters while we have the mutex */
-    getIntegerParam(NDPluginROIDim0Bin,      &dims[0].binning);
-    getIntegerParam(NDPluginROIDim1Bin,      &dims[1].binning);
-    getIntegerParam(NDPluginROIDim2Bin,      &dims[2].binning);
-    getIntegerParam(NDPluginROIDim0Reverse,  &dims[0].reverse);
-    getIntegerParam(NDPluginROIDim1Reverse,  &dims[1].reverse);
-    getIntegerParam(NDPluginROIDim2Reverse,  &dims[2].reverse);
-    getIntegerParam(NDPluginROIDim0Enable,   &enableDim[0]);
-    getIntegerParam(NDPluginROIDim1Enable,   &enableDim[1]);
-    getIntegerParam(NDPluginROIDim2Enable,   &enableDim[2]);
-    getIntegerParam(NDPluginROIDim0AutoSize, &autoSize[0]);
-    getIntegerParam(NDPluginROIDim1AutoSize, &autoSize[1]);
-    getIntegerParam(NDPluginROIDim2AutoSize, &autoSize[2]);
-    getIntegerParam(NDPluginROIDataType,     &dataType);
-    getIntegerParam(NDPluginROIEnableScale,  &enableScale);
-    getDoubleParam(NDPluginROIScale, &scale);
-    getIntegerParam(NDPluginROICollapseDims, &collapseDims);
 
     /* Call the base class method */
     NDPluginDriver::beginProcessCallbacks(pArray);
@@ -90,13 +179,89 @@ void NDPluginROI::processCallbacks(NDArray *pArray)
     userDims[1] = arrayInfo.yDim;
     userDims[2] = arrayInfo.colorDim;
 
+    /* Get all parameters while we have the mutex */
+    for (roi=0; roi<maxROIs_; roi++) {
+        getROIDefinition(roi, pArray, &arrayInfo, userDims, &defs[roi]);
+    }
+
+    /* ROI 0 is always extracted, it is the output of the plugin.
+     * The other ROIs are only extracted when a plugin is connected to their address,
+     * so that unused ROIs do not copy the input array. */
+    for (roi=1; roi<maxROIs_; roi++) {
+        useROI[roi] = hasArrayClients(roi);
+        if (!useROI[roi] && this->pArrays[roi]) {
+            this->pArrays[roi]->release();
+            this->pArrays[roi] = NULL;
+        }
+    }
+
+    /* This function is called with the lock taken, and it must be set when we exit.
+     * The following code can be executed without the mutex because we are not accessing memory
+     * that other threads can access. */
+    this->unlock();
+
+    /* Extract the ROIs from the input array.  The output arrays are allocated from the
+     * NDArrayPool and are reserved (reference count = 1).
+     * If scaling is enabled the ROI is extracted as NDFloat64, see finishROI(). */
+    if (maxROIs_ == 1) {
+        this->pNDArrayPool->convert(pArray, &pROIs[0],
+                                    isScaled(&defs[0]) ? NDFloat64 : (NDDataType_t)defs[0].dataType,
+                                    defs[0].dims);
+    } else {
+        extractROIs(pArray, &arrayInfo, &defs[0], &useROI[0], &pROIs[0]);
+    }
+    for (roi=0; roi<maxROIs_; roi++) {
+        if (pROIs[roi]) pROIs[roi] = finishROI(pROIs[roi], &arrayInfo, &defs[roi]);
+    }
+
+    this->lock();
+
+    for (roi=0; roi<maxROIs_; roi++) {
+        doROICallbacks(roi, pROIs[roi], userDims);
+    }
+}
+
+/** Reads the definition of one ROI from the parameter library and fixes it to fit the input array.
+  * This must be called with the mutex locked.
+  * \param[in] roi The ROI, which is also its asyn address.
+  * \param[in] pArray The input array.
+  * \param[in] pArrayInfo Information about the input array.
+  * \param[in] userDims The X, Y and color dimensions of the input array.
+  * \param[out] pDef The ROI definition, with the dimensions in the order of the input array dimensions.
+  */
+void NDPluginROI::getROIDefinition(int roi, NDArray *pArray, NDArrayInfo *pArrayInfo, size_t *userDims,
+                                   NDROIDefinition_t *pDef)
+{
+    int dim;
+    NDDimension_t *dims = pDef->dims, tempDim, *pDim;
+    int enableDim[3], autoSize[3];
+
+    memset(dims, 0, sizeof(NDDimension_t) * ND_ARRAY_MAX_DIMS);
+
+    getIntegerParam(roi, NDPluginROIDim0Bin,      &dims[0].binning);
+    getIntegerParam(roi, NDPluginROIDim1Bin,      &dims[1].binning);
+    getIntegerParam(roi, NDPluginROIDim2Bin,      &dims[2].binning);
+    getIntegerParam(roi, NDPluginROIDim0Reverse,  &dims[0].reverse);
+    getIntegerParam(roi, NDPluginROIDim1Reverse,  &dims[1].reverse);
+    getIntegerParam(roi, NDPluginROIDim2Reverse,  &dims[2].reverse);
+    getIntegerParam(roi, NDPluginROIDim0Enable,   &enableDim[0]);
+    getIntegerParam(roi, NDPluginROIDim1Enable,   &enableDim[1]);
+    getIntegerParam(roi, NDPluginROIDim2Enable,   &enableDim[2]);
+    getIntegerParam(roi, NDPluginROIDim0AutoSize, &autoSize[0]);
+    getIntegerParam(roi, NDPluginROIDim1AutoSize, &autoSize[1]);
+    getIntegerParam(roi, NDPluginROIDim2AutoSize, &autoSize[2]);
+    getIntegerParam(roi, NDPluginROIDataType,     &pDef->dataType);
+    getIntegerParam(roi, NDPluginROIEnableScale,  &pDef->enableScale);
+    getDoubleParam(roi, NDPluginROIScale,         &pDef->scale);
+    getIntegerParam(roi, NDPluginROICollapseDims, &pDef->collapseDims);
+
     /* Make sure dimensions are valid, fix them if they are not */
     for (dim=0; dim<pArray->ndims; dim++) {
         pDim = &dims[dim];
         if (enableDim[dim]) {
             size_t newDimSize = pArray->dims[userDims[dim]].size;
-            pDim->offset  = requestedOffset_[dim];
-            pDim->size    = requestedSize_[dim];
+            pDim->offset  = requestedOffset_[3*roi + dim];
+            pDim->size    = requestedSize_[3*roi + dim];
             pDim->offset  = MAX(pDim->offset,  0);
             pDim->offset  = MIN(pDim->offset,  newDimSize-1);
             if (autoSize[dim]) pDim->size = newDimSize;
@@ -112,96 +277,264 @@ void NDPluginROI::processCallbacks(NDArray *pArray)
     }
 
     /* Update the parameters that may have changed */
-    setIntegerParam(NDPluginROIDim0MaxSize, 0);
-    setIntegerParam(NDPluginROIDim1MaxSize, 0);
-    setIntegerParam(NDPluginROIDim2MaxSize, 0);
+    setIntegerParam(roi, NDPluginROIDim0MaxSize, 0);
+    setIntegerParam(roi, NDPluginROIDim1MaxSize, 0);
+    setIntegerParam(roi, NDPluginROIDim2MaxSize, 0);
     if (pArray->ndims > 0) {
         pDim = &dims[0];
-        setIntegerParam(NDPluginROIDim0MaxSize, (int)pArray->dims[userDims[0]].size);
+        setIntegerParam(roi, NDPluginROIDim0MaxSize, (int)pArray->dims[userDims[0]].size);
         if (enableDim[0]) {
-            setIntegerParam(NDPluginROIDim0Min,  (int)pDim->offset);
-            setIntegerParam(NDPluginROIDim0Size, (int)pDim->size);
-            setIntegerParam(NDPluginROIDim0Bin,  pDim->binning);
+            setIntegerParam(roi, NDPluginROIDim0Min,  (int)pDim->offset);
+            setIntegerParam(roi, NDPluginROIDim0Size, (int)pDim->size);
+            setIntegerParam(roi, NDPluginROIDim0Bin,  pDim->binning);
         }
     }
     if (pArray->ndims > 1) {
         pDim = &dims[1];
-        setIntegerParam(NDPluginROIDim1MaxSize, (int)pArray->dims[userDims[1]].size);
+        setIntegerParam(roi, NDPluginROIDim1MaxSize, (int)pArray->dims[userDims[1]].size);
         if (enableDim[1]) {
-            setIntegerParam(NDPluginROIDim1Min,  (int)pDim->offset);
-            setIntegerParam(NDPluginROIDim1Size, (int)pDim->size);
-            setIntegerParam(NDPluginROIDim1Bin,  pDim->binning);
+            setIntegerParam(roi, NDPluginROIDim1Min,  (int)pDim->offset);
+            setIntegerParam(roi, NDPluginROIDim1Size, (int)pDim->size);
+            setIntegerParam(roi, NDPluginROIDim1Bin,  pDim->binning);
         }
     }
     if (pArray->ndims > 2) {
         pDim = &dims[2];
-        setIntegerParam(NDPluginROIDim2MaxSize, (int)pArray->dims[userDims[2]].size);
+        setIntegerParam(roi, NDPluginROIDim2MaxSize, (int)pArray->dims[userDims[2]].size);
         if (enableDim[2]) {
-            setIntegerParam(NDPluginROIDim2Min,  (int)pDim->offset);
-            setIntegerParam(NDPluginROIDim2Size, (int)pDim->size);
-            setIntegerParam(NDPluginROIDim2Bin,  pDim->binning);
+            setIntegerParam(roi, NDPluginROIDim2Min,  (int)pDim->offset);
+            setIntegerParam(roi, NDPluginROIDim2Size, (int)pDim->size);
+            setIntegerParam(roi, NDPluginROIDim2Bin,  pDim->binning);
         }
     }
 
-    /* This function is called with the lock taken, and it must be set when we exit.
-     * The following code can be executed without the mutex because we are not accessing memory
-     * that other threads can access. */
-    this->unlock();
-
-    /* Extract this ROI from the input array.  The convert() function allocates
-     * a new array and it is reserved (reference count = 1) */
-    if (dataType == -1) dataType = (int)pArray->dataType;
+    if (pDef->dataType == -1) pDef->dataType = (int)pArray->dataType;
     /* We treat the case of RGB1 data specially, so that NX and NY are the X and Y dimensions of the
      * image, not the first 2 dimensions.  This makes it much easier to switch back and forth between
      * RGB1 and mono mode when using an ROI. */
-    if (arrayInfo.colorMode == NDColorModeRGB1) {
+    if (pArrayInfo->colorMode == NDColorModeRGB1) {
         tempDim = dims[0];
         dims[0] = dims[2];
         dims[2] = dims[1];
         dims[1] = tempDim;
     }
-    else if (arrayInfo.colorMode == NDColorModeRGB2) {
+    else if (pArrayInfo->colorMode == NDColorModeRGB2) {
         tempDim = dims[1];
         dims[1] = dims[2];
         dims[2] = tempDim;
     }
-    
-    if (enableScale && (scale != 0) && (scale != 1)) {
+}
+
+/** Allocates the output array of one ROI and clears it.  The fields, dimensions and attributes of
+  * the output array are set the same way as NDArrayPool::convert() sets them.
+  * \param[in] pArray The input array.
+  * \param[in] pDef The ROI definition.
+  * \param[in] dataType The data type of the output array.
+  */
+NDArray *NDPluginROI::allocROI(NDArray *pArray, NDROIDefinition_t *pDef, NDDataType_t dataType)
+{
+    size_t dimSizeOut[ND_ARRAY_MAX_DIMS];
+    NDArrayInfo roiInfo;
+    NDArray *pROI;
+    NDAttribute *pAttribute;
+    int colorMode, colorModeMono = NDColorModeMono;
+    int i;
+    static const char *functionName = "allocROI";
+
+    for (i=0; i<pArray->ndims; i++) {
+        dimSizeOut[i] = pDef->dims[i].size / pDef->dims[i].binning;
+    }
+    pROI = this->pNDArrayPool->alloc(pArray->ndims, dimSizeOut, dataType, 0, NULL);
+    if (!pROI) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s: cannot allocate ROI array\n",
+            driverName, functionName);
+        return NULL;
+    }
+    pROI->timeStamp = pArray->timeStamp;
+    pROI->epicsTS = pArray->epicsTS;
+    pROI->uniqueId = pArray->uniqueId;
+    for (i=0; i<pArray->ndims; i++) {
+        pROI->dims[i].offset  = pArray->dims[i].offset + pDef->dims[i].offset;
+        pROI->dims[i].binning = pArray->dims[i].binning * pDef->dims[i].binning;
+        pROI->dims[i].reverse = pDef->dims[i].reverse;
+        if (pArray->dims[i].reverse) pROI->dims[i].reverse = !pROI->dims[i].reverse;
+    }
+    pArray->pAttributeList->copy(pROI->pAttributeList);
+    pROI->getInfo(&roiInfo);
+    memset(pROI->pData, 0, roiInfo.totalBytes);
+
+    /* If the frame is an RGBx frame and we have collapsed that dimension then change the colorMode */
+    pAttribute = pROI->pAttributeList->find("ColorMode");
+    if (pAttribute && pAttribute->getValue(NDAttrInt32, &colorMode)) {
+        if      ((colorMode == NDColorModeRGB1) && (pROI->dims[0].size != 3))
+            pAttribute->setValue(&colorModeMono);
+        else if ((colorMode == NDColorModeRGB2) && (pROI->dims[1].size != 3))
+            pAttribute->setValue(&colorModeMono);
+        else if ((colorMode == NDColorModeRGB3) && (pROI->dims[2].size != 3))
+            pAttribute->setValue(&colorModeMono);
+    }
+    return pROI;
+}
+
+/** Extracts all of the ROIs in a single pass over the rows (the first dimension) of the input array.
+  * Each row is read once, and when ROIs need a different data type from the input array the part of
+  * the row that they use is converted once for all the ROIs of that data type.
+  * \param[in] pArray The input array.
+  * \param[in] pArrayInfo Information about the input array.
+  * \param[in] pDefs The definitions of the maxROIs_ ROIs.
+  * \param[in] useROI Flags that are 0 for the ROIs that are not extracted.
+  * \param[out] pROIs The output arrays, NULL for an ROI that is not extracted or could not be allocated.
+  */
+void NDPluginROI::extractROIs(NDArray *pArray, NDArrayInfo *pArrayInfo, NDROIDefinition_t *pDefs, int *useROI,
+                              NDArray **pROIs)
+{
+    std::vector<NDROIPass_t> passes;
+    std::vector<NDROIRowBuffer_t> rowBuffers;
+    NDArrayInfo roiInfo;
+    size_t idx[ND_ARRAY_MAX_DIMS];
+    int ndims = pArray->ndims;
+    size_t rowSize = (ndims > 0) ? pArray->dims[0].size : 0;
+    size_t inBytes = pArrayInfo->bytesPerElement;
+    size_t nRows, row, outRow, k, i;
+    int roi, dim;
+
+    for (roi=0; roi<maxROIs_; roi++) {
+        NDROIDefinition_t *pDef = &pDefs[roi];
+        NDDataType_t dataType = isScaled(pDef) ? NDFloat64 : (NDDataType_t)pDef->dataType;
+        NDROIPass_t pass;
+
+        if (!useROI[roi]) continue;
+        pROIs[roi] = allocROI(pArray, pDef, dataType);
+        if (!pROIs[roi]) continue;
+        pROIs[roi]->getInfo(&roiInfo);
+        pass.pDef = pDef;
+        pass.pData = (char *)pROIs[roi]->pData;
+        pass.elementSize = roiInfo.bytesPerElement;
+        for (dim=0; dim<ndims; dim++) pass.outSize[dim] = pROIs[roi]->dims[dim].size;
+        pass.binRow = getBinRow(dataType);
+        pass.rowBuffer = -1;
+        if (dataType != pArray->dataType) {
+            size_t start = pDef->dims[0].offset;
+            size_t end = start + pass.outSize[0]*pDef->dims[0].binning;
+            for (i=0; i<rowBuffers.size(); i++) {
+                if (rowBuffers[i].dataType == dataType) break;
+            }
+            if (i == rowBuffers.size()) {
+                NDROIRowBuffer_t rowBuffer;
+                rowBuffer.dataType = dataType;
+                rowBuffer.elementSize = pass.elementSize;
+                rowBuffer.start = start;
+                rowBuffer.end = end;
+                rowBuffer.row = 0;
+                rowBuffer.convertRow = getConvertRow(pArray->dataType, dataType);
+                rowBuffers.push_back(rowBuffer);
+            } else {
+                rowBuffers[i].start = std::min(rowBuffers[i].start, start);
+                rowBuffers[i].end = std::max(rowBuffers[i].end, end);
+            }
+            pass.rowBuffer = (int)i;
+        }
+        passes.push_back(pass);
+    }
+    if ((rowSize == 0) || passes.empty()) return;
+
+    nRows = pArrayInfo->nElements / rowSize;
+    for (i=0; i<rowBuffers.size(); i++) {
+        rowBuffers[i].data.resize(rowSize);
+        rowBuffers[i].row = nRows;
+    }
+
+    memset(idx, 0, sizeof(idx));
+    for (row=0; row<nRows; row++) {
+        const char *pInRow = (const char *)pArray->pData + row*rowSize*inBytes;
+        for (i=0; i<passes.size(); i++) {
+            NDROIPass_t *pPass = &passes[i];
+            NDDimension_t *pDims = pPass->pDef->dims;
+            const char *pSrc = pInRow;
+
+            /* Find the output row for this input row, if the ROI contains it */
+            outRow = 0;
+            for (dim=ndims-1; dim>0; dim--) {
+                if ((idx[dim] < pDims[dim].offset) ||
+                    (idx[dim] >= pDims[dim].offset + pPass->outSize[dim]*pDims[dim].binning)) break;
+                k = (idx[dim] - pDims[dim].offset) / pDims[dim].binning;
+                if (pDims[dim].reverse) k = pPass->outSize[dim] - 1 - k;
+                outRow = outRow*pPass->outSize[dim] + k;
+            }
+            if (dim > 0) continue;
+
+            if (pPass->rowBuffer >= 0) {
+                NDROIRowBuffer_t *pBuffer = &rowBuffers[pPass->rowBuffer];
+                pSrc = (const char *)&pBuffer->data[0];
+                if (pBuffer->row != row) {
+                    pBuffer->convertRow(pInRow + pBuffer->start*inBytes,
+                                        (char *)pSrc + pBuffer->start*pBuffer->elementSize,
+                                        pBuffer->end - pBuffer->start);
+                    pBuffer->row = row;
+                }
+            }
+            pPass->binRow(pSrc + pDims[0].offset*pPass->elementSize,
+                          pPass->pData + outRow*pPass->outSize[0]*pPass->elementSize,
+                          pPass->outSize[0], pDims[0].binning, pDims[0].reverse);
+        }
+
+        /* Move to the next row */
+        for (dim=1; dim<ndims; dim++) {
+            if (++idx[dim] < pArray->dims[dim].size) break;
+            idx[dim] = 0;
+        }
+    }
+}
+
+/** Scales an extracted ROI and converts it to its data type if scaling is enabled, and collapses its dimensions.
+  * \param[in] pROI The extracted ROI; it is released if a new array is returned.
+  * \param[in] pArrayInfo Information about the input array.
+  * \param[in] pDef The ROI definition.
+  * \return The output array, or NULL if it could not be allocated.
+  */
+NDArray *NDPluginROI::finishROI(NDArray *pROI, NDArrayInfo *pArrayInfo, NDROIDefinition_t *pDef)
+{
+    NDArray *pOutput = pROI;
+    NDArrayInfo roiInfo;
+    NDColorMode_t colorMode;
+    double *pData;
+    int collapseDims = pDef->collapseDims;
+    size_t i;
+
+    if (isScaled(pDef)) {
         /* This is tricky.  We want to do the operation to avoid errors due to integer truncation.
          * For example, if an image with all pixels=1 is binned 3x3 with scale=9 (divide by 9), then
          * the output should also have all pixels=1. 
          * We do this by extracting the ROI and converting to double, do the scaling, then convert
          * to the desired data type. */
-        this->pNDArrayPool->convert(pArray, &pScratch, NDFloat64, dims);
-        pScratch->getInfo(&scratchInfo);
-        pData = (double *)pScratch->pData;
-        for (i=0; i<scratchInfo.nElements; i++) pData[i] = pData[i]/scale;
-        this->pNDArrayPool->convert(pScratch, &pOutput, (NDDataType_t)dataType);
-        pScratch->release();
-    } 
-    else {        
-        this->pNDArrayPool->convert(pArray, &pOutput, (NDDataType_t)dataType, dims);
+        pROI->getInfo(&roiInfo);
+        pData = (double *)pROI->pData;
+        for (i=0; i<roiInfo.nElements; i++) pData[i] = pData[i]/pDef->scale;
+        this->pNDArrayPool->convert(pROI, &pOutput, (NDDataType_t)pDef->dataType);
+        pROI->release();
+        if (!pOutput) return NULL;
     }
 
     /* If we selected just one color from the array, then we need to collapse the
      * dimensions and set the color mode to mono */
     colorMode = NDColorModeMono;
     if ((pOutput->ndims == 3) && 
-        (arrayInfo.colorMode == NDColorModeRGB1) && 
+        (pArrayInfo->colorMode == NDColorModeRGB1) && 
         (pOutput->dims[0].size == 1)) 
     {
         collapseDims = 1;
         pOutput->pAttributeList->add("ColorMode", "Color mode", NDAttrInt32, &colorMode);
     }
     else if ((pOutput->ndims == 3) && 
-        (arrayInfo.colorMode == NDColorModeRGB2) && 
+        (pArrayInfo->colorMode == NDColorModeRGB2) && 
         (pOutput->dims[1].size == 1)) 
     {
         collapseDims = 1;
         pOutput->pAttributeList->add("ColorMode", "Color mode", NDAttrInt32, &colorMode);
     }
     else if ((pOutput->ndims == 3) && 
-        (arrayInfo.colorMode == NDColorModeRGB3) && 
+        (pArrayInfo->colorMode == NDColorModeRGB3) && 
         (pOutput->dims[2].size == 1)) 
     {
         collapseDims = 1;
@@ -222,20 +555,68 @@ void NDPluginROI::processCallbacks(NDArray *pArray)
             }
         }
     }
-    this->lock();
+    return pOutput;
+}
 
-    /* Set the image size of the ROI image data */
-    setIntegerParam(NDArraySizeX, 0);
-    setIntegerParam(NDArraySizeY, 0);
-    setIntegerParam(NDArraySizeZ, 0);
-    if (pOutput->ndims > 0) setIntegerParam(NDArraySizeX, (int)pOutput->dims[userDims[0]].size);
-    if (pOutput->ndims > 1) setIntegerParam(NDArraySizeY, (int)pOutput->dims[userDims[1]].size);
-    if (pOutput->ndims > 2) setIntegerParam(NDArraySizeZ, (int)pOutput->dims[userDims[2]].size);
+/** Returns 1 if a client is registered for NDArray callbacks on the address of an ROI, 0 otherwise.
+  * Must be called with the lock held.
+  * \param[in] roi The ROI.
+  */
+int NDPluginROI::hasArrayClients(int roi)
+{
+    ELLLIST *pclientList;
+    interruptNode *pnode;
+    asynGenericPointerInterrupt *pInterrupt;
+    int addr;
+    int found = 0;
+
+    pasynManager->interruptStart(this->asynStdInterfaces.genericPointerInterruptPvt, &pclientList);
+    for (pnode = (interruptNode *)ellFirst(pclientList); pnode; pnode = (interruptNode *)ellNext(&pnode->node)) {
+        pInterrupt = (asynGenericPointerInterrupt *)pnode->drvPvt;
+        pasynManager->getAddr(pInterrupt->pasynUser, &addr);
+        if ((pInterrupt->pasynUser->reason == NDArrayData) && (addr == roi)) {
+            found = 1;
+            break;
+        }
+    }
+    pasynManager->interruptEnd(this->asynStdInterfaces.genericPointerInterruptPvt);
+    return found;
+}
 
-    NDPluginDriver::endProcessCallbacks(pOutput, false, true);
+/** Passes the output array of one ROI to the plugins connected to the asyn address of the ROI.
+  * ROI 0 is passed on by NDPluginDriver::endProcessCallbacks(), so it is sorted if SortMode is set.
+  * This must be called with the mutex locked.
+  * \param[in] roi The ROI, which is also its asyn address.
+  * \param[in] pOutput The output array, which this function takes ownership of; may be NULL.
+  * \param[in] userDims The X, Y and color dimensions of the input array.
+  */
+void NDPluginROI::doROICallbacks(int roi, NDArray *pOutput, size_t *userDims)
+{
+    int arrayCallbacks;
 
-    callParamCallbacks();
+    /* Set the image size of the ROI image data */
+    setIntegerParam(roi, NDArraySizeX, 0);
+    setIntegerParam(roi, NDArraySizeY, 0);
+    setIntegerParam(roi, NDArraySizeZ, 0);
+    if (pOutput) {
+        if (pOutput->ndims > 0) setIntegerParam(roi, NDArraySizeX, (int)pOutput->dims[userDims[0]].size);
+        if (pOutput->ndims > 1) setIntegerParam(roi, NDArraySizeY, (int)pOutput->dims[userDims[1]].size);
+        if (pOutput->ndims > 2) setIntegerParam(roi, NDArraySizeZ, (int)pOutput->dims[userDims[2]].size);
+
+        if (roi == 0) {
+            NDPluginDriver::endProcessCallbacks(pOutput, false, true);
+        } else {
+            getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+            if (arrayCallbacks) {
+                this->getAttributes(pOutput->pAttributeList);
+                doCallbacksGenericPointer(pOutput, NDArrayData, roi);
+            }
+            if (this->pArrays[roi]) this->pArrays[roi]->release();
+            this->pArrays[roi] = pOutput;
+        }
+    }
 
+    callParamCallbacks(roi);
 }
 
 /** Called when asyn clients call pasynInt32->write().
@@ -248,23 +629,26 @@ asynStatus NDPluginROI::writeInt32(asynUser *pasynUser, epicsInt32 value)
 {
     int function = pasynUser->reason;
     asynStatus status = asynSuccess;
+    int roi;
     static const char* functionName = "writeInt32";
 
+    getAddress(pasynUser, &roi);
+
     /* Set the parameter in the parameter library. */
-    status = (asynStatus) setIntegerParam(function, value);
+    status = (asynStatus) setIntegerParam(roi, function, value);
 
     if        (function == NDPluginROIDim0Min) {
-        requestedOffset_[0] = value;
+        requestedOffset_[3*roi + 0] = value;
     } else if (function == NDPluginROIDim1Min) {
-        requestedOffset_[1] = value;
+        requestedOffset_[3*roi + 1] = value;
     } else if (function == NDPluginROIDim2Min) {
-        requestedOffset_[2] = value;
+        requestedOffset_[3*roi + 2] = value;
     } else if (function == NDPluginROIDim0Size) {
-        requestedSize_[0] = value;
+        requestedSize_[3*roi + 0] = value;
     } else if (function == NDPluginROIDim1Size) {
-        requestedSize_[1] = value;
+        requestedSize_[3*roi + 1] = value;
     } else if (function == NDPluginROIDim2Size) {
-        requestedSize_[2] = value;
+        requestedSize_[3*roi + 2] = value;
     } else {
         /* If this parameter belongs to a base class call its method */
         if (function < FIRST_NDPLUGIN_ROI_PARAM) 
@@ -272,7 +656,7 @@ asynStatus NDPluginROI::writeInt32(asynUser *pasynUser, epicsInt32 value)
     }
     
     /* Do callbacks so higher layers see any changes */
-    callParamCallbacks();
+    callParamCallbacks(roi);
     
     const char* paramName;
     if (status) {
@@ -312,17 +696,22 @@ asynStatus NDPluginROI::writeInt32(asynUser *pasynUser, epicsInt32 value)
   * \param[in] priority The thread priority for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
   * \param[in] stackSize The stack size for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
   * \param[in] maxThreads The maximum number of threads this driver is allowed to use. If 0 then 1 will be used.
+  * \param[in] maxROIs The number of ROIs this plugin extracts, each is defined and output on its own asyn address.
+  *            If 0 then 1 will be used.
   */
 NDPluginROI::NDPluginROI(const char *portName, int queueSize, int blockingCallbacks,
                          const char *NDArrayPort, int NDArrayAddr,
                          int maxBuffers, size_t maxMemory,
-                         int priority, int stackSize, int maxThreads)
+                         int priority, int stackSize, int maxThreads, int maxROIs)
     /* Invoke the base class constructor */
     : NDPluginDriver(portName, queueSize, blockingCallbacks,
-                   NDArrayPort, NDArrayAddr, 1, maxBuffers, maxMemory,
+                   NDArrayPort, NDArrayAddr, MAX(maxROIs, 1), maxBuffers, maxMemory,
                    asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask,
                    asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask,
-                   ASYN_MULTIDEVICE, 1, priority, stackSize, maxThreads)
+                   ASYN_MULTIDEVICE, 1, priority, stackSize, maxThreads),
+      maxROIs_(MAX(maxROIs, 1)),
+      requestedSize_(3*maxROIs_, 0),
+      requestedOffset_(3*maxROIs_, 0)
 {
     //static const char *functionName = "NDPluginROI";
 
@@ -359,6 +748,27 @@ NDPluginROI::NDPluginROI(const char *portName, int queueSize, int blockingCallba
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginROI");
 
+    /* Set the defaults for each ROI; the whole array is output until the ROI is defined */
+    for (int roi=0; roi<maxROIs_; roi++) {
+        setIntegerParam(roi, NDPluginROIDim0Bin,      1);
+        setIntegerParam(roi, NDPluginROIDim1Bin,      1);
+        setIntegerParam(roi, NDPluginROIDim2Bin,      1);
+        setIntegerParam(roi, NDPluginROIDim0Reverse,  0);
+        setIntegerParam(roi, NDPluginROIDim1Reverse,  0);
+        setIntegerParam(roi, NDPluginROIDim2Reverse,  0);
+        setIntegerParam(roi, NDPluginROIDim0Enable,   0);
+        setIntegerParam(roi, NDPluginROIDim1Enable,   0);
+        setIntegerParam(roi, NDPluginROIDim2Enable,   0);
+        setIntegerParam(roi, NDPluginROIDim0AutoSize, 0);
+        setIntegerParam(roi, NDPluginROIDim1AutoSize, 0);
+        setIntegerParam(roi, NDPluginROIDim2AutoSize, 0);
+        setIntegerParam(roi, NDPluginROIDataType,     -1);
+        setIntegerParam(roi, NDPluginROIEnableScale,  0);
+        setDoubleParam (roi, NDPluginROIScale,        1.0);
+        setIntegerParam(roi, NDPluginROICollapseDims, 0);
+        callParamCallbacks(roi);
+    }
+
     /* Try to connect to the array port */
     connectToArrayPort();
 }
@@ -367,10 +777,10 @@ NDPluginROI::NDPluginROI(const char *portName, int queueSize, int blockingCallba
 extern "C" int NDROIConfigure(const char *portName, int queueSize, int blockingCallbacks,
                                  const char *NDArrayPort, int NDArrayAddr,
                                  int maxBuffers, size_t maxMemory,
-                                 int priority, int stackSize, int maxThreads)
+                                 int priority, int stackSize, int maxThreads, int maxROIs)
 {
     NDPluginROI *pPlugin = new NDPluginROI(portName, queueSize, blockingCallbacks, NDArrayPort, NDArrayAddr,
-                                           maxBuffers, maxMemory, priority, stackSize, maxThreads);
+                                           maxBuffers, maxMemory, priority, stackSize, maxThreads, maxROIs);
     return pPlugin->start();
 }
 
@@ -385,6 +795,7 @@ static const iocshArg initArg6 = { "maxMemory",iocshArgInt};
 static const iocshArg initArg7 = { "priority",iocshArgInt};
 static const iocshArg initArg8 = { "stackSize",iocshArgInt};
 static const iocshArg initArg9 = { "maxThreads",iocshArgInt};
+static const iocshArg initArg10 = { "maxROIs",iocshArgInt};
 static const iocshArg * const initArgs[] = {&initArg0,
                                             &initArg1,
                                             &initArg2,
@@ -394,14 +805,15 @@ static const iocshArg * const initArgs[] = {&initArg0,
                                             &initArg6,
                                             &initArg7,
                                             &initArg8,
-                                            &initArg9};
-static const iocshFuncDef initFuncDef = {"NDROIConfigure",10,initArgs};
+                                            &initArg9,
+                                            &initArg10};
+static const iocshFuncDef initFuncDef = {"NDROIConfigure",11,initArgs};
 static void initCallFunc(const iocshArgBuf *args)
 {
     NDROIConfigure(args[0].sval, args[1].ival, args[2].ival,
                    args[3].sval, args[4].ival, args[5].ival,
                    args[6].ival, args[7].ival, args[8].ival,
-                   args[9].ival);
+                   args[9].ival, args[10].ival);
 }
 
 extern "C" void NDROIRegister(void)
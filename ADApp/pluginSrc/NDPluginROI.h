@@ -1,6 +1,8 @@
 #ifndef NDPluginROI_H
 #define NDPluginROI_H
 
+#include <vector>
+
 #include "NDPluginDriver.h"
 
 /* ROI general parameters */
@@ -33,15 +35,25 @@
 #define NDPluginROIScaleString              "SCALE_VALUE"       /* (asynFloat64, r/w) Scaling value, used as divisor */
 #define NDPluginROICollapseDimsString       "COLLAPSE_DIMS"     /* (asynInt32,   r/w) Collapse dimensions of size 1 */
 
+/** Definition of one ROI for the NDArray being processed, in the order of the NDArray dimensions */
+typedef struct {
+    NDDimension_t dims[ND_ARRAY_MAX_DIMS];
+    int dataType;
+    int enableScale;
+    double scale;
+    int collapseDims;
+} NDROIDefinition_t;
+
 /** Extract Regions-Of-Interest (ROI) from NDArray data; the plugin can be a source of NDArray callbacks for
   * other plugins, passing these sub-arrays. 
-  * The plugin also optionally computes a statistics on the ROI. */
+  * The plugin can extract several ROIs, each is defined on its own asyn address and is passed to the
+  * plugins that connect to that address. */
 class epicsShareClass NDPluginROI : public NDPluginDriver {
 public:
     NDPluginROI(const char *portName, int queueSize, int blockingCallbacks, 
                  const char *NDArrayPort, int NDArrayAddr,
                  int maxBuffers, size_t maxMemory,
-                 int priority, int stackSize, int maxThreads);
+                 int priority, int stackSize, int maxThreads, int maxROIs=1);
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
     asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
@@ -79,8 +91,18 @@ protected:
     int NDPluginROICollapseDims;
 
 private:
-    int requestedSize_[3];
-    int requestedOffset_[3];
+    void getROIDefinition(int roi, NDArray *pArray, NDArrayInfo *pArrayInfo, size_t *userDims,
+                          NDROIDefinition_t *pDef);
+    NDArray *allocROI(NDArray *pArray, NDROIDefinition_t *pDef, NDDataType_t dataType);
+    void extractROIs(NDArray *pArray, NDArrayInfo *pArrayInfo, NDROIDefinition_t *pDefs, int *useROI,
+                     NDArray **pROIs);
+    int hasArrayClients(int roi);
+    NDArray *finishROI(NDArray *pROI, NDArrayInfo *pArrayInfo, NDROIDefinition_t *pDef);
+    void doROICallbacks(int roi, NDArray *pOutput, size_t *userDims);
+
+    int maxROIs_;
+    std::vector<int> requestedSize_;    /* Requested size of each ROI, 3 elements per ROI */
+    std::vector<int> requestedOffset_;  /* Requested offset of each ROI, 3 elements per ROI */
 };
     
 #endif
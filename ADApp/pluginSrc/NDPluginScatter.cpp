@@ -8,6 +8,7 @@
  */
 
 #include <stdlib.h>
+#include <algorithm>
 
 #include <epicsTypes.h>
 #include <epicsMessageQueue.h>
@@ -23,6 +24,15 @@
 
 static const char *driverName="NDPluginScatter";
 
+/* Orders client indices by increasing load */
+class loadLess {
+public:
+    loadLess(const std::vector<double>& loads) : loads_(loads) {}
+    bool operator()(int lhs, int rhs) const { return loads_[lhs] < loads_[rhs]; }
+private:
+    const std::vector<double>& loads_;
+};
+
 /** 
   * \param[in] pArray  The NDArray from the callback.
   */
@@ -33,6 +43,9 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
      * structures don't need to be protected.
      */
     int arrayCallbacks;
+    int method;
+    int target;
+    NDArray *pArrayOut;
 
     static const char *functionName = "NDPluginScatter::processCallbacks";
 
@@ -40,59 +53,162 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
     NDPluginDriver::beginProcessCallbacks(pArray);
 
     getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+    getIntegerParam(NDPluginScatterMethod, &method);
     if (arrayCallbacks == 1) {
-        NDArray *pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 1);
-        if (NULL != pArrayOut) {
+        /* The input array is passed on by reference unless this plugin has attributes of its own.
+         * These must not be added to the input array, which other plugins may also be using,
+         * so they are added to an array that shares the input data but has its own attributes.
+         * Downstream plugins get the input data in either case, and must not modify it unless they own it
+         * (see NDPluginOverlay). */
+        if (this->pAttributeList->count() > 0) {
+            pArrayOut = this->pNDArrayPool->share(pArray);
+            if (NULL == pArrayOut) {
+                asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+                    "%s::%s: Couldn't allocate output array. Further processing terminated.\n", 
+                    driverName, functionName);
+                return;
+            }
             this->getAttributes(pArrayOut->pAttributeList);
-            this->unlock();
-            doNDArrayCallbacks(pArrayOut, NDArrayData, 0);
-            this->lock();
-            if (this->pArrays[0]) this->pArrays[0]->release();
-            this->pArrays[0] = pArrayOut;
+        } else {
+            pArray->reserve();
+            pArrayOut = pArray;
         }
-        else {
-            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
-                "%s::%s: Couldn't allocate output array. Further processing terminated.\n", 
-                driverName, functionName);
+        this->unlock();
+        target = doNDArrayCallbacks(pArrayOut, NDArrayData, 0, method);
+        this->lock();
+        if (this->pArrays[0]) this->pArrays[0]->release();
+        this->pArrays[0] = pArrayOut;
+        if (targetsChanged_) updateTargets();
+        if (target >= 0) {
+            targetCounts_[target]++;
+            doCallbacksInt32Array(&targetCounts_[0], targetCounts_.size(), NDPluginScatterTargetCounts, 0);
         }
     }
 }
 
-/** Called by driver to do the callbacks to the next registered client on the asynGenericPointer interface.
+/** Resets the per-client counters after the set of clients changes.
+  * Called with the lock held. */
+void NDPluginScatter::updateTargets()
+{
+    targetCounts_.assign(targets_.size(), 0);
+    setIntegerParam(NDPluginScatterNumTargets, (int)targets_.size());
+    setStringParam(NDPluginScatterTargets, targetNames_.c_str());
+    if (!targetCounts_.empty())
+        doCallbacksInt32Array(&targetCounts_[0], targetCounts_.size(), NDPluginScatterTargetCounts, 0);
+    targetsChanged_ = false;
+}
+
+/** Called by driver to do the callbacks to one registered client on the asynGenericPointer interface.
+  * The clients are tried in order of preference until one of them accepts the array; only the last one
+  * can drop it.  With NDScatterRoundRobin the order starts at the client after the one that was first choice last time.
+  * With NDScatterLeastQueued and NDScatterShortestCompletion the clients that are plugins are ordered
+  * by the number of NDArrays in their input queue, or by that number plus one times their execution time
+  * divided by their number of threads.  Clients with equal load are taken in round-robin order.
   * \param[in] pArray Pointer to the NDArray 
   * \param[in] reason A client will be called if reason matches pasynUser->reason registered for that client.
-  * \param[in] address A client will be called if address matches the address registered for that client. */
-asynStatus NDPluginScatter::doNDArrayCallbacks(NDArray *pArray, int reason, int address)
+  * \param[in] address A client will be called if address matches the address registered for that client.
+  * \param[in] method The NDScatterMethod_t used to choose the client.
+  * \return The index of the client that accepted the array in the list of clients, or -1 if none did. */
+int NDPluginScatter::doNDArrayCallbacks(NDArray *pArray, int reason, int address, int method)
 {
     ELLLIST *pclientList;
     interruptNode *pnode;
+    asynGenericPointerInterrupt *pInterrupt;
+    NDPluginDriver *pPlugin;
     int addr;
-    int numNodes;
+    int numClients;
+    int queuePending, numThreads;
+    double executionTime;
+    int target = -1;
     int i;
     //static const char *functionName = "doNDArrayCallbacks";
 
     pasynManager->interruptStart(this->asynStdInterfaces.genericPointerInterruptPvt, &pclientList);
-    numNodes = ellCount(pclientList);
-    for (i=0; i<numNodes; i++) {
-        if (nextClient_ > numNodes) nextClient_ = 1;
-        pnode = (interruptNode *)ellNth(pclientList, nextClient_);
-        nextClient_++;
-        asynGenericPointerInterrupt *pInterrupt = (asynGenericPointerInterrupt *)pnode->drvPvt;
+    clients_.clear();
+    for (pnode = (interruptNode *)ellFirst(pclientList); pnode; pnode = (interruptNode *)ellNext(&pnode->node)) {
+        pInterrupt = (asynGenericPointerInterrupt *)pnode->drvPvt;
         pasynManager->getAddr(pInterrupt->pasynUser, &addr);
         /* If this is not a multi-device then address is -1, change to 0 */
         if (addr == -1) addr = 0;
         if ((pInterrupt->pasynUser->reason != reason) || (address != addr)) continue;
+        clients_.push_back(pInterrupt);
+    }
+    numClients = (int)clients_.size();
+
+    /* Keep track of which clients the counters refer to */
+    bool changed = ((int)targets_.size() != numClients);
+    for (i=0; !changed && i<numClients; i++) {
+        changed = (targets_[i] != clients_[i]->pasynUser);
+    }
+    if (changed) {
+        targets_.resize(numClients);
+        targetNames_.clear();
+        for (i=0; i<numClients; i++) {
+            targets_[i] = clients_[i]->pasynUser;
+            pPlugin = NDPluginDriver::getCallbackPlugin(clients_[i]);
+            if (i > 0) targetNames_ += ",";
+            targetNames_ += pPlugin ? pPlugin->portName : "?";
+        }
+        targetsChanged_ = true;
+    }
+
+    if (numClients > 0) {
+        if (nextClient_ >= numClients) nextClient_ = 0;
+        order_.resize(numClients);
+        for (i=0; i<numClients; i++) {
+            order_[i] = (nextClient_ + i) % numClients;
+        }
+        nextClient_++;
+        if (method != NDScatterRoundRobin) {
+            loads_.assign(numClients, 0.);
+            for (i=0; i<numClients; i++) {
+                pPlugin = NDPluginDriver::getCallbackPlugin(clients_[i]);
+                if (!pPlugin) continue;
+                pPlugin->getQueueStatus(&queuePending, &numThreads, &executionTime);
+                if (method == NDScatterLeastQueued) {
+                    loads_[i] = queuePending;
+                } else {
+                    loads_[i] = (queuePending + 1) * executionTime / std::max(numThreads, 1);
+                }
+            }
+            std::stable_sort(order_.begin(), order_.end(), loadLess(loads_));
+        }
+    }
+
+    for (i=0; i<numClients; i++) {
+        pInterrupt = clients_[order_[i]];
         /* Set pasynUser->auxStatus to asynOverflow.  
          * This is a flag that means return without generating an error if the queue is full.
          * We don't set this for the last node because if the last node cannot queue the array
          * then the array will be dropped */
         pInterrupt->pasynUser->auxStatus = asynOverflow;
-        if (i == numNodes-1) pInterrupt->pasynUser->auxStatus = asynSuccess;
+        if (i == numClients-1) pInterrupt->pasynUser->auxStatus = asynSuccess;
         pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, pArray);
-        if (pInterrupt->pasynUser->auxStatus == asynSuccess) break;
+        if (pInterrupt->pasynUser->auxStatus == asynSuccess) {
+            target = order_[i];
+            break;
+        }
     }
     pasynManager->interruptEnd(this->asynStdInterfaces.genericPointerInterruptPvt);
-    return asynSuccess;
+    return target;
+}
+
+/** Called when asyn clients call pasynInt32->write().
+  * This function performs actions for some parameters, including SCATTER_RESET_COUNTS.
+  * For other parameters it calls NDPluginDriver::writeInt32.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[in] value Value to write. */
+asynStatus NDPluginScatter::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    int function = pasynUser->reason;
+
+    if (function == NDPluginScatterResetCounts) {
+        std::fill(targetCounts_.begin(), targetCounts_.end(), 0);
+        if (!targetCounts_.empty())
+            doCallbacksInt32Array(&targetCounts_[0], targetCounts_.size(), NDPluginScatterTargetCounts, 0);
+        return asynSuccess;
+    }
+    return NDPluginDriver::writeInt32(pasynUser, value);
 }
 
 /** Constructor for NDPluginScatter; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
@@ -123,11 +239,18 @@ NDPluginScatter::NDPluginScatter(const char *portName, int queueSize, int blocki
                    asynInt32ArrayMask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
                    asynInt32ArrayMask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
                    ASYN_MULTIDEVICE, 1, priority, stackSize, 1),
-    nextClient_(1)
+    nextClient_(0), targetsChanged_(false)
 {
     //static const char *functionName = "NDPluginScatter::NDPluginScatter";
 
     createParam(NDPluginScatterMethodString,         asynParamInt32,        &NDPluginScatterMethod);
+    createParam(NDPluginScatterNumTargetsString,     asynParamInt32,        &NDPluginScatterNumTargets);
+    createParam(NDPluginScatterTargetsString,        asynParamOctet,        &NDPluginScatterTargets);
+    createParam(NDPluginScatterTargetCountsString,   asynParamInt32Array,   &NDPluginScatterTargetCounts);
+    createParam(NDPluginScatterResetCountsString,    asynParamInt32,        &NDPluginScatterResetCounts);
+
+    setIntegerParam(NDPluginScatterNumTargets, 0);
+    setStringParam(NDPluginScatterTargets, "");
 
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginScatter");
@@ -1,10 +1,24 @@
 #ifndef NDPluginScatter_H
 #define NDPluginScatter_H
 
+#include <string>
+#include <vector>
+
 #include "NDPluginDriver.h"
 
+/** Algorithms for choosing the client that receives the next NDArray */
+typedef enum {
+    NDScatterRoundRobin,        /**< Clients in turn */
+    NDScatterLeastQueued,       /**< Client with the fewest NDArrays in its input queue */
+    NDScatterShortestCompletion /**< Client with the shortest expected time to process its queue and the new NDArray */
+} NDScatterMethod_t;
+
 /* General parameters */
 #define NDPluginScatterMethodString          "SCATTER_METHOD"            /* (asynInt32,        r/w) Algorithm for scatter */
+#define NDPluginScatterNumTargetsString      "SCATTER_NUM_TARGETS"       /* (asynInt32,        r/o) Number of callback clients */
+#define NDPluginScatterTargetsString         "SCATTER_TARGETS"           /* (asynOctet,        r/o) Port names of the clients, in the order of SCATTER_TARGET_COUNTS */
+#define NDPluginScatterTargetCountsString    "SCATTER_TARGET_COUNTS"     /* (asynInt32Array,   r/o) Number of NDArrays passed to each client */
+#define NDPluginScatterResetCountsString     "SCATTER_RESET_COUNTS"      /* (asynInt32,        r/w) Reset SCATTER_TARGET_COUNTS */
 
 /** A plugin that does callbacks in round-robin fashion rather than passing every NDArray to every callback client  */
 class epicsShareClass NDPluginScatter : public NDPluginDriver {
@@ -15,14 +29,27 @@ public:
                       int priority, int stackSize);
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
+    asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
 
 protected:
     int NDPluginScatterMethod;
     #define FIRST_NDPLUGIN_SCATTER_PARAM NDPluginScatterMethod
+    int NDPluginScatterNumTargets;
+    int NDPluginScatterTargets;
+    int NDPluginScatterTargetCounts;
+    int NDPluginScatterResetCounts;
                                 
 private:
     int nextClient_;
-    asynStatus doNDArrayCallbacks(NDArray *pArray, int reason, int addr);
+    std::vector<asynGenericPointerInterrupt *> clients_;  /* Clients matching reason and address, in list order */
+    std::vector<asynUser *> targets_;                     /* Clients that targetCounts_ refers to */
+    std::vector<epicsInt32> targetCounts_;
+    std::vector<int> order_;                              /* Indices into clients_ in order of preference */
+    std::vector<double> loads_;
+    std::string targetNames_;
+    bool targetsChanged_;
+    int doNDArrayCallbacks(NDArray *pArray, int reason, int addr, int method);
+    void updateTargets();
 };
     
 #endif
@@ -28,43 +28,279 @@
 
 static const char *driverName="NDPluginStdArrays";
 
+static void flushTaskC(void *drvPvt)
+{
+    NDPluginStdArrays *pPvt = (NDPluginStdArrays *)drvPvt;
+
+    pPvt->flushTask();
+}
+
+/** Extracts the region and does the decimation described by pDec, converting the data to epicsTypeOut.
+  * \param[in] pIn The input array.
+  * \param[in] pDec The region and decimation.
+  * \param[out] pOut The output buffer, which must hold pDec->nElements values. */
+template <typename epicsTypeIn, typename epicsTypeOut>
+static void decimateArray(NDArray *pIn, NDStdArraysDecimation_t *pDec, epicsTypeOut *pOut)
+{
+    epicsTypeIn *pDataIn = (epicsTypeIn *)pIn->pData;
+    size_t nx = pDec->outSize[0];
+    size_t decX = pDec->decimate[0], decY = pDec->decimate[1];
+    size_t strideX = pDec->inStride[0], strideY = pDec->inStride[1];
+    size_t x, y, c, ix, iy;
+
+    if (pDec->passThrough) {
+        for (x=0; x<pDec->nElements; x++) {
+            pOut[x] = (epicsTypeOut)pDataIn[x];
+        }
+        return;
+    }
+    if (pDec->mode == NDStdArraysDecimateMinMax) nx /= 2;
+
+    for (c=0; c<pDec->outSize[2]; c++) {
+        for (y=0; y<pDec->outSize[1]; y++) {
+            epicsTypeIn *pRow = pDataIn + (pDec->start[2] + c)*pDec->inStride[2] +
+                                          (pDec->start[1] + y*decY)*strideY +
+                                           pDec->start[0]*strideX;
+            epicsTypeOut *pRowOut = pOut + c*pDec->outStride[2] + y*pDec->outStride[1];
+            size_t outStrideX = pDec->outStride[0];
+
+            switch (pDec->mode) {
+                case NDStdArraysDecimateAverage: {
+                    double scale = 1./(decX*decY);
+                    for (x=0; x<nx; x++) {
+                        epicsTypeIn *pBlock = pRow + x*decX*strideX;
+                        double sum = 0;
+                        for (iy=0; iy<decY; iy++) {
+                            for (ix=0; ix<decX; ix++) {
+                                sum += pBlock[iy*strideY + ix*strideX];
+                            }
+                        }
+                        pRowOut[x*outStrideX] = (epicsTypeOut)(sum*scale);
+                    }
+                    break;
+                }
+                case NDStdArraysDecimateMinMax:
+                    for (x=0; x<nx; x++) {
+                        epicsTypeIn *pBlock = pRow + x*decX*strideX;
+                        epicsTypeIn vMin = *pBlock, vMax = *pBlock;
+                        for (iy=0; iy<decY; iy++) {
+                            for (ix=0; ix<decX; ix++) {
+                                epicsTypeIn value = pBlock[iy*strideY + ix*strideX];
+                                if (value < vMin) vMin = value;
+                                if (value > vMax) vMax = value;
+                            }
+                        }
+                        pRowOut[2*x*outStrideX]     = (epicsTypeOut)vMin;
+                        pRowOut[(2*x+1)*outStrideX] = (epicsTypeOut)vMax;
+                    }
+                    break;
+                default:
+                    for (x=0; x<nx; x++) {
+                        pRowOut[x*outStrideX] = (epicsTypeOut)pRow[x*decX*strideX];
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+template <typename epicsTypeOut>
+static int decimateArraySwitch(NDArray *pIn, NDStdArraysDecimation_t *pDec, epicsTypeOut *pOut)
+{
+    int status = ND_SUCCESS;
+
+    switch(pIn->dataType) {
+        case NDInt8:
+            decimateArray<epicsInt8, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        case NDUInt8:
+            decimateArray<epicsUInt8, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        case NDInt16:
+            decimateArray<epicsInt16, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        case NDUInt16:
+            decimateArray<epicsUInt16, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        case NDInt32:
+            decimateArray<epicsInt32, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        case NDUInt32:
+            decimateArray<epicsUInt32, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        case NDFloat32:
+            decimateArray<epicsFloat32, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        case NDFloat64:
+            decimateArray<epicsFloat64, epicsTypeOut> (pIn, pDec, pOut);
+            break;
+        default:
+            status = ND_ERROR;
+            break;
+    }
+    return(status);
+}
+
+/** Computes the region and decimation to apply to an NDArray from the current parameter values.
+  * Arrays with more than 3 dimensions are treated as 1-D arrays.
+  * This method must be called with the mutex locked.
+  * \param[in] pArray The NDArray.
+  * \param[out] pDec The region and decimation. */
+void NDPluginStdArrays::computeDecimation(NDArray *pArray, NDStdArraysDecimation_t *pDec)
+{
+    NDArrayInfo_t arrayInfo;
+    size_t inSize[3];
+    int min[2], size[2], decimate[2];
+    int i, j, order[3];
+
+    pArray->getInfo(&arrayInfo);
+    getIntegerParam(NDPluginStdArraysMinX,         &min[0]);
+    getIntegerParam(NDPluginStdArraysMinY,         &min[1]);
+    getIntegerParam(NDPluginStdArraysSizeX,        &size[0]);
+    getIntegerParam(NDPluginStdArraysSizeY,        &size[1]);
+    getIntegerParam(NDPluginStdArraysDecimateX,    &decimate[0]);
+    getIntegerParam(NDPluginStdArraysDecimateY,    &decimate[1]);
+    getIntegerParam(NDPluginStdArraysDecimateMode, &pDec->mode);
+
+    if ((pArray->ndims < 1) || (pArray->ndims > 3)) {
+        inSize[0] = arrayInfo.nElements;
+        inSize[1] = 1;
+        inSize[2] = 1;
+        pDec->inStride[0] = 1;
+        pDec->inStride[1] = arrayInfo.nElements;
+        pDec->inStride[2] = arrayInfo.nElements;
+    } else {
+        inSize[0] = arrayInfo.xSize;
+        inSize[1] = (pArray->ndims > 1) ? arrayInfo.ySize : 1;
+        inSize[2] = (pArray->ndims > 2) ? arrayInfo.colorSize : 1;
+        pDec->inStride[0] = arrayInfo.xStride;
+        pDec->inStride[1] = (pArray->ndims > 1) ? arrayInfo.yStride : arrayInfo.nElements;
+        pDec->inStride[2] = (pArray->ndims > 2) ? arrayInfo.colorStride : arrayInfo.nElements;
+    }
+
+    pDec->passThrough = true;
+    for (i=0; i<2; i++) {
+        if (min[i] < 0) min[i] = 0;
+        if ((size_t)min[i] >= inSize[i]) min[i] = (inSize[i] > 0) ? (int)inSize[i] - 1 : 0;
+        if ((size[i] <= 0) || ((size_t)(min[i] + size[i]) > inSize[i])) size[i] = (int)inSize[i] - min[i];
+        if (decimate[i] < 1) decimate[i] = 1;
+        if (decimate[i] > size[i]) decimate[i] = (size[i] > 0) ? size[i] : 1;
+        pDec->start[i]    = min[i];
+        pDec->decimate[i] = decimate[i];
+        pDec->outSize[i]  = size[i] / decimate[i];
+        if ((min[i] != 0) || ((size_t)size[i] != inSize[i]) || (decimate[i] != 1)) pDec->passThrough = false;
+    }
+    /* Min/max mode always doubles the X size, even without decimation */
+    if (pDec->mode == NDStdArraysDecimateMinMax) pDec->passThrough = false;
+    pDec->start[2]    = 0;
+    pDec->decimate[2] = 1;
+    pDec->outSize[2]  = inSize[2];
+    if (pDec->passThrough) {
+        pDec->nElements = arrayInfo.nElements;
+    } else {
+        if (pDec->mode == NDStdArraysDecimateMinMax) pDec->outSize[0] *= 2;
+        pDec->nElements = pDec->outSize[0] * pDec->outSize[1] * pDec->outSize[2];
+    }
+
+    /* The output keeps the same ordering of X, Y and color as the input */
+    for (i=0; i<3; i++) order[i] = i;
+    for (i=1; i<3; i++) {
+        for (j=i; (j>0) && (pDec->inStride[order[j]] < pDec->inStride[order[j-1]]); j--) {
+            int temp = order[j]; order[j] = order[j-1]; order[j-1] = temp;
+        }
+    }
+    pDec->outStride[order[0]] = 1;
+    pDec->outStride[order[1]] = pDec->outSize[order[0]];
+    pDec->outStride[order[2]] = pDec->outSize[order[0]] * pDec->outSize[order[1]];
+
+    setIntegerParam(NDPluginStdArraysOutSizeX, (int)pDec->outSize[0]);
+    setIntegerParam(NDPluginStdArraysOutSizeY, (int)pDec->outSize[1]);
+}
+
+/** Does the callbacks to the clients of one asynXXXArray interface.
+  * \param[in] pArray The NDArray.
+  * \param[in] pDec The region and decimation.
+  * \param[in] pNow The time of this callback.
+  * \param[in] minUpdateTime The minimum time between callbacks to each client.
+  * \param[in] pendingOnly Only do callbacks to the clients that were skipped because of minUpdateTime
+  *            and are now due.  This is used to send them the last array after arrays stop arriving.
+  * \param[out] clientUpdates The state of each client that is registered on this interface is added to
+  *             this map. It replaces lastUpdate_ when all of the interfaces have been done, so clients
+  *             that have gone away are removed.
+  * \param[in,out] pNextUpdate Reduced to the time until the next skipped client is due.
+  * \param[in] interruptPvt The interrupt list of the interface.
+  * \param[in] signedType The NDArray data type that is passed to the interface without conversion. */
 template <typename epicsType, typename interruptType>
-void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pNDArrayPool, 
-                            void *interruptPvt, int *initialized, NDDataType_t signedType)
+void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDStdArraysDecimation_t *pDec,
+                            epicsTimeStamp *pNow, double minUpdateTime,
+                            bool pendingOnly, std::map<asynUser*, NDStdArraysClient_t>& clientUpdates,
+                            double *pNextUpdate, void *interruptPvt, NDDataType_t signedType)
 {
     ELLLIST *pclientList;
     interruptNode *pnode;
     int status;
+    double elapsed;
     epicsType *pData=NULL;
-    NDArray *pOutput=NULL;
-    NDArrayInfo_t arrayInfo;
+    NDStdArraysClient_t *pClient;
+    std::map<asynUser*, NDStdArraysClient_t>::iterator it;
 
     pasynManager->interruptStart(interruptPvt, &pclientList);
     pnode = (interruptNode *)ellFirst(pclientList);
     while (pnode) {
         interruptType *pInterrupt = (interruptType *)pnode->drvPvt;
-        if (pInterrupt->pasynUser->reason == NDPluginStdArraysData) {
-            if (!*initialized) {
-                *initialized = 1;
-                pArray->getInfo(&arrayInfo);
-                status = pNDArrayPool->convert(pArray, &pOutput, signedType);
-                if (status) {
-                    asynPrint(pInterrupt->pasynUser, ASYN_TRACE_ERROR,
-                              "%s::arrayInterruptCallback: error allocating array in convert()\n",
-                               driverName);
-                    break;
+        bool due = (pInterrupt->pasynUser->reason == NDPluginStdArraysData) && (pDec->nElements > 0);
+        if (due && ((minUpdateTime > 0) || pendingOnly)) {
+            it = lastUpdate_.find(pInterrupt->pasynUser);
+            if (it == lastUpdate_.end()) {
+                /* A new client; it does not have the last array if this is a flush */
+                due = !pendingOnly;
+                if (due) {
+                    pClient = &clientUpdates[pInterrupt->pasynUser];
+                    pClient->lastUpdate = *pNow;
+                    pClient->pending = false;
+                }
+            } else {
+                pClient = &clientUpdates[pInterrupt->pasynUser];
+                *pClient = it->second;
+                elapsed = epicsTimeDiffInSeconds(pNow, &pClient->lastUpdate);
+                if (pendingOnly && !pClient->pending) {
+                    due = false;
+                } else if (elapsed < minUpdateTime) {
+                    due = false;
+                    pClient->pending = true;
+                    if ((*pNextUpdate < 0) || (minUpdateTime - elapsed < *pNextUpdate))
+                        *pNextUpdate = minUpdateTime - elapsed;
+                } else {
+                    pClient->lastUpdate = *pNow;
+                    pClient->pending = false;
+                }
+            }
+        }
+        if (due) {
+            /* Only convert if at least one client wants the data, and then only once */
+            if (!pData) {
+                if (pDec->passThrough && (pArray->dataType == signedType)) {
+                    pData = (epicsType *)pArray->pData;
+                } else {
+                    buffer_.resize(pDec->nElements * sizeof(epicsType));
+                    status = decimateArraySwitch<epicsType>(pArray, pDec, (epicsType *)&buffer_[0]);
+                    if (status) {
+                        asynPrint(pInterrupt->pasynUser, ASYN_TRACE_ERROR,
+                                  "%s::arrayInterruptCallback: error converting data type %d\n",
+                                   driverName, pArray->dataType);
+                        break;
+                    }
+                    pData = (epicsType *)&buffer_[0];
                 }
-                pData = (epicsType *)pOutput->pData;
             }
             pInterrupt->pasynUser->timestamp = pArray->epicsTS;
             pInterrupt->callback(pInterrupt->userPvt,
                                  pInterrupt->pasynUser,
-                                 pData, arrayInfo.nElements);
+                                 pData, pDec->nElements);
         }
         pnode = (interruptNode *)ellNext(&pnode->node);
     }
     pasynManager->interruptEnd(interruptPvt);
-    if (pOutput) pOutput->release();
 }
 
 template <typename epicsType> 
@@ -72,8 +308,8 @@ asynStatus NDPluginStdArrays::readArray(asynUser *pasynUser, epicsType *value, s
 {
     int command = pasynUser->reason;
     asynStatus status = asynSuccess;
-    NDArray *pOutput, *myArray;
-    NDArrayInfo_t arrayInfo;
+    NDArray *myArray;
+    NDStdArraysDecimation_t dec;
 
     myArray = this->pArrays[0];
     if (command == NDPluginStdArraysData) {
@@ -83,23 +319,25 @@ asynStatus NDPluginStdArrays::readArray(asynUser *pasynUser, epicsType *value, s
             status = asynError;
             goto done;
         }
-        myArray->getInfo(&arrayInfo);
-        if (arrayInfo.nElements > nElements) {
-            /* We have been requested fewer pixels than we have.
-             * Just pass the first nElements. */
-             arrayInfo.nElements = nElements;
+        computeDecimation(myArray, &dec);
+        /* If we have been requested fewer pixels than we have just pass the first nElements. */
+        *nIn = (dec.nElements > nElements) ? nElements : dec.nElements;
+        if (dec.passThrough && (myArray->dataType == outputType)) {
+            memcpy(value, myArray->pData, *nIn*sizeof(epicsType));
+        } else if (*nIn == dec.nElements) {
+            /* Convert directly into the client buffer */
+            status = (asynStatus)decimateArraySwitch<epicsType>(myArray, &dec, value);
+        } else {
+            std::vector<epicsType> temp(dec.nElements);
+            status = (asynStatus)decimateArraySwitch<epicsType>(myArray, &dec, &temp[0]);
+            if (!status) memcpy(value, &temp[0], *nIn*sizeof(epicsType));
         }
-        status = (asynStatus)this->pNDArrayPool->convert(myArray, &pOutput, outputType);
         if (status) {
             asynPrint(pasynUser, ASYN_TRACE_ERROR,
-                      "%s::readArray: error allocating array in convert()\n",
-                       driverName);
+                      "%s::readArray: error converting data type %d\n",
+                       driverName, myArray->dataType);
            goto done;
         }
-        /* Copy the data */
-        *nIn = arrayInfo.nElements;
-        memcpy(value, pOutput->pData, *nIn*sizeof(epicsType));
-        pOutput->release();
         /* Set the timestamp */
         pasynUser->timestamp = myArray->epicsTS;
     } else {
@@ -114,10 +352,119 @@ asynStatus NDPluginStdArrays::readArray(asynUser *pasynUser, epicsType *value, s
 
 
 
+/** Does the callbacks to the clients of all of the asynXXXArray interfaces.
+  * Called with callbackLock_ taken and the plugin lock released.
+  * If clients were skipped because of minUpdateTime, the flush thread is woken to send them
+  * the last array when they are due, in case no more arrays arrive.
+  * \param[in] pArray The NDArray.
+  * \param[in] pDec The region and decimation.
+  * \param[in] pNow The time of this callback.
+  * \param[in] minUpdateTime The minimum time between callbacks to each client.
+  * \param[in] pendingOnly Only do callbacks to the skipped clients that are now due. */
+void NDPluginStdArrays::doArrayCallbacks(NDArray *pArray, NDStdArraysDecimation_t *pDec, epicsTimeStamp *pNow,
+                                         double minUpdateTime, bool pendingOnly)
+{
+    std::map<asynUser*, NDStdArraysClient_t> clientUpdates;
+    double nextUpdate = -1.;
+    asynStandardInterfaces *pInterfaces = this->getAsynStdInterfaces();
+    static const char *functionName = "doArrayCallbacks";
+
+    /* Pass interrupts for int8Array data*/
+    arrayInterruptCallback<epicsInt8, asynInt8ArrayInterrupt>(pArray, pDec, pNow, minUpdateTime, pendingOnly,
+                             clientUpdates, &nextUpdate, pInterfaces->int8ArrayInterruptPvt, NDInt8);
+
+    /* Pass interrupts for int16Array data*/
+    arrayInterruptCallback<epicsInt16,  asynInt16ArrayInterrupt>(pArray, pDec, pNow, minUpdateTime, pendingOnly,
+                             clientUpdates, &nextUpdate, pInterfaces->int16ArrayInterruptPvt, NDInt16);
+
+    /* Pass interrupts for int32Array data*/
+    arrayInterruptCallback<epicsInt32, asynInt32ArrayInterrupt>(pArray, pDec, pNow, minUpdateTime, pendingOnly,
+                             clientUpdates, &nextUpdate, pInterfaces->int32ArrayInterruptPvt, NDInt32);
+
+    /* Pass interrupts for float32Array data*/
+    arrayInterruptCallback<epicsFloat32, asynFloat32ArrayInterrupt>(pArray, pDec, pNow, minUpdateTime, pendingOnly,
+                             clientUpdates, &nextUpdate, pInterfaces->float32ArrayInterruptPvt, NDFloat32);
+
+    /* Pass interrupts for float64Array data*/
+    arrayInterruptCallback<epicsFloat64, asynFloat64ArrayInterrupt>(pArray, pDec, pNow, minUpdateTime, pendingOnly,
+                             clientUpdates, &nextUpdate, pInterfaces->float64ArrayInterruptPvt, NDFloat64);
+
+    /* Only keep the clients that are still registered */
+    lastUpdate_.swap(clientUpdates);
+
+    flushDelay_ = nextUpdate;
+    if (nextUpdate < 0) return;
+    if (flushThreadId_ == 0) {
+        char taskName[256];
+        epicsSnprintf(taskName, sizeof(taskName)-1, "%s_Plugin_Flush", portName);
+        flushThreadId_ = epicsThreadCreate(taskName,
+                                           this->threadPriority_,
+                                           this->threadStackSize_,
+                                           (EPICSTHREADFUNC)flushTaskC, this);
+        if (flushThreadId_ == 0) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s error creating flush thread\n",
+                driverName, functionName);
+            return;
+        }
+    }
+    epicsEventSignal(flushWakeEvent_);
+}
+
+/** Sends the last array to the clients that were skipped because of MinUpdateTime and are now due.
+  * Called with the plugin lock taken. */
+void NDPluginStdArrays::doPendingCallbacks()
+{
+    NDStdArraysDecimation_t dec;
+    double minUpdateTime;
+    epicsTimeStamp now;
+    NDArray *pArray = this->pArrays[0];
+
+    if (!pArray) {
+        callbackLock_.lock();
+        flushDelay_ = -1.;
+        callbackLock_.unlock();
+        return;
+    }
+    pArray->reserve();
+    computeDecimation(pArray, &dec);
+    getDoubleParam(NDPluginStdArraysMinUpdateTime, &minUpdateTime);
+    epicsTimeGetCurrent(&now);
+    this->unlock();
+    callbackLock_.lock();
+    doArrayCallbacks(pArray, &dec, &now, minUpdateTime, true);
+    callbackLock_.unlock();
+    pArray->release();
+    this->lock();
+    callParamCallbacks();
+}
+
+/** Waits until a client that was skipped because of MinUpdateTime is due, and sends it the last array. */
+void NDPluginStdArrays::flushTask()
+{
+    double delay;
+
+    this->lock();
+    while (!flushExit_) {
+        this->unlock();
+        callbackLock_.lock();
+        delay = flushDelay_;
+        callbackLock_.unlock();
+        if (delay < 0) epicsEventWait(flushWakeEvent_);
+        else epicsEventWaitWithTimeout(flushWakeEvent_, delay);
+        this->lock();
+        if (!flushExit_) doPendingCallbacks();
+    }
+    this->unlock();
+    epicsEventSignal(flushExitEvent_);
+}
+
+
 /** Callback function that is called by the NDArray driver with new NDArray data.
   * It does callbacks with the array data to any registered asyn clients on any
-  * of the asynXXXArray interfaces.  It converts the array data to the type required for that
-  * interface.
+  * of the asynXXXArray interfaces.  It extracts the selected region, decimates it, and
+  * converts it to the type required for that interface.  The conversion is only done
+  * for interfaces that have a client whose minimum update time has elapsed.
   * \param[in] pArray  The NDArray from the callback.
   */ 
 void NDPluginStdArrays::processCallbacks(NDArray *pArray)
@@ -127,50 +474,27 @@ void NDPluginStdArrays::processCallbacks(NDArray *pArray)
      * It is called with the mutex already locked.
      */
      
-    int int8Initialized=0;
-    int int16Initialized=0;
-    int int32Initialized=0;
-    int float32Initialized=0;
-    int float64Initialized=0;
-    NDArrayInfo_t arrayInfo;
-    asynStandardInterfaces *pInterfaces = this->getAsynStdInterfaces();
+    NDStdArraysDecimation_t dec;
+    double minUpdateTime;
+    epicsTimeStamp now;
     /* static const char* functionName = "processCallbacks"; */
 
     /* Call the base class method */
     NDPluginDriver::beginProcessCallbacks(pArray);
     
-    pArray->getInfo(&arrayInfo);
+    computeDecimation(pArray, &dec);
+    getDoubleParam(NDPluginStdArraysMinUpdateTime, &minUpdateTime);
+    epicsTimeGetCurrent(&now);
  
     /* This function is called with the lock taken, and it must be set when we exit.
-     * The following code can be exected without the mutex because we are not accessing pPvt */
+     * The following code can be exected without the mutex because we are not accessing pPvt.
+     * callbackLock_ protects buffer_ and lastUpdate_ if there are multiple plugin threads. */
     this->unlock();
-
-    /* Pass interrupts for int8Array data*/
-    arrayInterruptCallback<epicsInt8, asynInt8ArrayInterrupt>(pArray, this->pNDArrayPool, 
-                             pInterfaces->int8ArrayInterruptPvt,
-                             &int8Initialized, NDInt8);
-    
-    /* Pass interrupts for int16Array data*/
-    arrayInterruptCallback<epicsInt16,  asynInt16ArrayInterrupt>(pArray, this->pNDArrayPool, 
-                             pInterfaces->int16ArrayInterruptPvt,
-                             &int16Initialized, NDInt16);
-    
-    /* Pass interrupts for int32Array data*/
-    arrayInterruptCallback<epicsInt32, asynInt32ArrayInterrupt>(pArray, this->pNDArrayPool, 
-                             pInterfaces->int32ArrayInterruptPvt,
-                             &int32Initialized, NDInt32);
-    
-    /* Pass interrupts for float32Array data*/
-    arrayInterruptCallback<epicsFloat32, asynFloat32ArrayInterrupt>(pArray, this->pNDArrayPool, 
-                             pInterfaces->float32ArrayInterruptPvt,
-                             &float32Initialized, NDFloat32);
-    
-    /* Pass interrupts for float64Array data*/
-    arrayInterruptCallback<epicsFloat64, asynFloat64ArrayInterrupt>(pArray, this->pNDArrayPool, 
-                             pInterfaces->float64ArrayInterruptPvt,
-                             &float64Initialized, NDFloat64);
+    callbackLock_.lock();
+    doArrayCallbacks(pArray, &dec, &now, minUpdateTime, false);
 
     /* We must exit with the mutex locked */
+    callbackLock_.unlock();
     this->lock();
     /* We always keep the last array so read() can use it.  
      * Release previous one, reserve new one */
@@ -182,7 +506,7 @@ void NDPluginStdArrays::processCallbacks(NDArray *pArray)
     callParamCallbacks();
 }
 
-
+
 /** Called when asyn clients call pasynInt8Array->read().
   * Converts the last NDArray callback data to epicsInt8 (if necessary) and returns it.  
   * \param[in] pasynUser pasynUser structure that encodes the reason and address.
@@ -279,11 +603,33 @@ NDPluginStdArrays::NDPluginStdArrays(const char *portName, int queueSize, int bl
                    
                    /* asynFlags is set to 0, because this plugin cannot block and is not multi-device.
                     * It does autoconnect */
-                   0, 1, priority, stackSize, maxThreads)
+                   0, 1, priority, stackSize, maxThreads),
+    flushDelay_(-1.), flushExit_(false), flushThreadId_(0)
 {
     //static const char *functionName = "NDPluginStdArrays";
     
-    createParam(NDPluginStdArraysDataString, asynParamGenericPointer, &NDPluginStdArraysData);
+    createParam(NDPluginStdArraysDataString,          asynParamGenericPointer, &NDPluginStdArraysData);
+    createParam(NDPluginStdArraysMinXString,          asynParamInt32,          &NDPluginStdArraysMinX);
+    createParam(NDPluginStdArraysMinYString,          asynParamInt32,          &NDPluginStdArraysMinY);
+    createParam(NDPluginStdArraysSizeXString,         asynParamInt32,          &NDPluginStdArraysSizeX);
+    createParam(NDPluginStdArraysSizeYString,         asynParamInt32,          &NDPluginStdArraysSizeY);
+    createParam(NDPluginStdArraysDecimateXString,     asynParamInt32,          &NDPluginStdArraysDecimateX);
+    createParam(NDPluginStdArraysDecimateYString,     asynParamInt32,          &NDPluginStdArraysDecimateY);
+    createParam(NDPluginStdArraysDecimateModeString,  asynParamInt32,          &NDPluginStdArraysDecimateMode);
+    createParam(NDPluginStdArraysOutSizeXString,      asynParamInt32,          &NDPluginStdArraysOutSizeX);
+    createParam(NDPluginStdArraysOutSizeYString,      asynParamInt32,          &NDPluginStdArraysOutSizeY);
+    createParam(NDPluginStdArraysMinUpdateTimeString, asynParamFloat64,        &NDPluginStdArraysMinUpdateTime);
+
+    setIntegerParam(NDPluginStdArraysMinX, 0);
+    setIntegerParam(NDPluginStdArraysMinY, 0);
+    setIntegerParam(NDPluginStdArraysSizeX, 0);
+    setIntegerParam(NDPluginStdArraysSizeY, 0);
+    setIntegerParam(NDPluginStdArraysDecimateX, 1);
+    setIntegerParam(NDPluginStdArraysDecimateY, 1);
+    setIntegerParam(NDPluginStdArraysDecimateMode, NDStdArraysDecimateSample);
+    setIntegerParam(NDPluginStdArraysOutSizeX, 0);
+    setIntegerParam(NDPluginStdArraysOutSizeY, 0);
+    setDoubleParam(NDPluginStdArraysMinUpdateTime, 0.);
 
     /* Set the plugin type string */    
     setStringParam(NDPluginDriverPluginType, "NDPluginStdArrays");
@@ -292,10 +638,28 @@ NDPluginStdArrays::NDPluginStdArrays(const char *portName, int queueSize, int bl
     // This plugin currently does not do array callbacks, so make the setting reflect the behavior
     setIntegerParam(NDArrayCallbacks, 0);
 
+    flushWakeEvent_ = epicsEventMustCreate(epicsEventEmpty);
+    flushExitEvent_ = epicsEventMustCreate(epicsEventEmpty);
+
     /* Try to connect to the NDArray port */
     connectToArrayPort();
 }
 
+/** Destructor; stops the callbacks from the driver and the flush thread */
+NDPluginStdArrays::~NDPluginStdArrays()
+{
+    setArrayInterrupt(0);
+    if (flushThreadId_ != 0) {
+        this->lock();
+        flushExit_ = true;
+        this->unlock();
+        epicsEventSignal(flushWakeEvent_);
+        epicsEventWait(flushExitEvent_);
+    }
+    epicsEventDestroy(flushWakeEvent_);
+    epicsEventDestroy(flushExitEvent_);
+}
+
 /* Configuration routine.  Called directly, or from the iocsh function */
 extern "C" int NDStdArraysConfigure(const char *portName, int queueSize, int blockingCallbacks, 
                                     const char *NDArrayPort, int NDArrayAddr, int maxBuffers, size_t maxMemory,
@@ -1,11 +1,52 @@
 #ifndef NDPluginStdArrays_H
 #define NDPluginStdArrays_H
 
+#include <map>
+#include <vector>
 #include <epicsTypes.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
 
 #include "NDPluginDriver.h"
 
-#define NDPluginStdArraysDataString "STD_ARRAY_DATA"           /* (asynXXXArray, r/w) Array data waveform */
+#define NDPluginStdArraysDataString          "STD_ARRAY_DATA"           /* (asynXXXArray, r/w) Array data waveform */
+#define NDPluginStdArraysMinXString          "STD_ARRAY_MIN_X"          /* (asynInt32,    r/w) First X element passed to clients */
+#define NDPluginStdArraysMinYString          "STD_ARRAY_MIN_Y"          /* (asynInt32,    r/w) First Y element passed to clients */
+#define NDPluginStdArraysSizeXString         "STD_ARRAY_SIZE_X"         /* (asynInt32,    r/w) Number of X elements, 0=to the end */
+#define NDPluginStdArraysSizeYString         "STD_ARRAY_SIZE_Y"         /* (asynInt32,    r/w) Number of Y elements, 0=to the end */
+#define NDPluginStdArraysDecimateXString     "STD_ARRAY_DECIMATE_X"     /* (asynInt32,    r/w) X decimation factor */
+#define NDPluginStdArraysDecimateYString     "STD_ARRAY_DECIMATE_Y"     /* (asynInt32,    r/w) Y decimation factor */
+#define NDPluginStdArraysDecimateModeString  "STD_ARRAY_DECIMATE_MODE"  /* (asynInt32,    r/w) Decimation mode, NDStdArraysDecimateMode_t */
+#define NDPluginStdArraysOutSizeXString      "STD_ARRAY_OUT_SIZE_X"     /* (asynInt32,    r/o) X size of the data passed to clients */
+#define NDPluginStdArraysOutSizeYString      "STD_ARRAY_OUT_SIZE_Y"     /* (asynInt32,    r/o) Y size of the data passed to clients */
+#define NDPluginStdArraysMinUpdateTimeString "STD_ARRAY_MIN_UPDATE_TIME" /* (asynFloat64, r/w) Minimum time between callbacks to each client */
+
+/** How the pixels in each decimation block are reduced to the output values */
+typedef enum {
+    NDStdArraysDecimateSample,   /**< Use the first pixel of each block */
+    NDStdArraysDecimateAverage,  /**< Use the average of the pixels in each block */
+    NDStdArraysDecimateMinMax    /**< Use the minimum and maximum of each block; doubles the X output size */
+} NDStdArraysDecimateMode_t;
+
+/** Region and decimation of the data passed to clients, computed for each NDArray */
+typedef struct {
+    bool   passThrough;     /**< No region or decimation, the data are passed unchanged */
+    int    mode;            /**< NDStdArraysDecimateMode_t */
+    size_t start[3];        /**< First input element in X, Y and color */
+    size_t decimate[3];     /**< Input elements per output element in X, Y and color */
+    size_t inStride[3];     /**< Input strides in X, Y and color */
+    size_t outSize[3];      /**< Output sizes in X, Y and color */
+    size_t outStride[3];    /**< Output strides in X, Y and color */
+    size_t nElements;       /**< Total number of output elements */
+} NDStdArraysDecimation_t;
+
+/** Rate limiting state of one client of the array data */
+typedef struct {
+    epicsTimeStamp lastUpdate;  /**< Time of the last callback to the client */
+    bool           pending;     /**< The client was skipped because of MinUpdateTime and has not got the last array */
+} NDStdArraysClient_t;
 
 /** Converts NDArray callback data into standard asyn arrays (asynInt8Array, asynInt16Array, asynInt32Array,
   * asynFloat32Array or asynFloat64Array); normally used for putting NDArray data in EPICS waveform records.
@@ -16,6 +57,7 @@ public:
     NDPluginStdArrays(const char *portName, int queueSize, int blockingCallbacks, 
                       const char *NDArrayPort, int NDArrayAddr, int maxBuffers, size_t maxMemory,
                       int priority, int stackSize, int maxThreads=1);
+    virtual ~NDPluginStdArrays();
 
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
@@ -29,17 +71,41 @@ public:
                                         size_t nElements, size_t *nIn);
     virtual asynStatus readFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
                                         size_t nElements, size_t *nIn);
+    void flushTask();
 protected:
     int NDPluginStdArraysData;
     #define FIRST_NDPLUGIN_STDARRAYS_PARAM NDPluginStdArraysData
+    int NDPluginStdArraysMinX;
+    int NDPluginStdArraysMinY;
+    int NDPluginStdArraysSizeX;
+    int NDPluginStdArraysSizeY;
+    int NDPluginStdArraysDecimateX;
+    int NDPluginStdArraysDecimateY;
+    int NDPluginStdArraysDecimateMode;
+    int NDPluginStdArraysOutSizeX;
+    int NDPluginStdArraysOutSizeY;
+    int NDPluginStdArraysMinUpdateTime;
 private:
     /* These methods are just for this class */
+    void computeDecimation(NDArray *pArray, NDStdArraysDecimation_t *pDec);
     template <typename epicsType> asynStatus readArray(asynUser *pasynUser, epicsType *value, 
                                         size_t nElements, size_t *nIn, NDDataType_t outputType);
     template <typename epicsType, typename interruptType> void arrayInterruptCallback(NDArray *pArray, 
-                            NDArrayPool *pNDArrayPool, 
-                            void *interruptPvt, int *initialized, NDDataType_t signedType);
-                                        
+                            NDStdArraysDecimation_t *pDec, epicsTimeStamp *pNow, double minUpdateTime,
+                            bool pendingOnly, std::map<asynUser*, NDStdArraysClient_t>& clientUpdates,
+                            double *pNextUpdate, void *interruptPvt, NDDataType_t signedType);
+    void doArrayCallbacks(NDArray *pArray, NDStdArraysDecimation_t *pDec, epicsTimeStamp *pNow,
+                          double minUpdateTime, bool pendingOnly);
+    void doPendingCallbacks();
+
+    epicsMutex callbackLock_;                         /**< Serializes client callbacks when maxThreads>1 */
+    std::vector<char> buffer_;                        /**< Converted data passed to clients */
+    std::map<asynUser*, NDStdArraysClient_t> lastUpdate_;  /**< Rate limiting state of each client */
+    double flushDelay_;                               /**< Time until a skipped client is due, <0 if there are none */
+    bool flushExit_;
+    epicsThreadId flushThreadId_;
+    epicsEventId flushWakeEvent_;
+    epicsEventId flushExitEvent_;
 };
 
 #endif
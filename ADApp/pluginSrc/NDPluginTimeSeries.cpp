@@ -27,13 +27,32 @@
 
 #include "NDPluginTimeSeries.h"
 
+/* Some systems do not define M_PI in math.h */
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
 #define DEFAULT_NUM_TSPOINTS 2048
 
+/* Number of time points that are transposed at once when the time series is published.
+ * A block of the time-major circular buffer for all signals should fit in the L1/L2 cache. */
+#define TRANSPOSE_BLOCK_SIZE 64
+
 enum {
   TSAcquireModeFixed,
   TSAcquireModeCircular
 };
 
+enum {
+  TSFilterAverage,
+  TSFilterCIC,
+  TSFilterFIR
+};
+
+#define DEFAULT_FILTER_ORDER 4
+// Limits the filter length and the time taken to compute the coefficients
+#define MAX_FILTER_ORDER 16
+
 /** Constructor for NDPluginTimeSeries; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   * \param[in] portName The name of the asyn port driver to be created.
   * \param[in] queueSize The number of NDArrays that the input queue for this plugin can hold when
@@ -65,6 +84,8 @@ NDPluginTimeSeries::NDPluginTimeSeries(const char *portName, int queueSize, int
              ASYN_MULTIDEVICE, 1, priority, stackSize, 1),
     dataType_(NDFloat64), dataSize_(sizeof(epicsFloat64)), numTimePoints_(DEFAULT_NUM_TSPOINTS), currentTimePoint_(0),
     uniqueId_(0), numAverage_(1), acquireMode_(TSAcquireModeFixed), averagingTimeRequested_(1), timePerPoint_(0), 
+    filterType_(TSFilterAverage), filterOrder_(DEFAULT_FILTER_ORDER), numFilterCoeffs_(0), filterCoeffs_(0),
+    numFilterPhases_(0), filterHead_(0), filterState_(0),
     signalData_(0), timeAxis_(0), timeStamp_(0), pTimeCircular_(0)
 {
   //const char *functionName = "NDPluginTimeSeries::NDPluginTimeSeries";
@@ -86,6 +107,8 @@ NDPluginTimeSeries::NDPluginTimeSeries(const char *portName, int queueSize, int
   createParam(TSNumAverageString,              asynParamInt32, &P_TSNumAverage);
   createParam(TSElapsedTimeString,           asynParamFloat64, &P_TSElapsedTime);
   createParam(TSAcquireModeString,             asynParamInt32, &P_TSAcquireMode);
+  createParam(TSFilterTypeString,              asynParamInt32, &P_TSFilterType);
+  createParam(TSFilterOrderString,             asynParamInt32, &P_TSFilterOrder);
   createParam(TSTimeAxisString,         asynParamFloat64Array, &P_TSTimeAxis);
   createParam(TSTimestampString,        asynParamFloat64Array, &P_TSTimestamp);
   
@@ -96,6 +119,8 @@ NDPluginTimeSeries::NDPluginTimeSeries(const char *portName, int queueSize, int
   setStringParam(NDPluginDriverPluginType, "NDPluginTimeSeries");
   
   setIntegerParam(P_TSNumPoints, numTimePoints_);
+  setIntegerParam(P_TSFilterType, filterType_);
+  setIntegerParam(P_TSFilterOrder, filterOrder_);
   allocateArrays();
   
   /* Try to connect to the array port */
@@ -119,10 +144,83 @@ void NDPluginTimeSeries::computeNumAverage()
   numAveraged_ = 0;
   setDoubleParam(P_TSAveragingTime, averagingTimeActual_);
   setIntegerParam(P_TSNumAverage, numAverage_);
+  computeFilter();
   createAxisArray();
   callParamCallbacks();
 }
 
+/** Computes the coefficients of the decimation filter for the current filter type, order and numAverage_.
+  * The CIC and FIR filters are both run as polyphase FIR decimators: each input point is multiplied by
+  * the coefficients of the output points it contributes to, and only the decimated output points are computed.
+  * The CIC filter uses the exact CIC impulse response, filterOrder_ boxcars of length numAverage_ convolved
+  * together, so that it does not need the wrapping integer arithmetic of the recursive form and works for
+  * all data types.
+  * The FIR filter is a Blackman windowed-sinc low-pass filter with filterOrder_*numAverage_ taps
+  * and cutoff at the Nyquist frequency of the output points.
+  * Both filters are normalized to unity gain at DC. */
+void NDPluginTimeSeries::computeFilter()
+{
+  int R = numAverage_;
+  int i, j, stage, len;
+  double *pTemp;
+  double sum, center, x, window;
+
+  free(filterCoeffs_);
+  free(filterState_);
+  filterCoeffs_ = 0;
+  filterState_ = 0;
+  numFilterCoeffs_ = 0;
+  numFilterPhases_ = 0;
+  filterHead_ = 0;
+  numAveraged_ = 0;
+  // The partial average belongs to the previous filter
+  memset(averageStore_, 0, maxSignals_ * sizeof(double));
+  if (filterOrder_ < 1) filterOrder_ = 1;
+  if (filterOrder_ > MAX_FILTER_ORDER) filterOrder_ = MAX_FILTER_ORDER;
+
+  switch (filterType_) {
+  case TSFilterCIC:
+    numFilterCoeffs_ = filterOrder_*(R-1) + 1;
+    filterCoeffs_ = (double *)calloc(numFilterCoeffs_, sizeof(double));
+    pTemp = (double *)calloc(numFilterCoeffs_, sizeof(double));
+    filterCoeffs_[0] = 1.;
+    for (stage=0, len=1; stage<filterOrder_; stage++) {
+      for (i=0; i<len+R-1; i++) {
+        pTemp[i] = 0;
+        for (j=0; j<R; j++) {
+          if ((i-j >= 0) && (i-j < len)) pTemp[i] += filterCoeffs_[i-j];
+        }
+        // Scale each stage to unity gain so the coefficients cannot overflow
+        pTemp[i] /= R;
+      }
+      len += R-1;
+      memcpy(filterCoeffs_, pTemp, len*sizeof(double));
+    }
+    free(pTemp);
+    break;
+  case TSFilterFIR:
+    numFilterCoeffs_ = filterOrder_*R;
+    filterCoeffs_ = (double *)calloc(numFilterCoeffs_, sizeof(double));
+    center = (numFilterCoeffs_ - 1) / 2.;
+    for (i=0; i<numFilterCoeffs_; i++) {
+      x = (i - center) / R;
+      filterCoeffs_[i] = (x == 0) ? 1. : sin(M_PI*x) / (M_PI*x);
+      if (numFilterCoeffs_ > 1) {
+        window = 0.42 - 0.5*cos(2*M_PI*i/(numFilterCoeffs_-1)) + 0.08*cos(4*M_PI*i/(numFilterCoeffs_-1));
+        filterCoeffs_[i] *= window;
+      }
+    }
+    break;
+  default:
+    return;
+  }
+
+  for (i=0, sum=0; i<numFilterCoeffs_; i++) sum += filterCoeffs_[i];
+  for (i=0; i<numFilterCoeffs_; i++) filterCoeffs_[i] /= sum;
+  numFilterPhases_ = (numFilterCoeffs_ + R - 1) / R;
+  filterState_ = (double *)calloc(numFilterPhases_*maxSignals_, sizeof(double));
+}
+
 void NDPluginTimeSeries::allocateArrays()
 {
   int numPoints;
@@ -137,9 +235,11 @@ void NDPluginTimeSeries::allocateArrays()
 
   timeStamp_  = (double *)calloc(numSignals_*numTimePoints_, sizeof(double));
   signalData_ = (double *)calloc(numSignals_*numTimePoints_, sizeof(double));
+  // The circular buffer is time-major, i.e. all of the signals for one time point are contiguous.
+  // It is transposed to the signal-major order of the output arrays in doTimeSeriesCallbacks().
   nDims = 2;
-  dims[0] = numTimePoints_;
-  dims[1] = numSignals_;
+  dims[0] = numSignals_;
+  dims[1] = numTimePoints_;
   pTimeCircular_ = pNDArrayPool->alloc(nDims, dims, dataType_, 0, 0);
   createAxisArray();
   acquireReset();
@@ -150,6 +250,10 @@ void NDPluginTimeSeries::acquireReset()
   memset(signalData_,           0, numTimePoints_ * numSignals_ * sizeof(double));
   memset(timeStamp_,            0, numTimePoints_ * sizeof(double));
   memset(pTimeCircular_->pData, 0, numTimePoints_ * numSignals_ * dataSize_);
+  memset(averageStore_,         0, maxSignals_ * sizeof(double));
+  if (filterState_) memset(filterState_, 0, numFilterPhases_ * maxSignals_ * sizeof(double));
+  filterHead_ = 0;
+  numAveraged_ = 0;
   currentTimePoint_ = 0;
   setIntegerParam(P_TSCurrentPoint, currentTimePoint_);
   epicsTimeGetCurrent(&startTime_);
@@ -173,6 +277,11 @@ void NDPluginTimeSeries::createAxisArray()
 
 /**
  * Templated function to append to time series on different NDArray data types.
+ * Each time point of the input is added to a row of averageStore_, and when numAverage_ points
+ * have been added the averages are written as one contiguous row of the time-major circular buffer.
+ * For the CIC and FIR filters each time point is instead multiplied by the filter coefficients and added
+ * to the rows of filterState_ for the output points it contributes to.  The filter state is kept
+ * between input arrays.
  * \param[in] NDArray The pointer to the NDArray object
  * \return asynStatus
  */
@@ -181,9 +290,14 @@ asynStatus NDPluginTimeSeries::doAddToTimeSeriesT(NDArray *pArray)
 {
   epicsType *pData         = (epicsType *)pArray->pData;
   epicsType *pIn; 
+  epicsType *pOut;
   epicsType *pTimeCircular = (epicsType *)pTimeCircular_->pData;
+  double *pAverage         = averageStore_;
+  double *pState;
+  double coeff;
+  int numSignals           = numSignals_;
   int signal;
-  int i;
+  int i, phase, k;
   int numTimes = 1;
   epicsTimeStamp timeNow;
   double elapsedTime;
@@ -192,17 +306,45 @@ asynStatus NDPluginTimeSeries::doAddToTimeSeriesT(NDArray *pArray)
   
   for (i=0; i<numTimes; i++) {
     pIn = pData + i*numSignalsIn_;
-    for (signal=0; signal<numSignals_; signal++) {
-      averageStore_[signal] += (epicsFloat64)*pIn++;
-    }
-    numAveraged_++;
-    if (numAveraged_ < numAverage_) continue;
-    /* We have now collected the desired number of points to average */
-    for (signal=0; signal<numSignals_; signal++) {
-      pTimeCircular[signal * numTimePoints_ + currentTimePoint_] = (epicsType)averageStore_[signal]/numAveraged_;
-      averageStore_[signal] = 0;
+    pOut = pTimeCircular + currentTimePoint_*numSignals;
+    if (filterState_ && (numFilterPhases_ > 0)) {
+      // Add this point to each output point it contributes to, starting with the next one
+      for (phase=0; phase<numFilterPhases_; phase++) {
+        k = phase*numAverage_ + numAverage_-1 - numAveraged_;
+        if (k >= numFilterCoeffs_) break;
+        coeff = filterCoeffs_[k];
+        pState = filterState_ + ((filterHead_ + phase) % numFilterPhases_)*maxSignals_;
+        for (signal=0; signal<numSignals; signal++) {
+          pState[signal] += coeff * pIn[signal];
+        }
+      }
+      numAveraged_++;
+      if (numAveraged_ < numAverage_) continue;
+      // The next output point is complete
+      pState = filterState_ + filterHead_*maxSignals_;
+      for (signal=0; signal<numSignals; signal++) {
+        pOut[signal] = (epicsType)pState[signal];
+        pState[signal] = 0;
+      }
+      filterHead_ = (filterHead_ + 1) % numFilterPhases_;
+      numAveraged_ = 0;
+    } else if (numAverage_ == 1) {
+      memcpy(pOut, pIn, numSignals*sizeof(epicsType));
+    } else {
+      // These loops are over contiguous memory with no dependencies between signals
+      // so the compiler can vectorize them
+      for (signal=0; signal<numSignals; signal++) {
+        pAverage[signal] += (epicsFloat64)pIn[signal];
+      }
+      numAveraged_++;
+      if (numAveraged_ < numAverage_) continue;
+      /* We have now collected the desired number of points to average */
+      for (signal=0; signal<numSignals; signal++) {
+        pOut[signal] = (epicsType)(pAverage[signal]/numAveraged_);
+        pAverage[signal] = 0;
+      }
+      numAveraged_ = 0;
     }
-    numAveraged_ = 0;
     timeStamp_[currentTimePoint_] = pArray->timeStamp;
     currentTimePoint_++;
     if (currentTimePoint_ >= numTimePoints_) {
@@ -222,7 +364,6 @@ asynStatus NDPluginTimeSeries::doAddToTimeSeriesT(NDArray *pArray)
   setDoubleParam(P_TSElapsedTime, elapsedTime);
   return asynSuccess;
 }
-
      
 /**
  * Call the templated doAddToTimeSeries so we can cast correctly. 
@@ -265,32 +406,78 @@ asynStatus NDPluginTimeSeries::addToTimeSeries(NDArray *pArray)
   return status;
 }
 
+/**
+ * Copies time points from the time-major circular buffer to a signal-major array.
+ * The source is read in blocks of TRANSPOSE_BLOCK_SIZE time points, which stay in cache
+ * while they are written to each of the signals.
+ * \param[in] pIn The circular buffer, dimensions [numSignals, numTimePoints]
+ * \param[out] pOut The output array, dimensions [numTimePoints, numSignals]
+ * \param[in] numSignals Number of signals
+ * \param[in] numTimePoints Number of time points in each signal
+ * \param[in] first Time point in pIn that is copied to the first time point of pOut
+ * \param[in] count Number of time points to copy, which may wrap around the end of pIn
+ */
 template <typename epicsType>
-void NDPluginTimeSeries::doTimeSeriesCallbacksT()
+static void transposeTimeSeries(const epicsType *pIn, epicsType *pOut, int numSignals,
+                                int numTimePoints, int first, int count)
+{
+  int span, spanStart, spanEnd, outStart;
+  int block, blockEnd;
+  int signal, time;
+
+  // The circular buffer is copied in at most 2 contiguous spans
+  for (span=0, outStart=0; (span<2) && (outStart<count); span++) {
+    spanStart = (span == 0) ? first : 0;
+    spanEnd   = spanStart + count - outStart;
+    if (spanEnd > numTimePoints) spanEnd = numTimePoints;
+    for (block=spanStart; block<spanEnd; block+=TRANSPOSE_BLOCK_SIZE) {
+      blockEnd = block + TRANSPOSE_BLOCK_SIZE;
+      if (blockEnd > spanEnd) blockEnd = spanEnd;
+      for (signal=0; signal<numSignals; signal++) {
+        const epicsType *pSrc = pIn + block*numSignals + signal;
+        epicsType *pDst = pOut + signal*numTimePoints + outStart + block - spanStart;
+        for (time=block; time<blockEnd; time++) {
+          *pDst++ = *pSrc;
+          pSrc += numSignals;
+        }
+      }
+    }
+    outStart += spanEnd - spanStart;
+  }
+}
+
+/**
+ * Transposes the circular buffer into pArrayOut and does the callbacks on the
+ * time series waveforms for each signal.
+ * \param[out] pArrayOut Signal-major array, dimensions [numTimePoints, numSignals]
+ */
+template <typename epicsType>
+void NDPluginTimeSeries::doTimeSeriesCallbacksT(NDArray *pArrayOut)
 {
   int signal;
   int timeOut;
-  int timeIn=0;
-  epicsType *timeCircular = (epicsType *)pTimeCircular_->pData;
-
+  int numPoints;
+  epicsType *pOut;
 
+  // In fixed mode the oldest point is the first one, and the whole buffer is copied because
+  // the points that have not been acquired yet are zero.
+  // In circular mode the oldest point is currentTimePoint_.
   if (acquireMode_ == TSAcquireModeFixed) {
-    for (signal=0; signal<numSignals_; signal++) {
-      for (timeOut=0; timeOut<currentTimePoint_; timeOut++) {
-        signalData_[timeOut] = timeCircular[signal*numTimePoints_ + timeOut];
-      }
-      doCallbacksFloat64Array(signalData_, currentTimePoint_, P_TSTimeSeries, signal);
-    }
+    transposeTimeSeries<epicsType>((epicsType *)pTimeCircular_->pData, (epicsType *)pArrayOut->pData,
+                                   numSignals_, numTimePoints_, 0, numTimePoints_);
+    numPoints = currentTimePoint_;
   }
   else {
-    timeIn = currentTimePoint_;
-    for (signal=0; signal<numSignals_; signal++) {
-      for (timeOut=0; timeOut<numTimePoints_; timeOut++) {
-        signalData_[timeOut] = timeCircular[signal*numTimePoints_ + timeIn];
-        if (++timeIn >= numTimePoints_) timeIn = 0;
-      }
-      doCallbacksFloat64Array(signalData_, numTimePoints_, P_TSTimeSeries, signal);
+    transposeTimeSeries<epicsType>((epicsType *)pTimeCircular_->pData, (epicsType *)pArrayOut->pData,
+                                   numSignals_, numTimePoints_, currentTimePoint_, numTimePoints_);
+    numPoints = numTimePoints_;
+  }
+  for (signal=0; signal<numSignals_; signal++) {
+    pOut = (epicsType *)pArrayOut->pData + signal*numTimePoints_;
+    for (timeOut=0; timeOut<numPoints; timeOut++) {
+      signalData_[timeOut] = (epicsFloat64)pOut[timeOut];
     }
+    doCallbacksFloat64Array(signalData_, numPoints, P_TSTimeSeries, signal);
   }
 }
 
@@ -305,60 +492,55 @@ asynStatus NDPluginTimeSeries::doTimeSeriesCallbacks()
   asynStatus status = asynSuccess;
   char *src, *dst;
   int signal;
-  size_t dims[1]; 
+  size_t dims[2]; 
   int numCopy;
+  NDArray *pArrayOut;
+  static const char* functionName = "NDPluginTimeSeries::doTimeSeriesCallbacks";
   
+  dims[0] = numTimePoints_;
+  dims[1] = numSignals_;
+  pArrayOut = pNDArrayPool->alloc(2, dims, dataType_, 0, 0);
+  if (!pArrayOut) {
+    asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+      "%s: error allocating output array\n",
+      functionName);
+    return asynError;
+  }
+
   switch(dataType_) {
   case NDInt8:
-    doTimeSeriesCallbacksT<epicsInt8>();
+    doTimeSeriesCallbacksT<epicsInt8>(pArrayOut);
     break;
   case NDUInt8:
-    doTimeSeriesCallbacksT<epicsUInt8>();
+    doTimeSeriesCallbacksT<epicsUInt8>(pArrayOut);
     break;
   case NDInt16:
-    doTimeSeriesCallbacksT<epicsInt16>();
+    doTimeSeriesCallbacksT<epicsInt16>(pArrayOut);
     break;
   case NDUInt16:
-    doTimeSeriesCallbacksT<epicsUInt16>();
+    doTimeSeriesCallbacksT<epicsUInt16>(pArrayOut);
     break;
   case NDInt32:
-    doTimeSeriesCallbacksT<epicsInt32>();
+    doTimeSeriesCallbacksT<epicsInt32>(pArrayOut);
     break;
   case NDUInt32:
-    doTimeSeriesCallbacksT<epicsUInt32>();
+    doTimeSeriesCallbacksT<epicsUInt32>(pArrayOut);
     break;
   case NDFloat32:
-    doTimeSeriesCallbacksT<epicsFloat32>();
+    doTimeSeriesCallbacksT<epicsFloat32>(pArrayOut);
     break;
   case NDFloat64:
-    doTimeSeriesCallbacksT<epicsFloat64>();
+    doTimeSeriesCallbacksT<epicsFloat64>(pArrayOut);
     break;
   default:
+    pArrayOut->release();
     return asynError;
     break;
   }
 
   getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
   if (arrayCallbacks) {
-    NDArray *pArrayOut = this->pArrays[0];
-    if (pArrayOut) pArrayOut->release();
-    if (acquireMode_ == TSAcquireModeFixed) {
-      pArrayOut = pNDArrayPool->copy(pTimeCircular_, NULL, 1);    
-    }
-    else {
-      // Shift the data so the oldest time point is the first point in the array
-      pArrayOut = pNDArrayPool->copy(pTimeCircular_, NULL, 0);
-      for (signal=0; signal<numSignals_; signal++) {
-        numCopy = numTimePoints_ - currentTimePoint_;
-        src = (char *)pTimeCircular_->pData + ((signal * numTimePoints_) + currentTimePoint_)*dataSize_;
-        dst = (char *)pArrayOut->pData      +  (signal * numTimePoints_)*dataSize_;
-        memcpy(dst, src, numCopy*dataSize_);
-        numCopy = currentTimePoint_;
-        src = (char *)pTimeCircular_->pData +  (signal * numTimePoints_)*dataSize_;
-        dst = (char *)pArrayOut->pData      + ((signal * numTimePoints_) + numTimePoints_ - currentTimePoint_)*dataSize_;
-        memcpy(dst, src, numCopy*dataSize_);
-      }
-    }
+    if (this->pArrays[0]) this->pArrays[0]->release();
     this->getAttributes(pArrayOut->pAttributeList);
     getTimeStamp(&pArrayOut->epicsTS);
     epicsTimeGetCurrent(&now);
@@ -382,6 +564,9 @@ asynStatus NDPluginTimeSeries::doTimeSeriesCallbacks()
       pArray->release();
     }
   }
+  else {
+    pArrayOut->release();
+  }
   return status;
 }
 
@@ -450,11 +635,27 @@ asynStatus NDPluginTimeSeries::writeInt32(asynUser *pasynUser, epicsInt32 value)
     return status;
   }
 
+  if ((function == P_TSFilterType) && ((value < TSFilterAverage) || (value > TSFilterFIR))) {
+    epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+          "%s: invalid filter type %d", functionName, value);
+    return asynError;
+  }
+  if ((function == P_TSFilterOrder) && ((value < 1) || (value > MAX_FILTER_ORDER))) {
+    epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+          "%s: invalid filter order %d, must be 1 to %d", functionName, value, MAX_FILTER_ORDER);
+    return asynError;
+  }
+
   /* Set parameter and readback in parameter library */
   stat = (setIntegerParam(signal, function, value) == asynSuccess) && stat;
 
   if (function == P_TSNumPoints) {
     allocateArrays();
+  } else if ((function == P_TSFilterType) || (function == P_TSFilterOrder)) {
+    if (function == P_TSFilterType) filterType_ = value;
+    else filterOrder_ = value;
+    computeFilter();
+    setIntegerParam(P_TSFilterOrder, filterOrder_);
   } else if (function == P_TSAcquireMode) {
     acquireMode_ = value;
     acquireReset();
@@ -26,6 +26,8 @@
 #define TSNumAverageString      "TS_NUM_AVERAGE"      /* (asynInt32,        r/o) Time points to average */
 #define TSElapsedTimeString     "TS_ELAPSED_TIME"     /* (asynFloat64,      r/o) Elapsed acquisition time */
 #define TSAcquireModeString     "TS_ACQUIRE_MODE"     /* (asynInt32,        r/w) Acquire mode */
+#define TSFilterTypeString      "TS_FILTER_TYPE"      /* (asynInt32,        r/w) Averaging filter type */
+#define TSFilterOrderString     "TS_FILTER_ORDER"     /* (asynInt32,        r/w) CIC stages or FIR taps per phase */
 #define TSTimeAxisString        "TS_TIME_AXIS"        /* (asynFloat64Array, r/o) Time axis array */
 #define TSTimestampString       "TS_TIMESTAMP"        /* (asynFloat64Array, r/o) Series of timestamps */
 
@@ -59,6 +61,8 @@ protected:
   int P_TSNumAverage;
   int P_TSElapsedTime;
   int P_TSAcquireMode;
+  int P_TSFilterType;
+  int P_TSFilterOrder;
   int P_TSTimeAxis;
   int P_TSTimestamp;
 
@@ -69,12 +73,13 @@ private:
   template <typename epicsType> asynStatus doAddToTimeSeriesT(NDArray *pArray);
   asynStatus addToTimeSeries(NDArray *pArray);
   asynStatus clear(epicsUInt32 roi);
-  template <typename epicsType> void doTimeSeriesCallbacksT();
+  template <typename epicsType> void doTimeSeriesCallbacksT(NDArray *pArrayOut);
   asynStatus doTimeSeriesCallbacks();
   void allocateArrays();
   void acquireReset();
   void createAxisArray();
   void computeNumAverage();
+  void computeFilter();
 
   int maxSignals_;
   int numSignals_;
@@ -92,6 +97,13 @@ private:
   double timePerPoint_; /* Actual time between points in input arrays */
   epicsTimeStamp startTime_;
   double *averageStore_;
+  int filterType_;
+  int filterOrder_;
+  int numFilterCoeffs_;
+  double *filterCoeffs_;
+  int numFilterPhases_; /* Number of output points that each input point contributes to */
+  int filterHead_;      /* Row of filterState_ for the next output point */
+  double *filterState_; /* Partial sums of the next numFilterPhases_ output points, [maxSignals_, numFilterPhases_] */
   double *signalData_;
   double *timeAxis_;
   double *timeStamp_;
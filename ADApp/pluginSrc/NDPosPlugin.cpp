@@ -10,8 +10,6 @@
 #include <iocsh.h>
 #include <sys/stat.h>
 #include <string>
-#include <list>
-#include <map>
 #include <vector>
 
 #include <epicsTypes.h>
@@ -52,9 +50,6 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
   // Call the base class method
   NDPluginDriver::beginProcessCallbacks(pArray);
   getIntegerParam(NDPos_Running, &running);
-  // We must maintain the size of the list ourselves, as calling
-  // size() on the list has a complexity of O(n) which causes a problem
-  // once we get into tens of thousands of items.
   getIntegerParam(NDPos_CurrentQty, &size);
   // Only attach the position data to the array if we are running
   if (running == NDPOS_RUNNING){
@@ -104,7 +99,7 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
           if (mode == MODE_DISCARD){
             while ((expectedID < IDValue) && (size > 0)){
               // The index will stay the same, and we need to pop the value out of the position array
-              positionArray.erase(positionArray.begin());
+              positionTable.discard(1);
               size--;
               expectedID += IDDifference;
               dropped++;
@@ -148,23 +143,17 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
         pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 1);
         this->getAttributes(pArrayOut->pAttributeList);
         if (pArrayOut){
-          std::list<std::map<std::string, double> >::iterator it = positionArray.begin();
-          std::advance(it, index);
-          //std::map<std::string, double> pos = positionArray[index];
-          std::map<std::string, double> pos = *it;
+          const std::vector<std::string>& names = positionTable.getDimensions();
           std::stringstream sspos;
           sspos << "[";
-          bool firstTime = true;
-          std::map<std::string, double>::iterator iter;
-          for (iter = pos.begin(); iter != pos.end(); iter++){
-            if (firstTime){
-              firstTime = false;
-            } else {
+          for (size_t dim = 0; dim < names.size(); dim++){
+            double value = positionTable.value(dim, index);
+            if (dim > 0){
               sspos << ",";
             }
-            sspos << iter->first << "=" << iter->second;
+            sspos << names[dim] << "=" << value;
             // Create the NDAttribute with the position data
-            NDAttribute *pAtt = new NDAttribute(iter->first.c_str(), "Position of NDArray", NDAttrSourceDriver, driverName, NDAttrFloat64, &(iter->second));
+            NDAttribute *pAtt = new NDAttribute(names[dim].c_str(), "Position of NDArray", NDAttrSourceDriver, driverName, NDAttrFloat64, &value);
             // Add the NDAttribute to the NDArray
             pArrayOut->pAttributeList->add(pAtt);
           }
@@ -188,7 +177,7 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
         getIntegerParam(NDPos_Mode, &mode);
         if (mode == MODE_DISCARD){
           // The index will stay the same, and we need to pop the value out of the position array
-          positionArray.erase(positionArray.begin());
+          positionTable.discard(1);
           size--;
           setIntegerParam(NDPos_CurrentQty, size);
         } else if (mode == MODE_KEEP){
@@ -252,8 +241,8 @@ asynStatus NDPosPlugin::writeInt32(asynUser *pasynUser, epicsInt32 value)
       // Reset the last sent position
       setStringParam(NDPos_CurrentPos, "");
       // Clear out the position array
-      positionArray.clear();
-      setIntegerParam(NDPos_CurrentQty, (int)positionArray.size());
+      positionTable.clear();
+      setIntegerParam(NDPos_CurrentQty, (int)positionTable.size());
     } else {
       // If this parameter belongs to a base class call its method
       if (function < FIRST_NDPOS_PARAM){
@@ -300,25 +289,28 @@ asynStatus NDPosPlugin::writeOctet(asynUser *pasynUser, const char *value, size_
 
   if (function == NDPos_Filename){
     // Read the filename parameter
-    std::string xml;
-    getStringParam(NDPos_Filename, xml);
-    // Now validate the XML
+    std::string filename;
+    getStringParam(NDPos_Filename, filename);
+    /* Load the positions with the lock released, so that arrays continue to be processed
+     * while a large file loads.  The positions are then appended to the position set,
+     * which is possible while running.
+     */
     NDPosPluginFileReader fr;
-    if (fr.validateXML(xml) == asynSuccess){
-      setIntegerParam(NDPos_FileValid, 1);
-      NDPosPluginFileReader fr;
-       /* Read the filename and valid parameters
-       * then the positions are loaded and appended to the position set.
-       */
-      fr.loadXML(xml);
-      std::vector<std::map<std::string, double> > positions = fr.readPositions();
-      positionArray.insert(positionArray.end(), positions.begin(), positions.end());
-      setIntegerParam(NDPos_CurrentQty, (int)positionArray.size());
-      callParamCallbacks();
-    } else {
-      setIntegerParam(NDPos_FileValid, 0);
+    this->unlock();
+    status = fr.loadFile(filename);
+    this->lock();
+    if (status == asynSuccess && positionTable.append(fr.readPositions()) != asynSuccess){
+      asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s:%s: dimensions of %s do not match the loaded positions\n",
+                driverName, functionName, filename.c_str());
       status = asynError;
+    } else if (status != asynSuccess){
+      asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s:%s: error loading %s: %s\n",
+                driverName, functionName, filename.c_str(), fr.getErrorMsg().c_str());
     }
+    setIntegerParam(NDPos_FileValid, status == asynSuccess ? 1 : 0);
+    setIntegerParam(NDPos_CurrentQty, (int)positionTable.size());
 
   } else if (function < FIRST_NDPOS_PARAM){
     // If this parameter belongs to a base class call its method
@@ -10,7 +10,7 @@
  *
  *  The following parameters are used to interact with this plugin:
  *
- *  NDPos_Filename           - Filename to load positional data from
+ *  NDPos_Filename           - Filename to load positional data from (XML, CSV or binary)
  *  NDPos_FileValid          - Is the currently selected filename a valid location
  *  NDPos_Load               - Load the filename specified above
  *  NDPos_Clear              - Clear the current positional data store
@@ -32,10 +32,9 @@
 
 #include <epicsTypes.h>
 #include <string>
-#include <list>
-#include <map>
 
 #include "NDPluginDriver.h"
+#include "NDPosPluginTable.h"
 
 #define str_NDPos_Filename        "NDPos_Filename"
 #define str_NDPos_FileValid       "NDPos_FileValid"
@@ -103,7 +102,7 @@ protected:
 
 private:
   // Plugin member variables
-  std::list<std::map<std::string, double> > positionArray;
+  NDPosPluginTable positionTable;
 };
 
 #endif /* NDPosPluginAPP_SRC_NDPOSPLUGIN_H_ */
@@ -6,7 +6,14 @@
  */
 
 #include "NDPosPluginFileReader.h"
-#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fstream>
+
+#include <epicsTypes.h>
+#include <epicsEndian.h>
 
 const std::string NDPosPluginFileReader::ELEMENT_NAME       = "name";
 const std::string NDPosPluginFileReader::ELEMENT_DIMENSIONS = "dimensions";
@@ -25,11 +32,10 @@ NDPosPluginFileReader::~NDPosPluginFileReader()
 {
 }
 
-asynStatus NDPosPluginFileReader::validateXML(const std::string& filename)
+asynStatus NDPosPluginFileReader::loadXML(const std::string& filename)
 {
   asynStatus status = asynSuccess;
   int ret = 0;
-  // Check for either a valid XML file or a valid XML string
   // if the file name contains <pos_layout> then load it as an xml string from memory
   if (filename.find("<pos_layout>") != std::string::npos){
     xmlreader = xmlReaderForMemory(filename.c_str(), (int)filename.length(), NULL, NULL, 0);
@@ -44,7 +50,7 @@ asynStatus NDPosPluginFileReader::validateXML(const std::string& filename)
 
   if (status == asynSuccess){
     while ((ret = xmlTextReaderRead(xmlreader)) == 1){
-      // Do nothing, we're just trying to validate
+      this->processNode();
     }
     xmlFreeTextReader(xmlreader);
     xmlreader = NULL;
@@ -57,51 +63,221 @@ asynStatus NDPosPluginFileReader::validateXML(const std::string& filename)
   return status;
 }
 
-asynStatus NDPosPluginFileReader::loadXML(const std::string& filename)
+std::vector<std::string> NDPosPluginFileReader::readDimensions()
 {
-  asynStatus status = asynSuccess;
-  int ret = 0;
-  // if the file name contains <pos_layout> then load it as an xml string from memory
+  return dimensions;
+}
+
+const NDPosPluginTable& NDPosPluginFileReader::readPositions()
+{
+  return positions;
+}
+
+asynStatus NDPosPluginFileReader::clearPositions()
+{
+  positions.clear();
+  dimensions.clear();
+  columnIndex.clear();
+  return asynSuccess;
+}
+
+/** Loads a position file in any of the supported formats.
+  * The format is XML if filename contains <pos_layout> (XML string) or if the file starts with '<',
+  * binary if the file starts with NDPOS_BINARY_MAGIC, and CSV otherwise.
+  * The positions are read one at a time into the column store, so no intermediate copy is made.
+  */
+asynStatus NDPosPluginFileReader::loadFile(const std::string& filename)
+{
+  char header[sizeof(NDPOS_BINARY_MAGIC)] = {0};
+  size_t nRead;
+  size_t i;
+  FILE *file;
+
   if (filename.find("<pos_layout>") != std::string::npos){
-    xmlreader = xmlReaderForMemory(filename.c_str(), (int)filename.length(), NULL, NULL, 0);
-  } else {
-    xmlreader = xmlReaderForFile(filename.c_str(), NULL, 0);
+    return loadXML(filename);
   }
-
-  if (xmlreader == NULL){
-    setErrorMsg("Error creating XML parser, check file");
-    status = asynError;
+  file = fopen(filename.c_str(), "rb");
+  if (file == NULL){
+    setErrorMsg("Unable to open file");
+    return asynError;
+  }
+  nRead = fread(header, 1, sizeof(header)-1, file);
+  fclose(file);
+  if (nRead == sizeof(header)-1 && memcmp(header, NDPOS_BINARY_MAGIC, nRead) == 0){
+    return loadBinary(filename);
+  }
+  for (i = 0; i < nRead && isspace((unsigned char)header[i]); i++){
+  }
+  if (i < nRead && header[i] == '<'){
+    return loadXML(filename);
   }
+  return loadCSV(filename);
+}
 
-  if (status == asynSuccess){
-    while ((ret = xmlTextReaderRead(xmlreader)) == 1){
-      this->processNode();
+/** Loads a CSV position file.  The first line that is not empty and does not start with '#'
+  * contains the dimension names separated by commas.  Each following line contains one position,
+  * with one value for each dimension.
+  */
+asynStatus NDPosPluginFileReader::loadCSV(const std::string& filename)
+{
+  std::ifstream file(filename.c_str());
+  std::string line;
+  const char *ptr;
+  char *end;
+  size_t dim;
+
+  if (!file){
+    setErrorMsg("Unable to open file");
+    return asynError;
+  }
+  while (std::getline(file, line)){
+    ptr = line.c_str();
+    while (isspace((unsigned char)*ptr)) ptr++;
+    if (*ptr == '\0' || *ptr == '#'){
+      continue;
     }
-    xmlFreeTextReader(xmlreader);
-    xmlreader = NULL;
-    if (ret != 0){
-      setErrorMsg("XML parsing failed, check file format");
-      status = asynError;
+    if (dimensions.empty()){
+      // Header line with the dimension names
+      std::string::size_type start = 0, comma;
+      do {
+        comma = line.find(',', start);
+        std::string name = line.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        name.erase(0, name.find_first_not_of(" \t\r"));
+        name.erase(name.find_last_not_of(" \t\r") + 1);
+        dimensions.push_back(name);
+        start = comma + 1;
+      } while (comma != std::string::npos);
+      if (startPositions() != asynSuccess){
+        return asynError;
+      }
+      continue;
+    }
+    for (dim = 0; dim < dimensions.size(); dim++){
+      position[columnIndex[dim]] = strtod(ptr, &end);
+      if (end == ptr){
+        break;
+      }
+      ptr = end;
+      while (isspace((unsigned char)*ptr)) ptr++;
+      if (*ptr == ',' && dim+1 < dimensions.size()){
+        ptr++;
+      }
     }
+    if (dim != dimensions.size() || *ptr != '\0'){
+      setErrorMsg("CSV parsing failed, check file format");
+      return asynError;
+    }
+    positions.appendPosition(&position[0]);
   }
-
-  return status;
+  if (dimensions.empty()){
+    setErrorMsg("CSV file has no dimension names");
+    return asynError;
+  }
+  return asynSuccess;
 }
 
-std::vector<std::string> NDPosPluginFileReader::readDimensions()
+static bool readUInt32(FILE *file, epicsUInt32 *value)
 {
-  return dimensions;
+  unsigned char bytes[4];
+  if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)){
+    return false;
+  }
+  *value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((epicsUInt32)bytes[3] << 24);
+  return true;
 }
 
-std::vector<std::map<std::string, double> > NDPosPluginFileReader::readPositions()
+/** Loads a binary position file, see NDPOS_BINARY_MAGIC for the format. */
+asynStatus NDPosPluginFileReader::loadBinary(const std::string& filename)
 {
-  return positions;
+  static const size_t blockPositions = 4096;
+  char magic[sizeof(NDPOS_BINARY_MAGIC)-1];
+  epicsUInt32 version, numDimensions, length, numPositions;
+  std::vector<double> block;
+  size_t count, pos, dim;
+  asynStatus status = asynSuccess;
+  FILE *file;
+
+  file = fopen(filename.c_str(), "rb");
+  if (file == NULL){
+    setErrorMsg("Unable to open file");
+    return asynError;
+  }
+  if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+      memcmp(magic, NDPOS_BINARY_MAGIC, sizeof(magic)) != 0 ||
+      !readUInt32(file, &version) || version != NDPOS_BINARY_VERSION ||
+      !readUInt32(file, &numDimensions) || numDimensions > 1024){
+    status = asynError;
+  }
+  for (dim = 0; status == asynSuccess && dim < numDimensions; dim++){
+    if (!readUInt32(file, &length) || length == 0 || length > 1024){
+      status = asynError;
+    } else {
+      std::string name(length, ' ');
+      if (fread(&name[0], 1, length, file) != length){
+        status = asynError;
+      }
+      dimensions.push_back(name);
+    }
+  }
+  if (status == asynSuccess && !readUInt32(file, &numPositions)){
+    status = asynError;
+  }
+  if (status != asynSuccess){
+    fclose(file);
+    setErrorMsg("Binary file header is invalid, check file format");
+    return status;
+  }
+  if (startPositions() != asynSuccess){
+    fclose(file);
+    return asynError;
+  }
+  positions.reserve(numPositions);
+  block.resize(blockPositions * numDimensions);
+  for (pos = 0; pos < numPositions; pos += count){
+    count = numPositions - pos;
+    if (count > blockPositions) count = blockPositions;
+    if (fread(&block[0], sizeof(double), count * numDimensions, file) != count * numDimensions){
+      fclose(file);
+      setErrorMsg("Binary file is shorter than its header says");
+      return asynError;
+    }
+    for (size_t i = 0; i < count; i++){
+      double *values = &block[i * numDimensions];
+      for (dim = 0; dim < numDimensions; dim++){
+#if EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG
+        char *bytes = (char *)&values[dim];
+        for (int b = 0; b < 4; b++){
+          char tmp = bytes[b];
+          bytes[b] = bytes[7-b];
+          bytes[7-b] = tmp;
+        }
+#endif
+        position[columnIndex[dim]] = values[dim];
+      }
+      positions.appendPosition(&position[0]);
+    }
+  }
+  fclose(file);
+  return asynSuccess;
 }
 
-asynStatus NDPosPluginFileReader::clearPositions()
+/** Called once the dimension names are known, before the first position is added.
+  * Sets up the column store and the mapping from the order of the file to the order of the store.
+  */
+asynStatus NDPosPluginFileReader::startPositions()
 {
-  positions.clear();
-  dimensions.clear();
+  if (!columnIndex.empty()){
+    return asynSuccess;
+  }
+  if (dimensions.empty() || positions.setDimensions(dimensions) != asynSuccess){
+    setErrorMsg("Dimension names are missing or not unique");
+    return asynError;
+  }
+  columnIndex.resize(dimensions.size());
+  for (size_t dim = 0; dim < dimensions.size(); dim++){
+    columnIndex[dim] = positions.findDimension(dimensions[dim]);
+  }
+  position.resize(dimensions.size());
   return asynSuccess;
 }
 
@@ -163,6 +339,7 @@ asynStatus NDPosPluginFileReader::addDimension()
   if (status == asynSuccess){
     std::string str_dim_name;
     str_dim_name = (char*)dim_name;
+    xmlFree(dim_name);
     //printf("Adding dimension: %s\n", str_dim_name.c_str());
     // Add the dimension to the vector of dimension names
     dimensions.push_back(str_dim_name);
@@ -174,40 +351,35 @@ asynStatus NDPosPluginFileReader::addPosition()
 {
   asynStatus status = asynSuccess;
   xmlChar *pos_val = NULL;
-  std::string pos_str;
-  std::map<std::string, double> pos;
+  char *end;
 
   // First check the basics
   if (!xmlTextReaderHasAttributes(this->xmlreader)){
     status = asynError;
   }
 
-  double index;
+  if (status == asynSuccess){
+    status = startPositions();
+  }
 
   // Loop over the dimensions looking for each
-  for (std::vector<std::string>::iterator iter = dimensions.begin(); iter != dimensions.end(); iter++){
+  for (size_t dim = 0; dim < dimensions.size() && status == asynSuccess; dim++){
     // Check for the dimension name specified in the element
-    if (status == asynSuccess){
-      pos_val = xmlTextReaderGetAttribute(this->xmlreader, (const xmlChar *)(*iter).c_str());
-      if (pos_val == NULL){
+    pos_val = xmlTextReaderGetAttribute(this->xmlreader, (const xmlChar *)dimensions[dim].c_str());
+    if (pos_val == NULL){
+      status = asynError;
+    } else {
+      // Convert the string value into the position value
+      position[columnIndex[dim]] = strtod((const char *)pos_val, &end);
+      if (end == (char *)pos_val){
         status = asynError;
-      } else {
-        // Convert the string value into an integer index
-        std::stringstream sindex((char *)pos_val);
-        sindex >> index;
-        if (!sindex){
-          status = asynError;
-        } else {
-          // Insert the dimension index into the position map
-          pos[*iter] = index;
-        }
       }
+      xmlFree(pos_val);
     }
   }
 
   if (status == asynSuccess){
-    //printf("Adding position: %s\n", pos_str.c_str());
-    positions.push_back(pos);
+    positions.appendPosition(&position[0]);
   }
   return status;
 }
@@ -12,7 +12,17 @@
 #include <libxml/xmlreader.h>
 #include <string>
 #include <vector>
-#include <map>
+
+#include "NDPosPluginTable.h"
+
+/* Binary position files start with NDPOS_BINARY_MAGIC followed by little-endian
+ * epicsUInt32 version (NDPOS_BINARY_VERSION), epicsUInt32 number of dimensions,
+ * for each dimension an epicsUInt32 name length and the name (not terminated),
+ * and an epicsUInt32 number of positions.  Then come the positions as little-endian
+ * IEEE doubles, one value for each dimension in the order the names were given.
+ */
+#define NDPOS_BINARY_MAGIC   "NDPosBin"
+#define NDPOS_BINARY_VERSION 1
 
 class NDPosPluginFileReader
 {
@@ -27,10 +37,12 @@ public:
 
   NDPosPluginFileReader();
   virtual ~NDPosPluginFileReader();
-  asynStatus validateXML(const std::string& filename);
   asynStatus loadXML(const std::string& filename);
+  asynStatus loadCSV(const std::string& filename);
+  asynStatus loadBinary(const std::string& filename);
+  asynStatus loadFile(const std::string& filename);
   std::vector<std::string> readDimensions();
-  std::vector<std::map<std::string, double> > readPositions();
+  const NDPosPluginTable& readPositions();
   asynStatus clearPositions();
   asynStatus processNode();
   asynStatus addDimension();
@@ -39,11 +51,14 @@ public:
 
 protected:
   void setErrorMsg(const std::string& msg);
+  asynStatus startPositions();
 
 private:
   xmlTextReaderPtr xmlreader;
-  std::vector<std::string> dimensions;
-  std::vector<std::map<std::string, double> > positions;
+  std::vector<std::string> dimensions;   // Dimension names in the order of the file
+  std::vector<int> columnIndex;          // Index in positions of each entry of dimensions
+  std::vector<double> position;          // Values of the position being read, in the order of positions
+  NDPosPluginTable positions;
   std::string errorMessage;
 };
 
@@ -0,0 +1,136 @@
+/*
+ * NDPosPluginTable.cpp
+ *
+ *  Column store for the positions used by NDPosPlugin.
+ */
+
+#include "NDPosPluginTable.h"
+#include <algorithm>
+
+// Discarded positions are only removed from the columns once there are at least this many
+static const size_t COMPACT_THRESHOLD = 4096;
+
+NDPosPluginTable::NDPosPluginTable()
+  : first(0)
+{
+}
+
+NDPosPluginTable::~NDPosPluginTable()
+{
+}
+
+/** Sets the dimension names.  The dimensions are held in alphabetical order,
+  * so use findDimension() to get the index of a named dimension.
+  * The names can only be changed while the table is empty.
+  * \param[in] dimensionNames Names of the dimensions, which must be unique.
+  */
+asynStatus NDPosPluginTable::setDimensions(const std::vector<std::string>& dimensionNames)
+{
+  std::vector<std::string> sorted(dimensionNames);
+  std::sort(sorted.begin(), sorted.end());
+  if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()){
+    return asynError;
+  }
+  if (sorted == names){
+    return asynSuccess;
+  }
+  if (size() > 0){
+    return asynError;
+  }
+  names = sorted;
+  columns.assign(names.size(), std::vector<double>());
+  first = 0;
+  return asynSuccess;
+}
+
+const std::vector<std::string>& NDPosPluginTable::getDimensions() const
+{
+  return names;
+}
+
+/** Returns the index of the named dimension, or -1 if there is no such dimension. */
+int NDPosPluginTable::findDimension(const std::string& name) const
+{
+  std::vector<std::string>::const_iterator iter = std::lower_bound(names.begin(), names.end(), name);
+  if (iter == names.end() || *iter != name){
+    return -1;
+  }
+  return (int)(iter - names.begin());
+}
+
+size_t NDPosPluginTable::numDimensions() const
+{
+  return names.size();
+}
+
+/** Returns the number of positions that have not been discarded. */
+size_t NDPosPluginTable::size() const
+{
+  if (columns.empty()){
+    return 0;
+  }
+  return columns[0].size() - first;
+}
+
+/** Returns the value of one dimension of a position.
+  * \param[in] dimension Index of the dimension, see findDimension().
+  * \param[in] position Index of the position, 0 being the first position that has not been discarded.
+  */
+double NDPosPluginTable::value(size_t dimension, size_t position) const
+{
+  return columns[dimension][first + position];
+}
+
+/** Reserves space for a number of positions beyond the current size. */
+void NDPosPluginTable::reserve(size_t positions)
+{
+  for (size_t dim = 0; dim < columns.size(); dim++){
+    columns[dim].reserve(columns[dim].size() + positions);
+  }
+}
+
+/** Appends one position.
+  * \param[in] values One value for each dimension, in the order of getDimensions().
+  */
+void NDPosPluginTable::appendPosition(const double *values)
+{
+  for (size_t dim = 0; dim < columns.size(); dim++){
+    columns[dim].push_back(values[dim]);
+  }
+}
+
+/** Appends all positions of another table, which must have the same dimensions
+  * unless this table is empty.
+  */
+asynStatus NDPosPluginTable::append(const NDPosPluginTable& other)
+{
+  if (setDimensions(other.names) != asynSuccess){
+    return asynError;
+  }
+  for (size_t dim = 0; dim < columns.size(); dim++){
+    columns[dim].insert(columns[dim].end(), other.columns[dim].begin() + other.first, other.columns[dim].end());
+  }
+  return asynSuccess;
+}
+
+/** Discards positions from the front of the table.  This takes constant time;
+  * the memory is reclaimed once at least half of the stored positions have been discarded.
+  */
+void NDPosPluginTable::discard(size_t positions)
+{
+  first += std::min(positions, size());
+  if (first >= COMPACT_THRESHOLD && first * 2 >= columns[0].size()){
+    for (size_t dim = 0; dim < columns.size(); dim++){
+      columns[dim].erase(columns[dim].begin(), columns[dim].begin() + first);
+    }
+    first = 0;
+  }
+}
+
+/** Removes all positions and dimensions. */
+void NDPosPluginTable::clear()
+{
+  names.clear();
+  columns.clear();
+  first = 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * NDPosPluginTable.h
+ *
+ *  Column store for the positions used by NDPosPlugin.
+ *  Each dimension is held in its own contiguous array of doubles,
+ *  so a position is read with an index rather than by walking a list,
+ *  and a position costs 8 bytes per dimension.
+ */
+
+#ifndef POSPLUGINAPP_SRC_NDPOSPLUGINTABLE_H_
+#define POSPLUGINAPP_SRC_NDPOSPLUGINTABLE_H_
+
+#include "asynDriver.h"
+#include <string>
+#include <vector>
+
+class NDPosPluginTable
+{
+public:
+  NDPosPluginTable();
+  virtual ~NDPosPluginTable();
+  asynStatus setDimensions(const std::vector<std::string>& names);
+  const std::vector<std::string>& getDimensions() const;
+  int findDimension(const std::string& name) const;
+  size_t numDimensions() const;
+  size_t size() const;
+  double value(size_t dimension, size_t position) const;
+  void reserve(size_t positions);
+  void appendPosition(const double *values);
+  asynStatus append(const NDPosPluginTable& other);
+  void discard(size_t positions);
+  void clear();
+
+private:
+  std::vector<std::string> names;                 // Dimension names, sorted
+  std::vector<std::vector<double> > columns;      // One array of values for each dimension
+  size_t first;                                   // Index in columns of the first position that has not been discarded
+};
+
+#endif /* POSPLUGINAPP_SRC_NDPOSPLUGINTABLE_H_ */
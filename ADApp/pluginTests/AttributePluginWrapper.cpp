@@ -0,0 +1,18 @@
+/*
+ * AttributePluginWrapper.cpp
+ *
+ */
+
+#include "AttributePluginWrapper.h"
+
+AttributePluginWrapper::AttributePluginWrapper(const std::string& port, int maxAttributes,
+                                               const std::string& ndArrayPort)
+  :  NDPluginAttribute(port.c_str(), 50, 1, ndArrayPort.c_str(), 0, maxAttributes, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+AttributePluginWrapper::~AttributePluginWrapper()
+{
+  cleanup();
+}
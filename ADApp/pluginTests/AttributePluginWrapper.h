@@ -0,0 +1,19 @@
+/*
+ * AttributePluginWrapper.h
+ *
+ */
+
+#ifndef ADAPP_PLUGINTESTS_ATTRIBUTEPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_ATTRIBUTEPLUGINWRAPPER_H_
+
+#include <NDPluginAttribute.h>
+#include "AsynPortClientContainer.h"
+
+class AttributePluginWrapper : public NDPluginAttribute, public AsynPortClientContainer
+{
+public:
+  AttributePluginWrapper(const std::string& port, int maxAttributes, const std::string& ndArrayPort);
+  virtual ~AttributePluginWrapper();
+};
+
+#endif /* ADAPP_PLUGINTESTS_ATTRIBUTEPLUGINWRAPPER_H_ */
@@ -0,0 +1,17 @@
+/*
+ * GatherPluginWrapper.cpp
+ *
+ */
+
+#include "GatherPluginWrapper.h"
+
+GatherPluginWrapper::GatherPluginWrapper(const std::string& port, int maxPorts, int blockingCallbacks)
+  :  NDPluginGather(port.c_str(), 10, blockingCallbacks, maxPorts, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+GatherPluginWrapper::~GatherPluginWrapper()
+{
+  cleanup();
+}
@@ -0,0 +1,19 @@
+/*
+ * GatherPluginWrapper.h
+ *
+ */
+
+#ifndef ADAPP_PLUGINTESTS_GATHERPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_GATHERPLUGINWRAPPER_H_
+
+#include <NDPluginGather.h>
+#include "AsynPortClientContainer.h"
+
+class GatherPluginWrapper : public NDPluginGather, public AsynPortClientContainer
+{
+public:
+  GatherPluginWrapper(const std::string& port, int maxPorts, int blockingCallbacks=1);
+  virtual ~GatherPluginWrapper();
+};
+
+#endif /* ADAPP_PLUGINTESTS_GATHERPLUGINWRAPPER_H_ */
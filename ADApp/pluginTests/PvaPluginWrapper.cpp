@@ -0,0 +1,24 @@
+/*
+ * PvaPluginWrapper.cpp
+ *
+ */
+
+#include "PvaPluginWrapper.h"
+
+PvaPluginWrapper::PvaPluginWrapper(const std::string& port,
+                                   int queueSize,
+                                   int blocking,
+                                   const std::string& detectorPort,
+                                   int address,
+                                   const std::string& pvName)
+  :  NDPluginPva(port.c_str(), queueSize, blocking,
+                 detectorPort.c_str(), address, pvName.c_str(),
+                 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+PvaPluginWrapper::~PvaPluginWrapper ()
+{
+  cleanup();
+}
@@ -0,0 +1,24 @@
+/*
+ * PvaPluginWrapper.h
+ *
+ */
+
+#ifndef ADAPP_PLUGINTESTS_PVAPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_PVAPLUGINWRAPPER_H_
+
+#include <NDPluginPva.h>
+#include "AsynPortClientContainer.h"
+
+class PvaPluginWrapper : public NDPluginPva, public AsynPortClientContainer
+{
+public:
+  PvaPluginWrapper(const std::string& port,
+                   int queueSize,
+                   int blocking,
+                   const std::string& detectorPort,
+                   int address,
+                   const std::string& pvName);
+  virtual ~PvaPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_PVAPLUGINWRAPPER_H_ */
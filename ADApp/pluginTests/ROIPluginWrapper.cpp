@@ -21,10 +21,11 @@ ROIPluginWrapper::ROIPluginWrapper(const std::string& port,
                                    size_t maxMemory,
                                    int priority,
                                    int stackSize,
-                                   int maxThreads)
+                                   int maxThreads,
+                                   int maxROIs)
   :  NDPluginROI(port.c_str(), queueSize, blocking,
                         detectorPort.c_str(), address,
-                        0, maxMemory, priority, stackSize, maxThreads),
+                        0, maxMemory, priority, stackSize, maxThreads, maxROIs),
      AsynPortClientContainer(port)
 {
 }
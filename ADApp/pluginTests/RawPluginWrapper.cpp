@@ -0,0 +1,17 @@
+/*
+ * RawPluginWrapper.cpp
+ *
+ */
+
+#include "RawPluginWrapper.h"
+
+RawPluginWrapper::RawPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDFileRaw(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+RawPluginWrapper::~RawPluginWrapper()
+{
+  cleanup();
+}
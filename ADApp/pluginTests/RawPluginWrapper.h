@@ -0,0 +1,19 @@
+/*
+ * RawPluginWrapper.h
+ *
+ */
+
+#ifndef ADAPP_PLUGINTESTS_RAWPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_RAWPLUGINWRAPPER_H_
+
+#include <NDFileRaw.h>
+#include "AsynPortClientContainer.h"
+
+class RawPluginWrapper : public NDFileRaw, public AsynPortClientContainer
+{
+public:
+  RawPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~RawPluginWrapper();
+};
+
+#endif /* ADAPP_PLUGINTESTS_RAWPLUGINWRAPPER_H_ */
@@ -0,0 +1,17 @@
+/*
+ * ScatterPluginWrapper.cpp
+ *
+ */
+
+#include "ScatterPluginWrapper.h"
+
+ScatterPluginWrapper::ScatterPluginWrapper(const std::string& port, const std::string& ndArrayPort)
+  :  NDPluginScatter(port.c_str(), 10, 1, ndArrayPort.c_str(), 0, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+ScatterPluginWrapper::~ScatterPluginWrapper()
+{
+  cleanup();
+}
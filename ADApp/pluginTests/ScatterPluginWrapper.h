@@ -0,0 +1,19 @@
+/*
+ * ScatterPluginWrapper.h
+ *
+ */
+
+#ifndef ADAPP_PLUGINTESTS_SCATTERPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_SCATTERPLUGINWRAPPER_H_
+
+#include <NDPluginScatter.h>
+#include "AsynPortClientContainer.h"
+
+class ScatterPluginWrapper : public NDPluginScatter, public AsynPortClientContainer
+{
+public:
+  ScatterPluginWrapper(const std::string& port, const std::string& ndArrayPort);
+  virtual ~ScatterPluginWrapper();
+};
+
+#endif /* ADAPP_PLUGINTESTS_SCATTERPLUGINWRAPPER_H_ */
@@ -15,6 +15,11 @@
 
 using namespace std;
 
+// Global variables in NDArrayPool.cpp that control when arrays are split across threads
+extern volatile int NDArrayPoolThreads;
+extern volatile int NDArrayPoolThreadBytes;
+extern volatile int NDArrayPoolStreamBytes;
+
 
 struct NDArrayPoolFixture
 {
@@ -129,4 +134,218 @@ BOOST_AUTO_TEST_CASE(test_Pool)
     
 }
 
+static int releaseCount = 0;
+static void *releasedData = 0;
+
+static void testReleaseFunc(void *pData, void *pvt)
+{
+  releasedData = pData;
+  releaseCount++;
+}
+
+BOOST_AUTO_TEST_CASE(test_ExternalData)
+{
+  size_t dims = 1000;
+  char *buffer = (char *)malloc(dims);
+  NDArray *pArray;
+
+  releaseCount = 0;
+  releasedData = 0;
+  pArray = pPool->alloc(1, &dims, NDUInt8, dims, buffer, testReleaseFunc, NULL);
+  BOOST_REQUIRE(pArray != 0);
+  BOOST_CHECK_EQUAL(pArray->pData, (void *)buffer);
+  // The pool does not own the buffer so it is not counted
+  BOOST_CHECK_EQUAL(pPool->getMemorySize(), 0);
+
+  pArray->reserve();
+  pArray->release();
+  BOOST_CHECK_EQUAL(releaseCount, 0);
+  pArray->release();
+  BOOST_CHECK_EQUAL(releaseCount, 1);
+  BOOST_CHECK_EQUAL(releasedData, (void *)buffer);
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), 1);
+  BOOST_CHECK_EQUAL(pPool->getMemorySize(), 0);
+  free(buffer);
+}
+
+BOOST_AUTO_TEST_CASE(test_Share)
+{
+  size_t dims[2] = {10, 20};
+  int value = 42;
+  NDArray *pArray, *pShared;
+
+  pArray = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+  BOOST_REQUIRE(pArray != 0);
+  pArray->uniqueId = 7;
+  pArray->pAttributeList->add("Test", "", NDAttrInt32, &value);
+
+  pShared = pPool->share(pArray);
+  BOOST_REQUIRE(pShared != 0);
+  BOOST_CHECK(pShared != pArray);
+  BOOST_CHECK_EQUAL(pShared->pData, pArray->pData);
+  BOOST_CHECK_EQUAL(pShared->uniqueId, 7);
+  BOOST_CHECK_EQUAL(pShared->ndims, 2);
+  BOOST_CHECK_EQUAL(pShared->dims[1].size, 20);
+  BOOST_CHECK_EQUAL(pArray->getReferenceCount(), 2);
+  // The shared array is its only reference, but it does not own its data
+  BOOST_CHECK_EQUAL(pShared->getReferenceCount(), 1);
+  BOOST_CHECK(pShared->getReleaseFunc() != NULL);
+  BOOST_CHECK(pArray->getReleaseFunc() == NULL);
+
+  // Attributes added to the shared array must not appear on the original
+  pShared->pAttributeList->add("Extra", "", NDAttrInt32, &value);
+  BOOST_CHECK_EQUAL(pShared->pAttributeList->count(), 2);
+  BOOST_CHECK_EQUAL(pArray->pAttributeList->count(), 1);
+
+  // The original is kept until the shared array is released
+  pArray->release();
+  BOOST_CHECK_EQUAL(pArray->getReferenceCount(), 1);
+  pShared->release();
+  BOOST_CHECK_EQUAL(pArray->getReferenceCount(), 0);
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_Convert)
+{
+  size_t dims[2] = {8, 6};
+  NDDimension_t dimsOut[2];
+  NDArray *pArray, *pOut;
+  epicsUInt16 *pData;
+  size_t x, y;
+
+  pArray = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+  BOOST_REQUIRE(pArray != 0);
+  pData = (epicsUInt16 *)pArray->pData;
+  for (y=0; y<dims[1]; y++) {
+    for (x=0; x<dims[0]; x++) {
+      pData[y*dims[0] + x] = (epicsUInt16)(x + 10*y);
+    }
+  }
+
+  // Region without binning and the same data type
+  memset(dimsOut, 0, sizeof(dimsOut));
+  dimsOut[0].offset = 1; dimsOut[0].size = 5; dimsOut[0].binning = 1;
+  dimsOut[1].offset = 2; dimsOut[1].size = 3; dimsOut[1].binning = 1; dimsOut[1].reverse = 1;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pArray, &pOut, NDUInt16, dimsOut), ND_SUCCESS);
+  BOOST_REQUIRE_EQUAL(pOut->dims[0].size, 5);
+  BOOST_REQUIRE_EQUAL(pOut->dims[1].size, 3);
+  epicsUInt16 *pRegion = (epicsUInt16 *)pOut->pData;
+  for (y=0; y<3; y++) {
+    for (x=0; x<5; x++) {
+      BOOST_CHECK_EQUAL(pRegion[y*5 + x], (x + 1) + 10*(4 - y));
+    }
+  }
+  pOut->release();
+
+  // 2x2 binning to a larger data type, reversed in X
+  memset(dimsOut, 0, sizeof(dimsOut));
+  dimsOut[0].size = 8; dimsOut[0].binning = 2; dimsOut[0].reverse = 1;
+  dimsOut[1].size = 6; dimsOut[1].binning = 2;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pArray, &pOut, NDUInt32, dimsOut), ND_SUCCESS);
+  BOOST_REQUIRE_EQUAL(pOut->dims[0].size, 4);
+  BOOST_REQUIRE_EQUAL(pOut->dims[1].size, 3);
+  epicsUInt32 *pBinned = (epicsUInt32 *)pOut->pData;
+  for (y=0; y<3; y++) {
+    for (x=0; x<4; x++) {
+      // Sum of input x=6-2x and 7-2x for y=2y and 2y+1
+      BOOST_CHECK_EQUAL(pBinned[y*4 + x], 2*(13 - 4*x) + 20*(4*y + 1));
+    }
+  }
+  pOut->release();
+
+  // Conversion of the whole array to Float32
+  BOOST_REQUIRE_EQUAL(pPool->convert(pArray, &pOut, NDFloat32), ND_SUCCESS);
+  epicsFloat32 *pFloat = (epicsFloat32 *)pOut->pData;
+  for (x=0; x<dims[0]*dims[1]; x++) {
+    BOOST_CHECK_EQUAL(pFloat[x], (epicsFloat32)pData[x]);
+  }
+  pOut->release();
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_ConvertThreads)
+{
+  size_t dims[2] = {60, 50};
+  NDDimension_t dimsOut[2];
+  NDArray *pArray, *pSingle, *pBanded;
+  epicsUInt16 *pData;
+  size_t i;
+  int saveThreadBytes = NDArrayPoolThreadBytes;
+
+  BOOST_REQUIRE(NDArrayPoolThreads > 0);
+  pArray = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+  BOOST_REQUIRE(pArray != 0);
+  pData = (epicsUInt16 *)pArray->pData;
+  for (i=0; i<dims[0]*dims[1]; i++) pData[i] = (epicsUInt16)(i*7 % 1000);
+
+  // Reversed region with 3x2 binning, by the calling thread and then split across threads
+  memset(dimsOut, 0, sizeof(dimsOut));
+  dimsOut[0].offset = 3; dimsOut[0].size = 45; dimsOut[0].binning = 3;
+  dimsOut[1].offset = 5; dimsOut[1].size = 42; dimsOut[1].binning = 2; dimsOut[1].reverse = 1;
+  NDArrayPoolThreadBytes = 1000000000;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pArray, &pSingle, NDFloat32, dimsOut), ND_SUCCESS);
+  NDArrayPoolThreadBytes = 0;
+  BOOST_REQUIRE_EQUAL(pPool->convert(pArray, &pBanded, NDFloat32, dimsOut), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(memcmp(pSingle->pData, pBanded->pData, 15*21*sizeof(epicsFloat32)), 0);
+  pSingle->release();
+  pBanded->release();
+
+  // Copy of the whole array
+  pBanded = pPool->copy(pArray, NULL, true);
+  BOOST_REQUIRE(pBanded != 0);
+  BOOST_CHECK_EQUAL(memcmp(pArray->pData, pBanded->pData, dims[0]*dims[1]*sizeof(epicsUInt16)), 0);
+  pBanded->release();
+
+  NDArrayPoolThreadBytes = saveThreadBytes;
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_CopyModes)
+{
+  size_t dims[2] = {30, 20};
+  int value = 42, oldValue = 1, readValue;
+  NDArray *pArray, *pOut;
+  NDAttribute *pAttribute;
+  epicsUInt16 *pData;
+  size_t i;
+
+  pArray = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+  BOOST_REQUIRE(pArray != 0);
+  pData = (epicsUInt16 *)pArray->pData;
+  for (i=0; i<dims[0]*dims[1]; i++) pData[i] = (epicsUInt16)i;
+  pArray->pAttributeList->add("Test", "", NDAttrInt32, &value);
+  pOut = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+  BOOST_REQUIRE(pOut != 0);
+  pOut->pAttributeList->add("Test", "", NDAttrInt32, &oldValue);
+  pOut->pAttributeList->add("Old", "", NDAttrInt32, &oldValue);
+  pAttribute = pOut->pAttributeList->find("Test");
+
+  // Update reuses the attribute with the same name and keeps the others
+  pPool->copy(pArray, pOut, false, true, true, NDCopyAttributesUpdate);
+  BOOST_CHECK_EQUAL(pOut->pAttributeList->count(), 2);
+  BOOST_CHECK(pOut->pAttributeList->find("Test") == pAttribute);
+  BOOST_REQUIRE(pAttribute->getValue(NDAttrInt32, &readValue) == ND_SUCCESS);
+  BOOST_CHECK_EQUAL(readValue, 42);
+
+  // None leaves the attributes alone
+  value = 43;
+  pArray->pAttributeList->add("Test", "", NDAttrInt32, &value);
+  pPool->copy(pArray, pOut, false, true, true, NDCopyAttributesNone);
+  pAttribute->getValue(NDAttrInt32, &readValue);
+  BOOST_CHECK_EQUAL(readValue, 42);
+
+  // Replace leaves only the input attributes; the data is copied with non-temporal stores
+  NDArrayPoolStreamBytes = 1;
+  pPool->copy(pArray, pOut, true);
+  NDArrayPoolStreamBytes = 0;
+  BOOST_CHECK_EQUAL(pOut->pAttributeList->count(), 1);
+  BOOST_REQUIRE(pOut->pAttributeList->find("Test") != 0);
+  pOut->pAttributeList->find("Test")->getValue(NDAttrInt32, &readValue);
+  BOOST_CHECK_EQUAL(readValue, 43);
+  BOOST_CHECK_EQUAL(memcmp(pArray->pData, pOut->pData, dims[0]*dims[1]*sizeof(epicsUInt16)), 0);
+
+  pOut->release();
+  pArray->release();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
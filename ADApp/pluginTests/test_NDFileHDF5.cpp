@@ -297,4 +297,540 @@ BOOST_AUTO_TEST_CASE(test_DatasetLayout1)
 
 }
 
+BOOST_AUTO_TEST_CASE(test_DirectChunkWrite)
+{
+  size_t tmpdims[] = {4,6};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  // The blocks do not need to be valid LZ4 since they are written to the file without being decompressed,
+  // but the chunk must have the layout of the HDF5 LZ4 filter: the uncompressed size (96 bytes) and block
+  // size as 8 and 4 byte big-endian integers, then one block of 28 bytes preceded by its size.
+  size_t compressedSize = 12 + 4 + 28;
+  const unsigned char header[] = {0, 0, 0, 0, 0, 0, 0, 96,  0, 0, 0, 96,  0, 0, 0, 28};
+
+  // Create some test arrays that look like compressed frames
+  std::vector<NDArray*>arrays(5);
+  fillNDArraysFromPool(dims, NDUInt32, arrays, arrayPool);
+  for (int i = 0; i < 5; i++)
+  {
+    memcpy(arrays[i]->pData, header, sizeof(header));
+    arrays[i]->codec = "lz4";
+    arrays[i]->compressedSize = compressedSize;
+  }
+
+  // Configure the HDF5 plugin with the LZ4 filter and one frame per chunk
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "directchunk");
+  hdf5->write(str_NDFileHDF5_compressionType, 6); // HDF5CompressLZ4
+  hdf5->write(str_NDFileHDF5_nRowChunks, 0);
+  hdf5->write(str_NDFileHDF5_nColChunks, 0);
+  hdf5->write(str_NDFileHDF5_nFramesChunks, 1);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, 3);
+  hdf5->write(NDFileCaptureString, 1);
+
+  // A codec that does not match the filter must be rejected
+  arrays[3]->codec = "blosc";
+  hdf5->lock();
+  BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[3]));
+  hdf5->unlock();
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), 0);
+
+  // A plain LZ4 frame without the header of the HDF5 filter must be rejected
+  memset(arrays[4]->pData, 0, sizeof(header));
+  hdf5->lock();
+  BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[4]));
+  hdf5->unlock();
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), 0);
+
+  for (int i = 0; i < 3; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+    BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), i+1);
+  }
+
+  HDF5FileReader fr("/tmp/directchunk_0.5");
+  std::vector<hsize_t> odims = fr.getDatasetDimensions("/entry/data/data");
+  BOOST_REQUIRE_EQUAL(odims.size(), 3);
+  BOOST_CHECK_EQUAL(odims[0], 3);
+  BOOST_CHECK_EQUAL(odims[1], 6);
+  BOOST_CHECK_EQUAL(odims[2], 4);
+
+#if H5_VERSION_GE(1,10,3)
+  // Each chunk must have been stored as it was received
+  hid_t file = H5Fopen("/tmp/directchunk_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  for (hsize_t frame = 0; frame < 3; frame++)
+  {
+    hsize_t offset[3] = {frame, 0, 0};
+    hsize_t chunkSize = 0;
+    BOOST_CHECK_EQUAL(H5Dget_chunk_storage_size(dataset, offset, &chunkSize), 0);
+    BOOST_CHECK_EQUAL(chunkSize, compressedSize);
+  }
+  H5Dclose(dataset);
+  H5Fclose(file);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(test_DirectChunkWriteBSLZ4)
+{
+  size_t tmpdims[] = {4,6};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  // A bitshuffle/LZ4 chunk of 96 bytes with a block size of 96 bytes, i.e. 24 4-byte elements,
+  // stored as one block of 28 bytes preceded by its size.
+  size_t compressedSize = 12 + 4 + 28;
+  const unsigned char header[] = {0, 0, 0, 0, 0, 0, 0, 96,  0, 0, 0, 96,  0, 0, 0, 28};
+
+  std::vector<NDArray*>arrays(2);
+  fillNDArraysFromPool(dims, NDUInt32, arrays, arrayPool);
+  for (int i = 0; i < 2; i++)
+  {
+    memcpy(arrays[i]->pData, header, sizeof(header));
+    for (size_t j = sizeof(header); j < compressedSize; j++) ((unsigned char *)arrays[i]->pData)[j] = (unsigned char)(i + j);
+    arrays[i]->codec = "bslz4";
+    arrays[i]->compressedSize = compressedSize;
+  }
+
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "directchunkbslz4");
+  hdf5->write(str_NDFileHDF5_compressionType, 5); // HDF5CompressBSLZ4
+  hdf5->write(str_NDFileHDF5_nRowChunks, 0);
+  hdf5->write(str_NDFileHDF5_nColChunks, 0);
+  hdf5->write(str_NDFileHDF5_nFramesChunks, 1);
+
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, 2);
+  hdf5->write(NDFileCaptureString, 1);
+  for (int i = 0; i < 2; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+    BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), i+1);
+  }
+
+  // The bitshuffle filter parameters must be complete, since the filter did not fill them in
+  // when the dataset was created: version, element size, block size and LZ4 compression.
+  hid_t file = H5Fopen("/tmp/directchunkbslz4_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE(file >= 0);
+  hid_t dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  hid_t cparms = H5Dget_create_plist(dataset);
+  unsigned int flags = 0;
+  unsigned int values[8] = {0};
+  size_t nValues = 8;
+  BOOST_REQUIRE(H5Pget_filter_by_id2(cparms, 32008, &flags, &nValues, values, 0, NULL, NULL) >= 0);
+  BOOST_REQUIRE_EQUAL(nValues, 5);
+  BOOST_CHECK_EQUAL(values[2], 4);
+  BOOST_CHECK_EQUAL(values[3], 0);
+  BOOST_CHECK_EQUAL(values[4], 2);
+  H5Pclose(cparms);
+
+#if H5_VERSION_GE(1,10,3)
+  // Each chunk must read back as it was received
+  for (hsize_t frame = 0; frame < 2; frame++)
+  {
+    hsize_t offset[3] = {frame, 0, 0};
+    uint32_t filterMask = 0;
+    std::vector<unsigned char> chunk(compressedSize);
+    BOOST_CHECK(H5Dread_chunk(dataset, H5P_DEFAULT, offset, &filterMask, &chunk[0]) >= 0);
+    BOOST_CHECK_EQUAL(filterMask, 0);
+    BOOST_CHECK(memcmp(&chunk[0], arrays[frame]->pData, compressedSize) == 0);
+  }
+#endif
+  H5Dclose(dataset);
+  H5Fclose(file);
+}
+
+BOOST_AUTO_TEST_CASE(test_ParallelChunkCompression)
+{
+  size_t tmpdims[] = {32,16};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  const int numFrames = 7;
+  const int numElements = 32*16;
+
+  // Frames that compress well, and one frame that does not compress and is stored uncompressed
+  std::vector<NDArray*>arrays(numFrames);
+  fillNDArraysFromPool(dims, NDUInt16, arrays, arrayPool);
+  for (int i = 0; i < numFrames; i++)
+  {
+    epicsUInt16 *pData = (epicsUInt16 *)arrays[i]->pData;
+    for (int j = 0; j < numElements; j++)
+    {
+      pData[j] = (i == 3) ? (epicsUInt16)((j * 40503u + 12345u) * 2654435761u >> 16) : (epicsUInt16)(j/8 + i);
+    }
+  }
+
+  // Configure the HDF5 plugin with the zlib filter, one frame per chunk and 3 compression threads
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "parallelcompress");
+  hdf5->write(str_NDFileHDF5_compressionType, 3); // HDF5CompressZlib
+  hdf5->write(str_NDFileHDF5_nRowChunks, 0);
+  hdf5->write(str_NDFileHDF5_nColChunks, 0);
+  hdf5->write(str_NDFileHDF5_nFramesChunks, 1);
+  hdf5->write(str_NDFileHDF5_numCompressThreads, 3);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, numFrames);
+  hdf5->write(NDFileCaptureString, 1);
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+    BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), i+1);
+  }
+
+  // The file must read back with the standard zlib filter, with the frames in order
+  std::vector<epicsUInt16> readback(numFrames*numElements);
+  hid_t file = H5Fopen("/tmp/parallelcompress_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE(file >= 0);
+  hid_t dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  BOOST_REQUIRE(dataset >= 0);
+  BOOST_CHECK(H5Dread(dataset, H5T_NATIVE_UINT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, &readback[0]) >= 0);
+  H5Dclose(dataset);
+  H5Fclose(file);
+  for (int i = 0; i < numFrames; i++)
+  {
+    BOOST_CHECK_EQUAL(memcmp(&readback[i*numElements], arrays[i]->pData, numElements*sizeof(epicsUInt16)), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_BatchWrites)
+{
+  size_t tmpdims[] = {8,4};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  // Not a multiple of the chunk size, so the last batch is written when the file is closed
+  const int numFrames = 10;
+  const int numElements = 8*4;
+
+  std::vector<NDArray*>arrays(numFrames);
+  fillNDArraysFromPool(dims, NDInt32, arrays, arrayPool);
+  for (int i = 0; i < numFrames; i++)
+  {
+    epicsInt32 *pData = (epicsInt32 *)arrays[i]->pData;
+    for (int j = 0; j < numElements; j++) pData[j] = i*1000 + j;
+  }
+
+  // Configure the HDF5 plugin to write batches of 4 frames
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "batchwrites");
+  hdf5->write(str_NDFileHDF5_nFramesChunks, 4);
+  hdf5->write(str_NDFileHDF5_batchWrites, 1);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, numFrames);
+  hdf5->write(NDFileCaptureString, 1);
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+    BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), i+1);
+  }
+
+  HDF5FileReader fr("/tmp/batchwrites_0.5");
+  std::vector<hsize_t> odims = fr.getDatasetDimensions("/entry/data/data");
+  BOOST_REQUIRE_EQUAL(odims.size(), 3);
+  BOOST_CHECK_EQUAL(odims[0], numFrames);
+  BOOST_CHECK_EQUAL(odims[1], 4);
+  BOOST_CHECK_EQUAL(odims[2], 8);
+
+  std::vector<epicsInt32> readback(numFrames*numElements);
+  hid_t file = H5Fopen("/tmp/batchwrites_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE(file >= 0);
+  hid_t dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  BOOST_REQUIRE(dataset >= 0);
+  BOOST_CHECK(H5Dread(dataset, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, &readback[0]) >= 0);
+  H5Dclose(dataset);
+  H5Fclose(file);
+  for (int i = 0; i < numFrames; i++)
+  {
+    BOOST_CHECK_EQUAL(memcmp(&readback[i*numElements], arrays[i]->pData, numElements*sizeof(epicsInt32)), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_ChunkAutoTune)
+{
+  size_t tmpdims[] = {256,256};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  // 64 kB frames: 16 frames fit in 1 MB, spread evenly over 2 chunks of 20 frames
+  const int numFrames = 40;
+
+  std::vector<NDArray*>arrays(numFrames);
+  fillNDArraysFromPool(dims, NDUInt8, arrays, arrayPool);
+
+  // Deliberately bad chunking, which the autotuning replaces
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "chunkautotune");
+  hdf5->write(str_NDFileHDF5_nRowChunks, 7);
+  hdf5->write(str_NDFileHDF5_nColChunks, 3);
+  hdf5->write(str_NDFileHDF5_nFramesChunks, 1);
+  hdf5->write(str_NDFileHDF5_chunkAutoTune, 1);
+  hdf5->write(str_NDFileHDF5_fsBlockSize, 1048576);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, numFrames);
+  hdf5->write(NDFileCaptureString, 1);
+
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_nColChunksActual), 256);
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_nRowChunksActual), 256);
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_nFramesChunksActual), 20);
+  // The chunking that was set is kept, so that it is used again when autotuning is switched off
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_nColChunks), 3);
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_nRowChunks), 7);
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_nFramesChunks), 1);
+  BOOST_CHECK_CLOSE(hdf5->readDouble(str_NDFileHDF5_writeAmplification), 1.0, 0.001);
+  BOOST_CHECK_EQUAL(hdf5->readString(str_NDFileHDF5_chunkTuneMsg), "Chunking OK");
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+  }
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), numFrames);
+
+  hsize_t chunk[3] = {0, 0, 0};
+  hid_t file = H5Fopen("/tmp/chunkautotune_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE(file >= 0);
+  hid_t dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  BOOST_REQUIRE(dataset >= 0);
+  hid_t cparms = H5Dget_create_plist(dataset);
+  BOOST_CHECK_EQUAL(H5Pget_chunk(cparms, 3, chunk), 3);
+  H5Pclose(cparms);
+  H5Dclose(dataset);
+  H5Fclose(file);
+  BOOST_CHECK_EQUAL(chunk[0], 20);
+  BOOST_CHECK_EQUAL(chunk[1], 256);
+  BOOST_CHECK_EQUAL(chunk[2], 256);
+}
+
+BOOST_AUTO_TEST_CASE(test_StageLatencies)
+{
+  size_t tmpdims[] = {8,4};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  const int numFrames = 10;
+
+  std::vector<NDArray*>arrays(numFrames);
+  fillNDArraysFromPool(dims, NDUInt16, arrays, arrayPool);
+
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "stagelatencies");
+  hdf5->write(str_NDFileHDF5_storeAttributes, 1);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, numFrames);
+  hdf5->write(NDFileCaptureString, 1);
+  for (int stage = 0; stage < HDF5NumStages; stage++)
+  {
+    BOOST_CHECK_EQUAL(hdf5->stageHistograms[stage].count(), 0);
+  }
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+  }
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), numFrames);
+
+  // Every frame gathers attributes, extends the dataset and writes its data; nothing is flushed without SWMR
+  BOOST_CHECK_EQUAL(hdf5->stageHistograms[HDF5StageAttributes].count(), numFrames);
+  BOOST_CHECK_EQUAL(hdf5->stageHistograms[HDF5StageExtend].count(), numFrames);
+  BOOST_CHECK_EQUAL(hdf5->stageHistograms[HDF5StageWrite].count(), numFrames);
+  BOOST_CHECK_EQUAL(hdf5->stageHistograms[HDF5StageAttrDatasets].count(), numFrames);
+  BOOST_CHECK_EQUAL(hdf5->stageHistograms[HDF5StageFlush].count(), 0);
+  BOOST_CHECK(hdf5->stageHistograms[HDF5StageWrite].percentile(0.5) <= hdf5->stageHistograms[HDF5StageWrite].percentile(0.99));
+  BOOST_CHECK(hdf5->stageHistograms[HDF5StageWrite].percentile(0.99) <= hdf5->stageHistograms[HDF5StageWrite].max());
+}
+
+BOOST_AUTO_TEST_CASE(test_LatencyHistogram)
+{
+  NDFileHDF5Histogram histogram;
+
+  BOOST_CHECK_EQUAL(histogram.percentile(0.5), 0.0);
+  for (int i = 0; i < 100; i++) histogram.add(0.001);
+  histogram.add(0.1);
+  BOOST_CHECK_EQUAL(histogram.count(), 101);
+  // The buckets are 2^(1/8) wide, so the percentiles are within 10% of the latencies
+  BOOST_CHECK_CLOSE(histogram.percentile(0.5), 0.001, 10.0);
+  BOOST_CHECK_CLOSE(histogram.percentile(0.99), 0.001, 10.0);
+  BOOST_CHECK_EQUAL(histogram.percentile(1.0), 0.1);
+  BOOST_CHECK_EQUAL(histogram.max(), 0.1);
+  histogram.reset();
+  BOOST_CHECK_EQUAL(histogram.count(), 0);
+  BOOST_CHECK_EQUAL(histogram.max(), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_BufferedAttributeDatasets)
+{
+  size_t tmpdims[] = {4,6};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  // Not a multiple of the attribute chunk size, so the last values are written when the file is closed
+  const int numFrames = 10;
+
+  std::vector<NDArray*>arrays(numFrames);
+  fillNDArraysFromPool(dims, NDUInt32, arrays, arrayPool);
+  for (int i = 0; i < numFrames; i++)
+  {
+    arrays[i]->uniqueId = 100 + i;
+  }
+
+  // Configure the HDF5 plugin to store the attributes with 4 values per chunk
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "bufferedattributes");
+  hdf5->write(str_NDFileHDF5_storeAttributes, 1);
+  hdf5->write(str_NDFileHDF5_NDAttributeChunk, 4);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, numFrames);
+  hdf5->write(NDFileCaptureString, 1);
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+    BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), i+1);
+  }
+
+  // Every frame must have its own value, in order
+  std::vector<epicsInt32> uniqueIds(numFrames);
+  hid_t file = H5Fopen("/tmp/bufferedattributes_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE(file >= 0);
+  hid_t dataset = H5Dopen2(file, "/entry/instrument/NDAttributes/NDArrayUniqueId", H5P_DEFAULT);
+  BOOST_REQUIRE(dataset >= 0);
+  hid_t dataspace = H5Dget_space(dataset);
+  BOOST_CHECK_EQUAL(H5Sget_simple_extent_npoints(dataspace), numFrames);
+  H5Sclose(dataspace);
+  BOOST_CHECK(H5Dread(dataset, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, &uniqueIds[0]) >= 0);
+  H5Dclose(dataset);
+  H5Fclose(file);
+  for (int i = 0; i < numFrames; i++)
+  {
+    BOOST_CHECK_EQUAL(uniqueIds[i], 100 + i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_WriteQueue)
+{
+  size_t tmpdims[] = {8,4};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  // More frames than the write queue can hold, so the plugin has to wait for the write thread
+  const int numFrames = 10;
+  const int numElements = 8*4;
+
+  std::vector<NDArray*>arrays(numFrames);
+  fillNDArraysFromPool(dims, NDInt32, arrays, arrayPool);
+  for (int i = 0; i < numFrames; i++)
+  {
+    epicsInt32 *pData = (epicsInt32 *)arrays[i]->pData;
+    for (int j = 0; j < numElements; j++) pData[j] = i*1000 + j;
+  }
+
+  // Configure the HDF5 plugin to write the frames in a separate thread
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "writequeue");
+  hdf5->write(NDFileWriteQueueSizeString, 3);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, numFrames);
+  hdf5->write(NDFileCaptureString, 1);
+
+  for (int i = 0; i < numFrames; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+    BOOST_CHECK(hdf5->readInt(NDFileWriteQueueUsedString) <= 3);
+  }
+
+  // The file is closed after the last frame was queued, once all of the frames are written
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileCaptureString), 0);
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), numFrames);
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileWriteQueueUsedString), 0);
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileWriteStatusString), NDFileWriteOK);
+  BOOST_CHECK(hdf5->readDouble(NDFileWriteLatencyMaxString) >= hdf5->readDouble(NDFileWriteLatencyP50String));
+
+  std::vector<epicsInt32> readback(numFrames*numElements);
+  hid_t file = H5Fopen("/tmp/writequeue_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE(file >= 0);
+  hid_t dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  BOOST_REQUIRE(dataset >= 0);
+  hid_t dataspace = H5Dget_space(dataset);
+  BOOST_CHECK_EQUAL(H5Sget_simple_extent_npoints(dataspace), numFrames*numElements);
+  H5Sclose(dataspace);
+  BOOST_CHECK(H5Dread(dataset, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, &readback[0]) >= 0);
+  H5Dclose(dataset);
+  H5Fclose(file);
+  for (int i = 0; i < numFrames; i++)
+  {
+    BOOST_CHECK_EQUAL(memcmp(&readback[i*numElements], arrays[i]->pData, numElements*sizeof(epicsInt32)), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_WriteQueueError)
+{
+  size_t tmpdims[] = {8,4};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  const int numCapture = 3;
+
+  std::vector<NDArray*>arrays(numCapture+1);
+  fillNDArraysFromPool(dims, NDInt32, arrays, arrayPool);
+
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "writequeueerror");
+  hdf5->write(NDFileWriteQueueSizeString, 3);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, numCapture);
+  hdf5->write(NDFileCaptureString, 1);
+
+  // The second frame has a codec that does not match the filter of the file, so the write thread fails to write it
+  arrays[1]->codec = "lz4";
+  arrays[1]->compressedSize = 16;
+  for (int i = 0; i < numCapture; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+  }
+
+  // Only the frames that were written count, so capture continues for one more frame
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileCaptureString), 1);
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), numCapture-1);
+
+  hdf5->lock();
+  BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[numCapture]));
+  hdf5->unlock();
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileCaptureString), 0);
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), numCapture);
+
+  HDF5FileReader fr("/tmp/writequeueerror_0.5");
+  std::vector<hsize_t> odims = fr.getDatasetDimensions("/entry/data/data");
+  BOOST_REQUIRE_EQUAL(odims.size(), 3);
+  BOOST_CHECK_EQUAL(odims[0], numCapture);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+/*
+ * test_NDFileRaw.cpp
+ *
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <NDAttribute.h>
+#include <asynNDArrayDriver.h>
+#include <asynPortClient.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+#include "testingutilities.h"
+#include "RawPluginWrapper.h"
+
+static NDArray *readArray = 0;
+
+static void Raw_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  readArray = (NDArray *)pointer;
+}
+
+struct NDFileRawTestFixture
+{
+  NDArrayPool *arrayPool;
+  asynNDArrayDriver *driver;
+  boost::shared_ptr<RawPluginWrapper> raw;
+  std::string testport;
+  std::vector<NDArray*> arrays;
+
+  NDFileRawTestFixture()
+  {
+    std::string simport("simRaw");
+    testport = "Raw";
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = new asynNDArrayDriver(simport.c_str(), 1, 0, 0, asynGenericPointerMask, asynGenericPointerMask, 0, 0, 0, 0);
+    arrayPool = driver->pNDArrayPool;
+
+    raw = boost::shared_ptr<RawPluginWrapper>(new RawPluginWrapper(testport, simport));
+    raw->write(NDPluginDriverEnableCallbacksString, 1);
+    raw->write(NDPluginDriverBlockingCallbacksString, 1);
+    raw->write(NDFileWriteModeString, NDFileModeStream);
+    raw->write(NDFilePathString, "/tmp");
+    raw->write(NDFileTemplateString, "%s%s_%d.raw");
+
+    size_t tmpdims[] = {8, 4};
+    std::vector<size_t> dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+    arrays.resize(3);
+    fillNDArraysFromPool(dims, NDUInt16, arrays, arrayPool);
+    for (size_t i = 0; i < arrays.size(); i++) {
+      epicsUInt16 *pData = (epicsUInt16 *)arrays[i]->pData;
+      for (size_t j = 0; j < 32; j++) pData[j] = (epicsUInt16)(i*100 + j);
+      arrays[i]->uniqueId = (int)i + 1;
+      epicsFloat64 exposure = 0.5 * (i + 1);
+      arrays[i]->pAttributeList->add("Exposure", "Exposure time", NDAttrFloat64, &exposure);
+    }
+  }
+
+  ~NDFileRawTestFixture()
+  {
+    for (size_t i = 0; i < arrays.size(); i++) arrays[i]->release();
+    raw.reset();
+    delete driver;
+  }
+
+  void writeFile(const std::string& fileName)
+  {
+    raw->write(NDFileNameString, fileName);
+    // Initialise the plugin with a dummy frame
+    raw->processCallbacks(arrays[0]);
+    raw->write(NDFileNumCaptureString, (int)arrays.size());
+    raw->write(NDFileCaptureString, 1);
+    for (size_t i = 0; i < arrays.size(); i++) {
+      raw->lock();
+      BOOST_CHECK_NO_THROW(raw->processCallbacks(arrays[i]));
+      raw->unlock();
+    }
+    BOOST_CHECK_EQUAL(raw->readInt(NDFileCaptureString), 0);
+    BOOST_CHECK_EQUAL(raw->readInt(NDFileNumCapturedString), (int)arrays.size());
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(NDFileRawTests, NDFileRawTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_WriteAndReadBack)
+{
+  writeFile("rawreadback");
+
+  asynGenericPointerClient client(testport.c_str(), 0, NDArrayDataString);
+  client.registerInterruptUser(&Raw_callback);
+  raw->write(NDArrayCallbacksString, 1);
+
+  for (size_t i = 0; i < arrays.size(); i++) {
+    readArray = 0;
+    raw->write(NDFileRawReadFrameString, (int)i);
+    raw->write(NDReadFileString, 1);
+    BOOST_CHECK_EQUAL(raw->readInt(NDFileRawNumFramesString), (int)arrays.size());
+    BOOST_REQUIRE(readArray != 0);
+    BOOST_REQUIRE_EQUAL(readArray->ndims, 2);
+    BOOST_CHECK_EQUAL(readArray->dims[0].size, 8);
+    BOOST_CHECK_EQUAL(readArray->dims[1].size, 4);
+    BOOST_CHECK_EQUAL(readArray->dataType, NDUInt16);
+    BOOST_CHECK_EQUAL(readArray->uniqueId, arrays[i]->uniqueId);
+    BOOST_CHECK_EQUAL(memcmp(readArray->pData, arrays[i]->pData, 32*sizeof(epicsUInt16)), 0);
+    NDAttribute *pAttribute = readArray->pAttributeList->find("Exposure");
+    BOOST_REQUIRE(pAttribute != 0);
+    epicsFloat64 exposure = 0;
+    pAttribute->getValue(NDAttrFloat64, &exposure);
+    BOOST_CHECK_EQUAL(exposure, 0.5 * (i + 1));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_BufferedWrite)
+{
+  // Without O_DIRECT the NDArrays are not padded, and the file is truncated to the end of the data
+  raw->write(NDFileRawDirectIOString, 0);
+  writeFile("rawbuffered");
+
+  struct stat info;
+  BOOST_REQUIRE_EQUAL(stat("/tmp/rawbuffered_0.raw", &info), 0);
+  BOOST_CHECK_EQUAL(info.st_size, (off_t)(arrays.size()*32*sizeof(epicsUInt16)));
+  BOOST_CHECK_EQUAL(stat("/tmp/rawbuffered_0.raw" RAW_INDEX_SUFFIX, &info), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -427,4 +427,73 @@ BOOST_AUTO_TEST_CASE(attrplot_multiple_attributes)
             ND_ATTRPLOT_NONE_INDEX);
 }
 
+BOOST_AUTO_TEST_CASE(attrplot_attribute_order)
+{
+    // Register the callback to get the data
+    asynFloat64ArrayClient client = asynFloat64ArrayClient(port.c_str(), 0, NDAttrPlotDataString);
+    client.registerInterruptUser(addr0DataInterrupt);
+
+    // Enable plugin
+    BOOST_CHECK_NO_THROW(attrPlot->write(NDArrayCallbacksString, 1));
+    BOOST_CHECK_EQUAL(attrPlot->readInt(NDArrayCallbacksString), 1);
+
+    NDArrayWrapper wrap(arrPool);
+    wrap.set_uid(1)
+        .add_attr("b", 2.)
+        .add_attr("a", 1.)
+        .add_attr("c", 3.);
+
+    attrPlot->lock();
+    BOOST_CHECK_NO_THROW(attrPlot->processCallbacks(wrap.get()));
+    attrPlot->unlock();
+
+    // The following arrays have their attributes in a different order and
+    // are missing some of them
+    NDArrayWrapper wrap_reordered(arrPool);
+    wrap_reordered.set_uid(2)
+        .add_attr("c", 30.)
+        .add_attr("a", 10.);
+
+    attrPlot->lock();
+    BOOST_CHECK_NO_THROW(attrPlot->processCallbacks(wrap_reordered.get()));
+    attrPlot->unlock();
+
+    NDArrayWrapper wrap_missing(arrPool);
+    wrap_missing.set_uid(3)
+        .add_attr("b", 200.);
+
+    attrPlot->lock();
+    BOOST_CHECK_NO_THROW(attrPlot->processCallbacks(wrap_missing.get()));
+    attrPlot->unlock();
+
+    BOOST_CHECK_EQUAL(attrPlot->readInt(NDAttrPlotNPtsString), 3);
+    BOOST_REQUIRE_EQUAL(attrPlot->readString(NDAttrPlotAttributeString, 0), "a");
+
+    // Select attribute a
+    addr0Data.reset();
+    BOOST_CHECK_NO_THROW(attrPlot->write(NDAttrPlotDataSelectString, 0, 0));
+    try {
+        std::vector<double> data = addr0Data.get_data();
+        BOOST_REQUIRE_EQUAL(data.size(), static_cast<size_t>(cache_size));
+        BOOST_CHECK_EQUAL(data[0], 1.);
+        BOOST_CHECK_EQUAL(data[1], 10.);
+        BOOST_CHECK(std::isnan(data[2]));
+    } catch (const AsynException& e) {
+        BOOST_FAIL("Exception thrown while trying to get data");
+    }
+
+    // Select attribute b
+    addr0Data.reset();
+    BOOST_CHECK_NO_THROW(attrPlot->write(NDAttrPlotDataSelectString, 1, 0));
+    try {
+        std::vector<double> data = addr0Data.get_data();
+        BOOST_REQUIRE_EQUAL(data.size(), static_cast<size_t>(cache_size));
+        BOOST_CHECK_EQUAL(data[0], 2.);
+        BOOST_CHECK(std::isnan(data[1]));
+        BOOST_CHECK_EQUAL(data[2], 200.);
+    } catch (const AsynException& e) {
+        BOOST_FAIL("Exception thrown while trying to get data");
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
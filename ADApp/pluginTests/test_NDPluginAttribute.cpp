@@ -0,0 +1,115 @@
+/*
+ * test_NDPluginAttribute.cpp
+ *
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynNDArrayDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+#include "testingutilities.h"
+#include "AttributePluginWrapper.h"
+
+struct AttributePluginTestFixture
+{
+  NDArrayPool *arrayPool;
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<AttributePluginWrapper> attr;
+
+  AttributePluginTestFixture()
+  {
+    std::string simport("simAttr"), testport("Attr");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(), 1, 0, 0,
+                                                                        asynGenericPointerMask, asynGenericPointerMask,
+                                                                        0, 0, 0, 0));
+    arrayPool = driver->pNDArrayPool;
+
+    attr = boost::shared_ptr<AttributePluginWrapper>(new AttributePluginWrapper(testport, 3, simport));
+    attr->start();
+    attr->write(NDPluginDriverEnableCallbacksString, 1);
+    attr->write(NDPluginDriverBlockingCallbacksString, 1);
+  }
+
+  ~AttributePluginTestFixture()
+  {
+    attr.reset();
+    driver.reset();
+  }
+
+  /** Processes an NDArray with a uniqueId and a Gain attribute */
+  void process(int uniqueId, double gain)
+  {
+    size_t dims[2] = {4, 4};
+    NDArray *pArray = arrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+    pArray->uniqueId = uniqueId;
+    pArray->pAttributeList->add("Exposure", "Exposure time", NDAttrFloat64, &gain);
+    pArray->pAttributeList->add("Gain", "Detector gain", NDAttrFloat64, &gain);
+    attr->lock();
+    BOOST_CHECK_NO_THROW(attr->processCallbacks(pArray));
+    attr->unlock();
+    pArray->release();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(AttributePluginTests, AttributePluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_Values)
+{
+  // Two addresses track the same attribute, and one the uniqueId
+  attr->write(NDPluginAttributeAttrNameString, "Gain", 0);
+  attr->write(NDPluginAttributeAttrNameString, "NDArrayUniqueId", 1);
+  attr->write(NDPluginAttributeAttrNameString, "Gain", 2);
+
+  process(1, 2.5);
+  process(2, 1.5);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValString, 0), 1.5);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValSumString, 0), 4.0);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValString, 1), 2.0);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValSumString, 1), 3.0);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValString, 2), 1.5);
+
+  // The name is resolved again when it changes
+  attr->write(NDPluginAttributeAttrNameString, "Exposure", 2);
+  process(3, 0.5);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValString, 2), 0.5);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValSumString, 2), 4.5);
+
+  attr->write(NDPluginAttributeResetString, 1);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValSumString, 0), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_MinUpdateTimeFlush)
+{
+  attr->write(NDPluginAttributeAttrNameString, "NDArrayUniqueId", 0);
+  attr->write(NDPluginAttributeMinUpdateTimeString, 0.2);
+
+  // The first value is published straight away, the next ones are held back
+  process(1, 1.0);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValString), 1.0);
+  process(2, 1.0);
+  process(3, 1.0);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValString), 1.0);
+
+  // No more arrays arrive, and the last value is published when MinUpdateTime has passed
+  epicsThreadSleep(0.5);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValString), 3.0);
+  BOOST_CHECK_EQUAL(attr->readDouble(NDPluginAttributeValSumString), 6.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
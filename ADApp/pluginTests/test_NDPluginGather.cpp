@@ -0,0 +1,135 @@
+/*
+ * test_NDPluginGather.cpp
+ *
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynNDArrayDriver.h>
+#include <asynPortClient.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+#include "testingutilities.h"
+#include "GatherPluginWrapper.h"
+
+static std::vector<int> outputIds;
+
+static void Gather_callback(void *userPvt, asynUser *pasynUser, void *pointer)
+{
+  outputIds.push_back(((NDArray *)pointer)->uniqueId);
+}
+
+struct GatherPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> sources[2];
+  boost::shared_ptr<GatherPluginWrapper> gather;
+  boost::shared_ptr<asynGenericPointerClient> client;
+
+  GatherPluginTestFixture()
+  {
+    std::string testport("Gather");
+    uniqueAsynPortName(testport);
+    gather = boost::shared_ptr<GatherPluginWrapper>(new GatherPluginWrapper(testport, 2));
+
+    for (int i = 0; i < 2; i++) {
+      std::string simport("simGather");
+      uniqueAsynPortName(simport);
+      sources[i] = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(), 1, 0, 0,
+                                                                               asynGenericPointerMask, asynGenericPointerMask,
+                                                                               0, 0, 0, 0));
+      gather->write(NDPluginDriverArrayPortString, simport, i);
+    }
+    gather->write(NDPluginDriverEnableCallbacksString, 1);
+    gather->write(NDArrayCallbacksString, 1);
+
+    outputIds.clear();
+    client = boost::shared_ptr<asynGenericPointerClient>(new asynGenericPointerClient(testport.c_str(), 0, NDArrayDataString));
+    client->registerInterruptUser(&Gather_callback);
+  }
+
+  ~GatherPluginTestFixture()
+  {
+    client.reset();
+    // This stops the merge thread
+    gather.reset();
+    sources[0].reset();
+    sources[1].reset();
+  }
+
+  /** Sends an NDArray with a uniqueId from one of the sources */
+  void send(int source, int uniqueId)
+  {
+    size_t dims[2] = {4, 4};
+    NDArray *pArray = sources[source]->pNDArrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+    int arrayData;
+    pArray->uniqueId = uniqueId;
+    sources[source]->findParam(NDArrayDataString, &arrayData);
+    sources[source]->doCallbacksGenericPointer(pArray, arrayData, 0);
+    pArray->release();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(GatherPluginTests, GatherPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_OrderedMerge)
+{
+  gather->write(NDPluginGatherTimeoutString, 10.0);
+  gather->write(NDPluginGatherModeString, (int)NDGatherOrdered);
+
+  // uniqueId 1 is held until the other source delivers an array, since it could still deliver a lower uniqueId
+  send(0, 1);
+  send(0, 3);
+  BOOST_CHECK_EQUAL(outputIds.size(), 0);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherQueuedString), 2);
+  send(1, 2);
+  // uniqueId 5 is held until 4 arrives
+  send(0, 5);
+  send(1, 4);
+  send(1, 6);
+
+  BOOST_REQUIRE_EQUAL(outputIds.size(), 6);
+  for (int i = 0; i < 6; i++) BOOST_CHECK_EQUAL(outputIds[i], i + 1);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherQueuedString), 0);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherMissingString), 0);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherLateString), 0);
+
+  // An array that arrives after a later uniqueId was output is dropped
+  send(0, 7);
+  send(1, 8);
+  send(1, 9);
+  send(0, 8);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherLateString), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_MergeTimeout)
+{
+  // The merge thread outputs an array that has waited for GATHER_TIMEOUT, and counts the skipped uniqueIds
+  gather->write(NDPluginGatherTimeoutString, 0.05);
+  gather->write(NDPluginGatherModeString, (int)NDGatherOrdered);
+  send(0, 1);
+  send(1, 2);
+  send(0, 4);
+  epicsThreadSleep(0.5);
+  BOOST_REQUIRE_EQUAL(outputIds.size(), 3);
+  BOOST_CHECK_EQUAL(outputIds[2], 4);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherMissingString), 1);
+
+  // Arrays that are still held when the plugin is destroyed are released
+  gather->write(NDPluginGatherTimeoutString, 10.0);
+  send(0, 6);
+  BOOST_CHECK_EQUAL(gather->readInt(NDPluginGatherQueuedString), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
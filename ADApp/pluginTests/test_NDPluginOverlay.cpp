@@ -256,4 +256,96 @@ BOOST_AUTO_TEST_CASE(basic_overlay_operation)
 }
 
 
+BOOST_AUTO_TEST_CASE(overlay_output_arrays)
+{
+  // Test 1 is a 1024x1024 cross centered on (525, 525), drawn on an array of zeros
+  overlayTestCaseStr *pStr = &overlayTestCaseStrs[0];
+  NDArray *pInput = pStr->pArrays[0];
+  NDArray *pOutput;
+  epicsFloat32 *pInputData = (epicsFloat32 *)pInput->pData;
+  size_t center = 525*1024 + 525;
+
+  // With no overlays in use the input array is passed on without being copied
+  Overlay->lock();
+  BOOST_CHECK_NO_THROW(Overlay->processCallbacks(pInput));
+  Overlay->unlock();
+  BOOST_REQUIRE_EQUAL(downstream_plugin->arrays.size(), 1);
+  BOOST_CHECK_EQUAL(downstream_plugin->arrays.back(), pInput);
+
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayUseString,       1,               pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayPositionXString, pStr->positionX, pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayPositionYString, pStr->positionY, pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlaySizeXString,     pStr->sizeX,     pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlaySizeYString,     pStr->sizeY,     pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayWidthXString,    pStr->widthX,    pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayWidthYString,    pStr->widthY,    pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayShapeString,     pStr->shape,     pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayDrawModeString,  pStr->drawMode,  pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayGreenString,     pStr->green,     pStr->overlayNum));
+
+  // With blocking callbacks the driver still owns the input array, so the overlay is drawn on a copy
+  Overlay->lock();
+  BOOST_CHECK_NO_THROW(Overlay->processCallbacks(pInput));
+  Overlay->unlock();
+  BOOST_REQUIRE_EQUAL(downstream_plugin->arrays.size(), 2);
+  pOutput = downstream_plugin->arrays.back();
+  BOOST_REQUIRE(pOutput != pInput);
+  BOOST_CHECK_EQUAL(pInputData[center], 0);
+  BOOST_CHECK_EQUAL(((epicsFloat32 *)pOutput->pData)[center], pStr->green);
+  BOOST_CHECK_EQUAL(((epicsFloat32 *)pOutput->pData)[0], 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(overlay_in_place)
+{
+  overlayTestCaseStr *pStr = &overlayTestCaseStrs[0];
+  NDArray *pInput = pStr->pArrays[0];
+  NDArray *pShared, *pOutput;
+  epicsFloat32 *pInputData = (epicsFloat32 *)pInput->pData;
+  size_t center = 525*1024 + 525;
+
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayUseString,       1,               pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayPositionXString, pStr->positionX, pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayPositionYString, pStr->positionY, pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlaySizeXString,     pStr->sizeX,     pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlaySizeYString,     pStr->sizeY,     pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayWidthXString,    pStr->widthX,    pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayWidthYString,    pStr->widthY,    pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayShapeString,     pStr->shape,     pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayDrawModeString,  pStr->drawMode,  pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginOverlayGreenString,     pStr->green,     pStr->overlayNum));
+  BOOST_CHECK_NO_THROW(Overlay->write(NDPluginDriverBlockingCallbacksString, 0));
+
+  // A shared array is the only reference to its header, but the data still belong to the input array
+  pShared = arrayPool->share(pInput);
+  BOOST_REQUIRE(pShared != NULL);
+  BOOST_CHECK_EQUAL(pShared->getReferenceCount(), 1);
+  BOOST_CHECK(pShared->getReleaseFunc() != NULL);
+  Overlay->lock();
+  BOOST_CHECK_NO_THROW(Overlay->processCallbacks(pShared));
+  Overlay->unlock();
+  BOOST_REQUIRE_EQUAL(downstream_plugin->arrays.size(), 1);
+  pOutput = downstream_plugin->arrays.back();
+  BOOST_CHECK(pOutput != pShared);
+  BOOST_CHECK(pOutput->pData != pInput->pData);
+  BOOST_CHECK_EQUAL(pInputData[center], 0);
+  BOOST_CHECK_EQUAL(((epicsFloat32 *)pOutput->pData)[center], pStr->green);
+  pShared->release();
+
+  // An array that owns its pool buffer and has no other users is drawn in place
+  NDArray *pOwned = arrayPool->copy(pInput, NULL, 1);
+  BOOST_REQUIRE(pOwned != NULL);
+  BOOST_CHECK_EQUAL(pOwned->getReferenceCount(), 1);
+  BOOST_CHECK(pOwned->getReleaseFunc() == NULL);
+  Overlay->lock();
+  BOOST_CHECK_NO_THROW(Overlay->processCallbacks(pOwned));
+  Overlay->unlock();
+  BOOST_REQUIRE_EQUAL(downstream_plugin->arrays.size(), 2);
+  BOOST_CHECK_EQUAL(downstream_plugin->arrays.back(), pOwned);
+  BOOST_CHECK_EQUAL(((epicsFloat32 *)pOwned->pData)[center], pStr->green);
+  BOOST_CHECK_EQUAL(pInputData[center], 0);
+  pOwned->release();
+}
+
+
 BOOST_AUTO_TEST_SUITE_END() // Done!
@@ -0,0 +1,140 @@
+/*
+ * test_NDPluginPva.cpp
+ *
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynNDArrayDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <pv/pvDatabase.h>
+#include <pv/nt.h>
+
+using namespace std;
+using namespace epics::pvData;
+using namespace epics::pvDatabase;
+using namespace epics::nt;
+
+#include "testingutilities.h"
+#include "PvaPluginWrapper.h"
+
+/** Returns a reference to the value of the NTNDArray record, as held by a client that is sending it */
+static PVUShortArray::const_svector getValue(const std::string& pvName)
+{
+  PVRecordPtr record(PVDatabase::getMaster()->findRecord(pvName));
+  NTNDArrayPtr ntndArray(NTNDArray::wrap(record->getPVStructure()));
+  return ntndArray->getValue()->get<PVUShortArray>()->view();
+}
+
+static int getUniqueId(const std::string& pvName)
+{
+  PVRecordPtr record(PVDatabase::getMaster()->findRecord(pvName));
+  return record->getPVStructure()->getSubField<PVInt>("uniqueId")->get();
+}
+
+struct PvaPluginTestFixture
+{
+  NDArrayPool *arrayPool;
+  // The driver and the plugin are not deleted: the record stays in the master database and keeps
+  // its last NDArray, which is released to the pools of the plugin and the driver when the program exits
+  asynNDArrayDriver *driver;
+  PvaPluginWrapper *pva;
+  std::string pvName;
+  std::vector<NDArray*> arrays;
+
+  PvaPluginTestFixture()
+  {
+    std::string simport("simPva"), testport("Pva");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+    pvName = testport + ":Array";
+
+    driver = new asynNDArrayDriver(simport.c_str(), 1, 0, 0,
+                                   asynGenericPointerMask, asynGenericPointerMask,
+                                   0, 0, 0, 0);
+    arrayPool = driver->pNDArrayPool;
+
+    pva = new PvaPluginWrapper(testport, 50, 1, simport, 0, pvName);
+    pva->start();
+    pva->write(NDPluginDriverEnableCallbacksString, 1);
+    pva->write(NDPluginDriverBlockingCallbacksString, 1);
+
+    size_t tmpdims[] = {8, 4};
+    std::vector<size_t> dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+    arrays.resize(6);
+    fillNDArraysFromPool(dims, NDUInt16, arrays, arrayPool);
+    for (size_t i = 0; i < arrays.size(); i++) arrays[i]->uniqueId = (int)i + 1;
+  }
+
+  ~PvaPluginTestFixture()
+  {
+    for (size_t i = 0; i < arrays.size(); i++) arrays[i]->release();
+  }
+
+  void process(NDArray *pArray)
+  {
+    pva->lock();
+    BOOST_CHECK_NO_THROW(pva->processCallbacks(pArray));
+    pva->unlock();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(PvaPluginTests, PvaPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_CurrentValueNotInFlight)
+{
+  // The record holds each NDArray until the next one replaces it, which must not stall the plugin
+  pva->write(NDPluginPvaMaxInFlightString, 1);
+  for (size_t i = 0; i < arrays.size(); i++) {
+    process(arrays[i]);
+    BOOST_CHECK_EQUAL(getUniqueId(pvName), arrays[i]->uniqueId);
+  }
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaNumInFlightString), 0);
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaDroppedUpdatesString), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_MaxInFlight)
+{
+  pva->write(NDPluginPvaMaxInFlightString, 2);
+
+  // Clients are still sending the first two NDArrays when they are replaced
+  process(arrays[0]);
+  PVUShortArray::const_svector sending0(getValue(pvName));
+  process(arrays[1]);
+  PVUShortArray::const_svector sending1(getValue(pvName));
+  process(arrays[2]);
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaNumInFlightString), 2);
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaDroppedUpdatesString), 0);
+  BOOST_CHECK_EQUAL(arrays[0]->getReferenceCount(), 2);
+
+  // MaxInFlight is reached, so the next NDArray is not published
+  process(arrays[3]);
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaDroppedUpdatesString), 1);
+  BOOST_CHECK_EQUAL(getUniqueId(pvName), arrays[2]->uniqueId);
+
+  // A client finishes sending, which releases the first NDArray and allows another one to be published.
+  // No client is sending the NDArray that this replaces, so it is released straight away.
+  sending0.clear();
+  BOOST_CHECK_EQUAL(arrays[0]->getReferenceCount(), 1);
+  process(arrays[4]);
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaNumInFlightString), 1);
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaDroppedUpdatesString), 1);
+  BOOST_CHECK_EQUAL(getUniqueId(pvName), arrays[4]->uniqueId);
+  BOOST_CHECK_EQUAL(arrays[2]->getReferenceCount(), 1);
+
+  sending1.clear();
+  process(arrays[5]);
+  BOOST_CHECK_EQUAL(pva->readInt(NDPluginPvaNumInFlightString), 0);
+  BOOST_CHECK_EQUAL(getUniqueId(pvName), arrays[5]->uniqueId);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
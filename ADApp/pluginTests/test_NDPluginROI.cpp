@@ -259,4 +259,122 @@ BOOST_AUTO_TEST_CASE(basic_roi_operation)
 }
 
 
+BOOST_AUTO_TEST_CASE(multiple_roi_operation)
+{
+  std::string multiport("MROI");
+  uniqueAsynPortName(multiport);
+
+  // A plugin with 2 ROIs, each passed to the plugins connected to its address
+  boost::shared_ptr<ROIPluginWrapper> multi(new ROIPluginWrapper(multiport.c_str(),
+                                                                 50, 1, driver->portName,
+                                                                 0, 0, 0, 2000000, 1, 2));
+  TestingPlugin* downstream0 = new TestingPlugin(multiport.c_str(), 0);
+  TestingPlugin* downstream1 = new TestingPlugin(multiport.c_str(), 1);
+  multi->start();
+  multi->write(NDPluginDriverEnableCallbacksString, 1);
+  multi->write(NDPluginDriverBlockingCallbacksString, 1);
+  multi->write(NDArrayCallbacksString, 1);
+
+  // ROI 0 is x=2-5, y=1-3 with the input data type
+  multi->write(NDPluginROIDim0MinString,    2, 0);
+  multi->write(NDPluginROIDim0SizeString,   4, 0);
+  multi->write(NDPluginROIDim0EnableString, 1, 0);
+  multi->write(NDPluginROIDim1MinString,    1, 0);
+  multi->write(NDPluginROIDim1SizeString,   3, 0);
+  multi->write(NDPluginROIDim1EnableString, 1, 0);
+
+  // ROI 1 is all of x binned by 2 and reversed, y=4-5 binned by 2, converted to NDFloat64
+  multi->write(NDPluginROIDim0MinString,     0, 1);
+  multi->write(NDPluginROIDim0SizeString,    10, 1);
+  multi->write(NDPluginROIDim0BinString,     2, 1);
+  multi->write(NDPluginROIDim0ReverseString, 1, 1);
+  multi->write(NDPluginROIDim0EnableString,  1, 1);
+  multi->write(NDPluginROIDim1MinString,     4, 1);
+  multi->write(NDPluginROIDim1SizeString,    2, 1);
+  multi->write(NDPluginROIDim1BinString,     2, 1);
+  multi->write(NDPluginROIDim1EnableString,  1, 1);
+  multi->write(NDPluginROIDataTypeString,    NDFloat64, 1);
+
+  size_t dims[2] = {10, 10};
+  NDArray *pArray = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  epicsUInt16 *pData = (epicsUInt16 *)pArray->pData;
+  for (size_t y=0; y<dims[1]; y++) {
+    for (size_t x=0; x<dims[0]; x++) {
+      pData[y*dims[0] + x] = (epicsUInt16)(x + 10*y);
+    }
+  }
+
+  multi->lock();
+  BOOST_CHECK_NO_THROW(multi->processCallbacks(pArray));
+  multi->unlock();
+  pArray->release();
+
+  BOOST_REQUIRE_EQUAL(downstream0->arrays.size(), 1);
+  NDArray *pROI0 = downstream0->arrays.back();
+  BOOST_REQUIRE_EQUAL(pROI0->ndims, 2);
+  BOOST_REQUIRE_EQUAL(pROI0->dims[0].size, 4);
+  BOOST_REQUIRE_EQUAL(pROI0->dims[1].size, 3);
+  BOOST_REQUIRE_EQUAL(pROI0->dataType, NDUInt16);
+  epicsUInt16 *pData0 = (epicsUInt16 *)pROI0->pData;
+  for (size_t y=0; y<3; y++) {
+    for (size_t x=0; x<4; x++) {
+      BOOST_CHECK_EQUAL(pData0[y*4 + x], (x + 2) + 10*(y + 1));
+    }
+  }
+
+  BOOST_REQUIRE_EQUAL(downstream1->arrays.size(), 1);
+  NDArray *pROI1 = downstream1->arrays.back();
+  BOOST_REQUIRE_EQUAL(pROI1->ndims, 2);
+  BOOST_REQUIRE_EQUAL(pROI1->dims[0].size, 5);
+  BOOST_REQUIRE_EQUAL(pROI1->dims[1].size, 1);
+  BOOST_REQUIRE_EQUAL(pROI1->dataType, NDFloat64);
+  epicsFloat64 *pData1 = (epicsFloat64 *)pROI1->pData;
+  for (size_t x=0; x<5; x++) {
+    // Output x is the sum of input x=8-2x and 9-2x for y=4 and 5
+    BOOST_CHECK_EQUAL(pData1[x], 2.*(17 - 4*x) + 180);
+  }
+  BOOST_CHECK_EQUAL(multi->readInt(NDArraySizeXString, 1), 5);
+  BOOST_CHECK_EQUAL(multi->readInt(NDPluginROIDim0MaxSizeString, 1), 10);
+}
+
+BOOST_AUTO_TEST_CASE(unused_roi_not_extracted)
+{
+  std::string multiport("UROI");
+  uniqueAsynPortName(multiport);
+
+  // A plugin with 3 ROIs, with no plugin connected to ROI 1
+  boost::shared_ptr<ROIPluginWrapper> multi(new ROIPluginWrapper(multiport.c_str(),
+                                                                 50, 1, driver->portName,
+                                                                 0, 0, 0, 2000000, 1, 3));
+  TestingPlugin* downstream0 = new TestingPlugin(multiport.c_str(), 0);
+  TestingPlugin* downstream2 = new TestingPlugin(multiport.c_str(), 2);
+  multi->start();
+  multi->write(NDPluginDriverEnableCallbacksString, 1);
+  multi->write(NDPluginDriverBlockingCallbacksString, 1);
+  multi->write(NDArrayCallbacksString, 1);
+
+  size_t dims[2] = {10, 10};
+  NDArray *pArray = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+  multi->lock();
+  BOOST_CHECK_NO_THROW(multi->processCallbacks(pArray));
+  multi->unlock();
+
+  BOOST_CHECK_EQUAL(downstream0->arrays.size(), 1);
+  BOOST_CHECK_EQUAL(downstream2->arrays.size(), 1);
+  BOOST_CHECK_EQUAL(multi->readInt(NDArraySizeXString, 0), 10);
+  BOOST_CHECK_EQUAL(multi->readInt(NDArraySizeXString, 1), 0);
+  BOOST_CHECK_EQUAL(multi->readInt(NDArraySizeXString, 2), 10);
+
+  // ROI 1 is extracted once a plugin is connected to it
+  TestingPlugin* downstream1 = new TestingPlugin(multiport.c_str(), 1);
+  multi->lock();
+  BOOST_CHECK_NO_THROW(multi->processCallbacks(pArray));
+  multi->unlock();
+  pArray->release();
+
+  BOOST_CHECK_EQUAL(downstream1->arrays.size(), 1);
+  BOOST_CHECK_EQUAL(multi->readInt(NDArraySizeXString, 1), 10);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END() // Done!
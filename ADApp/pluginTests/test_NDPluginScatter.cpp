@@ -0,0 +1,128 @@
+/*
+ * test_NDPluginScatter.cpp
+ *
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynNDArrayDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+#include "testingutilities.h"
+#include "ScatterPluginWrapper.h"
+#include "GatherPluginWrapper.h"
+
+struct ScatterPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> source;
+  boost::shared_ptr<ScatterPluginWrapper> scatter;
+  // NDPluginGather registers its own callback function with the NDArray source,
+  // so it checks that Scatter recognizes plugins whatever callback they register
+  boost::shared_ptr<GatherPluginWrapper> targets[2];
+  std::string scatterPort;
+
+  ScatterPluginTestFixture()
+  {
+    std::string simport("simScatter");
+    uniqueAsynPortName(simport);
+    source = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(), 1, 0, 0,
+                                                                        asynGenericPointerMask, asynGenericPointerMask,
+                                                                        0, 0, 0, 0));
+    scatterPort = "Scatter";
+    uniqueAsynPortName(scatterPort);
+    scatter = boost::shared_ptr<ScatterPluginWrapper>(new ScatterPluginWrapper(scatterPort, simport));
+    scatter->write(NDPluginDriverEnableCallbacksString, 1);
+    scatter->write(NDArrayCallbacksString, 1);
+  }
+
+  ~ScatterPluginTestFixture()
+  {
+    // Start the targets so that they empty their queues before they are destroyed
+    for (int i = 0; i < 2; i++) {
+      if (targets[i]) targets[i]->start();
+      targets[i].reset();
+    }
+    scatter.reset();
+    source.reset();
+  }
+
+  /** Creates a target that receives the NDArrays from Scatter.
+    * Without blocking callbacks the target has an input queue, but its thread is not started,
+    * so the NDArrays stay in the queue. */
+  void addTarget(int i, int blockingCallbacks)
+  {
+    std::string port("ScatterTarget");
+    uniqueAsynPortName(port);
+    targets[i] = boost::shared_ptr<GatherPluginWrapper>(new GatherPluginWrapper(port, 1, blockingCallbacks));
+    targets[i]->write(NDPluginDriverArrayPortString, scatterPort);
+    targets[i]->write(NDPluginDriverEnableCallbacksString, 1);
+  }
+
+  void send(int numArrays)
+  {
+    size_t dims[2] = {4, 4};
+    int arrayData;
+    source->findParam(NDArrayDataString, &arrayData);
+    for (int i = 0; i < numArrays; i++) {
+      NDArray *pArray = source->pNDArrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+      pArray->uniqueId = i;
+      source->doCallbacksGenericPointer(pArray, arrayData, 0);
+      pArray->release();
+    }
+  }
+
+  int numQueued(int i)
+  {
+    return 10 - targets[i]->readInt(NDPluginDriverQueueFreeString);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ScatterPluginTests, ScatterPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_LeastQueued)
+{
+  // The second target processes each NDArray as soon as it is received, so its queue stays empty
+  addTarget(0, 0);
+  addTarget(1, 1);
+  scatter->write(NDPluginScatterMethodString, (int)NDScatterLeastQueued);
+
+  // Only one of the first two NDArrays goes to the first target, which keeps it queued
+  send(6);
+  BOOST_CHECK_EQUAL(scatter->readInt(NDPluginScatterNumTargetsString), 2);
+  BOOST_CHECK_EQUAL(numQueued(0), 1);
+  BOOST_CHECK_EQUAL(targets[1]->readInt(NDArrayCounterString), 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_ShortestCompletion)
+{
+  addTarget(0, 0);
+  addTarget(1, 0);
+  // The second target is 10 times slower, so the first one gets NDArrays until it has 9 queued
+  targets[0]->write(NDPluginDriverExecutionTimeString, 1.0);
+  targets[1]->write(NDPluginDriverExecutionTimeString, 10.0);
+  scatter->write(NDPluginScatterMethodString, (int)NDScatterShortestCompletion);
+
+  send(5);
+  BOOST_CHECK_EQUAL(numQueued(0), 5);
+  BOOST_CHECK_EQUAL(numQueued(1), 0);
+
+  // With round robin the NDArrays are shared equally whatever the load
+  scatter->write(NDPluginScatterMethodString, (int)NDScatterRoundRobin);
+  send(4);
+  BOOST_CHECK_EQUAL(numQueued(0), 7);
+  BOOST_CHECK_EQUAL(numQueued(1), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
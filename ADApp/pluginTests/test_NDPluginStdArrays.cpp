@@ -0,0 +1,169 @@
+/*
+ * test_NDPluginStdArrays.cpp
+ *
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynNDArrayDriver.h>
+#include <asynPortClient.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+#include "testingutilities.h"
+#include "StdArraysPluginWrapper.h"
+
+/** Records the callbacks to one client of the STD_ARRAY_DATA waveform */
+struct StdArraysClient
+{
+  int callbackCount;
+  std::vector<epicsFloat64> data;
+};
+
+static void StdArrays_callback(void *userPvt, asynUser *pasynUser, epicsFloat64 *value, size_t nelements)
+{
+  StdArraysClient *pClient = (StdArraysClient *)userPvt;
+  pClient->callbackCount++;
+  pClient->data.assign(value, value + nelements);
+}
+
+struct StdArraysPluginTestFixture
+{
+  NDArrayPool *arrayPool;
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<StdArraysPluginWrapper> stdArrays;
+  std::string testport;
+  std::vector<NDArray*> arrays;
+
+  StdArraysPluginTestFixture()
+  {
+    std::string simport("simStdArrays");
+    testport = "StdArrays";
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(), 1, 0, 0,
+                                                                        asynGenericPointerMask, asynGenericPointerMask,
+                                                                        0, 0, 0, 0));
+    arrayPool = driver->pNDArrayPool;
+
+    stdArrays = boost::shared_ptr<StdArraysPluginWrapper>(new StdArraysPluginWrapper(testport, simport));
+    stdArrays->write(NDPluginDriverEnableCallbacksString, 1);
+    stdArrays->write(NDPluginDriverBlockingCallbacksString, 1);
+
+    size_t tmpdims[] = {4};
+    std::vector<size_t> dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+    arrays.resize(1);
+    fillNDArraysFromPool(dims, NDFloat64, arrays, arrayPool);
+    epicsFloat64 *pData = (epicsFloat64 *)arrays[0]->pData;
+    for (size_t i = 0; i < 4; i++) pData[i] = (epicsFloat64)(i + 1);
+  }
+
+  ~StdArraysPluginTestFixture()
+  {
+    for (size_t i = 0; i < arrays.size(); i++) arrays[i]->release();
+    stdArrays.reset();
+    driver.reset();
+  }
+
+  void process()
+  {
+    stdArrays->lock();
+    BOOST_CHECK_NO_THROW(stdArrays->processCallbacks(arrays[0]));
+    stdArrays->unlock();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(StdArraysPluginTests, StdArraysPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_MinUpdateTimePerClient)
+{
+  StdArraysClient client1 = StdArraysClient(), client2 = StdArraysClient();
+  asynFloat64ArrayClient waveform1(testport.c_str(), 0, NDPluginStdArraysDataString);
+  asynFloat64ArrayClient waveform2(testport.c_str(), 0, NDPluginStdArraysDataString);
+  stdArrays->write(NDPluginStdArraysMinUpdateTimeString, 60.0);
+
+  waveform1.registerInterruptUser(StdArrays_callback, &client1);
+  process();
+  BOOST_CHECK_EQUAL(client1.callbackCount, 1);
+
+  // A client that connects later gets the next array, although the first one is throttled
+  waveform2.registerInterruptUser(StdArrays_callback, &client2);
+  process();
+  BOOST_CHECK_EQUAL(client1.callbackCount, 1);
+  BOOST_CHECK_EQUAL(client2.callbackCount, 1);
+  process();
+  BOOST_CHECK_EQUAL(client1.callbackCount, 1);
+  BOOST_CHECK_EQUAL(client2.callbackCount, 1);
+
+  // The time of the last update is forgotten when the client goes away,
+  // so a new client with the same asynUser is not throttled
+  waveform2.cancelInterruptUser();
+  process();
+  waveform2.registerInterruptUser(StdArrays_callback, &client2);
+  process();
+  BOOST_CHECK_EQUAL(client1.callbackCount, 1);
+  BOOST_CHECK_EQUAL(client2.callbackCount, 2);
+
+  stdArrays->write(NDPluginStdArraysMinUpdateTimeString, 0.0);
+  process();
+  BOOST_CHECK_EQUAL(client1.callbackCount, 2);
+  BOOST_CHECK_EQUAL(client2.callbackCount, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_MinUpdateTimeTrailingUpdate)
+{
+  StdArraysClient client = StdArraysClient();
+  asynFloat64ArrayClient waveform(testport.c_str(), 0, NDPluginStdArraysDataString);
+  epicsFloat64 *pData = (epicsFloat64 *)arrays[0]->pData;
+  waveform.registerInterruptUser(StdArrays_callback, &client);
+  stdArrays->write(NDPluginStdArraysMinUpdateTimeString, 0.2);
+
+  process();
+  BOOST_CHECK_EQUAL(client.callbackCount, 1);
+  pData[0] = 10;
+  process();
+  pData[0] = 20;
+  process();
+  BOOST_CHECK_EQUAL(client.callbackCount, 1);
+  BOOST_CHECK_EQUAL(client.data[0], 1);
+
+  // No more arrays arrive, and the client gets the last one when MinUpdateTime has passed
+  epicsThreadSleep(0.5);
+  BOOST_CHECK_EQUAL(client.callbackCount, 2);
+  BOOST_REQUIRE_EQUAL(client.data.size(), 4);
+  BOOST_CHECK_EQUAL(client.data[0], 20);
+
+  // A client that already has the last array gets nothing more
+  epicsThreadSleep(0.3);
+  BOOST_CHECK_EQUAL(client.callbackCount, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_MinMaxWithoutDecimation)
+{
+  StdArraysClient client = StdArraysClient();
+  asynFloat64ArrayClient waveform(testport.c_str(), 0, NDPluginStdArraysDataString);
+  waveform.registerInterruptUser(StdArrays_callback, &client);
+
+  stdArrays->write(NDPluginStdArraysDecimateModeString, (int)NDStdArraysDecimateMinMax);
+  process();
+  BOOST_CHECK_EQUAL(stdArrays->readInt(NDPluginStdArraysOutSizeXString), 8);
+  BOOST_REQUIRE_EQUAL(client.data.size(), 8);
+  for (size_t i = 0; i < 4; i++) {
+    BOOST_CHECK_EQUAL(client.data[2*i], i + 1);
+    BOOST_CHECK_EQUAL(client.data[2*i + 1], i + 1);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
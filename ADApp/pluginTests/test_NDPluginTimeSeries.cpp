@@ -339,4 +339,62 @@ BOOST_AUTO_TEST_CASE(trigger_output_NDArray_circular_mode)
 }
 
 
+BOOST_AUTO_TEST_CASE(decimation_filters)
+{
+  BOOST_MESSAGE("Checking the CIC and FIR filters have unity DC gain, 2D input: " << arrays_2d[0]->dims[0].size
+                << " channels with " << arrays_2d[0]->dims[1].size
+                << " elements. Averaging=" << 10 << " Time series length=" << 20);
+
+  // Constant input so every output point after the filter startup transient equals the input
+  for (size_t i = 0; i < arrays_2d.size(); i++)
+  {
+    epicsFloat32 *pData = (epicsFloat32 *)arrays_2d[i]->pData;
+    for (size_t j = 0; j < arrays_2d[i]->dataSize/sizeof(epicsFloat32); j++) pData[j] = 5.0;
+  }
+  BOOST_CHECK_NO_THROW(ts->write(NDArrayCallbacksString, 1));
+  BOOST_CHECK_NO_THROW(ts->write(TSFilterOrderString, 3));
+
+  for (int filterType = 1; filterType <= 2; filterType++)
+  {
+    BOOST_CHECK_NO_THROW(ts->write(TSFilterTypeString, filterType)); // CIC=1, FIR=2
+    BOOST_CHECK_NO_THROW(ts->write(TSAcquireString, 1));
+    for (int i = 0; i < 10; i++)
+    {
+      ts->lock();
+      BOOST_CHECK_NO_THROW(ts->processCallbacks(arrays_2d[i]));
+      ts->unlock();
+      BOOST_CHECK_EQUAL(ts->readInt(TSCurrentPointString), (i+1)*2);
+    }
+    BOOST_CHECK_EQUAL(ts->readInt(TSAcquireString), 0);
+
+    BOOST_REQUIRE_EQUAL(downstream_plugin->arrays.size(), (size_t)filterType);
+    NDArray *pArray = downstream_plugin->arrays.back();
+    BOOST_REQUIRE_EQUAL(pArray->dims[0].size, 20);
+    epicsFloat32 *pOut = (epicsFloat32 *)pArray->pData;
+    // The filters are 3 output points long, so the first 2 points are the startup transient
+    BOOST_CHECK_LT(pOut[0], 5.0);
+    for (int i = 3; i < 20; i++)
+    {
+      BOOST_CHECK_CLOSE(pOut[i], 5.0, 1e-3);
+    }
+  }
+
+  // An unknown filter type is rejected and the FIR filter is still used
+  BOOST_CHECK_THROW(ts->write(TSFilterTypeString, 3), AsynException);
+  BOOST_CHECK_EQUAL(ts->readInt(TSFilterTypeString), 2);
+  BOOST_CHECK_NO_THROW(ts->write(TSAcquireString, 1));
+  ts->lock();
+  BOOST_CHECK_NO_THROW(ts->processCallbacks(arrays_2d[0]));
+  ts->unlock();
+  BOOST_CHECK_EQUAL(ts->readInt(TSCurrentPointString), 2);
+
+  // Filter orders outside 1-16 are rejected and the previous order is kept
+  BOOST_CHECK_THROW(ts->write(TSFilterOrderString, 17), AsynException);
+  BOOST_CHECK_THROW(ts->write(TSFilterOrderString, 0), AsynException);
+  BOOST_CHECK_EQUAL(ts->readInt(TSFilterOrderString), 3);
+  BOOST_CHECK_NO_THROW(ts->write(TSFilterOrderString, 16));
+  BOOST_CHECK_EQUAL(ts->readInt(TSFilterOrderString), 16);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END() // Done!
@@ -301,4 +301,86 @@ BOOST_AUTO_TEST_CASE(test_LoadingDataPoints)
   BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_CurrentQty), 0);
 }
 
+BOOST_AUTO_TEST_CASE(test_LoadingCSVAndBinary)
+{
+  // Create CSV points file
+  {
+    std::ofstream out("/tmp/valid_points.csv");
+    out << "# x and y positions\n"
+           "x,y\n"
+           "0,0\n"
+           "1,0\n"
+           "0,1.5\n";
+  }
+  // Create binary points file with the dimensions in a different order
+  {
+    std::ofstream out("/tmp/valid_points.bin", std::ios::binary);
+    epicsUInt32 header[] = {1, 2, 1};
+    out.write("NDPosBin", 8);
+    out.write((const char *)header, sizeof(header));
+    out.write("y", 1);
+    out.write((const char *)&header[2], sizeof(epicsUInt32));
+    out.write("x", 1);
+    epicsUInt32 numPositions = 2;
+    out.write((const char *)&numPositions, sizeof(numPositions));
+    double values[] = {2.0, 3.0, 4.0, 5.0};
+    out.write((const char *)values, sizeof(values));
+  }
+  // Create CSV points file with other dimensions
+  {
+    std::ofstream out("/tmp/other_points.csv");
+    out << "x,z\n0,0\n";
+  }
+
+  // Load the CSV file, verify qty is 3
+  pos->write(str_NDPos_Filename, "/tmp/valid_points.csv");
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_FileValid), 1);
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_CurrentQty), 3);
+  // Append the binary file, verify qty is 5
+  pos->write(str_NDPos_Filename, "/tmp/valid_points.bin");
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_FileValid), 1);
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_CurrentQty), 5);
+  // Try to append a file with different dimensions, verify error and qty is still 5
+  BOOST_CHECK_THROW(pos->write(str_NDPos_Filename, "/tmp/other_points.csv"), AsynException);
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_FileValid), 0);
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_CurrentQty), 5);
+
+  size_t tmpdims[] = {10,10};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  std::vector<NDArray*>arrays(5);
+  fillNDArraysFromPool(dims, NDUInt32, arrays, arrayPool);
+
+  BOOST_CHECK_NO_THROW(pos->write(str_NDPos_Mode, 0));
+  BOOST_CHECK_NO_THROW(pos->write(str_NDPos_Running, 1));
+  BOOST_CHECK_NO_THROW(pos->write(str_NDPos_ExpectedID, 0));
+
+  double xvals[5] = {0, 1, 0,   3, 5};
+  double yvals[5] = {0, 0, 1.5, 2, 4};
+  for (int i = 0; i < 5; i++)
+  {
+    arrays[i]->uniqueId = i;
+    pos->lock();
+    BOOST_CHECK_NO_THROW(pos->processCallbacks(arrays[i]));
+    pos->unlock();
+    NDArray *arrayPtr = (NDArray *)cbPtr;
+    double val;
+    NDAttribute *aPtr = arrayPtr->pAttributeList->find("x");
+    BOOST_REQUIRE(aPtr != 0);
+    BOOST_CHECK_NO_THROW(aPtr->getValue(NDAttrFloat64, &val));
+    BOOST_CHECK_EQUAL(val, xvals[i]);
+    aPtr = arrayPtr->pAttributeList->find("y");
+    BOOST_REQUIRE(aPtr != 0);
+    BOOST_CHECK_NO_THROW(aPtr->getValue(NDAttrFloat64, &val));
+    BOOST_CHECK_EQUAL(val, yvals[i]);
+    BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_CurrentQty), (4-i));
+  }
+  // All positions have been used, verify the plugin stopped
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_Running), 0);
+
+  // With all positions discarded a file with other dimensions can be loaded
+  pos->write(str_NDPos_Filename, "/tmp/other_points.csv");
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_FileValid), 1);
+  BOOST_CHECK_EQUAL(pos->readInt(str_NDPos_CurrentQty), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
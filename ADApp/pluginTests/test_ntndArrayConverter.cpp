@@ -0,0 +1,113 @@
+/*
+ * test_ntndArrayConverter.cpp
+ *
+ */
+
+#include <stdio.h>
+
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDArray.h>
+#include <asynNDArrayDriver.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include <pv/nt.h>
+#include <ntndArrayConverter.h>
+
+using namespace std;
+using namespace epics::nt;
+
+#include "testingutilities.h"
+
+struct NTNDArrayConverterFixture
+{
+  NDArrayPool *pPool;
+  asynNDArrayDriver *dummy_driver;
+  NTNDArrayPtr ntndArray;
+
+  NTNDArrayConverterFixture()
+  {
+    std::string dummy_port("simNTNDArray");
+    uniqueAsynPortName(dummy_port);
+    dummy_driver = new asynNDArrayDriver(dummy_port.c_str(), 1, 0, 0, asynGenericPointerMask, asynGenericPointerMask, 0, 0, 0, 0);
+    pPool = dummy_driver->pNDArrayPool;
+
+    // The same structure as the record of NDPluginPva
+    NTNDArrayBuilderPtr builder = NTNDArray::createBuilder();
+    builder->addDescriptor()->addTimeStamp()->addAlarm()->addDisplay();
+    ntndArray = builder->create();
+  }
+  ~NTNDArrayConverterFixture()
+  {
+    ntndArray.reset();
+    delete dummy_driver;
+  }
+
+  NDArray *createArray(int uniqueId)
+  {
+    size_t dims[2] = {6, 4};
+    double gain = 2.5;
+    NDArray *pArray = pPool->alloc(2, dims, NDUInt16, 0, NULL);
+    epicsUInt16 *pData = (epicsUInt16 *)pArray->pData;
+    for (size_t i = 0; i < dims[0]*dims[1]; i++) pData[i] = (epicsUInt16)(i + uniqueId);
+    pArray->uniqueId = uniqueId;
+    pArray->pAttributeList->add("Gain", "Detector gain", NDAttrFloat64, &gain);
+    return pArray;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(NTNDArrayConverterTests, NTNDArrayConverterFixture)
+
+BOOST_AUTO_TEST_CASE(test_toArrayPool)
+{
+  NTNDArrayConverter converter(ntndArray);
+  NDArray *pSrc = createArray(42);
+
+  // fromArray does not copy the data, the NTNDArray value holds a reference to the NDArray
+  converter.fromArray(pSrc);
+  BOOST_CHECK_EQUAL(pSrc->getReferenceCount(), 2);
+
+  // toArray(NDArrayPool*) does not copy the data either, the NDArray wraps the NTNDArray value
+  NDArray *pDest = converter.toArray(pPool);
+  BOOST_REQUIRE(pDest != NULL);
+  BOOST_CHECK(pDest->pData == pSrc->pData);
+  BOOST_REQUIRE_EQUAL(pDest->ndims, 2);
+  BOOST_CHECK_EQUAL(pDest->dims[0].size, 6);
+  BOOST_CHECK_EQUAL(pDest->dims[1].size, 4);
+  BOOST_CHECK_EQUAL(pDest->dataType, NDUInt16);
+  BOOST_CHECK_EQUAL(pDest->uniqueId, 42);
+  BOOST_CHECK(pDest->codec.empty());
+  epicsUInt16 *pData = (epicsUInt16 *)pDest->pData;
+  for (int i = 0; i < 24; i++) BOOST_CHECK_EQUAL(pData[i], i + 42);
+  NDAttribute *pAttribute = pDest->pAttributeList->find("Gain");
+  BOOST_REQUIRE(pAttribute != NULL);
+  double gain = 0;
+  BOOST_CHECK_EQUAL(pAttribute->getValue(NDAttrFloat64, &gain), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(gain, 2.5);
+
+  // The wrapped value stays valid after the NTNDArray is given a new value,
+  // until the NDArray from toArray is released
+  NDArray *pNext = createArray(43);
+  converter.fromArray(pNext);
+  BOOST_CHECK_EQUAL(pSrc->getReferenceCount(), 2);
+  BOOST_CHECK_EQUAL(pData[0], 42);
+  pDest->release();
+  BOOST_CHECK_EQUAL(pSrc->getReferenceCount(), 1);
+
+  // A converter that is created for the received structure gives the new value
+  NTNDArrayConverter receiver(ntndArray);
+  pDest = receiver.toArray(pPool);
+  BOOST_REQUIRE(pDest != NULL);
+  BOOST_CHECK_EQUAL(pDest->uniqueId, 43);
+  BOOST_CHECK(pDest->pData == pNext->pData);
+  pDest->release();
+
+  pSrc->release();
+  pNext->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()